@@ -83,6 +83,7 @@ function convert_iff_to_buffer(iff_path)
     "Unsupported IFF type: " .. tostring(form_type))
 
   local sample_rate, raw_data
+  local compression = 0
   local chunk_count = 0
 
   while true do
@@ -99,8 +100,9 @@ function convert_iff_to_buffer(iff_path)
       -- read 16-bit sample rate
       sample_rate = read_be_u16(f)
       debug_print("VHDR sample rate:", sample_rate)
-      -- skip ctOctave (1), sCompression (1), volume (4)
-      f:seek("cur", size - 14)
+      -- ctOctave (1), sCompression (1), volume (4)
+      local rest = f:read(math.max(0, size - 14)) or ""
+      compression = rest:byte(2) or 0
     elseif hdr == "BODY" then
       raw_data = f:read(size)
       debug_print("BODY length:", raw_data and #raw_data)
@@ -122,7 +124,22 @@ function convert_iff_to_buffer(iff_path)
 
   -- Decode samples into normalized floats
   local buffer_data = {}
-  if form_type == "8SVX" then
+  if form_type == "8SVX" and compression == 1 then
+    -- Fibonacci-delta: pad byte, initial value, then two 4-bit delta
+    -- codes per byte, high nibble first
+    local code_to_delta = {-34, -21, -13, -8, -5, -3, -2, -1, 0, 1, 2, 3, 5, 8, 13, 21}
+    local x = raw_data:byte(2) or 0
+    local idx = 1
+    for i = 3, #raw_data do
+      local b = raw_data:byte(i)
+      for _, code in ipairs({math.floor(b / 16), b % 16}) do
+        x = (x + code_to_delta[code + 1]) % 256
+        buffer_data[idx] = ((x < 128) and x or (x - 256)) / 128.0
+        idx = idx + 1
+      end
+    end
+
+  elseif form_type == "8SVX" then
     for i = 1, #raw_data do
       local b = raw_data:byte(i)
       local s8 = (b < 128) and b or (b - 256)
@@ -1335,6 +1352,78 @@ function saveCurrentSampleAs16SV()
   end
 end
 
+--------------------------------------------------------------------------------
+-- Native batch converter (tools/iffconvert): converts a whole file list on
+-- all cores, producing the same files as the Lua converters below
+--------------------------------------------------------------------------------
+
+-- Path of the native converter for this OS, or nil if it is not there
+local function iffconvert_path()
+  local names = { MACINTOSH = "iffconvert_mac", WINDOWS = "iffconvert_win.exe", LINUX = "iffconvert_linux" }
+  local name = names[os.platform()]
+  if not name then return nil end
+  local path = renoise.tool().bundle_path .. "tools" .. separator .. name
+  local f = io.open(path, "rb")
+  if not f then return nil end
+  f:close()
+  return path
+end
+
+-- Convert files to target ("wav", "8svx", "16sv" or "iff") with the native
+-- converter, reporting each file as its manifest line arrives. Returns the
+-- succeeded and failed counts, or nil if the converter is missing.
+local function convert_batch_natively(files, target)
+  local tool = iffconvert_path()
+  if not tool then
+    print("Native IFF converter not found, converting in Lua")
+    return nil
+  end
+  local list_path = os.tmpname()
+  local list = io.open(list_path, "wb")
+  if not list then
+    os.remove(list_path)
+    return nil
+  end
+  list:write(table.concat(files, "\n"), "\n")
+  list:close()
+
+  local cmd = string.format("%q %s %q 2>&1", tool, target, list_path)
+  if os.platform() == "WINDOWS" then
+    -- cmd.exe strips the outer quotes of the whole line
+    cmd = '"' .. cmd .. '"'
+  end
+  debug_print("Running native IFF converter:", cmd)
+  local success_count, fail_count, done = 0, 0, 0
+  local pipe = io.popen(cmd)
+  if pipe then
+    for line in pipe:lines() do
+      local status, index, detail = line:match("^(%u+)\t(%d+)\t([^\t]*)")
+      if status == "OK" or status == "ERR" then
+        done = done + 1
+        local file_path = files[tonumber(index)] or detail
+        if status == "OK" then
+          success_count = success_count + 1
+          debug_print(string.format("Converted %d/%d: %s", done, #files, filename_from_path(file_path)))
+        else
+          fail_count = fail_count + 1
+          print(string.format("Failed %d/%d: %s (Error: %s)", done, #files, file_path, detail))
+        end
+        renoise.app():show_status(string.format("Converting %d/%d...", done, #files))
+      elseif not line:match("^DONE\t") then
+        print("iffconvert: " .. line)
+      end
+    end
+    pipe:close()
+  end
+  os.remove(list_path)
+
+  if done == 0 then
+    -- The converter did not run at all; let the Lua path do the work
+    return nil
+  end
+  return success_count, fail_count + (#files - done)
+end
+
 -- Batch conversion: folder of WAV/AIFF files to 8SVX
 function batchConvertToIFF()
   local folder_path = renoise.app():prompt_for_path("Select Folder Containing WAV/AIFF Files to Convert")
@@ -1371,6 +1460,14 @@ function batchConvertToIFF()
     return
   end
 
+  local native_ok, native_failed = convert_batch_natively(files, "8svx")
+  if native_ok then
+    local status_msg = string.format("Batch conversion complete: %d succeeded, %d failed", native_ok, native_failed)
+    renoise.app():show_status(status_msg)
+    print(status_msg)
+    return
+  end
+
   local success_count = 0
   local fail_count = 0
 
@@ -1458,6 +1555,14 @@ function batchConvertTo16SV()
     return
   end
 
+  local native_ok, native_failed = convert_batch_natively(files, "16sv")
+  if native_ok then
+    local status_msg = string.format("Batch conversion complete: %d succeeded, %d failed", native_ok, native_failed)
+    renoise.app():show_status(status_msg)
+    print(status_msg)
+    return
+  end
+
   local success_count = 0
   local fail_count = 0
 
@@ -1545,6 +1650,14 @@ function batchConvertIFFToWAV()
     return
   end
 
+  local native_ok, native_failed = convert_batch_natively(files, "wav")
+  if native_ok then
+    local status_msg = string.format("Batch IFF to WAV complete: %d succeeded, %d failed", native_ok, native_failed)
+    renoise.app():show_status(status_msg)
+    print(status_msg)
+    return
+  end
+
   local success_count = 0
   local fail_count = 0
 
@@ -1617,6 +1730,14 @@ function batchConvertWAVToIFF()
     return
   end
 
+  local native_ok, native_failed = convert_batch_natively(files, "iff")
+  if native_ok then
+    local status_msg = string.format("Batch WAV to IFF complete: %d succeeded, %d failed", native_ok, native_failed)
+    renoise.app():show_status(status_msg)
+    print(status_msg)
+    return
+  end
+
   local success_count = 0
   local fail_count = 0
 
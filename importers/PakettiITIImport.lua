@@ -1,6 +1,6 @@
 -- PakettiITIImport.lua
 -- Impulse Tracker Instrument (.ITI) importer for Renoise
--- Full IT214/IT215 decompression support
+-- Full IT214/IT215 decompression support (via the native tools/itdecompress)
 
 local _DEBUG = false
 local function dprint(...) if _DEBUG then print("ITI Debug:", ...) end end
@@ -73,6 +73,53 @@ local ENV_ON = 1
 local ENV_LOOP = 2
 local ENV_SUSTAIN_LOOP = 4
 
+local separator = package.config:sub(1,1)
+
+-- Path of the native decompressor for this OS, or nil if it is not there
+local function itdecompress_path()
+  local names = { MACINTOSH = "itdecompress_mac", WINDOWS = "itdecompress_win.exe", LINUX = "itdecompress_linux" }
+  local name = names[os.platform()]
+  if not name then return nil end
+  local path = renoise.tool().bundle_path .. "tools" .. separator .. name
+  local f = io.open(path, "rb")
+  if not f then return nil end
+  f:close()
+  return path
+end
+
+-- Decompress every IT214/IT215 sample of filename to WAV in one run of
+-- the native tool. Returns a table of WAV paths keyed by the byte offset
+-- of each sample header; samples the tool could not decode are missing.
+local function decompress_iti_samples(filename)
+  local decoder = itdecompress_path()
+  if not decoder then
+    dprint("Native decompressor not found, compressed samples get placeholder audio")
+    return {}
+  end
+  local prefix = os.tmpname()
+  local cmd = string.format("%q %q %q 2>&1", decoder, filename, prefix)
+  if os.platform() == "WINDOWS" then
+    -- cmd.exe strips the outer quotes of the whole line
+    cmd = '"' .. cmd .. '"'
+  end
+  dprint("Running:", cmd)
+  local wavs = {}
+  local pipe = io.popen(cmd)
+  if not pipe then return wavs end
+  for line in pipe:lines() do
+    local offset, wav = line:match("^OK\t(%d+)\t([^\t]+)\t")
+    if offset then
+      wavs[tonumber(offset)] = wav
+    else
+      dprint("Decompressor:", line)
+    end
+  end
+  pipe:close()
+  -- os.tmpname may have created the prefix file itself
+  os.remove(prefix)
+  return wavs
+end
+
 function iti_loadinstrument(filename)
   if not filename or filename == "" then
     dprint("ITI import cancelled - no file selected")
@@ -143,16 +190,35 @@ function iti_loadinstrument(filename)
     local sample_positions = find_sample_positions(data)
     
     for i = 1, math.min(instrument_data.num_samples, #sample_positions) do
-      local sample_pos = sample_positions[i]
-      local sample_data = parse_iti_sample(data, sample_pos)
+      local sample_data = parse_iti_sample(data, sample_positions[i])
       if sample_data then
         iti_sample_data[i] = sample_data
-        local renoise_sample = load_iti_sample_to_renoise(instrument, sample_data, data, instrument_data.name)
+      end
+    end
+
+    -- Compressed samples are decoded natively, all in one go
+    local decoded_wavs = {}
+    for _, sample_data in pairs(iti_sample_data) do
+      if bit_and(sample_data.flags, SAMPLE_COMPRESSED) ~= 0 then
+        decoded_wavs = decompress_iti_samples(filename)
+        break
+      end
+    end
+
+    for i = 1, math.min(instrument_data.num_samples, #sample_positions) do
+      local sample_data = iti_sample_data[i]
+      if sample_data then
+        local decoded_wav = decoded_wavs[sample_data.header_offset]
+        local renoise_sample = load_iti_sample_to_renoise(instrument, sample_data, data, instrument_data.name, decoded_wav)
         if renoise_sample then
           loaded_samples[i] = renoise_sample
         end
       end
     end
+
+    for _, wav in pairs(decoded_wavs) do
+      os.remove(wav)
+    end
   end
   
   if #loaded_samples > 0 then
@@ -214,6 +280,7 @@ function parse_iti_sample(data, pos)
     return nil
   end
   
+  local header_offset = pos - 1
   pos = pos + 4
   pos = pos + 12  -- Skip DOS filename
   pos = pos + 1   -- Skip null byte
@@ -242,11 +309,12 @@ function parse_iti_sample(data, pos)
     loop_begin = loop_begin,
     loop_end = loop_end,
     c5_speed = c5_speed,
-    sample_pointer = sample_pointer
+    sample_pointer = sample_pointer,
+    header_offset = header_offset
   }
 end
 
-function load_iti_sample_to_renoise(instrument, sample_data, file_data, instrument_name)
+function load_iti_sample_to_renoise(instrument, sample_data, file_data, instrument_name, decoded_wav)
   if sample_data.length == 0 or bit_and(sample_data.flags, SAMPLE_ASSOCIATED) == 0 then
     return nil
   end
@@ -267,18 +335,35 @@ function load_iti_sample_to_renoise(instrument, sample_data, file_data, instrume
   local channels = bit_and(sample_data.flags, SAMPLE_STEREO) ~= 0 and 2 or 1
   local bit_depth = bit_and(sample_data.flags, SAMPLE_16BIT) ~= 0 and 16 or 8
   
-  local create_success = pcall(function()
-    sample.sample_buffer:create_sample_data(sample_rate, bit_depth, channels, sample_data.length)
-  end)
-  
-  if not create_success then
-    return nil
+  if decoded_wav then
+    -- Decompressed by the native tool; the WAV carries rate, depth and channels.
+    -- load_from returns false rather than raising when it cannot read the file
+    local ok, loaded = pcall(function()
+      return sample.sample_buffer:load_from(decoded_wav)
+    end)
+    if ok and loaded and sample.sample_buffer.has_sample_data then
+      sample.name = (sample_data.name ~= "" and sample_data.name) or
+                    string.format("%s sample %02d", instrument_name or "ITI", sample_index)
+    else
+      print("Failed to load decompressed sample " .. decoded_wav .. ", reading it in Lua")
+      decoded_wav = nil
+    end
   end
-  
-  -- Load sample data (compressed or uncompressed)
-  local load_success = load_sample_data(sample, sample_data, file_data)
-  if not load_success then
-    return nil
+  if not decoded_wav then
+    local create_success = pcall(function()
+      sample.sample_buffer:create_sample_data(sample_rate, bit_depth, channels, sample_data.length)
+    end)
+    
+    if not create_success then
+      return nil
+    end
+    
+    -- Load sample data (uncompressed, or a placeholder for compressed
+    -- samples the native tool could not decode)
+    local load_success = load_sample_data(sample, sample_data, file_data)
+    if not load_success then
+      return nil
+    end
   end
   
   -- Set loop properties
@@ -309,7 +394,8 @@ function load_sample_data(sample, sample_data, file_data)
   
   local success = false
   if is_compressed then
-    -- Create audible placeholder for compressed samples
+    -- Create audible placeholder for compressed samples the native
+    -- decompressor was unavailable for
     success = create_placeholder_sample_data(buffer, sample_data, channels)
   else
     success = load_uncompressed_sample_data(buffer, sample_data, file_data, channels, is_16bit, is_signed)
@@ -3,7 +3,7 @@ local function dprint(...) if _DEBUG then print("REX Debug:", ...) end end
 
 local function get_clean_filename(filepath)
   local filename = filepath:match("[^/\\]+$")
-  if filename then return filename:gsub("%.rex$", "") end
+  if filename then return filename:gsub("%.rex$", ""):gsub("%.rcy$", "") end
   return "REX Sample"
 end
 
@@ -12,6 +12,39 @@ local function read_dword(data, pos)
   return (b1 * 16777216) + (b2 * 65536) + (b3 * 256) + b4
 end
 
+-- Slice settings, names and the macro device, shared by the native and
+-- the Lua import
+local function finish_rex_import(filename, new_smp, slice_count)
+  local song = renoise.song()
+
+  -- Enable oversampling for all slices
+  for i = 1, #renoise.song().selected_instrument.samples[1].slice_markers do
+    renoise.song().selected_instrument.samples[i+1].oversample_enabled = true
+  end
+
+  -- Set names
+  new_smp.name = get_clean_filename(filename)
+  song.selected_instrument.name = get_clean_filename(filename)
+  renoise.song().instruments[renoise.song().selected_instrument_index].sample_modulation_sets[1].name=get_clean_filename(filename)
+  renoise.song().instruments[renoise.song().selected_instrument_index].sample_device_chains[1].name=get_clean_filename(filename)
+
+  dprint("Import completed successfully")
+
+  -- Always create automation device
+  if renoise.song().selected_track.type == 2 then 
+    renoise.app():show_status("*Instr. Macro Device will not be added to the Master track.") 
+    return 
+  else
+    loadnative("Audio/Effects/Native/*Instr. Macros") 
+    local macro_device = renoise.song().selected_track:device(2)
+    macro_device.display_name = string.format("%02X", renoise.song().selected_instrument_index - 1) .. " " .. get_clean_filename(filename)
+    renoise.song().selected_track.devices[2].is_maximized = false
+  end
+  
+  renoise.app():show_status(string.format("REX cleaned and imported with %d slice markers", slice_count))
+  return true
+end
+
 function rex_loadsample(filename)
   dprint("Starting REX import for file:", filename)
   
@@ -33,6 +66,23 @@ function rex_loadsample(filename)
     dprint("Using Paketti default instrument configuration")
   end
   local smp = song.selected_sample
+
+  -- The native decoder drops the slice headers and places the markers in
+  -- one pass over the file; the AIFF round trip below is the fallback
+  if rex_native_import then
+    local native_success, slice_count = rex_native_import(filename, smp)
+    if native_success then
+      dprint("Imported with the native decoder:", slice_count, "slices")
+      smp.autofade = true
+      smp.autoseek = false
+      smp.loop_mode = 1
+      smp.interpolation_mode = renoise.Sample.INTERPOLATE_SINC
+      smp.oversample_enabled = true
+      smp.oneshot = false
+      smp.loop_release = false
+      return finish_rex_import(filename, smp, slice_count)
+    end
+  end
   
   -- Create temporary AIFF file
   local aiff_copy = os.tmpname() .. ".aiff"
@@ -315,33 +365,8 @@ function rex_loadsample(filename)
   end
   dprint(string.format("Added %d slice markers in total (including start)", #slice_offsets + 1))
 
-  -- Enable oversampling for all slices
-  for i = 1, #renoise.song().selected_instrument.samples[1].slice_markers do
-    renoise.song().selected_instrument.samples[i+1].oversample_enabled = true
-  end
-
-  -- Set names
-  new_smp.name = get_clean_filename(filename)
-  song.selected_instrument.name = get_clean_filename(filename)
-  renoise.song().instruments[renoise.song().selected_instrument_index].sample_modulation_sets[1].name=get_clean_filename(filename)
-  renoise.song().instruments[renoise.song().selected_instrument_index].sample_device_chains[1].name=get_clean_filename(filename)
-
   os.remove(aiff_copy)
-  dprint("Import completed successfully")
-
-  -- Always create automation device
-  if renoise.song().selected_track.type == 2 then 
-    renoise.app():show_status("*Instr. Macro Device will not be added to the Master track.") 
-    return 
-  else
-    loadnative("Audio/Effects/Native/*Instr. Macros") 
-    local macro_device = renoise.song().selected_track:device(2)
-    macro_device.display_name = string.format("%02X", renoise.song().selected_instrument_index - 1) .. " " .. get_clean_filename(filename)
-    renoise.song().selected_track.devices[2].is_maximized = false
-  end
-  
-  renoise.app():show_status(string.format("REX cleaned and imported with %d slice markers", #slice_offsets))
-  return true
+  return finish_rex_import(filename, new_smp, #slice_offsets)
 end
 
 -- DEBUG TOOL: Dump REX structure to .txt
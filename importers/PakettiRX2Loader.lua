@@ -1,18 +1,121 @@
 local separator = package.config:sub(1,1)  -- Gets \ for Windows, / for Unix
 
+--------------------------------------------------------------------------------
+-- Helper: Read the binary .rx2meta sidecar written by the decoder.
+-- Layout (see rx2/sidecar.h): "PKRX", u32 version, then chunks of
+-- 4-byte id + u32 size + payload. Unknown chunks and record bytes past the
+-- known fields are skipped. Returns nil if data is not a sidecar.
+--------------------------------------------------------------------------------
+local function read_u32_le(data, pos)
+  local b1, b2, b3, b4 = data:byte(pos, pos + 3)
+  return b1 + (b2 * 256) + (b3 * 65536) + (b4 * 16777216)
+end
+
+local function read_i32_le(data, pos)
+  local v = read_u32_le(data, pos)
+  if v >= 2147483648 then v = v - 4294967296 end
+  return v
+end
+
+local function parse_rx2_sidecar(data)
+  if #data < 8 or data:sub(1, 4) ~= "PKRX" then
+    return nil
+  end
+  local meta = { version = read_u32_le(data, 5), info = {}, creator = nil, slices = {} }
+  local pos = 9
+  while pos + 7 <= #data do
+    local id = data:sub(pos, pos + 3)
+    local size = read_u32_le(data, pos + 4)
+    local body = pos + 8
+    if body + size - 1 > #data then
+      print("Warning: truncated sidecar chunk " .. id)
+      break
+    end
+    if id == "INFO" then
+      local names = { "channels", "sample_rate", "slice_count", "tempo", "original_tempo",
+        "ppq_length", "time_sign_nom", "time_sign_denom", "bit_depth",
+        "rendered_frames", "output_bits", "render_mode", "marker_offset" }
+      for i, name in ipairs(names) do
+        if i * 4 <= size then
+          meta.info[name] = read_i32_le(data, body + (i - 1) * 4)
+        end
+      end
+    elseif id == "CRTR" then
+      local creator = {}
+      local p = body
+      for _, name in ipairs({ "name", "copyright", "url", "email", "free_text" }) do
+        if p + 3 >= body + size then break end
+        local len = read_u32_le(data, p)
+        creator[name] = data:sub(p + 4, p + 3 + len)
+        p = p + 4 + len
+      end
+      meta.creator = creator
+    elseif id == "SLCE" and size >= 8 then
+      local count = read_u32_le(data, body)
+      local record_bytes = read_u32_le(data, body + 4)
+      -- Levels are hundredths of a dBFS (-14400 is silence), onset_frame -1 means none found
+      local fields = { "ppq_pos", "sample_length", "start_frame", "length_frames", "marker",
+        "peak_level", "rms_level", "onset_frame" }
+      for i = 0, count - 1 do
+        local record = body + 8 + i * record_bytes
+        if record + record_bytes - 1 > body + size - 1 then break end
+        local slice = {}
+        for f, name in ipairs(fields) do
+          if f * 4 <= record_bytes then
+            slice[name] = read_i32_le(data, record + (f - 1) * 4)
+          end
+        end
+        meta.slices[#meta.slices + 1] = slice
+      end
+    end
+    pos = body + size
+  end
+  return meta
+end
+
 --------------------------------------------------------------------------------
 -- Helper: Read and process slice marker file.
--- The file is assumed to contain lines like:
+-- Newer decoders write a binary .rx2meta sidecar; older ones write lines like:
 --    renoise.song().selected_sample:insert_slice_marker(12345)
+-- Both are accepted. Returns true and the sidecar table (nil for the text
+-- format) on success.
 --------------------------------------------------------------------------------
 local function load_slice_markers(slice_file_path)
-  local file = io.open(slice_file_path, "r")
+  local file = io.open(slice_file_path, "rb")
   if not file then
     renoise.app():show_status("Could not open slice marker file: " .. slice_file_path)
     return false
   end
-  
-  for line in file:lines() do
+  local data = file:read("*a")
+  file:close()
+
+  local meta = parse_rx2_sidecar(data)
+  if meta then
+    local info = meta.info
+    print(string.format("RX2 sidecar v%d: %d slices, %.3f BPM (original %.3f), %d/%d, %d-bit source, %d-bit output",
+      meta.version, #meta.slices, (info.tempo or 0) / 1000, (info.original_tempo or 0) / 1000,
+      info.time_sign_nom or 0, info.time_sign_denom or 0, info.bit_depth or 0, info.output_bits or 0))
+    if meta.creator and meta.creator.name and meta.creator.name ~= "" then
+      print("RX2 creator:", meta.creator.name)
+    end
+    if info.marker_offset and info.render_mode == 0 then
+      print("Decoder marker offset:", info.marker_offset, "frames")
+    end
+    for _, slice in ipairs(meta.slices) do
+      if slice.marker then
+        renoise.song().selected_sample:insert_slice_marker(slice.marker)
+        if slice.peak_level then
+          print(string.format("Inserted slice marker at position %d (peak %.2f dB, RMS %.2f dB, onset %d)",
+            slice.marker, slice.peak_level / 100, slice.rms_level / 100, slice.onset_frame))
+        else
+          print("Inserted slice marker at position", slice.marker)
+        end
+      end
+    end
+    return true, meta
+  end
+
+  for line in data:gmatch("[^\r\n]+") do
     -- Extract the number between parentheses, e.g. "insert_slice_marker(12345)"
     local marker = tonumber(line:match("%((%d+)%)"))
     if marker then
@@ -22,8 +125,7 @@ local function load_slice_markers(slice_file_path)
       print("Warning: Could not parse marker from line:", line)
     end
   end
-  
-  file:close()
+
   return true
 end
 
@@ -78,6 +180,51 @@ local function setup_os_specific_paths()
   return setup_success, rex_decoder_path, sdk_path
 end
 
+--------------------------------------------------------------------------------
+-- Helper: Temp output prefix that no other import uses. Building it from the
+-- instrument name alone let two imports of same-named loops overwrite each
+-- other's files, and a leftover file could pass for a fresh one.
+--------------------------------------------------------------------------------
+local rx2_temp_counter = 0
+
+local function unique_temp_prefix(temp_folder, instrument_name)
+  while true do
+    rx2_temp_counter = rx2_temp_counter + 1
+    local prefix = string.format("%s%s%s_%d_%d_%d", temp_folder, separator, instrument_name,
+      os.time(), rx2_temp_counter, math.random(100000, 999999))
+    local f = io.open(prefix .. "_output.wav", "rb")
+    if not f then
+      return prefix
+    end
+    f:close()
+  end
+end
+
+--------------------------------------------------------------------------------
+-- Helper: Folder for the decoder's temporary outputs
+--------------------------------------------------------------------------------
+local function decoder_temp_folder()
+  local os_name = os.platform()
+  if os_name == "MACINTOSH" then
+    return os.getenv("TMPDIR")
+  elseif os_name == "WINDOWS" then
+    return os.getenv("TEMP")
+  end
+  return "/tmp"
+end
+
+--------------------------------------------------------------------------------
+-- Helper: Command line running the external decoder on one file
+--------------------------------------------------------------------------------
+local function decoder_command(rex_decoder_path, filename, wav_output, txt_output, sdk_path)
+  if os.platform() == "LINUX" then
+    return string.format("wine %q %q %q %q %q 2>&1",
+      rex_decoder_path, filename, wav_output, txt_output, sdk_path)
+  end
+  return string.format("%s %q %q %q %q 2>&1",
+    rex_decoder_path, filename, wav_output, txt_output, sdk_path)
+end
+
 --------------------------------------------------------------------------------
 -- Main RX2 import function using the external decoder
 --------------------------------------------------------------------------------
@@ -130,40 +277,26 @@ function rx2_loadsample(filename)
   renoise.song().selected_sample.name = rx2_basename
  
   -- Define paths for the output WAV file and the slice marker text file
-  local TEMP_FOLDER = "/tmp"
-  local os_name = os.platform()
-  if os_name == "MACINTOSH" then
-    TEMP_FOLDER = os.getenv("TMPDIR")
-  elseif os_name == "WINDOWS" then
-    TEMP_FOLDER = os.getenv("TEMP")
-  end
+  local TEMP_FOLDER = decoder_temp_folder()
 
+  local temp_prefix = unique_temp_prefix(TEMP_FOLDER, instrument_name)
+  local wav_output = temp_prefix .. "_output.wav"
+  -- Decoders that know the .rx2meta extension write the binary sidecar;
+  -- older ones write marker lines to the same path, which are also accepted
+  local txt_output = temp_prefix .. "_slices.rx2meta"
 
-  local wav_output = TEMP_FOLDER .. separator .. instrument_name .. "_output.wav"
-  local txt_output = TEMP_FOLDER .. separator .. instrument_name .. "_slices.txt"
+  -- The sample data and markers are copied into the song, so the decoder
+  -- output is removed again however the import ends
+  local function remove_temp_outputs()
+    os.remove(wav_output)
+    os.remove(txt_output)
+  end
 
 print (wav_output)
 print (txt_output)
 
 -- Build and run the command to execute the external decoder
-local cmd
-if os_name == "LINUX" then
-  cmd = string.format("wine %q %q %q %q %q 2>&1", 
-    rex_decoder_path,  -- decoder executable
-    filename,          -- input file
-    wav_output,        -- output WAV file
-    txt_output,        -- output TXT file
-    sdk_path           -- SDK directory
-  )
-else
-  cmd = string.format("%s %q %q %q %q 2>&1", 
-    rex_decoder_path,  -- decoder executable
-    filename,          -- input file
-    wav_output,        -- output WAV file
-    txt_output,        -- output TXT file
-    sdk_path           -- SDK directory
-  )
-end
+local cmd = decoder_command(rex_decoder_path, filename, wav_output, txt_output, sdk_path)
 
 print("----- Running External Decoder Command -----")
 print(cmd)
@@ -186,6 +319,7 @@ if (result ~= 0) then
   else
     print("Decoder returned error code", result)
     renoise.app():show_status("External decoder failed with error code " .. tostring(result))
+    remove_temp_outputs()
     return false
   end
 end
@@ -198,11 +332,13 @@ end
   if not load_success then
     print("Failed to load WAV file:", wav_output)
     renoise.app():show_status("RX2 Import Error: Failed to load decoded sample.")
+    remove_temp_outputs()
     return false
   end
   if not smp.sample_buffer.has_sample_data then
     print("Loaded WAV file has no sample data")
     renoise.app():show_status("RX2 Import Error: No audio data in decoded sample.")
+    remove_temp_outputs()
     return false
   end
   print("Sample loaded successfully from external decoder")
@@ -214,6 +350,7 @@ end
   else
     print("Warning: Could not load slice markers from file:", txt_output)
   end
+  remove_temp_outputs()
 
   -- Set sample properties
   smp.autofade = true
@@ -228,3 +365,75 @@ end
   return true
 end
 
+--------------------------------------------------------------------------------
+-- REX1 (.rex) and ReCycle (.rcy) import through the external decoder, which
+-- cuts out the slice headers and writes the markers in one pass over the
+-- file without loading the REX library. Loads the result into smp and
+-- returns true and the slice count; on false smp is untouched, so the
+-- caller can fall back to its own AIFF round trip.
+--------------------------------------------------------------------------------
+-- Decoders built before the REX1 parser hand these files to the REX library's
+-- preview render instead, so only use one whose usage text says it reads them
+local decoder_reads_rex1_cache = {}
+
+local function decoder_reads_rex1(rex_decoder_path)
+  if decoder_reads_rex1_cache[rex_decoder_path] == nil then
+    local cmd = string.format("%s 2>&1", rex_decoder_path)
+    if os.platform() == "LINUX" then
+      cmd = string.format("wine %q 2>&1", rex_decoder_path)
+    end
+    local usage = ""
+    local pipe = io.popen(cmd)
+    if pipe then
+      usage = pipe:read("*a") or ""
+      pipe:close()
+    end
+    decoder_reads_rex1_cache[rex_decoder_path] =
+      usage:find("REX1 (.rex) and ReCycle (.rcy) inputs are decoded", 1, true) ~= nil
+  end
+  return decoder_reads_rex1_cache[rex_decoder_path]
+end
+
+function rex_native_import(filename, smp)
+  local setup_success, rex_decoder_path, sdk_path = setup_os_specific_paths()
+  if not setup_success or not rex_decoder_path then
+    return false
+  end
+  if not decoder_reads_rex1(rex_decoder_path) then
+    print("External decoder cannot read REX1 files, using the Lua importer")
+    return false
+  end
+
+  local rex_name = (filename:match("[^/\\]+$") or "REX Sample"):gsub("%.[^.]+$", "")
+  local temp_prefix = unique_temp_prefix(decoder_temp_folder(), rex_name)
+  local wav_output = temp_prefix .. "_output.wav"
+  local txt_output = temp_prefix .. "_slices.rx2meta"
+  local function remove_temp_outputs()
+    os.remove(wav_output)
+    os.remove(txt_output)
+  end
+
+  local cmd = decoder_command(rex_decoder_path, filename, wav_output, txt_output, sdk_path)
+  print("Running external decoder command:", cmd)
+  if os.execute(cmd) ~= 0 then
+    print("Native REX decode failed, using the Lua importer")
+    remove_temp_outputs()
+    return false
+  end
+
+  local load_success = pcall(function()
+    smp.sample_buffer:load_from(wav_output)
+  end)
+  if not load_success or not smp.sample_buffer.has_sample_data then
+    print("Failed to load natively decoded REX:", wav_output)
+    remove_temp_outputs()
+    return false
+  end
+
+  local success, meta = load_slice_markers(txt_output)
+  remove_temp_outputs()
+  if not success then
+    print("Warning: Could not load slice markers from file:", txt_output)
+  end
+  return true, meta and #meta.slices or #smp.slice_markers
+end
@@ -445,12 +445,141 @@ local function read_presets(data)
   return presets
 end
 
+--------------------------------------------------------------------------------
+-- Native extractor (tools/sf2extract): mmaps the SoundFont, writes each
+-- sample the presets use to a WAV and describes presets and zones in a
+-- tab-separated .sf2map, so the file is never read into Lua
+--------------------------------------------------------------------------------
+local separator = package.config:sub(1,1)
+
+-- Path of the native extractor for this OS, or nil if it is not there
+local function sf2extract_path()
+  local names = { MACINTOSH = "sf2extract_mac", WINDOWS = "sf2extract_win.exe", LINUX = "sf2extract_linux" }
+  local name = names[os.platform()]
+  if not name then return nil end
+  local path = renoise.tool().bundle_path .. "tools" .. separator .. name
+  local f = io.open(path, "rb")
+  if not f then return nil end
+  f:close()
+  return path
+end
+
+-- "op:amount op:amount" ("-" for none) to a params table like the Lua parser's
+local function parse_gen_list(text)
+  local params = {}
+  for op, amount in text:gmatch("(%d+):(%d+)") do
+    params[tonumber(op)] = tonumber(amount)
+  end
+  return params
+end
+
+-- Run the extractor and build the same mappings the Lua parser builds in
+-- sf2_loadsample. The key range and sample name fallbacks are resolved by
+-- the extractor and arrive as ordinary ZONE records without instrument
+-- generators. Sample headers carry the path of their WAV in .wav.
+-- Returns mappings and the files to remove after the import, or nil if
+-- the extractor is missing or failed.
+local function extract_sf2_natively(file_path)
+  local tool = sf2extract_path()
+  if not tool then
+    print("Native SF2 extractor not found, parsing in Lua")
+    return nil
+  end
+  local prefix = os.tmpname()
+  local files = { prefix, prefix .. ".sf2map" }
+  local cmd = string.format("%q %q %q 2>&1", tool, file_path, prefix)
+  if os.platform() == "WINDOWS" then
+    -- cmd.exe strips the outer quotes of the whole line
+    cmd = '"' .. cmd .. '"'
+  end
+  print("Running native SF2 extractor: " .. cmd)
+  local pipe = io.popen(cmd)
+  if pipe then
+    for line in pipe:lines() do
+      print("sf2extract: " .. line)
+    end
+    pipe:close()
+  end
+
+  local map_file = io.open(prefix .. ".sf2map", "rb")
+  if not map_file then
+    for _, path in ipairs(files) do os.remove(path) end
+    return nil
+  end
+  local headers = {}
+  local mappings = {}
+  local current = nil
+  for line in map_file:lines() do
+    local f = {}
+    for field in (line .. "\t"):gmatch("([^\t]*)\t") do
+      f[#f + 1] = field
+    end
+    if f[1] == "SAMPLE" then
+      local hdr = {
+        name        = f[12],
+        s_start     = 0,
+        s_end       = tonumber(f[3]),
+        loop_start  = tonumber(f[7]),
+        loop_end    = tonumber(f[8]),
+        sample_rate = tonumber(f[4]),
+        orig_pitch  = tonumber(f[5]),
+        pitch_corr  = tonumber(f[6]),
+        sample_link = tonumber(f[10]),
+        sample_type = tonumber(f[9]),
+        wav         = f[13],
+      }
+      headers[tonumber(f[2])] = hdr
+      files[#files + 1] = hdr.wav
+    elseif f[1] == "PRESET" then
+      local last_params = parse_gen_list(f[5])
+      local key_range = nil
+      if last_params[43] then
+        local kr = last_params[43]
+        key_range = { low = math.min(119, kr % 256), high = math.min(119, math.floor(kr / 256) % 256) }
+      end
+      current = {
+        preset_name = f[4],
+        bank = tonumber(f[2]),
+        preset_num = tonumber(f[3]),
+        samples = {},
+        fallback_params = last_params,
+        key_range = key_range
+      }
+      mappings[#mappings + 1] = current
+    elseif f[1] == "ZONE" and current then
+      -- Zones of samples without a WAV (empty or broken headers) are skipped
+      local hdr = headers[tonumber(f[2])]
+      if hdr then
+        if f[4] == "-" then
+          print("  Fallback (no instrument zone) => Sample " .. hdr.name .. " for preset " .. current.preset_name)
+        end
+        current.samples[#current.samples + 1] = {
+          header = hdr,
+          zone_params = parse_gen_list(f[3]),
+          inst_zone_params = parse_gen_list(f[4])
+        }
+      end
+    end
+  end
+  map_file:close()
+
+  -- Presets whose zones all pointed at skipped samples
+  local usable = {}
+  for _, map in ipairs(mappings) do
+    if #map.samples > 0 then usable[#usable + 1] = map end
+  end
+  print(string.format("Native SF2 extractor: %d presets with samples", #usable))
+  return usable, files
+end
+
 --------------------------------------------------------------------------------
 -- Step 4: Import SF2
 --------------------------------------------------------------------------------
 function sf2_loadsample(file_path)
   -- Create a ProcessSlicer to handle the import
   local slicer = nil
+  -- Temporary files from the native extractor, removed however the import ends
+  local native_files = nil
   
   local function process_import()
     local dialog, vb = nil, nil
@@ -459,144 +588,149 @@ function sf2_loadsample(file_path)
     renoise.app():show_status("Starting SF2 import...")
     print("Importing SF2 file: " .. file_path)
 
-    local f = io.open(file_path, "rb")
-    if not f then
-      renoise.app():show_error("Could not open SF2 file: " .. file_path)
-      return false
-    end
-    local data = f:read("*all")
-    f:close()
+    local data, smpl_data_start
+    local mappings
+    mappings, native_files = extract_sf2_natively(file_path)
+    if not mappings then
+      local f = io.open(file_path, "rb")
+      if not f then
+        renoise.app():show_error("Could not open SF2 file: " .. file_path)
+        return false
+      end
+      data = f:read("*all")
+      f:close()
 
-    if data:sub(1,4) ~= "RIFF" then
-      renoise.app():show_error("Invalid SF2 file (missing RIFF header).")
-      return false
-    end
-    print("RIFF header found.")
+      if data:sub(1,4) ~= "RIFF" then
+        renoise.app():show_error("Invalid SF2 file (missing RIFF header).")
+        return false
+      end
+      print("RIFF header found.")
 
-    local smpl_pos = data:find("smpl", 1, true)
-    if not smpl_pos then
-      renoise.app():show_error("SF2 file missing 'smpl' chunk.")
-      return false
-    end
-    local smpl_data_start = smpl_pos + 8
+      local smpl_pos = data:find("smpl", 1, true)
+      if not smpl_pos then
+        renoise.app():show_error("SF2 file missing 'smpl' chunk.")
+        return false
+      end
+      smpl_data_start = smpl_pos + 8
 
-    -- Read SF2 components:
-    if vb then vb.views.progress_text.text = "Reading sample headers..." end
-    coroutine.yield()
+      -- Read SF2 components:
+      if vb then vb.views.progress_text.text = "Reading sample headers..." end
+      coroutine.yield()
     
-    local headers = read_sample_headers(data)
-    if not headers or #headers == 0 then
-      renoise.app():show_error("No sample headers found in SF2.")
-      return false
-    end
+      local headers = read_sample_headers(data)
+      if not headers or #headers == 0 then
+        renoise.app():show_error("No sample headers found in SF2.")
+        return false
+      end
 
-    if vb then vb.views.progress_text.text = "Reading instruments..." end
-    coroutine.yield()
+      if vb then vb.views.progress_text.text = "Reading instruments..." end
+      coroutine.yield()
     
-    local instruments_zones = read_instruments(data)
+      local instruments_zones = read_instruments(data)
     
-    if vb then vb.views.progress_text.text = "Reading presets..." end
-    coroutine.yield()
+      if vb then vb.views.progress_text.text = "Reading presets..." end
+      coroutine.yield()
     
-    local presets = read_presets(data)
-    if #presets == 0 then
-      renoise.app():show_error("No presets found in SF2.")
-      return false
-    end
+      local presets = read_presets(data)
+      if #presets == 0 then
+        renoise.app():show_error("No presets found in SF2.")
+        return false
+      end
 
-    -- Build a mapping: one XRNI instrument per preset
-    local mappings = {}
+      -- Build a mapping: one XRNI instrument per preset
+      mappings = {}
 
-    if vb then vb.views.progress_text.text = "Processing presets..." end
-    coroutine.yield()
+      if vb then vb.views.progress_text.text = "Processing presets..." end
+      coroutine.yield()
 
-    for _, preset in ipairs(presets) do
-      if slicer:was_cancelled() then
-        return false
-      end
-      
-      print("Preset " .. preset.name)
-      local combined_samples = {}
-      for _, zone in ipairs(preset.zones) do
-        local assigned_samples = {}
-        local zone_params = zone.params or {}
-
-        print("Processing preset zone params:")
-        for k,v in pairs(zone_params) do
-            print("  [" .. k .. "] = " .. v)
+      for _, preset in ipairs(presets) do
+        if slicer:was_cancelled() then
+          return false
         end
+      
+        print("Preset " .. preset.name)
+        local combined_samples = {}
+        for _, zone in ipairs(preset.zones) do
+          local assigned_samples = {}
+          local zone_params = zone.params or {}
+
+          print("Processing preset zone params:")
+          for k,v in pairs(zone_params) do
+              print("  [" .. k .. "] = " .. v)
+          end
 
-        -- If there's an assigned instrument
-        if zone_params[41] then
-          local inst_idx = zone_params[41] + 1
-          local inst_info = instruments_zones[inst_idx]
-          if inst_info and inst_info.zones then
-            for _, izone in ipairs(inst_info.zones) do
-              if izone.sample_id then
-                local hdr_idx = izone.sample_id + 1
-                local hdr = headers[hdr_idx]
-                if hdr then
-                  print("  Instrument " .. inst_info.name .. " => Sample " .. hdr.name .. " (SampleID " .. izone.sample_id .. ")")
-                  print("  Instrument zone params:")
-                  for k,v in pairs(izone.params or {}) do
-                      print("    [" .. k .. "] = " .. v)
+          -- If there's an assigned instrument
+          if zone_params[41] then
+            local inst_idx = zone_params[41] + 1
+            local inst_info = instruments_zones[inst_idx]
+            if inst_info and inst_info.zones then
+              for _, izone in ipairs(inst_info.zones) do
+                if izone.sample_id then
+                  local hdr_idx = izone.sample_id + 1
+                  local hdr = headers[hdr_idx]
+                  if hdr then
+                    print("  Instrument " .. inst_info.name .. " => Sample " .. hdr.name .. " (SampleID " .. izone.sample_id .. ")")
+                    print("  Instrument zone params:")
+                    for k,v in pairs(izone.params or {}) do
+                        print("    [" .. k .. "] = " .. v)
+                    end
+                    assigned_samples[#assigned_samples+1] = {
+                      header = hdr,
+                      zone_params = zone_params,
+                      inst_zone_params = izone.params
+                    }
                   end
-                  assigned_samples[#assigned_samples+1] = {
-                    header = hdr,
-                    zone_params = zone_params,
-                    inst_zone_params = izone.params
-                  }
                 end
               end
             end
           end
-        end
 
-        -- Fallback: key_range from the preset zone
-        if #assigned_samples == 0 and zone.key_range then
-          for _, hdr in ipairs(headers) do
-            if hdr.orig_pitch >= zone.key_range.low and hdr.orig_pitch <= zone.key_range.high then
-              print("  KeyRange fallback => Sample " .. hdr.name .. " (pitch " .. hdr.orig_pitch .. " in range " .. zone.key_range.low .. "-" .. zone.key_range.high .. ")")
-              assigned_samples[#assigned_samples+1] = {
-                header = hdr,
-                zone_params = zone_params
-              }
+          -- Fallback: key_range from the preset zone
+          if #assigned_samples == 0 and zone.key_range then
+            for _, hdr in ipairs(headers) do
+              if hdr.orig_pitch >= zone.key_range.low and hdr.orig_pitch <= zone.key_range.high then
+                print("  KeyRange fallback => Sample " .. hdr.name .. " (pitch " .. hdr.orig_pitch .. " in range " .. zone.key_range.low .. "-" .. zone.key_range.high .. ")")
+                assigned_samples[#assigned_samples+1] = {
+                  header = hdr,
+                  zone_params = zone_params
+                }
+              end
             end
           end
-        end
 
-        -- Substring fallback if we still have no assigned samples
-        if #assigned_samples == 0 then
-          for _, hdr in ipairs(headers) do
-            if hdr.name:lower():find(preset.name:lower()) then
-              print("  Substring fallback => Sample " .. hdr.name)
-              assigned_samples[#assigned_samples+1] = {
-                header = hdr,
-                zone_params = zone_params
-              }
+          -- Substring fallback if we still have no assigned samples
+          if #assigned_samples == 0 then
+            for _, hdr in ipairs(headers) do
+              if hdr.name:lower():find(preset.name:lower()) then
+                print("  Substring fallback => Sample " .. hdr.name)
+                assigned_samples[#assigned_samples+1] = {
+                  header = hdr,
+                  zone_params = zone_params
+                }
+              end
             end
           end
-        end
 
-        for _, smp_entry in ipairs(assigned_samples) do
-          combined_samples[#combined_samples+1] = smp_entry
+          for _, smp_entry in ipairs(assigned_samples) do
+            combined_samples[#combined_samples+1] = smp_entry
+          end
         end
-      end
 
-      if #combined_samples > 0 then
-        mappings[#mappings+1] = {
-          preset_name = preset.name,
-          bank = preset.bank,
-          preset_num = preset.preset,
-          samples = combined_samples,
-          fallback_params = (preset.zones[#preset.zones] and preset.zones[#preset.zones].params) or {},
-          key_range = (preset.zones[#preset.zones] and preset.zones[#preset.zones].key_range)
-        }
-      else
-        print("Preset " .. preset.name .. " has no assigned samples.")
-      end
+        if #combined_samples > 0 then
+          mappings[#mappings+1] = {
+            preset_name = preset.name,
+            bank = preset.bank,
+            preset_num = preset.preset,
+            samples = combined_samples,
+            fallback_params = (preset.zones[#preset.zones] and preset.zones[#preset.zones].params) or {},
+            key_range = (preset.zones[#preset.zones] and preset.zones[#preset.zones].key_range)
+          }
+        else
+          print("Preset " .. preset.name .. " has no assigned samples.")
+        end
       
-      coroutine.yield()
+        coroutine.yield()
+      end
     end
 
     if #mappings == 0 then
@@ -672,9 +806,10 @@ function sf2_loadsample(file_path)
         if frames <= 0 then
           print("Skipping sample " .. hdr.name .. " (non-positive frame count).")
         else
-          -- Determine if sample is stereo
+          -- Determine if sample is stereo (the native extractor's WAVs are
+          -- always mono, one per sample header)
           local is_stereo = false
-          if hdr.sample_link ~= 0 then
+          if hdr.sample_link ~= 0 and not hdr.wav then
             if hdr.sample_type == 0 or hdr.sample_type == 1 then
               is_stereo = true
             else
@@ -685,32 +820,36 @@ function sf2_loadsample(file_path)
 
           -- Load sample data
           local sample_data = {}
-          if is_stereo then
-            for f_i = hdr.s_start + 1, hdr.s_end do
-              local offset = smpl_data_start + (f_i - 1) * 4
-              if offset + 3 <= #data then
-                local left_val  = read_s16_le(data, offset)
-                local right_val = read_s16_le(data, offset + 2)
-                sample_data[#sample_data+1] = { left = left_val/32768.0, right = right_val/32768.0 }
+          local sample_frames = frames
+          if not hdr.wav then
+            if is_stereo then
+              for f_i = hdr.s_start + 1, hdr.s_end do
+                local offset = smpl_data_start + (f_i - 1) * 4
+                if offset + 3 <= #data then
+                  local left_val  = read_s16_le(data, offset)
+                  local right_val = read_s16_le(data, offset + 2)
+                  sample_data[#sample_data+1] = { left = left_val/32768.0, right = right_val/32768.0 }
+                end
+                -- Yield every 100,000 frames
+                if f_i % 100000 == 0 then coroutine.yield() end
               end
-              -- Yield every 100,000 frames
-              if f_i % 100000 == 0 then coroutine.yield() end
-            end
-          else
-            for f_i = hdr.s_start + 1, hdr.s_end do
-              local offset = smpl_data_start + (f_i - 1) * 2
-              if offset + 1 <= #data then
-                local raw_val = read_s16_le(data, offset)
-                sample_data[#sample_data+1] = raw_val / 32768.0
+            else
+              for f_i = hdr.s_start + 1, hdr.s_end do
+                local offset = smpl_data_start + (f_i - 1) * 2
+                if offset + 1 <= #data then
+                  local raw_val = read_s16_le(data, offset)
+                  sample_data[#sample_data+1] = raw_val / 32768.0
+                end
+                -- Yield every 100,000 frames
+                if f_i % 100000 == 0 then coroutine.yield() end
               end
-              -- Yield every 100,000 frames
-              if f_i % 100000 == 0 then coroutine.yield() end
             end
-          end
-          print("Extracted " .. #sample_data .. " frames from sample " .. hdr.name)
-          if #sample_data == 0 then
-            print("Skipping sample " .. hdr.name .. " (zero frames).")
+            sample_frames = #sample_data
+            print("Extracted " .. #sample_data .. " frames from sample " .. hdr.name)
+            if #sample_data == 0 then
+              print("Skipping sample " .. hdr.name .. " (zero frames).")
             
+            end
           end
 
           local sample_slot = nil
@@ -728,34 +867,41 @@ function sf2_loadsample(file_path)
           end
 
           local reno_smp = r_inst.samples[sample_slot]
-          local success, err = pcall(function()
-            if is_stereo then
+          -- load_from returns false rather than raising when it cannot read the WAV
+          local success, result = pcall(function()
+            if hdr.wav then
+              return reno_smp.sample_buffer:load_from(hdr.wav)
+            elseif is_stereo then
               reno_smp.sample_buffer:create_sample_data(hdr.sample_rate, 16, 2, #sample_data)
             else
               reno_smp.sample_buffer:create_sample_data(hdr.sample_rate, 16, 1, #sample_data)
             end
           end)
           if not success then
-            print("Error creating sample data for " .. hdr.name .. ": " .. err)
+            print("Error creating sample data for " .. hdr.name .. ": " .. result)
+          elseif hdr.wav and not (result and reno_smp.sample_buffer.has_sample_data) then
+            print("Skipping sample " .. hdr.name .. " (could not load " .. hdr.wav .. ").")
           else
-            -- Fill sample buffer
-            local buf = reno_smp.sample_buffer
-            buf:prepare_sample_data_changes()  -- Prepare before setting sample data
-            if is_stereo then
-              for f_i=1, #sample_data do
-                buf:set_sample_data(1, f_i, sample_data[f_i].left)
-                buf:set_sample_data(2, f_i, sample_data[f_i].right)
-                -- Yield every 100,000 frames
-                if f_i % 100000 == 0 then coroutine.yield() end
-              end
-            else
-              for f_i=1, #sample_data do
-                buf:set_sample_data(1, f_i, sample_data[f_i])
-                -- Yield every 100,000 frames
-                if f_i % 100000 == 0 then coroutine.yield() end
+            if not hdr.wav then
+              -- Fill sample buffer
+              local buf = reno_smp.sample_buffer
+              buf:prepare_sample_data_changes()  -- Prepare before setting sample data
+              if is_stereo then
+                for f_i=1, #sample_data do
+                  buf:set_sample_data(1, f_i, sample_data[f_i].left)
+                  buf:set_sample_data(2, f_i, sample_data[f_i].right)
+                  -- Yield every 100,000 frames
+                  if f_i % 100000 == 0 then coroutine.yield() end
+                end
+              else
+                for f_i=1, #sample_data do
+                  buf:set_sample_data(1, f_i, sample_data[f_i])
+                  -- Yield every 100,000 frames
+                  if f_i % 100000 == 0 then coroutine.yield() end
+                end
               end
+              buf:finalize_sample_data_changes()  -- Finalize after all sample data is set
             end
-            buf:finalize_sample_data_changes()  -- Finalize after all sample data is set
             reno_smp.name = hdr.name
 
             -- After first sample import, check for and remove placeholder if it exists
@@ -851,7 +997,7 @@ function sf2_loadsample(file_path)
 
             if not is_drumkit then
                 if loop_start_rel <= 0 then loop_start_rel = 1 end
-                if loop_end_rel > #sample_data then loop_end_rel = #sample_data end
+                if loop_end_rel > sample_frames then loop_end_rel = sample_frames end
 
                 if loop_end_rel > loop_start_rel then
                     reno_smp.loop_mode = renoise.Sample.LOOP_MODE_FORWARD
@@ -986,7 +1132,13 @@ function sf2_loadsample(file_path)
   end
   
   -- Create and start the ProcessSlicer
-  slicer = ProcessSlicer(process_import)
+  slicer = ProcessSlicer(function()
+    local result = process_import()
+    for _, path in ipairs(native_files or {}) do
+      os.remove(path)
+    end
+    return result
+  end)
   slicer:start()
 end
 
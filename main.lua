@@ -372,8 +372,8 @@ if renoise.tool():has_file_import_hook("sample", {"sf2"}) then
   renoise.tool():remove_file_import_hook("sample", {"sf2"})
 end
 
-if renoise.tool():has_file_import_hook("sample", {"rex"}) then
-  renoise.tool():remove_file_import_hook("sample", {"rex"})
+if renoise.tool():has_file_import_hook("sample", {"rex", "rcy"}) then
+  renoise.tool():remove_file_import_hook("sample", {"rex", "rcy"})
 end
 
 if renoise.tool():has_file_import_hook("sample", {"rx2"}) then
@@ -423,7 +423,7 @@ renoise.tool():add_file_import_hook({
 -- REX files
 renoise.tool():add_file_import_hook({
   category = "sample",
-  extensions = { "rex" },
+  extensions = { "rex", "rcy" },
   invoke = rex_loadsample
 })
 
@@ -512,7 +512,7 @@ renoise.tool():add_menu_entry {
 renoise.tool():add_menu_entry {
   name = "Main Menu:File:Paketti Formats:Import .REX (ReCycle V1)...",
   invoke = function()
-    local f = renoise.app():prompt_for_filename_to_read({"*.rex"}, "Select REX to import")
+    local f = renoise.app():prompt_for_filename_to_read({"*.rex", "*.rcy"}, "Select REX to import")
     if f and f ~= "" then rex_loadsample(f) end
   end
 }
@@ -0,0 +1,86 @@
+#!/bin/bash
+# Compare one-process-per-file decoding against a single --batch process.
+#
+# Usage: ./bench_batch.sh <decoder> <sdk_path> <folder_with_rx2_files> [out_dir]
+#   DECODER_PREFIX="wine" ./bench_batch.sh rex2decoder_win.exe . loops/
+#   POOL_JOBS=8 ./bench_batch.sh ./rex2decoder_mac . loops/
+#   DECODER_ARGS="--backend synth" ./bench_batch.sh ./rex2decoder_linux - loops/
+#
+# All runs decode the same files into out_dir (default: a fresh temp folder)
+# and report files per second. The worker pool runs use POOL_JOBS workers
+# (default 4) as threads and as isolated processes. DECODER_ARGS is passed
+# to every decoder run, e.g. to pick the backend or the output format.
+
+if [ $# -lt 3 ]; then
+  echo "Usage: $0 <decoder> <sdk_path> <folder_with_rx2_files> [out_dir]"
+  exit 1
+fi
+
+DECODER="$1"
+SDK_PATH="$2"
+INPUT_DIR="$3"
+OUT_DIR="${4:-$(mktemp -d)}"
+PREFIX="${DECODER_PREFIX:-}"
+ARGS="${DECODER_ARGS:-}"
+
+now() {
+  perl -MTime::HiRes=time -e 'printf "%.6f\n", time'
+}
+
+FILES=()
+while IFS= read -r -d '' f; do
+  FILES+=("$f")
+done < <(find "$INPUT_DIR" -type f -iname '*.rx2' -print0)
+
+COUNT=${#FILES[@]}
+if [ "$COUNT" -eq 0 ]; then
+  echo "No .rx2 files found in $INPUT_DIR"
+  exit 1
+fi
+mkdir -p "$OUT_DIR/single" "$OUT_DIR/batch" "$OUT_DIR/threads" "$OUT_DIR/processes"
+POOL_JOBS="${POOL_JOBS:-4}"
+echo "Decoding $COUNT files, output in $OUT_DIR"
+
+# One process per file, as PakettiRX2Loader.lua does today
+START=$(now)
+FAILED=0
+for i in "${!FILES[@]}"; do
+  $PREFIX "$DECODER" "${FILES[$i]}" "$OUT_DIR/single/$i.wav" "$OUT_DIR/single/$i.txt" "$SDK_PATH" $ARGS > /dev/null 2>&1 || FAILED=$((FAILED + 1))
+done
+END=$(now)
+SINGLE=$(perl -e "printf '%.3f', $END - $START")
+echo "one process per file: ${SINGLE}s, $(perl -e "printf '%.2f', $COUNT / $SINGLE") files/s, $FAILED failed"
+
+# One long-lived process fed through stdin
+JOBS="$OUT_DIR/jobs.txt"
+: > "$JOBS"
+for i in "${!FILES[@]}"; do
+  printf '%s\t%s\t%s\n' "${FILES[$i]}" "$OUT_DIR/batch/$i.wav" "$OUT_DIR/batch/$i.txt" >> "$JOBS"
+done
+START=$(now)
+$PREFIX "$DECODER" --batch "$SDK_PATH" $ARGS < "$JOBS" 2> /dev/null > "$OUT_DIR/batch_results.txt"
+END=$(now)
+BATCH=$(perl -e "printf '%.3f', $END - $START")
+FAILED=$(grep -c '^ERR' "$OUT_DIR/batch_results.txt")
+PEAK=$(awk -F'\t' '$1 == "OK" && $4 > m { m = $4 } END { print m + 0 }' "$OUT_DIR/batch_results.txt")
+echo "single --batch process: ${BATCH}s, $(perl -e "printf '%.2f', $COUNT / $BATCH") files/s, $FAILED failed, peak RSS ${PEAK} KB"
+echo "speedup: $(perl -e "printf '%.2f', $SINGLE / $BATCH")x"
+
+# Worker pool over the same folder
+for MODE in threads processes; do
+  EXTRA=""
+  if [ "$MODE" = "processes" ]; then
+    EXTRA="--processes"
+  fi
+  : > "$OUT_DIR/${MODE}_jobs.txt"
+  for i in "${!FILES[@]}"; do
+    printf '%s\t%s\t%s\n' "${FILES[$i]}" "$OUT_DIR/$MODE/$i.wav" "$OUT_DIR/$MODE/$i.txt" >> "$OUT_DIR/${MODE}_jobs.txt"
+  done
+  START=$(now)
+  $PREFIX "$DECODER" --batch "$SDK_PATH" $ARGS --jobs "$POOL_JOBS" $EXTRA --manifest "$OUT_DIR/${MODE}_jobs.txt" 2> /dev/null > "$OUT_DIR/${MODE}_results.txt"
+  END=$(now)
+  POOL=$(perl -e "printf '%.3f', $END - $START")
+  FAILED=$(grep -c '^ERR' "$OUT_DIR/${MODE}_results.txt")
+  PEAK=$(awk -F'\t' '$1 == "OK" && $4 > m { m = $4 } END { print m + 0 }' "$OUT_DIR/${MODE}_results.txt")
+  echo "--jobs $POOL_JOBS ($MODE): ${POOL}s, $(perl -e "printf '%.2f', $COUNT / $POOL") files/s, $FAILED failed, peak RSS ${PEAK} KB"
+done
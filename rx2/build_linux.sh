@@ -0,0 +1,5 @@
+# There is no REX SDK for Linux, so this build only has the synth stand-in
+# backend (see rex_backend_synth.cpp). Use it to benchmark and test the
+# render, conversion and write pipeline natively; smoke_linux.sh runs one
+# decode with it.
+g++ -O2 rex2decoder_posix.cpp decoder_core.cpp rex_backend.cpp rex_backend_synth.cpp decode_cache.cpp flac_encoder.cpp library_index.cpp pcm_convert.cpp resample.cpp rex1_file.cpp sidecar.cpp slice_analysis.cpp trace.cpp -o rex2decoder_linux -lpthread
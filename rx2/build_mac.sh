@@ -1,3 +1,3 @@
 ##clang++ -Wc++17-extensions rex2decoder_mac.cpp /Users/esaruoho/Downloads/rx2/REX.c -o rex2decoder -I /Users/esaruoho/Downloads/rx2/REXSDK_Mac_1.9.2 -DREX_MAC=1 -DREX_WINDOWS=0 -DREX_DLL_LOADER=1 -framework CoreFoundation
-clang++ rex2decoder_mac.cpp Wav.c /Users/esaruoho/Downloads/rx2/REX.c -o rex2decoder_mac -I /Users/esaruoho/Downloads/rx2/REXSDK_Mac_1.9.2 -DREX_MAC=1 -DREX_WINDOWS=0 -DREX_DLL_LOADER=1 -framework CoreFoundation
+clang++ rex2decoder_posix.cpp decoder_core.cpp rex_backend.cpp rex_backend_sdk.cpp rex_backend_synth.cpp decode_cache.cpp flac_encoder.cpp library_index.cpp pcm_convert.cpp resample.cpp rex1_file.cpp sidecar.cpp slice_analysis.cpp trace.cpp /Users/esaruoho/Downloads/rx2/REX.c -o rex2decoder_mac -I /Users/esaruoho/Downloads/rx2/REXSDK_Mac_1.9.2 -DREX_MAC=1 -DREX_WINDOWS=0 -DREX_DLL_LOADER=1 -DREX_BACKEND_SDK=1 -framework CoreFoundation
 ./rex2decoder_mac billy.rx2 billy.wav billy.txt /Users/esaruoho/Downloads/rx2
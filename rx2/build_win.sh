@@ -1,5 +1,6 @@
-x86_64-w64-mingw32-g++ -static rex2decoder_win.cpp Wav.c REXSDK_Win_1.9.2/REX.c -o rex2decoder_win.exe \
+x86_64-w64-mingw32-g++ -static rex2decoder_win.cpp decoder_core.cpp rex_backend.cpp rex_backend_sdk.cpp rex_backend_synth.cpp \
+  decode_cache.cpp flac_encoder.cpp library_index.cpp pcm_convert.cpp resample.cpp rex1_file.cpp sidecar.cpp slice_analysis.cpp trace.cpp REXSDK_Win_1.9.2/REX.c -o rex2decoder_win.exe \
   -I/Users/esaruoho/Downloads/rx2 \
-  -DREX_MAC=0 -DREX_WINDOWS=1 -DREX_DLL_LOADER=1 \
+  -DREX_MAC=0 -DREX_WINDOWS=1 -DREX_DLL_LOADER=1 -DREX_BACKEND_SDK=1 \
   -DREX_TYPES_DEFINED -DREX_int32_t=int \
-  -static-libstdc++ -static-libgcc -lversion
+  -static-libstdc++ -static-libgcc -lversion -lpsapi
@@ -0,0 +1,280 @@
+// decode_cache.cpp
+//
+// Content-addressed decode cache behind decode_cache.h.
+
+#include "decode_cache.h"
+#include "platform.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const char* ENTRY_EXTENSION = ".rx2cache";
+const char* TEMP_MARKER = ".tmp.";
+// Temporary files older than this were left behind by a crashed writer
+const long long STALE_TEMP_SECONDS = 3600;
+
+// MurmurHash64A: fast on whole buffers and good enough for cache keys
+uint64_t murmur64(const void* key, size_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m);
+    const unsigned char* data = static_cast<const unsigned char*>(key);
+    const unsigned char* end = data + (len & ~(size_t)7);
+    for (; data != end; data += 8) {
+        uint64_t k;
+        memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    switch (len & 7) {
+    case 7: h ^= (uint64_t)data[6] << 48; // fall through
+    case 6: h ^= (uint64_t)data[5] << 40; // fall through
+    case 5: h ^= (uint64_t)data[4] << 32; // fall through
+    case 4: h ^= (uint64_t)data[3] << 24; // fall through
+    case 3: h ^= (uint64_t)data[2] << 16; // fall through
+    case 2: h ^= (uint64_t)data[1] << 8;  // fall through
+    case 1: h ^= (uint64_t)data[0];
+            h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+string entry_path(const DecodeCache& cache, const DecodeCacheKey& key) {
+    return cache.dir + PATH_SEPARATOR + key.hex + ENTRY_EXTENSION;
+}
+
+bool ends_with(const string& text, const char* suffix) {
+    size_t len = strlen(suffix);
+    return text.size() >= len && text.compare(text.size() - len, len, suffix) == 0;
+}
+
+void write_u32(ostream& out, uint32_t v) {
+    unsigned char bytes[4] = {(unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24)};
+    out.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+void write_u64(ostream& out, uint64_t v) {
+    write_u32(out, (uint32_t)v);
+    write_u32(out, (uint32_t)(v >> 32));
+}
+
+bool read_u32(istream& in, uint32_t& v) {
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), 4)) return false;
+    v = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    return true;
+}
+
+bool read_u64(istream& in, uint64_t& v) {
+    uint32_t lo, hi;
+    if (!read_u32(in, lo) || !read_u32(in, hi)) return false;
+    v = ((uint64_t)hi << 32) | lo;
+    return true;
+}
+
+// Copy exactly count bytes from in to out
+bool copy_bytes(istream& in, ostream& out, uint64_t count) {
+    vector<char> chunk(1 << 20);
+    while (count > 0) {
+        size_t todo = (size_t)min<uint64_t>(count, chunk.size());
+        if (!in.read(chunk.data(), todo)) return false;
+        out.write(chunk.data(), todo);
+        if (!out) return false;
+        count -= todo;
+    }
+    return true;
+}
+
+bool copy_file_into(const string& path, uint64_t size, ostream& out) {
+    ifstream in(path.c_str(), ios::binary);
+    return in && copy_bytes(in, out, size);
+}
+
+bool copy_entry_part(istream& in, uint64_t size, const string& path) {
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    if (!out || !copy_bytes(in, out, size)) return false;
+    out.close();
+    return !out.fail();
+}
+
+// Drop least recently used entries until the cache fits its limit
+void trim_cache(const DecodeCache& cache) {
+    vector<DirectoryEntry> files;
+    list_directory(cache.dir, files);
+    long long now = (long long)time(nullptr);
+    vector<DirectoryEntry> entries;
+    long long total = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        const DirectoryEntry& file = files[i];
+        if (file.name.find(TEMP_MARKER) != string::npos) {
+            if (now - file.modified > STALE_TEMP_SECONDS) {
+                remove((cache.dir + PATH_SEPARATOR + file.name).c_str());
+            }
+        } else if (ends_with(file.name, ENTRY_EXTENSION)) {
+            entries.push_back(file);
+            total += file.size;
+        }
+    }
+    if (total <= cache.limitBytes) {
+        return;
+    }
+    sort(entries.begin(), entries.end(), [](const DirectoryEntry& a, const DirectoryEntry& b) {
+        return a.modified < b.modified;
+    });
+    for (size_t i = 0; i < entries.size() && total > cache.limitBytes; i++) {
+        // A reader may still hold the file open; it keeps its copy on POSIX
+        // and the removal fails harmlessly on Windows
+        if (remove((cache.dir + PATH_SEPARATOR + entries[i].name).c_str()) == 0) {
+            total -= entries[i].size;
+        }
+    }
+}
+
+bool read_entry_header(istream& in, const DecodeCacheKey& key, uint32_t& sidecarBytes, uint64_t& wavBytes) {
+    char magic[4];
+    uint32_t version, settingsBytes;
+    uint64_t sourceBytes;
+    if (!in || !in.read(magic, 4) || memcmp(magic, "PKRC", 4) != 0 ||
+        !read_u32(in, version) || version != DECODE_CACHE_VERSION ||
+        !read_u64(in, sourceBytes) || sourceBytes != key.sourceBytes ||
+        !read_u32(in, settingsBytes) || settingsBytes != key.settings.size()) {
+        return false;
+    }
+    string settings(settingsBytes, '\0');
+    return (settingsBytes == 0 || in.read(&settings[0], settingsBytes)) && settings == key.settings &&
+           read_u32(in, sidecarBytes) && read_u64(in, wavBytes);
+}
+
+// Writes one entry under a temporary name, then renames it into place
+// and trims the cache
+struct EntryWriter {
+    EntryWriter(const DecodeCache& entryCache, const DecodeCacheKey& entryKey)
+        : cache(entryCache), key(entryKey), path(entry_path(entryCache, entryKey)), tempPath(unique_temp_path(path)) {}
+
+    bool begin(uint32_t sidecarBytes, uint64_t wavBytes) {
+        if (!make_directory(cache.dir)) {
+            return false;
+        }
+        out.open(tempPath.c_str(), ios::binary | ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out.write("PKRC", 4);
+        write_u32(out, DECODE_CACHE_VERSION);
+        write_u64(out, key.sourceBytes);
+        write_u32(out, (uint32_t)key.settings.size());
+        out.write(key.settings.data(), key.settings.size());
+        write_u32(out, sidecarBytes);
+        write_u64(out, wavBytes);
+        return true;
+    }
+
+    bool publish(bool ok) {
+        out.close();
+        if (!ok || out.fail() || !replace_file(tempPath, path)) {
+            remove(tempPath.c_str());
+            return false;
+        }
+        trim_cache(cache);
+        return true;
+    }
+
+    const DecodeCache& cache;
+    const DecodeCacheKey& key;
+    string path;
+    string tempPath;
+    ofstream out;
+};
+
+} // namespace
+
+DecodeCacheKey decode_cache_key(const char* data, size_t size, const string& settings) {
+    uint64_t h1 = murmur64(data, size, 0x504B525843414348ULL);
+    uint64_t h2 = murmur64(data, size, 0x9E3779B97F4A7C15ULL);
+    h1 = murmur64(settings.data(), settings.size(), h1);
+    h2 = murmur64(settings.data(), settings.size(), h2);
+    char hex[33];
+    snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)h1, (unsigned long long)h2);
+    DecodeCacheKey key;
+    key.hex = hex;
+    key.sourceBytes = size;
+    key.settings = settings;
+    return key;
+}
+
+bool decode_cache_fetch(const DecodeCache& cache, const DecodeCacheKey& key,
+                        const string& wavPath, const string& sidecarPath) {
+    string path = entry_path(cache, key);
+    ifstream in(path.c_str(), ios::binary);
+    uint32_t sidecarBytes;
+    uint64_t wavBytes;
+    if (!read_entry_header(in, key, sidecarBytes, wavBytes) ||
+        !copy_entry_part(in, sidecarBytes, sidecarPath) || !copy_entry_part(in, wavBytes, wavPath)) {
+        return false;
+    }
+    in.close();
+    touch_file(path);
+    return true;
+}
+
+bool decode_cache_fetch_memory(const DecodeCache& cache, const DecodeCacheKey& key, string& wav, string& sidecar) {
+    string path = entry_path(cache, key);
+    ifstream in(path.c_str(), ios::binary);
+    uint32_t sidecarBytes;
+    uint64_t wavBytes;
+    if (!read_entry_header(in, key, sidecarBytes, wavBytes)) {
+        return false;
+    }
+    sidecar.resize(sidecarBytes);
+    wav.resize((size_t)wavBytes);
+    if ((sidecarBytes > 0 && !in.read(&sidecar[0], sidecarBytes)) || (wavBytes > 0 && !in.read(&wav[0], wavBytes))) {
+        return false;
+    }
+    in.close();
+    touch_file(path);
+    return true;
+}
+
+bool decode_cache_store(const DecodeCache& cache, const DecodeCacheKey& key,
+                        const string& wavPath, const string& sidecarPath) {
+    long long wavBytes = file_size(wavPath);
+    long long sidecarBytes = file_size(sidecarPath);
+    if (wavBytes <= 0) {
+        return false;
+    }
+    EntryWriter entry(cache, key);
+    if (!entry.begin((uint32_t)sidecarBytes, (uint64_t)wavBytes)) {
+        return false;
+    }
+    bool ok = copy_file_into(sidecarPath, (uint64_t)sidecarBytes, entry.out) &&
+              copy_file_into(wavPath, (uint64_t)wavBytes, entry.out);
+    return entry.publish(ok);
+}
+
+bool decode_cache_store_memory(const DecodeCache& cache, const DecodeCacheKey& key, const string& wav, const string& sidecar) {
+    if (wav.empty()) {
+        return false;
+    }
+    EntryWriter entry(cache, key);
+    if (!entry.begin((uint32_t)sidecar.size(), wav.size())) {
+        return false;
+    }
+    entry.out.write(sidecar.data(), sidecar.size());
+    entry.out.write(wav.data(), wav.size());
+    return entry.publish(true);
+}
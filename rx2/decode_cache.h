@@ -0,0 +1,60 @@
+// decode_cache.h
+//
+// On-disk cache of finished decodes, so re-importing a loop skips the
+// render entirely.
+//
+// Entries are content addressed: the key is a 128-bit hash of the RX2
+// bytes and of a settings string that must name everything else that
+// changes the output (sample format, dither, render mode, batch size,
+// latency compensation, backend, sidecar kind). Each entry is one file,
+// <key>.rx2cache, holding the sidecar and the WAV:
+//
+//   "PKRC"  u32 version
+//   u64 sourceBytes, u32 settings length + settings
+//   u32 sidecarBytes, u64 wavBytes
+//   sidecar bytes, WAV bytes
+//
+// Entries are written to a temporary name and renamed into place, so a
+// concurrent reader sees the old entry, the new one or none, never a
+// partial one. A hit refreshes the entry's modification time; when the
+// cache grows past its size limit the least recently used entries are
+// removed first.
+
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include <cstddef>
+#include <string>
+
+const unsigned int DECODE_CACHE_VERSION = 1;
+const long long DEFAULT_DECODE_CACHE_MB = 1024;
+
+struct DecodeCache {
+    std::string dir;                // Empty when caching is off
+    long long limitBytes = DEFAULT_DECODE_CACHE_MB * 1024 * 1024;
+};
+
+struct DecodeCacheKey {
+    std::string hex;                // 32 hex digits, the entry file name
+    unsigned long long sourceBytes = 0;
+    std::string settings;
+};
+
+DecodeCacheKey decode_cache_key(const char* data, size_t size, const std::string& settings);
+
+// Copy a cached decode to wavPath and sidecarPath. Returns false on a miss
+// or an unusable entry; the caller then decodes as usual.
+bool decode_cache_fetch(const DecodeCache& cache, const DecodeCacheKey& key,
+                        const std::string& wavPath, const std::string& sidecarPath);
+
+// Same, into memory (for --stdout)
+bool decode_cache_fetch_memory(const DecodeCache& cache, const DecodeCacheKey& key,
+                               std::string& wav, std::string& sidecar);
+
+// Publish a finished decode, then trim the cache to its limit
+bool decode_cache_store(const DecodeCache& cache, const DecodeCacheKey& key,
+                        const std::string& wavPath, const std::string& sidecarPath);
+bool decode_cache_store_memory(const DecodeCache& cache, const DecodeCacheKey& key,
+                               const std::string& wav, const std::string& sidecar);
+
+#endif
@@ -0,0 +1,3052 @@
+// decoder_core.cpp
+//
+// The decoder itself: preview and slice rendering, WAV output, the batch
+// and benchmark modes and main(). Shared by every platform; the OS layer
+// lives behind platform.h and the REX library behind rex_backend.h.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#include "platform.h"
+#include "rex_backend.h"
+#include "decode_cache.h"
+#include "flac_encoder.h"
+#include "library_index.h"
+#include "pcm_convert.h"
+#include "rex1_file.h"
+#include "resample.h"
+#include "sidecar.h"
+#include "slice_analysis.h"
+#include "trace.h"
+
+using namespace std;
+
+// Latency compensation for preview rendering, used when the slice onsets
+// found in a render are too few to calibrate that file's own offset
+// Positive values shift markers later, negative values shift them earlier
+const int PREVIEW_LATENCY_COMPENSATION = -64; // About 1.45ms at 44.1kHz
+
+// Largest offset --compensation accepts: markers must stay inside the
+// analyzer's search windows for the slice levels to be exact, which any
+// calibrated offset does too
+const int MAX_PREVIEW_COMPENSATION = ONSET_SEARCH_FRAMES - ONSET_HISTORY_FRAMES;
+
+// ---------------------------------------------------------------------
+// Preview rendering in configurable batch sizes
+// ---------------------------------------------------------------------
+// The REX Test App renders the preview in 64-frame batches
+const int DEFAULT_PREVIEW_BLOCK_FRAMES = 64;
+// Largest batch size the auto-tuner will try
+const int MAX_PREVIEW_BLOCK_FRAMES = 16384;
+
+struct DecodeOptions {
+    int blockFrames = DEFAULT_PREVIEW_BLOCK_FRAMES; // Frames per REXRenderPreviewBatch call
+    bool autoBlock = false;                          // Probe for the largest sample-identical batch size
+    bool extractSlices = false;                      // Render slices with REXRenderSlice instead of the preview
+    bool dither = false;                             // TPDF dither when quantizing to PCM
+    PcmFormat format = kPcm16;                       // Sample format of the output WAV
+    bool matchSourceDepth = false;                   // Pick the format from REXInfo.fBitDepth instead
+    LogLevel logLevel = kLogInfo;                    // How much of the decode to describe
+    DecodeCache cache;                               // Reuse earlier decodes of the same bytes
+    bool atomic = false;                             // Write temporary files, then rename them into place
+    int outputRate = 0;                              // Resample the output to this rate; 0 keeps the file's
+    ResampleQuality resampleQuality = kResampleStandard;
+    vector<int> tempos;                              // --tempos: one preview variant per tempo, BPM * 1000
+    int flacLevel = DEFAULT_FLAC_LEVEL;              // Compression level of .flac outputs
+    int flacThreads = 0;                             // Encoder threads per .flac output; 0 splits the cores among jobs
+    bool autoCompensation = true;                    // Take the preview marker offset from the slice onsets
+    int compensation = PREVIEW_LATENCY_COMPENSATION; // Preview marker offset without (or failing) calibration
+    string slicesDir;                                // --slices-dir: also write every slice to a file of its own here
+    double sliceFadeMs = 0;                          // Fade-out at the end of each exported slice
+    double slicePadMs = 0;                           // Silence after each exported slice
+    int sliceThreads = 0;                            // Slice export threads; 0 splits the cores among jobs
+    ostream* progress = nullptr;                     // --progress: where the events go, see RenderProgress
+};
+
+// Where one decode's WAV and sidecar go
+struct DecodeOutput {
+    string wavPath;             // The paths the caller asked for
+    string sidecarPath;
+    string wavWritePath;        // The paths written; temporary names with --atomic
+    string sidecarWritePath;
+    bool inMemory = false;      // --stdout: collect both below instead of writing files
+    string wav;
+    string sidecar;
+    int tempo = 0;              // Preview tempo, BPM * 1000; 0 renders at the file's own tempo
+    bool written = false;       // Set once this output is complete
+};
+
+// Receives rendered audio block by block: begin() hands out the channel
+// pointers to render the next block into, end() commits what was rendered
+class PreviewSink {
+public:
+    virtual ~PreviewSink() {}
+    virtual bool begin(int frames, float* buffers[2]) = 0;
+    virtual void end(int frames) = 0;
+};
+
+// Sink rendering straight into full-length planar buffers
+class MemorySink : public PreviewSink {
+public:
+    explicit MemorySink(float* buffers[2]) : offset(0) {
+        base[0] = buffers[0];
+        base[1] = buffers[1];
+    }
+    bool begin(int, float* buffers[2]) {
+        buffers[0] = base[0] + offset;
+        buffers[1] = base[1] != nullptr ? base[1] + offset : nullptr;
+        return true;
+    }
+    void end(int frames) { offset += frames; }
+
+private:
+    float* base[2];
+    int offset;
+};
+
+// ---------------------------------------------------------------------
+// Streaming WAV output
+//
+// The header is written up front from the expected length and patched on
+// close if the real length differs. Rendered blocks collect in one of two
+// reusable staging buffers; when it fills up, a writer thread converts it
+// to PCM and writes it to disk while rendering continues into the other.
+// Memory use is bounded by the staging buffers, not the loop length.
+//
+// 16-bit and 24-bit output is written as WAVE_FORMAT_PCM, 32-bit float as
+// WAVE_FORMAT_IEEE_FLOAT with a fact chunk. With encodeFlac() the writer
+// thread feeds the same PCM to a FlacEncoder instead, and the header is
+// the FLAC stream header, completed on close.
+// ---------------------------------------------------------------------
+const int STREAM_BLOCK_FRAMES = 16384;
+
+void put_le16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+}
+
+void put_le32(unsigned char* p, unsigned int v) {
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, (v >> 16) & 0xFFFF);
+}
+
+class WavStreamWriter : public PreviewSink {
+public:
+    WavStreamWriter() {}
+    ~WavStreamWriter() { close(); }
+
+    // Write FLAC at level with up to threads encoder threads instead of a
+    // WAV; call before open()
+    void encodeFlac(int level, int threads) {
+        flacLevel = level;
+        flacThreads = max(1, threads);
+    }
+
+    // Write to path, or into memory when it is non-null
+    bool open(const string& path, string* memory, int channelCount, int sampleRate, int expectedFrames,
+              int minBlockFrames, PcmFormat sampleFormat, bool useDither) {
+        if (flacLevel >= 0 && sampleFormat == kFloat32) {
+            return false;
+        }
+        if (memory != nullptr) {
+            buffer = memory;
+            buffer->clear();
+            buffer->reserve(58 + (size_t)expectedFrames * channelCount * pcm_bytes_per_sample(sampleFormat));
+        } else {
+            file = fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                return false;
+            }
+        }
+        channels = channelCount;
+        rate = sampleRate;
+        format = sampleFormat;
+        dither = useDither;
+        capacity = max(STREAM_BLOCK_FRAMES, minBlockFrames);
+        if (flacLevel >= 0) {
+            // Enough whole FLAC blocks per staging buffer to keep every encoder thread busy
+            flac.reset(new FlacEncoder(channels, rate, (int)format, flacLevel, flacThreads));
+            capacity = max(capacity, flac->blockFrames() * flacThreads * 4);
+        }
+        for (int b = 0; b < 2; b++) {
+            blocks[b].samples.assign((size_t)channels * capacity, 0.0f);
+            blocks[b].frames = 0;
+            blocks[b].full = false;
+        }
+        current = 0;
+        framesWritten = 0;
+        headerFrames = expectedFrames;
+        headerWritten = false;
+        failed = !writeHeader(expectedFrames);
+        stopping = false;
+        writer = thread(&WavStreamWriter::writerLoop, this);
+        return true;
+    }
+
+    bool begin(int frames, float* buffers[2]) {
+        if (blocks[current].frames + frames > capacity) {
+            submit();
+        }
+        Block& block = blocks[current];
+        buffers[0] = block.samples.data() + block.frames;
+        buffers[1] = channels == 2 ? block.samples.data() + capacity + block.frames : nullptr;
+        return !failed;
+    }
+
+    void end(int frames) { blocks[current].frames += frames; }
+
+    // Copy already rendered planar audio into the stream
+    bool write(float* const source[2], int frames) {
+        int done = 0;
+        while (done < frames) {
+            int todo = min(capacity, frames - done);
+            float* buffers[2];
+            if (!begin(todo, buffers)) {
+                return false;
+            }
+            memcpy(buffers[0], source[0] + done, todo * sizeof(float));
+            if (channels == 2) {
+                memcpy(buffers[1], source[1] + done, todo * sizeof(float));
+            }
+            end(todo);
+            done += todo;
+        }
+        return !failed;
+    }
+
+    // Flush, stop the writer thread and fix up the header. Returns false if
+    // anything failed to write.
+    bool close() {
+        if (file == nullptr && buffer == nullptr) {
+            return !failed;
+        }
+        if (blocks[current].frames > 0) {
+            submit();
+        }
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        writer.join();
+        if (flac) {
+            vector<unsigned char> tail;
+            flac->finish(tail);
+            if (!failed && !emit(tail.data(), tail.size())) {
+                failed = true;
+            }
+        }
+        if (!failed && (flac || framesWritten != headerFrames)) {
+            failed = !writeHeader(framesWritten);
+        }
+        if (file != nullptr && fclose(file) != 0) {
+            failed = true;
+        }
+        file = nullptr;
+        buffer = nullptr;
+        return !failed;
+    }
+
+    long long frames() const { return framesWritten; }
+    long long bytes() const { return bytesWritten; }
+    const FlacEncoder* flacEncoder() const { return flac.get(); }
+
+private:
+    struct Block {
+        vector<float> samples; // Planar: left then right, capacity frames each
+        int frames;
+        bool full;
+    };
+
+    // Header size does not depend on the length, so it can be rewritten in
+    // place; the first call writes it, later calls overwrite it
+    bool writeHeader(long long frameCount) {
+        if (flac) {
+            string header = flac->header();
+            return placeHeader(header.data(), header.size());
+        }
+        bool isFloat = (format == kFloat32);
+        unsigned int blockAlign = channels * pcm_bytes_per_sample(format);
+        unsigned int dataBytes = (unsigned int)(frameCount * blockAlign);
+        unsigned int fmtBytes = isFloat ? 18 : 16;
+        unsigned char header[58];
+        unsigned char* p = header;
+        memcpy(p, "RIFF", 4);
+        memcpy(p + 8, "WAVEfmt ", 8);
+        put_le32(p + 16, fmtBytes);
+        put_le16(p + 20, isFloat ? 3 : 1); // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+        put_le16(p + 22, channels);
+        put_le32(p + 24, rate);
+        put_le32(p + 28, rate * blockAlign);
+        put_le16(p + 32, blockAlign);
+        put_le16(p + 34, (unsigned int)format);
+        p += 20 + fmtBytes;
+        if (isFloat) {
+            put_le16(p - 2, 0); // cbSize
+            memcpy(p, "fact", 4);
+            put_le32(p + 4, 4);
+            put_le32(p + 8, (unsigned int)frameCount);
+            p += 12;
+        }
+        memcpy(p, "data", 4);
+        put_le32(p + 4, dataBytes);
+        p += 8;
+        unsigned int headerBytes = (unsigned int)(p - header);
+        put_le32(header + 4, headerBytes - 8 + dataBytes);
+        return placeHeader(header, headerBytes);
+    }
+
+    // Write the header first, or overwrite the one written before
+    bool placeHeader(const void* header, size_t headerBytes) {
+        if (!headerWritten) {
+            headerWritten = true;
+            return emit(header, headerBytes);
+        }
+        if (buffer != nullptr) {
+            buffer->replace(0, headerBytes, static_cast<const char*>(header), headerBytes);
+            return true;
+        }
+        return fseek(file, 0, SEEK_SET) == 0 && fwrite(header, 1, headerBytes, file) == headerBytes;
+    }
+
+    bool emit(const void* data, size_t bytes) {
+        bytesWritten += bytes;
+        if (buffer != nullptr) {
+            buffer->append(static_cast<const char*>(data), bytes);
+            return true;
+        }
+        return fwrite(data, 1, bytes, file) == bytes;
+    }
+
+    // Hand the current block to the writer and wait for the other one
+    void submit() {
+        unique_lock<mutex> guard(lock);
+        blocks[current].full = true;
+        changed.notify_all();
+        current ^= 1;
+        changed.wait(guard, [this]() { return !blocks[current].full; });
+    }
+
+    void writerLoop() {
+        vector<unsigned char> pcm;
+        vector<unsigned char> encoded;
+        DitherState ditherState;
+        int next = 0;
+        unique_lock<mutex> guard(lock);
+        while (true) {
+            changed.wait(guard, [this, next]() { return blocks[next].full || stopping; });
+            if (!blocks[next].full) {
+                break;
+            }
+            guard.unlock();
+
+            Block& block = blocks[next];
+            if (format == kFloat32 && channels == 1) {
+                // Mono float is already in its final layout
+                TraceSpan writeSpan("write");
+                if (!failed && !emit(block.samples.data(), (size_t)block.frames * sizeof(float))) {
+                    failed = true;
+                }
+            } else {
+                TraceSpan convertSpan("convert");
+                pcm.resize((size_t)block.frames * channels * pcm_bytes_per_sample(format));
+                const float* planes[2] = {block.samples.data(), block.samples.data() + capacity};
+                convert_planar_to_pcm(planes, channels, block.frames, format, dither ? &ditherState : nullptr, pcm.data());
+                convertSpan.end();
+
+                if (flac) {
+                    TraceSpan encodeSpan("flac_encode");
+                    encoded.clear();
+                    flac->encode(pcm.data(), block.frames, encoded);
+                    encodeSpan.end();
+                    TraceSpan writeSpan("write");
+                    if (!failed && !emit(encoded.data(), encoded.size())) {
+                        failed = true;
+                    }
+                } else {
+                    TraceSpan writeSpan("write");
+                    if (!failed && !emit(pcm.data(), pcm.size())) {
+                        failed = true;
+                    }
+                }
+            }
+
+            guard.lock();
+            framesWritten += block.frames;
+            block.frames = 0;
+            block.full = false;
+            changed.notify_all();
+            next ^= 1;
+        }
+    }
+
+    FILE* file = nullptr;
+    string* buffer = nullptr;
+    bool headerWritten = false;
+    int channels = 0;
+    int rate = 0;
+    PcmFormat format = kPcm16;
+    bool dither = false;
+    int flacLevel = -1;         // -1 writes a WAV
+    int flacThreads = 1;
+    unique_ptr<FlacEncoder> flac;
+    long long bytesWritten = 0;
+    int capacity = 0;
+    Block blocks[2];
+    int current = 0;
+    long long framesWritten = 0;
+    long long headerFrames = 0;
+    atomic<bool> failed{false};     // Set by the writer thread, polled by the render thread
+    bool stopping = false;
+    mutex lock;
+    condition_variable changed;
+    thread writer;
+};
+
+// The audio of a render at the output rate, kept for --slices-dir and
+// the first segment of --progress
+struct RenderCapture {
+    int channels = 0;
+    int limit = INT32_MAX;      // Frames kept; the rest is dropped
+    vector<float> planes[2];
+
+    void append(const float* const source[2], int frames) {
+        frames = max(0, min(frames, limit - this->frames()));
+        for (int c = 0; c < channels; c++) {
+            planes[c].insert(planes[c].end(), source[c], source[c] + frames);
+        }
+    }
+    int frames() const { return (int)planes[0].size(); }
+};
+
+struct SliceTable;
+
+// --progress: events for one output while it renders, and its first bar
+// published as soon as it is known (see "Progressive decode" below)
+class RenderProgress {
+public:
+    RenderProgress(ostream& eventStream, const DecodeOutput& renderOutput, const Sidecar& renderSidecar,
+                   const DecodeOptions& decodeOptions, RenderCapture& renderCapture, ostream& renderLog);
+
+    // Called by the render before the first frame. positions are where
+    // the analyzer searches for each slice; a preview's table is laid out
+    // from the onsets found so far when the segment is published.
+    void start(const RexInfo& renderInfo, int lengthFrames, const SliceTable& sliceTable, const vector<int>& positions,
+               const SliceAnalyzer& sliceAnalyzer, bool previewRender);
+
+    // frames more frames have been rendered and their output captured
+    void rendered(int frames);
+
+    ~RenderProgress();
+
+private:
+    RenderProgress(const RenderProgress&);
+    RenderProgress& operator=(const RenderProgress&);
+
+    void layoutSegment();
+    void publishSegment();
+
+    ostream& events;
+    const DecodeOutput& output;
+    const Sidecar& sidecar;
+    const DecodeOptions& options;
+    RenderCapture& capture;
+    ostream& log;
+    const RexInfo* info = nullptr;
+    const SliceTable* table = nullptr;
+    const SliceAnalyzer* analyzer = nullptr;
+    bool preview = false;
+    int length = 0;
+    int done = 0;               // Frames rendered so far
+    int reported = 0;           // done at the last PROGRESS event
+    vector<int> resolveAt;      // Per slice, sorted: frames rendered once its search window is
+    size_t resolved = 0;
+    int segmentSlice = -1;      // First slice after the segment, -1 when there is none to publish
+    int segmentDue = 0;         // Frames rendered before the segment is laid out
+    unique_ptr<SliceTable> segment;     // Its slices at the output rate, once laid out
+    int segmentSlices = 0;
+};
+
+// ---------------------------------------------------------------------
+// Resampling between the render and the WAV writer, for --rate. With the
+// file's own rate it hands out the writer's buffers directly, so the
+// default path costs nothing extra. Each block is also shown to the slice
+// analyzer, if any, at the render's rate while it is still in cache,
+// copied to the capture, if any, at the output rate, and then reported
+// to the progress, if any.
+// ---------------------------------------------------------------------
+class ResamplingSink : public PreviewSink {
+public:
+    ResamplingSink(WavStreamWriter& writer, int channelCount, int inputRate, int outputRate, ResampleQuality quality)
+        : wav(writer), channels(channelCount) {
+        if (inputRate != outputRate) {
+            resampler.reset(new Resampler(channelCount, inputRate, outputRate, quality));
+        }
+    }
+
+    // Feed every rendered frame to analyzer as well
+    void analyze(SliceAnalyzer* sliceAnalyzer) { analyzer = sliceAnalyzer; }
+
+    // Keep a copy of everything written in renderCapture
+    void capture(RenderCapture* renderCapture) { captured = renderCapture; }
+
+    // Tell renderProgress about every block
+    void report(RenderProgress* renderProgress) { progress = renderProgress; }
+
+    bool begin(int frames, float* buffers[2]) {
+        bool ready = ok;
+        if (!resampler) {
+            ready = wav.begin(frames, buffers);
+        } else {
+            for (int c = 0; c < channels; c++) {
+                input[c].resize(frames);
+                buffers[c] = input[c].data();
+            }
+            if (channels == 1) buffers[1] = nullptr;
+        }
+        rendering[0] = buffers[0];
+        rendering[1] = buffers[1];
+        return ready;
+    }
+
+    void end(int frames) {
+        if (analyzer != nullptr) {
+            analyzer->process(rendering, frames);
+        }
+        if (!resampler) {
+            if (captured != nullptr) captured->append(rendering, frames);
+            wav.end(frames);
+        } else {
+            const float* source[2] = {input[0].data(), input[1].data()};
+            resampler->process(source, frames, output);
+            flush();
+        }
+        if (progress != nullptr) {
+            progress->rendered(frames);
+        }
+    }
+
+    bool write(float* const source[2], int frames) {
+        const float* planes[2] = {source[0], source[1]};
+        if (analyzer != nullptr) {
+            analyzer->process(planes, frames);
+        }
+        bool written;
+        if (!resampler) {
+            if (captured != nullptr) captured->append(planes, frames);
+            written = wav.write(source, frames);
+        } else {
+            resampler->process(planes, frames, output);
+            written = flush();
+        }
+        if (progress != nullptr) {
+            progress->rendered(frames);
+        }
+        return written;
+    }
+
+    // Emit the filter tail and close the WAV
+    bool close() {
+        if (resampler) {
+            resampler->finish(output);
+            flush();
+        }
+        return wav.close() && ok;
+    }
+
+private:
+    ResamplingSink(const ResamplingSink&);
+    ResamplingSink& operator=(const ResamplingSink&);
+
+    bool flush() {
+        float* planes[2] = {output[0].data(), channels == 2 ? output[1].data() : nullptr};
+        if (captured != nullptr) captured->append(planes, (int)output[0].size());
+        ok = wav.write(planes, (int)output[0].size()) && ok;
+        output[0].clear();
+        output[1].clear();
+        return ok;
+    }
+
+    WavStreamWriter& wav;
+    int channels;
+    unique_ptr<Resampler> resampler;
+    vector<float> input[2];
+    vector<float> output[2];
+    SliceAnalyzer* analyzer = nullptr;
+    RenderCapture* captured = nullptr;
+    RenderProgress* progress = nullptr;
+    const float* rendering[2] = {nullptr, nullptr};    // The buffers handed out by begin()
+    bool ok = true;
+};
+
+// Output sample format for a file. The source bit depth maps to the
+// smallest format that holds it without requantizing.
+PcmFormat output_format(const DecodeOptions& options, const RexInfo& info) {
+    if (!options.matchSourceDepth) {
+        return options.format;
+    }
+    if (info.fBitDepth <= 16) {
+        return kPcm16;
+    }
+    return info.fBitDepth <= 24 ? kPcm24 : kFloat32;
+}
+
+const char* format_name(PcmFormat format) {
+    switch (format) {
+        case kPcm24: return "24-bit PCM";
+        case kFloat32: return "32-bit float";
+        default: return "16-bit PCM";
+    }
+}
+
+// Sample rate of the output WAV
+int output_rate(const DecodeOptions& options, const RexInfo& info) {
+    return options.outputRate > 0 ? options.outputRate : info.fSampleRate;
+}
+
+// Open the audio stream of an output: FLAC for a .flac path, else WAV
+bool open_output_stream(WavStreamWriter& wav, DecodeOutput& output, const DecodeOptions& options, int channels,
+                        int rate, int expectedFrames, int minBlockFrames, PcmFormat format) {
+    bool flac = !output.inMemory && is_flac_path(output.wavPath);
+    if (flac) {
+        if (format == kFloat32) {
+            cerr << "FLAC stores integer samples; use --bits 16, 24 or source for " << output.wavPath << endl;
+            return false;
+        }
+        wav.encodeFlac(options.flacLevel, options.flacThreads);
+    }
+    if (!wav.open(output.wavWritePath, output.inMemory ? &output.wav : nullptr, channels, rate, expectedFrames,
+                  minBlockFrames, format, options.dither)) {
+        cerr << "Failed to open output " << (flac ? "FLAC" : "WAV") << " file: " << output.wavPath << endl;
+        return false;
+    }
+    return true;
+}
+
+// Bytes written for a closed stream and, for FLAC, the encoder's throughput
+void log_output_stream(const WavStreamWriter& wav, int channels, int rate, PcmFormat format, ostream& log) {
+    trace_add_counter("output_bytes", wav.bytes());
+    const FlacEncoder* flac = wav.flacEncoder();
+    if (flac == nullptr) {
+        log << "Wrote " << wav.bytes() << " bytes\n";
+        return;
+    }
+    double pcmBytes = (double)flac->frames() * channels * pcm_bytes_per_sample(format);
+    double seconds = max(flac->encodeSeconds(), 1e-9);
+    ostringstream line;
+    line << "Wrote " << wav.bytes() << " bytes of FLAC, level " << flac->compressionLevel() << ", "
+         << fixed << setprecision(1) << 100.0 * wav.bytes() / max(pcmBytes, 1.0) << "% of PCM; encoded "
+         << setprecision(2) << (double)flac->frames() / rate << " s of audio in " << seconds * 1000.0 << " ms on "
+         << flac->threadCount() << " thread(s), " << setprecision(1) << pcmBytes / 1048576.0 / seconds << " MB/s\n";
+    log << line.str();
+}
+
+// Length in frames of the preview rendered loop at a tempo (same formula as REX Test App)
+double previewExactLength(const RexInfo& info, int tempo) {
+    return (double)info.fSampleRate * 1000.0 * (double)info.fPPQLength / ((double)tempo * 256.0);
+}
+
+// Render lengthFrames of preview at the given tempo into sink, calling
+// REXRenderPreviewBatch with at most blockFrames frames at a time
+RexError renderPreview(RexHandle handle, int tempo, int lengthFrames, PreviewSink& sink, int blockFrames, bool quiet) {
+    RexError result = rex_backend().setPreviewTempo(handle, tempo);
+    if (result != kRexError_NoError) {
+        if (!quiet) cerr << "REXSetPreviewTempo failed: " << result << endl;
+        return result;
+    }
+
+    result = rex_backend().startPreview(handle);
+    if (result != kRexError_NoError) {
+        if (!quiet) cerr << "REXStartPreview failed: " << result << endl;
+        return result;
+    }
+
+    int framesRendered = 0;
+    while (framesRendered != lengthFrames) {
+        int todo = min(blockFrames, lengthFrames - framesRendered);
+        float* tmpRenderBuffers[2] = {nullptr, nullptr};
+        if (!sink.begin(todo, tmpRenderBuffers)) {
+            if (!quiet) cerr << "Writing rendered audio failed" << endl;
+            rex_backend().stopPreview(handle);
+            return kRexError_Undefined;
+        }
+
+        result = rex_backend().renderPreviewBatch(handle, todo, tmpRenderBuffers);
+        if (result != kRexError_NoError) {
+            if (!quiet) cerr << "REXRenderPreviewBatch failed: " << result << endl;
+            rex_backend().stopPreview(handle);
+            return result;
+        }
+        sink.end(todo);
+        framesRendered += todo;
+    }
+
+    result = rex_backend().stopPreview(handle);
+    if (result != kRexError_NoError && !quiet) {
+        cerr << "REXStopPreview failed: " << result << endl;
+    }
+    return result;
+}
+
+// Auto-tuned batch size, shared by every file decoded in this process.
+// The probe is only conclusive once it hit a mismatch, an SDK error or the
+// size limit; a short loop cannot test batches longer than half its length,
+// so a later, longer loop may continue the search.
+mutex gBlockTuneLock;
+int gTunedBlockFrames = 0;
+bool gBlockTuneConclusive = false;
+
+// Render the loop in 64-frame batches into buffers, then re-render it into a
+// scratch buffer with doubling batch sizes for as long as the output stays
+// sample-identical. Leaves the 64-frame render in buffers.
+RexError autotuneBlockFrames(RexHandle handle, int tempo, int lengthFrames, int channels, float* buffers[2], ostream& log) {
+    MemorySink reference(buffers);
+    RexError result = renderPreview(handle, tempo, lengthFrames, reference, DEFAULT_PREVIEW_BLOCK_FRAMES, false);
+    if (result != kRexError_NoError) {
+        return result;
+    }
+
+    vector<float> probe((size_t)channels * lengthFrames);
+    float* probeBuffers[2] = {probe.data(), channels == 2 ? probe.data() + lengthFrames : nullptr};
+    int best = max(gTunedBlockFrames, DEFAULT_PREVIEW_BLOCK_FRAMES);
+    bool conclusive = false;
+    for (int candidate = best * 2; ; candidate *= 2) {
+        if (candidate > MAX_PREVIEW_BLOCK_FRAMES) {
+            conclusive = true;
+            break;
+        }
+        if (candidate > lengthFrames / 2) {
+            break;
+        }
+        MemorySink probeSink(probeBuffers);
+        RexError probeErr = renderPreview(handle, tempo, lengthFrames, probeSink, candidate, true);
+        bool identical = (probeErr == kRexError_NoError) &&
+            memcmp(buffers[0], probeBuffers[0], lengthFrames * sizeof(float)) == 0 &&
+            (channels != 2 || memcmp(buffers[1], probeBuffers[1], lengthFrames * sizeof(float)) == 0);
+        log << "Block size probe: " << candidate << " frames -> "
+            << (probeErr != kRexError_NoError ? "SDK error" : (identical ? "identical" : "differs")) << '\n';
+        if (!identical) {
+            conclusive = true;
+            break;
+        }
+        best = candidate;
+    }
+    gTunedBlockFrames = best;
+    gBlockTuneConclusive = conclusive;
+    log << "Auto-tuned preview batch size: " << best << " frames" << (conclusive ? "" : " (limited by loop length)") << '\n';
+    return kRexError_NoError;
+}
+
+// ---------------------------------------------------------------------
+// Slice table: REXGetSliceInfo is called once per slice when a file is
+// opened. The render fills in where each slice landed in the output, and
+// logging, marker export and the sidecar all read the same table.
+// ---------------------------------------------------------------------
+struct SliceEntry {
+    int ppqPos = 0;         // REXSliceInfo.fPPQPos
+    int sampleLength = 0;   // REXSliceInfo.fSampleLength
+    int startFrame = 0;     // First frame in the output WAV, 0-based
+    int endFrame = 0;       // Next slice start or end of the loop
+    int marker = 0;         // Renoise slice marker, 1-based
+    bool valid = false;     // REXGetSliceInfo succeeded
+    int peakLevel = SILENT_LEVEL;   // Of frames startFrame to endFrame, hundredths of a dBFS
+    int rmsLevel = SILENT_LEVEL;
+    int onsetFrame = -1;    // Transient found near the slice start, -1 if none
+};
+
+struct SliceTable {
+    vector<SliceEntry> slices;
+    int renderedFrames = 0;
+    int markerOffset = 0;   // Latency compensation the preview layout applied, at the render's rate
+    RexError firstError = kRexError_NoError;
+};
+
+// Fetch the info of every slice. Slices the SDK fails on stay in the
+// table, marked invalid, so indices keep matching the file.
+void load_slice_table(RexHandle handle, int sliceCount, SliceTable& table) {
+    table.slices.assign(max(0, sliceCount), SliceEntry());
+    table.renderedFrames = 0;
+    table.firstError = kRexError_NoError;
+    for (int i = 0; i < sliceCount; i++) {
+        RexSliceInfo slice;
+        RexError sliceErr = rex_backend().getSliceInfo(handle, i, &slice);
+        if (sliceErr != kRexError_NoError) {
+            cerr << "REXGetSliceInfo failed for slice index " << i << " with error: " << sliceErr << endl;
+            if (table.firstError == kRexError_NoError) {
+                table.firstError = sliceErr;
+            }
+            continue;
+        }
+        table.slices[i].ppqPos = slice.fPPQPos;
+        table.slices[i].sampleLength = slice.fSampleLength;
+        table.slices[i].valid = true;
+    }
+}
+
+// Where a slice's PPQ position falls in a preview render of lengthFrames,
+// before any latency compensation
+int preview_slice_position(const SliceEntry& slice, const RexInfo& info, int lengthFrames) {
+    double ratio = (double)slice.ppqPos / (double)info.fPPQLength;
+    return (int)round(ratio * lengthFrames);
+}
+
+// Place slices in the preview render by PPQ position, as REX Test App
+// does, shifted by the preview latency compensation. A slice ends where
+// the next one starts, or at the end of the loop.
+void layout_preview_slices(SliceTable& table, const RexInfo& info, int lengthFrames, int compensation) {
+    table.renderedFrames = lengthFrames;
+    table.markerOffset = compensation;
+    size_t count = table.slices.size();
+    for (size_t i = 0; i < count; i++) {
+        SliceEntry& slice = table.slices[i];
+        if (!slice.valid) continue;
+        int position = preview_slice_position(slice, info, lengthFrames) + compensation;
+        slice.startFrame = max(0, position);
+        slice.marker = max(1, position);
+    }
+    for (size_t i = 0; i < count; i++) {
+        SliceEntry& slice = table.slices[i];
+        if (!slice.valid) continue;
+        bool hasNext = (i + 1 < count && table.slices[i + 1].valid);
+        slice.endFrame = hasNext ? table.slices[i + 1].startFrame : lengthFrames;
+    }
+}
+
+// Lay slices end to end at their native lengths. Returns false if the
+// total does not fit a WAV.
+bool layout_native_slices(SliceTable& table) {
+    long long totalFrames = 0;
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        SliceEntry& slice = table.slices[i];
+        slice.startFrame = (int)min(totalFrames, (long long)INT32_MAX);
+        totalFrames += slice.sampleLength;
+        slice.endFrame = (int)min(totalFrames, (long long)INT32_MAX);
+        slice.marker = slice.startFrame + 1;
+    }
+    if (totalFrames <= 0 || totalFrames > INT32_MAX) {
+        return false;
+    }
+    table.renderedFrames = (int)totalFrames;
+    return true;
+}
+
+// Move a laid out table to the output rate with the resampler's own
+// rounding, so markers land on the same audio as before resampling
+void rescale_slice_table(SliceTable& table, int inputRate, int outputRate) {
+    if (inputRate == outputRate) {
+        return;
+    }
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        SliceEntry& slice = table.slices[i];
+        if (!slice.valid) continue;
+        int markerOffset = slice.marker - slice.startFrame;
+        slice.startFrame = (int)resampled_frame(slice.startFrame, inputRate, outputRate);
+        slice.endFrame = (int)resampled_frame(slice.endFrame, inputRate, outputRate);
+        slice.marker = slice.startFrame + markerOffset;
+        if (slice.onsetFrame >= 0) {
+            slice.onsetFrame = (int)resampled_frame(slice.onsetFrame, inputRate, outputRate);
+        }
+    }
+    table.renderedFrames = (int)resampled_frame(table.renderedFrames, inputRate, outputRate);
+}
+
+// Where the analyzer should look for each slice of a laid out table.
+// Invalid slices go past the end of the render, where nothing is searched.
+vector<int> expected_slice_starts(const SliceTable& table, int lengthFrames) {
+    vector<int> positions(table.slices.size(), lengthFrames + ONSET_SEARCH_FRAMES);
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        if (table.slices[i].valid) positions[i] = table.slices[i].startFrame;
+    }
+    return positions;
+}
+
+// A level in hundredths of a dB as text, independent of the log's formatting
+string level_text(int level) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.2f dB", level / 100.0);
+    return text;
+}
+
+// Copy the onsets and the levels between the laid out boundaries into the
+// table, at the render's rate
+void apply_slice_analysis(SliceTable& table, const SliceAnalyzer& analyzer, ostream& log, bool debug) {
+    TraceSpan analysisSpan("analysis");
+    int loudest = SILENT_LEVEL;
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        SliceEntry& slice = table.slices[i];
+        if (!slice.valid) continue;
+        analyzer.measure(slice.startFrame, slice.endFrame, slice.peakLevel, slice.rmsLevel);
+        slice.onsetFrame = analyzer.onset((int)i);
+        loudest = max(loudest, slice.peakLevel);
+        if (debug) {
+            log << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ')
+                << ": peak " << level_text(slice.peakLevel) << ", RMS " << level_text(slice.rmsLevel) << ", onset "
+                << (slice.onsetFrame >= 0 ? to_string(slice.onsetFrame) : string("none")) << '\n';
+        }
+    }
+    log << "Slice analysis: onsets in " << analyzer.onsetCount() << " of " << table.slices.size()
+        << " slices, loudest peak " << level_text(loudest) << '\n';
+}
+
+// ---------------------------------------------------------------------
+// Preview render function like REX Test App
+// ---------------------------------------------------------------------
+RexError previewRenderFullLoop(RexHandle handle, const RexInfo& info, int tempo, DecodeOutput& output,
+                               const DecodeOptions& options, SliceTable& table, RenderCapture* capture,
+                               RenderProgress* progress, ostream& log) {
+    RexError result;
+    int lengthFrames = 0;
+
+    // Calculate length in frames of preview rendered loop (same formula as REX Test App)
+    // Use double precision to minimize rounding errors
+    double exactLength = previewExactLength(info, tempo);
+    lengthFrames = (int)round(exactLength);
+
+    if (options.logLevel >= kLogDebug) {
+        log << "=== LENGTH CALCULATION DEBUG ===\n";
+        log << "REX Test App formula: (sampleRate * 1000.0 * PPQLength) / (tempo * 256)\n";
+        log << "Step by step:\n";
+        log << "  Sample Rate: " << info.fSampleRate << '\n';
+        log << "  PPQ Length: " << info.fPPQLength << '\n';
+        log << "  Tempo: " << tempo << " (internal units)\n";
+        log << "  Real BPM: " << (tempo / 1000.0) << '\n';
+        log << "  Calculation: (" << info.fSampleRate << " * 1000.0 * " << info.fPPQLength << ") / (" << tempo << " * 256)\n";
+        log << "  = " << (info.fSampleRate * 1000.0 * info.fPPQLength) << " / " << (tempo * 256) << '\n';
+        log << "  = " << exactLength << " (exact)\n";
+        log << "  = " << lengthFrames << " frames (after rounding)\n";
+        log << "  Precision difference: " << (exactLength - lengthFrames) << " frames\n";
+        log << "=================================\n";
+    }
+
+    log << "Calculated preview length: " << lengthFrames << " frames\n";
+
+    // Stream the WAV out while rendering; only two staging blocks live in memory
+    int largestBlock = options.autoBlock ? MAX_PREVIEW_BLOCK_FRAMES : options.blockFrames;
+    PcmFormat format = output_format(options, info);
+    log << "Output format: " << format_name(format) << '\n';
+    int outputRate = output_rate(options, info);
+    int outputFrames = (int)resampled_frame(lengthFrames, info.fSampleRate, outputRate);
+    WavStreamWriter wav;
+    const string& wavPath = output.wavPath;
+    if (!open_output_stream(wav, output, options, info.fChannels, outputRate, outputFrames, largestBlock, format)) {
+        return kRexError_Undefined;
+    }
+    ResamplingSink sink(wav, info.fChannels, info.fSampleRate, outputRate, options.resampleQuality);
+
+    // The analyzer watches for each slice's transient around its uncompensated position
+    vector<int> expected(table.slices.size(), lengthFrames + ONSET_SEARCH_FRAMES);
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        if (table.slices[i].valid) expected[i] = preview_slice_position(table.slices[i], info, lengthFrames);
+    }
+    SliceAnalyzer analyzer(info.fChannels, lengthFrames, expected);
+    sink.analyze(&analyzer);
+    sink.capture(capture);
+    sink.report(progress);
+    if (progress != nullptr) {
+        progress->start(info, lengthFrames, table, expected, analyzer, true);
+    }
+
+    // Render the loop, finding the largest sample-identical batch size first when asked to
+    int blockFrames = options.blockFrames;
+    bool rendered = false;
+    if (options.autoBlock) {
+        lock_guard<mutex> guard(gBlockTuneLock);
+        if (gTunedBlockFrames == 0 || (!gBlockTuneConclusive && lengthFrames / 2 >= gTunedBlockFrames * 2)) {
+            // Tuning compares whole renders, so this one loop is rendered in memory
+            vector<float> renderSamples((size_t)info.fChannels * lengthFrames);
+            float* renderBuffers[2] = {renderSamples.data(), info.fChannels == 2 ? renderSamples.data() + lengthFrames : nullptr};
+            result = autotuneBlockFrames(handle, tempo, lengthFrames, info.fChannels, renderBuffers, log);
+            if (result != kRexError_NoError) {
+                return result;
+            }
+            if (!sink.write(renderBuffers, lengthFrames)) {
+                cerr << "Failed to write output WAV file: " << wavPath << endl;
+                return kRexError_Undefined;
+            }
+            rendered = true;
+        }
+        blockFrames = gTunedBlockFrames;
+    }
+    if (!rendered) {
+        result = renderPreview(handle, tempo, lengthFrames, sink, blockFrames, false);
+        if (result != kRexError_NoError) {
+            return result;
+        }
+    }
+    log << "Rendered " << lengthFrames << " frames in batches of " << blockFrames << " frames\n";
+    if (outputRate != info.fSampleRate) {
+        log << "Resampled to " << outputRate << " Hz (" << resample_quality_name(options.resampleQuality)
+            << "): " << outputFrames << " frames\n";
+    }
+
+    if (!sink.close()) {
+        cerr << "Failed to write output WAV file: " << wavPath << endl;
+        return kRexError_Undefined;
+    }
+    log_output_stream(wav, info.fChannels, outputRate, format, log);
+    log << "Full loop written to: " << wavPath << '\n';
+
+    // Calculate slice markers for Renoise, shifted by the offset between
+    // PPQ positions and the onsets found in this render, if there were enough
+    // Use the actual rendered length, not a separate calculation
+    int compensation = options.compensation;
+    int calibrated = 0;
+    bool calibratedOffset = options.autoCompensation && analyzer.calibrate(calibrated);
+    if (calibratedOffset) {
+        compensation = calibrated;
+        log << "Marker offset: " << compensation << " frames, calibrated from the onsets of "
+            << analyzer.onsetCount() << " of " << info.fSliceCount << " slices\n";
+    } else if (options.autoCompensation) {
+        log << "Marker offset: " << compensation << " frames (default; onsets found in only "
+            << analyzer.onsetCount() << " of " << info.fSliceCount << " slices)\n";
+    } else {
+        log << "Marker offset: " << compensation << " frames (--compensation)\n";
+    }
+    layout_preview_slices(table, info, lengthFrames, compensation);
+    apply_slice_analysis(table, analyzer, log, options.logLevel >= kLogDebug);
+
+    // Step-by-step marker math, only when asked for
+    if (options.logLevel >= kLogDebug) {
+        log << "=== COMPREHENSIVE SLICE DEBUG ANALYSIS ===\n";
+        log << "Original file info:\n";
+        log << "  Sample Rate: " << info.fSampleRate << " Hz\n";
+        log << "  Tempo: " << tempo << " (Real BPM: " << (tempo / 1000.0) << ")\n";
+        log << "  PPQ Length: " << info.fPPQLength << " PPQ units\n";
+        log << "  Total Slices: " << info.fSliceCount << '\n';
+        log << '\n';
+
+        log << "Rendered preview info:\n";
+        log << "  Total rendered frames: " << lengthFrames << '\n';
+        log << "  Rendered duration: " << (double)lengthFrames / info.fSampleRate << " seconds\n";
+        log << "  Frames per PPQ unit: " << (double)lengthFrames / info.fPPQLength << '\n';
+        log << '\n';
+
+        log << "=== DETAILED SLICE ANALYSIS ===\n";
+
+        for (int i = 0; i < info.fSliceCount; i++) {
+            const SliceEntry& slice = table.slices[i];
+            if (slice.valid) {
+                // Frame position in the rendered WAV, from the slice table
+                double ratio = (double)slice.ppqPos / (double)info.fPPQLength;
+                int rawFramePosition = (int)round(ratio * lengthFrames);
+                int framePosition = slice.marker;
+                int nextSliceStart = slice.endFrame;
+                int sliceLength = nextSliceStart - framePosition;
+
+                // Time calculations
+                double sliceStartTime = (double)framePosition / info.fSampleRate;
+                double sliceEndTime = (double)nextSliceStart / info.fSampleRate;
+                double sliceDuration = sliceEndTime - sliceStartTime;
+
+                log << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ') << ":\n";
+                log << "  PPQ Position: " << slice.ppqPos << " / " << info.fPPQLength;
+                log << " (ratio: " << fixed << setprecision(6) << ratio << ")\n";
+                log << "  Original Sample Length: " << slice.sampleLength << " samples\n";
+                log << "  Raw Frame Position: " << rawFramePosition << '\n';
+                log << "  Latency Compensation: " << compensation << " frames\n";
+                log << "  Final Frame Start: " << framePosition << '\n';
+                log << "  Rendered Frame End: " << nextSliceStart << '\n';
+                log << "  Rendered Slice Length: " << sliceLength << " frames\n";
+                log << "  Time Start: " << fixed << setprecision(6) << sliceStartTime << "s\n";
+                log << "  Time End: " << fixed << setprecision(6) << sliceEndTime << "s\n";
+                log << "  Time Duration: " << fixed << setprecision(6) << sliceDuration << "s\n";
+
+                // Show the math step by step
+                log << "  Math: " << slice.ppqPos << " / " << info.fPPQLength << " * " << lengthFrames;
+                log << " = " << ratio << " * " << lengthFrames << " = " << (ratio * lengthFrames);
+                log << " → " << rawFramePosition << " + (" << compensation << ") = " << framePosition << '\n';
+
+                log << "  Renoise command: renoise.song().selected_sample:insert_slice_marker(" << framePosition << ")\n";
+                log << '\n';
+            } else {
+                log << "ERROR: Failed to get slice " << (i+1) << " info\n";
+            }
+        }
+
+        log << "=== SUMMARY ===\n";
+        log << "Applied latency compensation: " << compensation << " frames ("
+            << (calibratedOffset ? "calibrated from slice onsets" : "fixed") << ")\n";
+        log << "Total analysis complete. Onsets were found in " << analyzer.onsetCount() << " of "
+            << info.fSliceCount << " slices (see the per-slice onsets above).\n";
+        log << "If positions are still off:\n";
+        log << "  - Pin the offset with --compensation N (default without calibration "
+            << PREVIEW_LATENCY_COMPENSATION << ")\n";
+        log << "  - Positive values shift markers later in time\n";
+        log << "  - Negative values shift markers earlier in time\n";
+        log << "  - Each frame = " << fixed << setprecision(3) << (1000.0 / info.fSampleRate) << "ms at " << info.fSampleRate << "Hz\n";
+        log << "=============================================\n";
+    }
+
+    rescale_slice_table(table, info.fSampleRate, outputRate);
+    return kRexError_NoError;
+}
+
+// ---------------------------------------------------------------------
+// Slice render function: every slice rendered natively with REXRenderSlice
+// at its own fSampleLength and laid end to end, so slice boundaries are
+// exact and need no latency compensation
+// ---------------------------------------------------------------------
+RexError sliceRenderFullLoop(RexHandle handle, const RexInfo& info, DecodeOutput& output, const DecodeOptions& options,
+                                  SliceTable& table, RenderCapture* capture, RenderProgress* progress, ostream& log) {
+    // Every slice is needed; slice lengths decide where each one starts in the output
+    if (table.firstError != kRexError_NoError) {
+        return table.firstError;
+    }
+    if (!layout_native_slices(table)) {
+        cerr << "Invalid total slice length in " << info.fSliceCount << " slices" << endl;
+        return kRexError_FileCorrupt;
+    }
+    RexError result;
+    int lengthFrames = table.renderedFrames;
+    log << "Slice render length: " << lengthFrames << " frames in " << info.fSliceCount << " slices\n";
+
+    PcmFormat format = output_format(options, info);
+    log << "Output format: " << format_name(format) << '\n';
+    int outputRate = output_rate(options, info);
+    WavStreamWriter wav;
+    const string& wavPath = output.wavPath;
+    if (!open_output_stream(wav, output, options, info.fChannels, outputRate,
+                            (int)resampled_frame(lengthFrames, info.fSampleRate, outputRate), 0, format)) {
+        return kRexError_Undefined;
+    }
+    // Slices go through one resampler back to back, so the filter runs
+    // across slice boundaries exactly as over the preview render
+    ResamplingSink sink(wav, info.fChannels, info.fSampleRate, outputRate, options.resampleQuality);
+    vector<int> expected = expected_slice_starts(table, lengthFrames);
+    SliceAnalyzer analyzer(info.fChannels, lengthFrames, expected);
+    sink.analyze(&analyzer);
+    sink.capture(capture);
+    sink.report(progress);
+    if (progress != nullptr) {
+        progress->start(info, lengthFrames, table, expected, analyzer, false);
+    }
+
+    // One scratch buffer sized for the longest slice is reused for every slice
+    int longestSlice = 0;
+    for (int i = 0; i < info.fSliceCount; i++) {
+        longestSlice = max(longestSlice, table.slices[i].sampleLength);
+    }
+    vector<float> sliceSamples((size_t)info.fChannels * longestSlice);
+    float* sliceBuffers[2] = {sliceSamples.data(), info.fChannels == 2 ? sliceSamples.data() + longestSlice : nullptr};
+
+    for (int i = 0; i < info.fSliceCount; i++) {
+        const SliceEntry& slice = table.slices[i];
+        result = rex_backend().renderSlice(handle, i, slice.sampleLength, sliceBuffers);
+        if (result != kRexError_NoError) {
+            cerr << "REXRenderSlice failed for slice index " << i << " with error: " << result << endl;
+            return result;
+        }
+        if (!sink.write(sliceBuffers, slice.sampleLength)) {
+            cerr << "Failed to write output WAV file: " << wavPath << endl;
+            return kRexError_Undefined;
+        }
+
+        // Renoise slice markers are 1-based sample positions
+        log << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ')
+            << ": frames " << slice.startFrame << " - " << slice.endFrame
+            << " (" << slice.sampleLength << " frames, PPQ " << slice.ppqPos << ")"
+            << ", marker " << slice.marker << '\n';
+    }
+
+    if (!sink.close()) {
+        cerr << "Failed to write output WAV file: " << wavPath << endl;
+        return kRexError_Undefined;
+    }
+    log_output_stream(wav, info.fChannels, outputRate, format, log);
+    apply_slice_analysis(table, analyzer, log, options.logLevel >= kLogDebug);
+    if (outputRate != info.fSampleRate) {
+        rescale_slice_table(table, info.fSampleRate, outputRate);
+        log << "Resampled to " << outputRate << " Hz (" << resample_quality_name(options.resampleQuality)
+            << "): " << table.renderedFrames << " frames\n";
+    }
+    log << "Slices written to: " << wavPath << '\n';
+    return kRexError_NoError;
+}
+
+// ---------------------------------------------------------------------
+// Load an RX2 file and create a handle rendering at the file's native rate
+// ---------------------------------------------------------------------
+// Map (or stream) the RX2 file into memory
+bool readRex(const string& rx2Path, InputFile& input) {
+    TraceSpan readSpan("read");
+    if (!input.open(rx2Path)) {
+        cerr << "Failed to open RX2 file: " << rx2Path << endl;
+        return false;
+    }
+    return true;
+}
+
+RexError openRex(const string& rx2Path, const InputFile& input, RexHandle& handle, RexInfo& info, ostream& log) {
+    size_t fileSize = input.size();
+    if (fileSize > INT32_MAX) {
+        cerr << "RX2 file too large: " << rx2Path << endl;
+        return kRexError_FileCorrupt;
+    }
+    log << "Loaded RX2 file: " << rx2Path << ", size: " << fileSize << " bytes"
+        << (input.isMapped() ? " (memory-mapped)" : " (streamed)") << '\n';
+
+    // Create a REX handle straight from the mapped pages
+    TraceSpan createSpan("create");
+    handle = nullptr;
+    RexError createErr = rex_backend().create(&handle, input.data(), static_cast<int>(fileSize));
+    log << "REXCreate returned: " << createErr << ", handle: " << handle << '\n';
+    if (createErr != kRexError_NoError || !handle) {
+        cerr << "REXCreate failed or returned null handle." << endl;
+        if (handle) {
+            rex_backend().destroy(&handle);
+        }
+        return createErr != kRexError_NoError ? createErr : kRexError_Undefined;
+    }
+
+    // Extract header information
+    RexError infoErr = rex_backend().getInfo(handle, &info);
+    if (infoErr != kRexError_NoError) {
+        cerr << "REXGetInfo failed with error: " << infoErr << endl;
+        rex_backend().destroy(&handle);
+        return infoErr;
+    }
+    
+    // Set output sample rate to native rate
+    RexError sampleRateErr = rex_backend().setOutputSampleRate(handle, info.fSampleRate);
+    if (sampleRateErr != kRexError_NoError) {
+        cerr << "REXSetOutputSampleRate failed with error: " << sampleRateErr << endl;
+        rex_backend().destroy(&handle);
+        return sampleRateErr;
+    }
+    
+    // Re-fetch info after setting sample rate
+    infoErr = rex_backend().getInfo(handle, &info);
+    if (infoErr != kRexError_NoError) {
+        cerr << "REXGetInfo #2 failed with error: " << infoErr << endl;
+        rex_backend().destroy(&handle);
+        return infoErr;
+    }
+    return kRexError_NoError;
+}
+
+// Everything besides the RX2 bytes that changes what decodeFile writes.
+// Add new output-affecting options here, or cached decodes go stale.
+string cache_settings(const DecodeOptions& options, bool binarySidecar, bool flacAudio, int tempo) {
+    ostringstream settings;
+    settings << "backend=" << rex_backend().name()
+             << " extract=" << (options.extractSlices ? "slices" : "preview")
+             << " tempo=" << tempo
+             << " block=" << (options.autoBlock ? string("auto") : to_string(options.blockFrames))
+             << " bits=" << (options.matchSourceDepth ? string("source") : to_string((int)options.format))
+             << " dither=" << (options.dither ? 1 : 0)
+             << " rate=" << options.outputRate
+             << " quality=" << resample_quality_name(options.resampleQuality)
+             << " audio=" << (flacAudio ? "flac" + to_string(options.flacLevel) : string("wav"))
+             << " compensation=" << (options.autoCompensation ? "auto" : to_string(options.compensation))
+             << " analysis=" << SLICE_ANALYSIS_VERSION
+             << " sidecar=" << (binarySidecar ? "rx2meta" : "markers")
+             << " sidecar_version=" << SIDECAR_VERSION;
+    return settings.str();
+}
+
+// Write the slice markers and metadata of a rendered output, as a binary
+// .rx2meta or the marker script, and store the pair in the cache when
+// cacheKey is set. The caller fills in the sidecar's render fields. The
+// output only counts as written once its sidecar is.
+RexError finish_output(DecodeOutput& output, Sidecar& sidecar, const SliceTable& table, const DecodeOptions& options,
+                   const DecodeCacheKey* cacheKey, ostream& log) {
+    TraceSpan sidecarSpan("sidecar");
+    const string& txtPath = output.sidecarPath;
+    bool binarySidecar = output.inMemory || is_binary_sidecar_path(txtPath);
+    sidecar.header.renderedFrames = table.renderedFrames;
+    sidecar.header.markerOffset = table.markerOffset;
+    sidecar.slices.clear();
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        const SliceEntry& slice = table.slices[i];
+        if (!slice.valid) continue;
+        SidecarSlice entry;
+        entry.ppqPos = slice.ppqPos;
+        entry.sampleLength = slice.sampleLength;
+        entry.startFrame = slice.startFrame;
+        entry.lengthFrames = slice.endFrame - slice.startFrame;
+        entry.marker = slice.marker;
+        entry.peakLevel = slice.peakLevel;
+        entry.rmsLevel = slice.rmsLevel;
+        entry.onsetFrame = slice.onsetFrame;
+        sidecar.slices.push_back(entry);
+    }
+    bool sidecarWritten;
+    if (output.inMemory) {
+        output.sidecar = sidecar_bytes(sidecar, true);
+        sidecarWritten = true;
+    } else {
+        sidecarWritten = write_sidecar(output.sidecarWritePath, sidecar, binarySidecar);
+    }
+    if (!sidecarWritten) {
+        cerr << "Failed to write sidecar: " << output.sidecarWritePath << endl;
+        return kRexError_Undefined;
+    }
+    log << (binarySidecar ? "Slice metadata written to: " : "Renoise slice commands written to: ")
+        << txtPath << '\n';
+    output.written = true;
+    sidecarSpan.end();
+
+    if (cacheKey != nullptr) {
+        TraceSpan cacheSpan("cache_store");
+        bool stored = output.inMemory
+            ? decode_cache_store_memory(options.cache, *cacheKey, output.wav, output.sidecar)
+            : decode_cache_store(options.cache, *cacheKey, output.wavWritePath, output.sidecarWritePath);
+        if (!stored) {
+            cerr << "Failed to store decode in cache: " << options.cache.dir << endl;
+        }
+    }
+    return kRexError_NoError;
+}
+
+// ---------------------------------------------------------------------
+// Slice export (--slices-dir), for drumkits: every slice of a decode cut
+// from the render at the slice table's boundaries and written to a file
+// of its own, named after the input (loop_01.wav, loop_02.wav, ...),
+// plus loop_chain.wav with the same slices laid end to end and a marker
+// at each. Slices can be faded out and padded with silence; the rate,
+// sample format and container follow the main output. The files are
+// written on --slice-threads worker threads while this thread writes the
+// chain.
+// ---------------------------------------------------------------------
+// Defined with the output naming further down
+string tempo_variant_path(const string& path, int tempo);
+RexError publish_outputs(const DecodeOutput& output, RexError err);
+
+// path with suffix added to the file name, before the extension
+string path_with_suffix(const string& path, const string& suffix) {
+    size_t dot = path.rfind('.');
+    size_t separator = path.find_last_of("/\\");
+    if (dot == string::npos || (separator != string::npos && dot < separator)) {
+        dot = path.size();
+    }
+    return path.substr(0, dot) + suffix + path.substr(dot);
+}
+
+// Input file name without folder and extension, tagged with the tempo of a --tempos variant
+string slice_export_stem(const string& inputPath, int tempo) {
+    size_t separator = inputPath.find_last_of("/\\");
+    string name = separator == string::npos ? inputPath : inputPath.substr(separator + 1);
+    size_t dot = name.rfind('.');
+    if (dot != string::npos && dot > 0) {
+        name.erase(dot);
+    }
+    return tempo > 0 ? tempo_variant_path(name, tempo) : name;
+}
+
+// Copy frames [start, end) of the capture into out, fade the last
+// fadeFrames of them out and add padFrames of silence. Returns the length.
+int cut_slice(const RenderCapture& capture, int start, int end, int fadeFrames, int padFrames, vector<float> out[2]) {
+    start = min(max(0, start), capture.frames());
+    end = min(max(start, end), capture.frames());
+    int frames = end - start;
+    int fade = min(fadeFrames, frames);
+    for (int c = 0; c < capture.channels; c++) {
+        out[c].assign(capture.planes[c].begin() + start, capture.planes[c].begin() + end);
+        for (int k = 0; k < fade; k++) {
+            out[c][frames - fade + k] *= 1.0f - (float)(k + 1) / fade;
+        }
+        out[c].resize((size_t)frames + padFrames, 0.0f);
+    }
+    return frames + padFrames;
+}
+
+// Write planar audio to a file of its own through the output stream
+bool write_audio_file(const string& path, vector<float> planes[2], int frames, int channels, int rate,
+                      PcmFormat format, const DecodeOptions& options) {
+    DecodeOutput output;
+    output.wavPath = path;
+    output.wavWritePath = options.atomic ? unique_temp_path(path) : path;
+    WavStreamWriter wav;
+    if (!open_output_stream(wav, output, options, channels, rate, frames, 0, format)) {
+        return false;
+    }
+    float* source[2] = {planes[0].data(), channels == 2 ? planes[1].data() : nullptr};
+    bool written = wav.write(source, frames);
+    written = wav.close() && written;
+    if (!written) {
+        cerr << "Failed to write slice file: " << path << endl;
+    }
+    if (!options.atomic && written) {
+        return true;
+    }
+    return publish_outputs(output, written ? kRexError_NoError : kRexError_Undefined) == kRexError_NoError;
+}
+
+// Export the slices of a finished output. table and capture are at the output rate.
+RexError export_slices(const string& inputPath, const DecodeOutput& output, const RenderCapture& capture,
+                       const SliceTable& table, const Sidecar& sidecar, const DecodeOptions& options, ostream& log) {
+    TraceSpan exportSpan("slice_export");
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    if (!make_directory(options.slicesDir)) {
+        cerr << "Failed to create slice folder: " << options.slicesDir << endl;
+        return kRexError_Undefined;
+    }
+    int channels = capture.channels;
+    int rate = sidecar.header.sampleRate;
+    PcmFormat format = (PcmFormat)sidecar.header.outputBits;
+    string prefix = options.slicesDir + PATH_SEPARATOR + slice_export_stem(inputPath, output.tempo);
+    const char* extension = !output.inMemory && is_flac_path(output.wavPath) ? ".flac" : ".wav";
+    int fadeFrames = (int)lround(options.sliceFadeMs * rate / 1000.0);
+    int padFrames = (int)lround(options.slicePadMs * rate / 1000.0);
+
+    vector<size_t> slices;
+    for (size_t i = 0; i < table.slices.size(); i++) {
+        if (table.slices[i].valid) slices.push_back(i);
+    }
+    vector<string> paths(slices.size());
+    for (size_t k = 0; k < slices.size(); k++) {
+        char number[16];
+        snprintf(number, sizeof(number), "_%0*d", slices.size() > 99 ? 3 : 2, (int)k + 1);
+        paths[k] = prefix + number + extension;
+    }
+
+    // Slice files on the workers; each encodes on its own thread, so FLAC gets one
+    DecodeOptions sliceOptions = options;
+    sliceOptions.flacThreads = 1;
+    atomic<size_t> next(0);
+    atomic<int> failures(0);
+    int threadCount = max(1, min(options.sliceThreads, (int)slices.size()));
+    vector<thread> workers;
+    for (int t = 0; t < threadCount; t++) {
+        workers.push_back(thread([&]() {
+            vector<float> samples[2];
+            for (size_t k = next++; k < slices.size(); k = next++) {
+                const SliceEntry& slice = table.slices[slices[k]];
+                int frames = cut_slice(capture, slice.startFrame, slice.endFrame, fadeFrames, padFrames, samples);
+                if (!write_audio_file(paths[k], samples, frames, channels, rate, format, sliceOptions)) {
+                    failures++;
+                }
+            }
+        }));
+    }
+
+    // The chain meanwhile: the same slices end to end, with its own markers and levels
+    DecodeOutput chain;
+    bool binarySidecar = output.inMemory || is_binary_sidecar_path(output.sidecarPath);
+    chain.wavPath = prefix + "_chain" + extension;
+    chain.sidecarPath = prefix + "_chain" + (binarySidecar ? ".rx2meta" : ".txt");
+    chain.wavWritePath = options.atomic ? unique_temp_path(chain.wavPath) : chain.wavPath;
+    chain.sidecarWritePath = options.atomic ? unique_temp_path(chain.sidecarPath) : chain.sidecarPath;
+    SliceTable chainTable;
+    long long chainFrames = 0;
+    for (size_t k = 0; k < slices.size(); k++) {
+        const SliceEntry& slice = table.slices[slices[k]];
+        SliceEntry entry;
+        entry.ppqPos = slice.ppqPos;
+        entry.sampleLength = slice.sampleLength;
+        entry.valid = true;
+        entry.startFrame = (int)min(chainFrames, (long long)INT32_MAX);
+        chainFrames += max(0, min(slice.endFrame, capture.frames()) - max(0, slice.startFrame)) + padFrames;
+        entry.endFrame = (int)min(chainFrames, (long long)INT32_MAX);
+        entry.marker = entry.startFrame + 1;
+        chainTable.slices.push_back(entry);
+    }
+    RexError chainErr = kRexError_NoError;
+    if (chainFrames > INT32_MAX) {
+        cerr << "Slice chain too long for a WAV: " << chain.wavPath << endl;
+        chainErr = kRexError_Undefined;
+    } else {
+        chainTable.renderedFrames = (int)chainFrames;
+        WavStreamWriter wav;
+        if (!open_output_stream(wav, chain, options, channels, rate, chainTable.renderedFrames, 0, format)) {
+            chainErr = kRexError_Undefined;
+        } else {
+            SliceAnalyzer analyzer(channels, chainTable.renderedFrames,
+                                   expected_slice_starts(chainTable, chainTable.renderedFrames));
+            vector<float> samples[2];
+            bool written = true;
+            for (size_t k = 0; k < slices.size(); k++) {
+                const SliceEntry& slice = table.slices[slices[k]];
+                int frames = cut_slice(capture, slice.startFrame, slice.endFrame, fadeFrames, padFrames, samples);
+                float* planes[2] = {samples[0].data(), channels == 2 ? samples[1].data() : nullptr};
+                analyzer.process(planes, frames);
+                written = wav.write(planes, frames) && written;
+            }
+            written = wav.close() && written;
+            if (!written) {
+                cerr << "Failed to write slice chain: " << chain.wavPath << endl;
+                chainErr = kRexError_Undefined;
+            } else {
+                ostream discard(nullptr);
+                apply_slice_analysis(chainTable, analyzer, discard, false);
+                Sidecar chainSidecar = sidecar;
+                chainSidecar.header.sliceCount = (int)slices.size();
+                chainSidecar.header.renderMode = 1;
+                chainErr = finish_output(chain, chainSidecar, chainTable, options, nullptr, log);
+            }
+        }
+    }
+    // A failed chain leaves nothing behind
+    if (options.atomic || chainErr != kRexError_NoError) {
+        chainErr = publish_outputs(chain, chainErr);
+    }
+
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    trace_add_counter("slices_exported", (long long)slices.size() - failures);
+    if (failures > 0) {
+        cerr << "Failed to export " << failures << " of " << slices.size() << " slices to " << options.slicesDir << endl;
+        return kRexError_Undefined;
+    }
+    if (chainErr != kRexError_NoError) {
+        return chainErr;
+    }
+    ostringstream line;
+    line << "Exported " << slices.size() << " slices to " << prefix << "_*" << extension << " on " << threadCount
+         << " thread(s) in " << fixed << setprecision(1) << elapsedMs << " ms (fade " << fadeFrames
+         << " frames, pad " << padFrames << " frames); chain: " << chain.wavPath << '\n';
+    log << line.str();
+    return kRexError_NoError;
+}
+
+// ---------------------------------------------------------------------
+// Progressive decode (--progress): while each output renders, stdout
+// carries one tab-separated event per line, flushed as it happens:
+//
+//   START <TAB> output.wav <TAB> render_frames <TAB> slice_count
+//   PROGRESS <TAB> frames_rendered <TAB> render_frames <TAB> slices_resolved <TAB> slice_count
+//   SEGMENT <TAB> output_first.wav <TAB> output_first.txt <TAB> frames <TAB> slice_count
+//   DONE <TAB> output.wav <TAB> status (a RexError, 1 = no error)
+//
+// PROGRESS comes every PROGRESS_INTERVAL_FRAMES frames of the render and
+// at its end. A slice is resolved once its onset search window has been
+// rendered, so its onset and levels are known. SEGMENT announces the
+// first bar, cut at the first slice of the second, as an output of its
+// own with its markers, published before the rest of the loop has
+// rendered. The decoder never removes it: once SEGMENT has been sent the
+// two files belong to the caller, who deletes them when done with them. A preview segment takes
+// its marker offset from the onsets found so far. Loops of one bar, REX1
+// files and outputs served from the cache have no segment, and the
+// cache sends only DONE. DONE follows once the outputs are in place.
+// ---------------------------------------------------------------------
+const int PROGRESS_INTERVAL_FRAMES = 16384;
+
+// REX PPQ positions count 15360 per quarter note
+const int REX_PPQ_PER_QUARTER = 15360;
+
+RenderProgress::RenderProgress(ostream& eventStream, const DecodeOutput& renderOutput, const Sidecar& renderSidecar,
+                               const DecodeOptions& decodeOptions, RenderCapture& renderCapture, ostream& renderLog)
+    : events(eventStream), output(renderOutput), sidecar(renderSidecar), options(decodeOptions),
+      capture(renderCapture), log(renderLog) {}
+
+RenderProgress::~RenderProgress() {}
+
+void RenderProgress::start(const RexInfo& renderInfo, int lengthFrames, const SliceTable& sliceTable,
+                           const vector<int>& positions, const SliceAnalyzer& sliceAnalyzer, bool previewRender) {
+    info = &renderInfo;
+    table = &sliceTable;
+    analyzer = &sliceAnalyzer;
+    preview = previewRender;
+    length = lengthFrames;
+    done = 0;
+    reported = 0;
+    resolveAt.clear();
+    for (size_t i = 0; i < positions.size(); i++) {
+        resolveAt.push_back((int)min((long long)length, (long long)max(0, positions[i]) + ONSET_SEARCH_FRAMES));
+    }
+    sort(resolveAt.begin(), resolveAt.end());
+    resolved = 0;
+
+    // The segment needs the first slice of the second bar, rendered early enough to be worth publishing
+    int nominator = info->fTimeSignNom > 0 ? info->fTimeSignNom : 4;
+    int denominator = info->fTimeSignDenom > 0 ? info->fTimeSignDenom : 4;
+    long long barPpq = (long long)nominator * REX_PPQ_PER_QUARTER * 4 / denominator;
+    segmentSlice = -1;
+    for (size_t i = 0; i < table->slices.size(); i++) {
+        const SliceEntry& slice = table->slices[i];
+        if (slice.valid && slice.ppqPos >= barPpq) {
+            segmentSlice = (int)i;
+            break;
+        }
+    }
+    if (segmentSlice >= 0) {
+        const SliceEntry& slice = table->slices[segmentSlice];
+        int end = preview ? preview_slice_position(slice, *info, length) : slice.startFrame;
+        // A preview waits for the onsets around the end, which may move it by the marker offset
+        segmentDue = preview ? end + ONSET_SEARCH_FRAMES : end;
+        if (end <= 0 || segmentDue >= length) {
+            segmentSlice = -1;
+        } else {
+            int lastFrame = preview ? end + MAX_PREVIEW_COMPENSATION : end;
+            long long keep = resampled_frame(lastFrame, info->fSampleRate, output_rate(options, *info));
+            capture.limit = max(capture.limit, (int)keep);
+        }
+    }
+    events << "START\t" << output.wavPath << '\t' << length << '\t' << resolveAt.size() << endl;
+}
+
+void RenderProgress::rendered(int frames) {
+    done = min(length, done + frames);
+    while (resolved < resolveAt.size() && resolveAt[resolved] <= done) {
+        resolved++;
+    }
+    if (segmentSlice >= 0 && done >= segmentDue) {
+        // The resampler's output may trail the render by a block or two
+        if (!segment) {
+            layoutSegment();
+        }
+        if (capture.frames() >= segment->renderedFrames) {
+            publishSegment();
+            segmentSlice = -1;
+            segment.reset();
+        }
+    }
+    if (done - reported >= PROGRESS_INTERVAL_FRAMES || (done == length && reported != length)) {
+        reported = done;
+        events << "PROGRESS\t" << done << '\t' << length << '\t' << resolved << '\t' << resolveAt.size() << endl;
+    }
+}
+
+// Lay out the slices of the first bar once they are all rendered, at the output rate
+void RenderProgress::layoutSegment() {
+    segment.reset(new SliceTable(*table));
+    if (preview) {
+        int compensation = options.compensation;
+        int calibrated = 0;
+        if (options.autoCompensation && analyzer->calibrate(calibrated)) {
+            compensation = calibrated;
+        }
+        layout_preview_slices(*segment, *info, length, compensation);
+    }
+    int end = segment->slices[segmentSlice].startFrame;
+    segmentSlices = 0;
+    for (size_t i = 0; i < segment->slices.size(); i++) {
+        SliceEntry& slice = segment->slices[i];
+        if ((int)i >= segmentSlice) {
+            slice.valid = false;
+        } else if (slice.valid) {
+            slice.endFrame = min(slice.endFrame, end);
+            segmentSlices++;
+        }
+    }
+    segment->renderedFrames = end;
+    rescale_slice_table(*segment, info->fSampleRate, output_rate(options, *info));
+}
+
+// Write the laid out first segment next to the output
+void RenderProgress::publishSegment() {
+    TraceSpan segmentSpan("first_segment");
+    int outputRate = output_rate(options, *info);
+    int frames = segment->renderedFrames;
+    DecodeOutput first;
+    first.wavPath = path_with_suffix(output.wavPath, "_first");
+    first.sidecarPath = path_with_suffix(output.sidecarPath, "_first");
+    first.wavWritePath = options.atomic ? unique_temp_path(first.wavPath) : first.wavPath;
+    first.sidecarWritePath = options.atomic ? unique_temp_path(first.sidecarPath) : first.sidecarPath;
+    int channels = capture.channels;
+    PcmFormat format = (PcmFormat)sidecar.header.outputBits;
+    float* planes[2] = {capture.planes[0].data(), channels == 2 ? capture.planes[1].data() : nullptr};
+    WavStreamWriter wav;
+    bool written = open_output_stream(wav, first, options, channels, outputRate, frames, 0, format);
+    if (written) {
+        written = wav.write(planes, frames);
+        written = wav.close() && written;
+    }
+    RexError err = written ? kRexError_NoError : kRexError_Undefined;
+    if (written) {
+        // Levels and onsets of the segment's own audio, at the output rate
+        SliceAnalyzer levels(channels, frames, expected_slice_starts(*segment, frames));
+        levels.process(planes, frames);
+        ostream discard(nullptr);
+        apply_slice_analysis(*segment, levels, discard, false);
+        Sidecar segmentSidecar = sidecar;
+        segmentSidecar.header.sliceCount = segmentSlices;
+        err = finish_output(first, segmentSidecar, *segment, options, nullptr, log);
+    }
+    // A failed segment leaves nothing behind
+    if (options.atomic || err != kRexError_NoError) {
+        err = publish_outputs(first, err);
+    }
+    if (err != kRexError_NoError) {
+        cerr << "Failed to write the first segment: " << first.wavPath << endl;
+        return;
+    }
+    log << "First segment: " << frames << " frames in " << segmentSlices << " slices, written to "
+        << first.wavPath << '\n';
+    events << "SEGMENT\t" << first.wavPath << '\t' << first.sidecarPath << '\t' << frames << '\t' << segmentSlices
+           << endl;
+}
+
+// ---------------------------------------------------------------------
+// Decode a REX1 or ReCycle file without the REX library: the sound data
+// is copied from the mapped file to the WAV with the slice headers left
+// out, and the slices are laid end to end like --extract slices. Audio
+// before the first slice becomes a slice of its own. REX1 files have no
+// tempo or PPQ grid, so tempo variants are refused.
+// ---------------------------------------------------------------------
+RexError decodeRex1File(const string& rexPath, const InputFile& input, vector<DecodeOutput>& outputs,
+                        const DecodeOptions& options, const vector<DecodeCacheKey>* cacheKeys, ostream& log) {
+    Rex1File file;
+    string parseError;
+    {
+        TraceSpan parseSpan("rex1_parse");
+        if (!parse_rex1(input.data(), input.size(), file, parseError)) {
+            cerr << "Failed to read REX1 file " << rexPath << ": " << parseError << endl;
+            return kRexError_FileCorrupt;
+        }
+    }
+    for (size_t v = 0; v < outputs.size(); v++) {
+        if (outputs[v].tempo > 0) {
+            cerr << "REX1 files have no tempo; --tempos needs an RX2 file: " << rexPath << endl;
+            return kRexImplError_InvalidArgument;
+        }
+    }
+
+    RexInfo info;
+    memset(&info, 0, sizeof(info));
+    info.fChannels = file.channels;
+    info.fSampleRate = file.sampleRate;
+    info.fSliceCount = (int)(file.spans.size());
+    info.fBitDepth = file.bits;
+    log << "Loaded REX1 file: " << rexPath << ", size: " << input.size() << " bytes"
+        << (input.isMapped() ? " (memory-mapped)" : " (streamed)") << '\n';
+    log << "=== Header Information ===\n";
+    log << "Channels:       " << info.fChannels << '\n';
+    log << "Sample Rate:    " << info.fSampleRate << '\n';
+    log << "Slice Count:    " << file.sliceCount << '\n';
+    log << "Bit Depth:      " << info.fBitDepth << '\n';
+    log << "Sound Frames:   " << file.soundFrames << " (" << file.sliceCount << " slice headers of "
+        << REX1_SLICE_HEADER_FRAMES << " frames)\n";
+    log << "==========================\n";
+
+    // Spans in output order; the lead-in, if any, is the first one
+    SliceTable fileSlices;
+    for (size_t i = 0; i < file.spans.size(); i++) {
+        SliceEntry slice;
+        slice.sampleLength = (int)file.spans[i].frames;
+        slice.valid = true;
+        fileSlices.slices.push_back(slice);
+    }
+    layout_native_slices(fileSlices);
+
+    Sidecar sidecar;
+    sidecar.header.channels = info.fChannels;
+    sidecar.header.sampleRate = output_rate(options, info);
+    sidecar.header.sliceCount = info.fSliceCount;
+    sidecar.header.bitDepth = info.fBitDepth;
+    sidecar.header.outputBits = output_format(options, info);
+    sidecar.header.renderMode = 1;
+
+    const int chunkFrames = STREAM_BLOCK_FRAMES;
+    vector<float> samples((size_t)info.fChannels * chunkFrames);
+    float* buffers[2] = {samples.data(), info.fChannels == 2 ? samples.data() + chunkFrames : nullptr};
+    for (size_t v = 0; v < outputs.size(); v++) {
+        DecodeOutput& output = outputs[v];
+        if (output.written) {
+            continue;
+        }
+        TraceSpan renderSpan("render");
+        SliceTable table = fileSlices;
+        PcmFormat format = output_format(options, info);
+        log << "Output format: " << format_name(format) << '\n';
+        int outputRate = output_rate(options, info);
+        WavStreamWriter wav;
+        if (!open_output_stream(wav, output, options, info.fChannels, outputRate,
+                                (int)resampled_frame(table.renderedFrames, info.fSampleRate, outputRate), 0, format)) {
+            return kRexError_Undefined;
+        }
+        ResamplingSink sink(wav, info.fChannels, info.fSampleRate, outputRate, options.resampleQuality);
+        vector<int> expected = expected_slice_starts(table, table.renderedFrames);
+        SliceAnalyzer analyzer(info.fChannels, table.renderedFrames, expected);
+        sink.analyze(&analyzer);
+        RenderCapture capture;
+        capture.channels = info.fChannels;
+        if (options.slicesDir.empty()) {
+            capture.limit = 0;      // Only what a first segment needs
+        }
+        sink.capture(options.slicesDir.empty() && options.progress == nullptr ? nullptr : &capture);
+        unique_ptr<RenderProgress> progress;
+        if (options.progress != nullptr) {
+            progress.reset(new RenderProgress(*options.progress, output, sidecar, options, capture, log));
+            progress->start(info, table.renderedFrames, table, expected, analyzer, false);
+            sink.report(progress.get());
+        }
+        for (size_t i = 0; i < file.spans.size(); i++) {
+            const Rex1Span& span = file.spans[i];
+            for (long long done = 0; done < span.frames; done += chunkFrames) {
+                int frames = (int)min<long long>(chunkFrames, span.frames - done);
+                rex1_read_frames(file, span.sourceFrame + done, frames, buffers);
+                if (!sink.write(buffers, frames)) {
+                    cerr << "Failed to write output WAV file: " << output.wavPath << endl;
+                    return kRexError_Undefined;
+                }
+            }
+            const SliceEntry& slice = table.slices[i];
+            log << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ')
+                << ": frames " << slice.startFrame << " - " << slice.endFrame
+                << " (" << slice.sampleLength << " frames from sound frame " << span.sourceFrame
+                << (span.slice < 0 ? ", before the first slice" : "") << ")"
+                << ", marker " << slice.marker << '\n';
+        }
+        if (!sink.close()) {
+            cerr << "Failed to write output WAV file: " << output.wavPath << endl;
+            return kRexError_Undefined;
+        }
+        log_output_stream(wav, info.fChannels, outputRate, format, log);
+        apply_slice_analysis(table, analyzer, log, options.logLevel >= kLogDebug);
+        if (outputRate != info.fSampleRate) {
+            rescale_slice_table(table, info.fSampleRate, outputRate);
+            log << "Resampled to " << outputRate << " Hz (" << resample_quality_name(options.resampleQuality)
+                << "): " << table.renderedFrames << " frames\n";
+        }
+        log << "Slices written to: " << output.wavPath << '\n';
+        renderSpan.end();
+
+        RexError sidecarErr = finish_output(output, sidecar, table, options,
+                                            cacheKeys != nullptr ? &(*cacheKeys)[v] : nullptr, log);
+        if (sidecarErr != kRexError_NoError) {
+            return sidecarErr;
+        }
+        if (!options.slicesDir.empty()) {
+            RexError exportErr = export_slices(rexPath, output, capture, table, sidecar, options, log);
+            if (exportErr != kRexError_NoError) {
+                return exportErr;
+            }
+        }
+    }
+
+    long long peakKb = peak_rss_kb();
+    trace_add_counter("peak_rss_kb", peakKb);
+    log << "Peak RSS: " << peakKb << " KB\n";
+    return kRexError_NoError;
+}
+
+// ---------------------------------------------------------------------
+// Decode one RX2 file with an already initialized REX library into one
+// output per tempo variant. The file is read, parsed and its slices
+// fetched once; every variant is then rendered from the same handle.
+// Stops at the first failure, leaving later outputs unwritten. REX1
+// files are handed to decodeRex1File once the cache has been checked.
+// ---------------------------------------------------------------------
+RexError decodeFile(const string& rx2Path, vector<DecodeOutput>& outputs, const DecodeOptions& options,
+                    ostream& logStream) {
+    // Quiet decodes log into a stream without a buffer, which drops
+    // everything before any formatting happens
+    ostream discard(nullptr);
+    ostream& log = options.logLevel >= kLogInfo ? logStream : discard;
+    TraceSpan decodeSpan("decode", rx2Path);
+
+    InputFile input;
+    if (!readRex(rx2Path, input)) {
+        return kRexError_Undefined;
+    }
+
+    // A finished decode of the same bytes and settings is simply copied
+    vector<DecodeCacheKey> cacheKeys(outputs.size());
+    bool caching = !options.cache.dir.empty();
+    size_t pending = outputs.size();
+    // Slice export cuts the slices from the render, so it always renders
+    if (caching && options.slicesDir.empty()) {
+        TraceSpan cacheSpan("cache_fetch");
+        for (size_t v = 0; v < outputs.size(); v++) {
+            DecodeOutput& output = outputs[v];
+            bool binarySidecar = output.inMemory || is_binary_sidecar_path(output.sidecarPath);
+            cacheKeys[v] = decode_cache_key(input.data(), input.size(),
+                                            cache_settings(options, binarySidecar,
+                                                           !output.inMemory && is_flac_path(output.wavPath),
+                                                           output.tempo));
+            bool hit = output.inMemory
+                ? decode_cache_fetch_memory(options.cache, cacheKeys[v], output.wav, output.sidecar)
+                : decode_cache_fetch(options.cache, cacheKeys[v], output.wavWritePath, output.sidecarWritePath);
+            if (hit) {
+                log << "Cache hit " << cacheKeys[v].hex << ": " << output.wavPath << ", " << output.sidecarPath << '\n';
+                output.written = true;
+                pending--;
+            } else {
+                log << "Cache miss " << cacheKeys[v].hex << '\n';
+            }
+        }
+    }
+    if (pending == 0) {
+        return kRexError_NoError;
+    }
+    if (is_rex1_file(input.data(), input.size())) {
+        return decodeRex1File(rx2Path, input, outputs, options, caching ? &cacheKeys : nullptr, log);
+    }
+
+    RexHandle handle = nullptr;
+    RexInfo info;
+    RexError openErr = openRex(rx2Path, input, handle, info, log);
+    if (openErr != kRexError_NoError) {
+        return openErr;
+    }
+
+    log << "=== Header Information ===\n";
+    log << "Channels:       " << info.fChannels << '\n';
+    log << "Sample Rate:    " << info.fSampleRate << '\n';
+    log << "Slice Count:    " << info.fSliceCount << '\n';
+    double realTempo = info.fTempo / 1000.0;
+    double realOriginalTempo = info.fOriginalTempo / 1000.0;
+    log << "Tempo:          " << info.fTempo << " (Real BPM: " << realTempo << " BPM)\n";
+    log << "Original Tempo: " << info.fOriginalTempo << " (Real BPM: " << realOriginalTempo << " BPM)\n";
+    log << "Loop Length (PPQ):    " << info.fPPQLength << '\n';
+    log << "Time Signature:       " << info.fTimeSignNom << "/" << info.fTimeSignDenom << '\n';
+    log << "Bit Depth:      " << info.fBitDepth << '\n';
+    log << "==========================\n";
+
+    Sidecar sidecar;
+    sidecar.header.channels = info.fChannels;
+    sidecar.header.sampleRate = output_rate(options, info);
+    sidecar.header.sliceCount = info.fSliceCount;
+    sidecar.header.originalTempo = info.fOriginalTempo;
+    sidecar.header.ppqLength = info.fPPQLength;
+    sidecar.header.timeSignNom = info.fTimeSignNom;
+    sidecar.header.timeSignDenom = info.fTimeSignDenom;
+    sidecar.header.bitDepth = info.fBitDepth;
+
+    // Extract creator info
+    RexCreatorInfo creator;
+    RexError creatorErr = rex_backend().getCreatorInfo(handle, &creator);
+    bool hasCreatorInfo = (creatorErr == kRexError_NoError);
+    if (hasCreatorInfo) {
+        log << "=== Creator Information ===\n";
+        log << "Name:       " << creator.fName << '\n';
+        log << "Copyright:  " << creator.fCopyright << '\n';
+        log << "URL:        " << creator.fURL << '\n';
+        log << "Email:      " << creator.fEmail << '\n';
+        log << "FreeText:   " << creator.fFreeText << '\n';
+        log << "===========================\n";
+        sidecar.hasCreator = true;
+        sidecar.creator.name = creator.fName;
+        sidecar.creator.copyright = creator.fCopyright;
+        sidecar.creator.url = creator.fURL;
+        sidecar.creator.email = creator.fEmail;
+        sidecar.creator.freeText = creator.fFreeText;
+    } else {
+        log << "No creator information available.\n";
+    }
+
+    // Extract slice info once; every variant's render and marker export reuse it
+    TraceSpan sliceSpan("slice_info");
+    SliceTable fileSlices;
+    load_slice_table(handle, info.fSliceCount, fileSlices);
+    sliceSpan.end();
+    log << "=== Slice Information ===\n";
+    for (int i = 0; i < info.fSliceCount; i++) {
+        const SliceEntry& slice = fileSlices.slices[i];
+        if (slice.valid) {
+            log << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ')
+                 << ": PPQ Position = " << slice.ppqPos
+                 << ", Sample Length = " << slice.sampleLength << '\n';
+        }
+    }
+    log << "=========================\n";
+
+    RexError renderErr = kRexError_NoError;
+    for (size_t v = 0; v < outputs.size() && renderErr == kRexError_NoError; v++) {
+        DecodeOutput& output = outputs[v];
+        if (output.written) {
+            continue;
+        }
+        int tempo = output.tempo > 0 ? output.tempo : info.fTempo;
+        if (output.tempo > 0) {
+            log << "=== Tempo Variant: " << tempo / 1000.0 << " BPM ===\n";
+        }
+
+        // Render full loop using preview API (like REX Test App), or slice by slice.
+        // The layout depends on the render, so each variant lays out its own copy.
+        TraceSpan renderSpan("render");
+        SliceTable table = fileSlices;
+        sidecar.header.tempo = tempo;
+        sidecar.header.outputBits = output_format(options, info);
+        sidecar.header.renderMode = options.extractSlices ? 1 : 0;
+        RenderCapture capture;
+        capture.channels = info.fChannels;
+        if (options.slicesDir.empty()) {
+            capture.limit = 0;      // Only what a first segment needs
+        }
+        RenderCapture* keep = options.slicesDir.empty() && options.progress == nullptr ? nullptr : &capture;
+        unique_ptr<RenderProgress> progress;
+        if (options.progress != nullptr) {
+            progress.reset(new RenderProgress(*options.progress, output, sidecar, options, capture, log));
+        }
+        if (options.extractSlices) {
+            renderErr = sliceRenderFullLoop(handle, info, output, options, table, keep, progress.get(), log);
+            if (renderErr != kRexError_NoError) {
+                cerr << "Slice render failed with error: " << renderErr << endl;
+            }
+        } else {
+            renderErr = previewRenderFullLoop(handle, info, tempo, output, options, table, keep, progress.get(), log);
+            if (renderErr != kRexError_NoError) {
+                cerr << "Preview render failed with error: " << renderErr << endl;
+            }
+        }
+
+        renderSpan.end();
+        if (renderErr != kRexError_NoError) {
+            break;
+        }
+
+        renderErr = finish_output(output, sidecar, table, options, caching ? &cacheKeys[v] : nullptr, log);
+        if (renderErr == kRexError_NoError && !options.slicesDir.empty()) {
+            renderErr = export_slices(rx2Path, output, capture, table, sidecar, options, log);
+        }
+    }
+
+    rex_backend().destroy(&handle);
+    long long peakKb = peak_rss_kb();
+    trace_add_counter("peak_rss_kb", peakKb);
+    log << "Peak RSS: " << peakKb << " KB\n";
+    return renderErr;
+}
+
+// The outputs of one decode: the paths as given, or one pair per --tempos
+// entry with the tempo added to the names (loop.wav -> loop_92.5bpm.wav)
+string tempo_variant_path(const string& path, int tempo) {
+    string bpm = to_string(tempo / 1000);
+    if (tempo % 1000 != 0) {
+        string fraction = to_string(1000 + tempo % 1000).substr(1);
+        fraction.erase(fraction.find_last_not_of('0') + 1);
+        bpm += "." + fraction;
+    }
+    return path_with_suffix(path, "_" + bpm + "bpm");
+}
+
+vector<DecodeOutput> decode_outputs(const string& wavPath, const string& txtPath, const DecodeOptions& options) {
+    vector<DecodeOutput> outputs(max<size_t>(1, options.tempos.size()));
+    for (size_t v = 0; v < outputs.size(); v++) {
+        DecodeOutput& output = outputs[v];
+        output.wavPath = wavPath;
+        output.sidecarPath = txtPath;
+        if (!options.tempos.empty()) {
+            output.tempo = options.tempos[v];
+            output.wavPath = tempo_variant_path(wavPath, output.tempo);
+            output.sidecarPath = tempo_variant_path(txtPath, output.tempo);
+        }
+        output.wavWritePath = options.atomic ? unique_temp_path(output.wavPath) : output.wavPath;
+        output.sidecarWritePath = options.atomic ? unique_temp_path(output.sidecarPath) : output.sidecarPath;
+    }
+    return outputs;
+}
+
+// Move --atomic temporaries to their final names, sidecar first so the WAV
+// appearing means both are there; on failure remove them. An output with
+// a sidecar path needs both temporaries; a missing one fails the output
+// rather than leave a new WAV next to an older sidecar.
+RexError publish_outputs(const DecodeOutput& output, RexError err) {
+    if (err == kRexError_NoError) {
+        bool hasSidecar = !output.sidecarWritePath.empty();
+        bool published = (!hasSidecar || replace_file(output.sidecarWritePath, output.sidecarPath)) &&
+                         replace_file(output.wavWritePath, output.wavPath);
+        if (published) {
+            return err;
+        }
+        cerr << "Failed to move output into place: " << output.wavPath << endl;
+        err = kRexError_Undefined;
+    }
+    remove(output.sidecarWritePath.c_str());
+    remove(output.wavWritePath.c_str());
+    return err;
+}
+
+RexError decodeFile(const string& rx2Path, const string& wavPath, const string& txtPath, const DecodeOptions& options, ostream& log) {
+    vector<DecodeOutput> outputs = decode_outputs(wavPath, txtPath, options);
+    RexError err = decodeFile(rx2Path, outputs, options, log);
+    // Variants finished before a failure are still published
+    vector<RexError> status(outputs.size());
+    for (size_t v = 0; v < outputs.size(); v++) {
+        status[v] = outputs[v].written ? kRexError_NoError : err;
+        if (options.atomic) {
+            status[v] = publish_outputs(outputs[v], status[v]);
+        }
+        if (options.progress != nullptr) {
+            *options.progress << "DONE\t" << outputs[v].wavPath << '\t' << status[v] << endl;
+        }
+    }
+    if (err == kRexError_NoError) {
+        for (size_t v = 0; v < outputs.size() && err == kRexError_NoError; v++) {
+            err = status[v];
+        }
+    }
+    return err;
+}
+
+// ---------------------------------------------------------------------
+// --stdout: one framed message instead of output files. All integers
+// little-endian:
+//
+//   "PKRF"  u32 version (1)  i32 status (a RexError, 1 = no error)
+//   u64 sidecarBytes  u64 wavBytes
+//   sidecarBytes of binary .rx2meta sidecar (see sidecar.h)
+//   wavBytes of WAV file
+//
+// A failed decode still sends a frame, with both lengths zero. With
+// --tempos there is one frame per tempo, in the order given.
+// ---------------------------------------------------------------------
+const unsigned int STREAM_FRAME_VERSION = 1;
+
+void write_stream_frame(ostream& out, RexError status, const DecodeOutput& output) {
+    bool ok = (status == kRexError_NoError);
+    unsigned long long sidecarBytes = ok ? output.sidecar.size() : 0;
+    unsigned long long wavBytes = ok ? output.wav.size() : 0;
+    unsigned char header[28];
+    memcpy(header, "PKRF", 4);
+    put_le32(header + 4, STREAM_FRAME_VERSION);
+    put_le32(header + 8, (unsigned int)status);
+    put_le32(header + 12, (unsigned int)sidecarBytes);
+    put_le32(header + 16, (unsigned int)(sidecarBytes >> 32));
+    put_le32(header + 20, (unsigned int)wavBytes);
+    put_le32(header + 24, (unsigned int)(wavBytes >> 32));
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    if (ok) {
+        out.write(output.sidecar.data(), output.sidecar.size());
+        out.write(output.wav.data(), output.wav.size());
+    }
+    out.flush();
+}
+
+RexError decodeToStream(const string& rx2Path, const DecodeOptions& options, ostream& log, ostream& out) {
+    vector<DecodeOutput> outputs = decode_outputs("stdout", "stdout", options);
+    for (size_t v = 0; v < outputs.size(); v++) {
+        outputs[v].inMemory = true;
+    }
+    RexError err = decodeFile(rx2Path, outputs, options, log);
+    for (size_t v = 0; v < outputs.size(); v++) {
+        write_stream_frame(out, outputs[v].written ? kRexError_NoError : err, outputs[v]);
+    }
+    return err;
+}
+
+// ---------------------------------------------------------------------
+// Batch mode: keep the REX library loaded and decode many files
+//
+// Each job has three tab-separated fields:
+//   input.rx2 <TAB> output.wav <TAB> output.txt
+// Each job produces exactly one result line on stdout:
+//   OK <TAB> input.rx2 <TAB> elapsed_ms <TAB> peak_rss_kb
+//   ERR <TAB> input.rx2 <TAB> rex_error_code
+// Jobs are read from stdin (an empty line or end of input stops the
+// batch), from a manifest file in the same format, or from a directory
+// scan. All diagnostics go to stderr so that stdout carries nothing but
+// results. peak_rss_kb is the high-water mark of the decoding process, so
+// it only grows over a batch; with one worker process per file it is the
+// peak of that decode.
+// ---------------------------------------------------------------------
+struct DecodeJob {
+    string rx2Path;
+    string wavPath;
+    string txtPath;
+    long long cost = 0; // Input file size, used to balance workers
+};
+
+bool parse_job_line(const string& line, DecodeJob& job) {
+    vector<string> fields;
+    size_t start = 0;
+    while (true) {
+        size_t tab = line.find('\t', start);
+        fields.push_back(line.substr(start, tab == string::npos ? string::npos : tab - start));
+        if (tab == string::npos) break;
+        start = tab + 1;
+    }
+    job.rx2Path = fields[0];
+    if (fields.size() != 3) {
+        return false;
+    }
+    job.wavPath = fields[1];
+    job.txtPath = fields[2];
+    job.cost = file_size(job.rx2Path);
+    return true;
+}
+
+string format_result(const DecodeJob& job, RexError err, double elapsedMs) {
+    ostringstream result;
+    if (err == kRexError_NoError) {
+        result << "OK\t" << job.rx2Path << "\t" << fixed << setprecision(3) << elapsedMs << "\t" << peak_rss_kb();
+    } else {
+        result << "ERR\t" << job.rx2Path << "\t" << err;
+    }
+    return result.str();
+}
+
+// Decode one job in this process and return its result line
+string run_job(const DecodeJob& job, const DecodeOptions& options, ostream& log, bool& ok) {
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    RexError err = decodeFile(job.rx2Path, job.wavPath, job.txtPath, options, log);
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    ok = (err == kRexError_NoError);
+    return format_result(job, err, elapsedMs);
+}
+
+int runBatch(istream& jobs, const DecodeOptions& options, ostream& results) {
+    string line;
+    int failed = 0;
+    while (getline(jobs, line)) {
+        trim_line_end(line);
+        if (line.empty()) {
+            break;
+        }
+
+        DecodeJob job;
+        if (!parse_job_line(line, job)) {
+            cerr << "Malformed batch job (expected 3 tab-separated fields): " << line << endl;
+            results << format_result(job, kRexImplError_InvalidArgument, 0.0) << endl;
+            failed++;
+            continue;
+        }
+
+        bool ok = false;
+        results << run_job(job, options, cout, ok) << endl;
+        if (!ok) {
+            failed++;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+// Collect jobs from a manifest (or stdin) in the batch line format
+bool read_job_list(istream& in, vector<DecodeJob>& jobs) {
+    string line;
+    while (getline(in, line)) {
+        trim_line_end(line);
+        if (line.empty()) {
+            break;
+        }
+        DecodeJob job;
+        if (!parse_job_line(line, job)) {
+            cerr << "Malformed batch job (expected 3 tab-separated fields): " << line << endl;
+            return false;
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Turn every .rx2 below inputDir into a job writing to outputDir. Nested
+// folders are flattened into the output name so that same-named loops in
+// different folders do not collide.
+void collect_directory_jobs(const string& inputDir, const string& outputDir, const char* audioExtension,
+                            vector<DecodeJob>& jobs) {
+    vector<string> files;
+    list_rx2_files(inputDir, "", files);
+    for (size_t i = 0; i < files.size(); i++) {
+        string name = files[i].substr(0, files[i].size() - 4);
+        for (size_t c = 0; c < name.size(); c++) {
+            if (name[c] == '/' || name[c] == '\\') name[c] = '_';
+        }
+        DecodeJob job;
+        job.rx2Path = inputDir + PATH_SEPARATOR + files[i];
+        job.wavPath = outputDir + PATH_SEPARATOR + name + audioExtension;
+        job.txtPath = outputDir + PATH_SEPARATOR + name + "_slices.txt";
+        job.cost = file_size(job.rx2Path);
+        jobs.push_back(job);
+    }
+}
+
+// ---------------------------------------------------------------------
+// Work-stealing job queues for the worker pool
+//
+// Jobs are dealt largest-first to whichever worker has the least cost
+// assigned so far. Each worker drains its own queue from the front; a
+// worker that runs dry steals the largest pending job from the queue with
+// the most work left, so one 64-bar loop cannot hold up a whole folder.
+// ---------------------------------------------------------------------
+class JobQueues {
+public:
+    JobQueues(const vector<DecodeJob>& jobs, int workerCount) {
+        for (int i = 0; i < workerCount; i++) {
+            queues.push_back(unique_ptr<Queue>(new Queue()));
+        }
+        vector<size_t> order(jobs.size());
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        sort(order.begin(), order.end(), [&jobs](size_t a, size_t b) { return jobs[a].cost > jobs[b].cost; });
+        for (size_t i = 0; i < order.size(); i++) {
+            Queue* target = queues[0].get();
+            for (size_t q = 1; q < queues.size(); q++) {
+                if (queues[q]->remainingCost < target->remainingCost) target = queues[q].get();
+            }
+            target->items.push_back(make_pair(order[i], jobs[order[i]].cost + 1));
+            target->remainingCost += jobs[order[i]].cost + 1;
+        }
+    }
+
+    bool next(int worker, size_t& jobIndex) {
+        if (take(*queues[worker], jobIndex)) {
+            return true;
+        }
+        while (true) {
+            Queue* victim = nullptr;
+            long long victimCost = 0;
+            for (size_t q = 0; q < queues.size(); q++) {
+                lock_guard<mutex> guard(queues[q]->lock);
+                if (!queues[q]->items.empty() && queues[q]->remainingCost > victimCost) {
+                    victim = queues[q].get();
+                    victimCost = queues[q]->remainingCost;
+                }
+            }
+            if (victim == nullptr) {
+                return false;
+            }
+            if (take(*victim, jobIndex)) {
+                return true;
+            }
+        }
+    }
+
+private:
+    struct Queue {
+        mutex lock;
+        deque<pair<size_t, long long> > items;
+        long long remainingCost = 0;
+    };
+
+    bool take(Queue& queue, size_t& jobIndex) {
+        lock_guard<mutex> guard(queue.lock);
+        if (queue.items.empty()) {
+            return false;
+        }
+        jobIndex = queue.items.front().first;
+        queue.remainingCost -= queue.items.front().second;
+        queue.items.pop_front();
+        return true;
+    }
+
+    vector<unique_ptr<Queue> > queues;
+};
+
+bool read_child_line(ChildProcess& child, string& line) {
+    line.clear();
+    int c;
+    while ((c = fgetc(child.out)) != EOF) {
+        if (c == '\n') {
+            trim_line_end(line);
+            return true;
+        }
+        line += (char)c;
+    }
+    return false;
+}
+
+// ---------------------------------------------------------------------
+// Worker pool: N threads sharing the loaded library, each creating its
+// own REXHandle per job, or N isolated child processes running --batch.
+// Processes are the default for backends that are not thread-safe, the
+// REX SDK among them, and --processes asks for them with any backend.
+// ---------------------------------------------------------------------
+int runPool(const vector<DecodeJob>& jobs, int workerCount, const vector<string>& childArgs, const DecodeOptions& options, ostream& results) {
+    bool useProcesses = !childArgs.empty();
+    JobQueues queues(jobs, workerCount);
+    mutex outputLock;
+    int failed = 0;
+
+    vector<ChildProcess> children(useProcesses ? workerCount : 0);
+    for (size_t w = 0; w < children.size(); w++) {
+        if (!spawn_child(childArgs, children[w])) {
+            cerr << "Failed to start worker process " << w << endl;
+            for (size_t started = 0; started < w; started++) finish_child(children[started]);
+            return 1;
+        }
+    }
+
+    vector<thread> workers;
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&, w]() {
+            size_t jobIndex;
+            while (queues.next(w, jobIndex)) {
+                const DecodeJob& job = jobs[jobIndex];
+                string result;
+                bool ok = false;
+                if (useProcesses) {
+                    ChildProcess& child = children[w];
+                    TraceSpan jobSpan("job", job.rx2Path);
+                    bool sent = fprintf(child.in, "%s\t%s\t%s\n", job.rx2Path.c_str(), job.wavPath.c_str(), job.txtPath.c_str()) > 0
+                                && fflush(child.in) == 0;
+                    if (sent && read_child_line(child, result)) {
+                        ok = (result.compare(0, 3, "OK\t") == 0);
+                    } else {
+                        // The worker died on this file; report it and start a fresh one
+                        result = format_result(job, kRexError_Undefined, 0.0);
+                        finish_child(child);
+                        if (!spawn_child(childArgs, child)) {
+                            lock_guard<mutex> guard(outputLock);
+                            cerr << "Failed to restart worker process " << w << endl;
+                            results << result << endl;
+                            failed++;
+                            return;
+                        }
+                    }
+                } else {
+                    ostringstream log;
+                    result = run_job(job, options, log, ok);
+                    lock_guard<mutex> guard(outputLock);
+                    cerr << log.str();
+                }
+                lock_guard<mutex> guard(outputLock);
+                results << result << endl;
+                if (!ok) failed++;
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+    for (size_t w = 0; w < children.size(); w++) {
+        finish_child(children[w]);
+    }
+
+    // Anything left behind by workers that could not be restarted
+    size_t jobIndex;
+    while (queues.next(0, jobIndex)) {
+        results << format_result(jobs[jobIndex], kRexError_Undefined, 0.0) << endl;
+        failed++;
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+// ---------------------------------------------------------------------
+// Render benchmark: time full-loop preview renders for each batch size and
+// check every one bit-for-bit against the 64-frame render
+// ---------------------------------------------------------------------
+int runRenderBenchmark(const string& rx2Path, const vector<int>& blockSizes, int repeats) {
+    ostringstream quietLog;
+    InputFile input;
+    RexHandle handle = nullptr;
+    RexInfo info;
+    if (!readRex(rx2Path, input) || openRex(rx2Path, input, handle, info, quietLog) != kRexError_NoError) {
+        return 1;
+    }
+
+    int lengthFrames = (int)round(previewExactLength(info, info.fTempo));
+    size_t samples = (size_t)info.fChannels * lengthFrames;
+    vector<float> reference(samples);
+    vector<float> output(samples);
+    float* referenceBuffers[2] = {reference.data(), info.fChannels == 2 ? reference.data() + lengthFrames : nullptr};
+    float* outputBuffers[2] = {output.data(), info.fChannels == 2 ? output.data() + lengthFrames : nullptr};
+    MemorySink referenceSink(referenceBuffers);
+    if (renderPreview(handle, info.fTempo, lengthFrames, referenceSink, DEFAULT_PREVIEW_BLOCK_FRAMES, false) != kRexError_NoError) {
+        rex_backend().destroy(&handle);
+        return 1;
+    }
+
+    cout << "Render benchmark: " << rx2Path << endl;
+    cout << "  " << lengthFrames << " frames, " << info.fChannels << " channel(s), " << repeats << " render(s) per batch size" << endl;
+    cout << setw(8) << "block" << setw(10) << "calls" << setw(12) << "ms/render"
+         << setw(12) << "Mframes/s" << setw(10) << "speedup" << "  bit-exact" << endl;
+    double baselineMs = 0.0;
+    for (size_t b = 0; b < blockSizes.size(); b++) {
+        int block = blockSizes[b];
+        RexError err = kRexError_NoError;
+        chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+        for (int r = 0; r < repeats && err == kRexError_NoError; r++) {
+            MemorySink outputSink(outputBuffers);
+            err = renderPreview(handle, info.fTempo, lengthFrames, outputSink, block, true);
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / repeats;
+        if (err != kRexError_NoError) {
+            cout << setw(8) << block << "  SDK error " << err << endl;
+            continue;
+        }
+        if (block == DEFAULT_PREVIEW_BLOCK_FRAMES || baselineMs == 0.0) {
+            baselineMs = ms;
+        }
+        bool identical = memcmp(reference.data(), output.data(), samples * sizeof(float)) == 0;
+        cout << setw(8) << block
+             << setw(10) << (lengthFrames + block - 1) / block
+             << setw(12) << fixed << setprecision(3) << ms
+             << setw(12) << setprecision(2) << (lengthFrames / 1000.0) / ms
+             << setw(9) << setprecision(2) << baselineMs / ms << "x"
+             << "  " << (identical ? "yes" : "NO") << endl;
+    }
+
+    rex_backend().destroy(&handle);
+    return 0;
+}
+
+// Parse one option that changes how files are decoded. Returns false when
+// argv[i] is not a decode option; otherwise consumes its value and records
+// the option in forwarded so worker processes decode the same way.
+bool parse_decode_option(int argc, char** argv, int& i, DecodeOptions& options, vector<string>& forwarded) {
+    if (strcmp(argv[i], "--block") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        if (value == "auto") {
+            options.autoBlock = true;
+        } else {
+            options.autoBlock = false;
+            options.blockFrames = atoi(value.c_str());
+            if (options.blockFrames <= 0) {
+                cerr << "Invalid --block value " << value << ", using " << DEFAULT_PREVIEW_BLOCK_FRAMES << endl;
+                options.blockFrames = DEFAULT_PREVIEW_BLOCK_FRAMES;
+            }
+        }
+        forwarded.push_back("--block");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--extract") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        if (value != "preview" && value != "slices") {
+            cerr << "Invalid --extract value " << value << ", expected preview or slices" << endl;
+            return false;
+        }
+        options.extractSlices = (value == "slices");
+        forwarded.push_back("--extract");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--bits") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.matchSourceDepth = (value == "source");
+        if (value == "16") {
+            options.format = kPcm16;
+        } else if (value == "24") {
+            options.format = kPcm24;
+        } else if (value == "32f" || value == "float") {
+            options.format = kFloat32;
+        } else if (!options.matchSourceDepth) {
+            cerr << "Invalid --bits value " << value << ", expected 16, 24, 32f or source" << endl;
+            return false;
+        }
+        forwarded.push_back("--bits");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        if (!parse_log_level(value, options.logLevel)) {
+            cerr << "Invalid --log-level value " << value << ", expected quiet, info or debug" << endl;
+            return false;
+        }
+        forwarded.push_back("--log-level");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+        options.cache.dir = argv[++i];
+        forwarded.push_back("--cache");
+        forwarded.push_back(options.cache.dir);
+        return true;
+    }
+    if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        long long megabytes = atoll(value.c_str());
+        if (megabytes <= 0) {
+            cerr << "Invalid --cache-size value " << value << ", expected megabytes" << endl;
+            return false;
+        }
+        options.cache.limitBytes = megabytes * 1024 * 1024;
+        forwarded.push_back("--cache-size");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--atomic") == 0) {
+        options.atomic = true;
+        forwarded.push_back("--atomic");
+        return true;
+    }
+    if (strcmp(argv[i], "--dither") == 0) {
+        options.dither = true;
+        forwarded.push_back("--dither");
+        return true;
+    }
+    if (strcmp(argv[i], "--tempos") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.tempos.clear();
+        stringstream list(value);
+        string item;
+        while (getline(list, item, ',')) {
+            int tempo = (int)lround(atof(item.c_str()) * 1000.0);
+            if (tempo < 20000 || tempo > 450000) {
+                cerr << "Invalid --tempos entry " << item << ", expected 20 to 450 BPM" << endl;
+                return false;
+            }
+            options.tempos.push_back(tempo);
+        }
+        if (options.tempos.empty()) {
+            cerr << "Invalid --tempos value " << value << ", expected a comma-separated BPM list" << endl;
+            return false;
+        }
+        forwarded.push_back("--tempos");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.outputRate = atoi(value.c_str());
+        if (options.outputRate < 8000 || options.outputRate > 192000) {
+            cerr << "Invalid --rate value " << value << ", expected 8000 to 192000 Hz" << endl;
+            return false;
+        }
+        forwarded.push_back("--rate");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--quality") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        if (!parse_resample_quality(value, options.resampleQuality)) {
+            cerr << "Invalid --quality value " << value << ", expected fast, standard or best" << endl;
+            return false;
+        }
+        forwarded.push_back("--quality");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--flac-level") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.flacLevel = atoi(value.c_str());
+        if (value.empty() || value.find_first_not_of("0123456789") != string::npos || options.flacLevel > MAX_FLAC_LEVEL) {
+            cerr << "Invalid --flac-level value " << value << ", expected 0 to " << MAX_FLAC_LEVEL << endl;
+            return false;
+        }
+        forwarded.push_back("--flac-level");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--flac-threads") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.flacThreads = atoi(value.c_str());
+        if (options.flacThreads <= 0) {
+            cerr << "Invalid --flac-threads value " << value << ", expected a thread count" << endl;
+            return false;
+        }
+        forwarded.push_back("--flac-threads");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--compensation") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.autoCompensation = (value == "auto");
+        if (!options.autoCompensation) {
+            char* end = nullptr;
+            long frames = strtol(value.c_str(), &end, 10);
+            if (value.empty() || *end != '\0' || frames < -MAX_PREVIEW_COMPENSATION || frames > MAX_PREVIEW_COMPENSATION) {
+                cerr << "Invalid --compensation value " << value << ", expected auto or " << -MAX_PREVIEW_COMPENSATION
+                     << " to " << MAX_PREVIEW_COMPENSATION << " frames" << endl;
+                return false;
+            }
+            options.compensation = (int)frames;
+        }
+        forwarded.push_back("--compensation");
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--slices-dir") == 0 && i + 1 < argc) {
+        options.slicesDir = argv[++i];
+        forwarded.push_back("--slices-dir");
+        forwarded.push_back(options.slicesDir);
+        return true;
+    }
+    if ((strcmp(argv[i], "--slice-fade") == 0 || strcmp(argv[i], "--slice-pad") == 0) && i + 1 < argc) {
+        const char* name = argv[i];
+        string value = argv[++i];
+        char* end = nullptr;
+        double ms = strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || !(ms >= 0 && ms <= 10000)) {
+            cerr << "Invalid " << name << " value " << value << ", expected 0 to 10000 ms" << endl;
+            return false;
+        }
+        (strcmp(name, "--slice-fade") == 0 ? options.sliceFadeMs : options.slicePadMs) = ms;
+        forwarded.push_back(name);
+        forwarded.push_back(value);
+        return true;
+    }
+    if (strcmp(argv[i], "--slice-threads") == 0 && i + 1 < argc) {
+        string value = argv[++i];
+        options.sliceThreads = atoi(value.c_str());
+        if (options.sliceThreads <= 0) {
+            cerr << "Invalid --slice-threads value " << value << ", expected a thread count" << endl;
+            return false;
+        }
+        forwarded.push_back("--slice-threads");
+        forwarded.push_back(value);
+        return true;
+    }
+    return false;
+}
+
+vector<int> parse_int_list(const string& text) {
+    vector<int> values;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ',')) {
+        int value = atoi(item.c_str());
+        if (value > 0) values.push_back(value);
+    }
+    return values;
+}
+
+// Report what --timings and --trace asked for once all work is done
+void write_trace_output(bool printTimings, const char* tracePath) {
+    if (printTimings) {
+        trace_write_summary(cerr);
+    }
+    if (tracePath && !trace_write_chrome(tracePath)) {
+        cerr << "Failed to write trace file: " << tracePath << endl;
+    }
+}
+
+// True when path is a REX1 or ReCycle file, which decodeFile reads itself
+bool is_rex1_input(const char* path) {
+    InputFile input;
+    return input.open(path) && is_rex1_file(input.data(), input.size());
+}
+
+void printUsage(const char* program) {
+    cerr << "Usage: " << program << " input.rx2 output.wav output.txt sdk_path [options]" << endl;
+    cerr << "       " << program << " --batch sdk_path [--jobs N] [--processes]"
+         << " [--manifest jobs.txt | --dir input_dir output_dir [--flac]] [options] [< jobs.txt]" << endl;
+    cerr << "       " << program << " --index sdk_path index_file library_dir [--jobs N] [--creator]" << endl;
+    cerr << "       " << program << " --query index_file [--tempo BPM[-BPM]] [--bars N[-N]] [--sig 4/4]"
+         << " [--slices N[-N]] [--channels 1|2] [--text words]" << endl;
+    cerr << "       " << program << " --bench-render input.rx2 sdk_path [--repeat N] [--block-sizes 64,128,...]" << endl;
+    cerr << "       " << program << " --bench-convert [--frames N] [--repeat N]" << endl;
+    cerr << "       " << program << " --bench-resample [--frames N] [--rate-in HZ] [--rate-out HZ] [--repeat N]"
+         << endl;
+    cerr << "       " << program << " --bench-flac [--frames N] [--threads N] [--repeat N]" << endl;
+    cerr << "output.txt receives one insert_slice_marker() line per slice; name it *.rx2meta to get" << endl;
+    cerr << "the binary sidecar with header, creator and per-slice data instead (see sidecar.h)" << endl;
+    cerr << "--batch --jobs N decodes on N threads when the backend is thread-safe and in N worker" << endl;
+    cerr << "processes otherwise, as with the REX SDK; --processes always uses processes" << endl;
+    cerr << "Name output.wav *.flac to get lossless FLAC instead of a WAV; --dir batches do so with --flac" << endl;
+    // importers/PakettiRX2Loader.lua looks for this line before sending .rex and .rcy files here
+    cerr << "REX1 (.rex) and ReCycle (.rcy) inputs are decoded without the REX library, slice by slice;" << endl;
+    cerr << "sdk_path is not loaded for them and --tempos does not apply" << endl;
+    cerr << "Options:" << endl;
+    cerr << "  --block N|auto   frames per REXRenderPreviewBatch call (default " << DEFAULT_PREVIEW_BLOCK_FRAMES
+         << "); auto finds the largest sample-identical size" << endl;
+    cerr << "  --extract preview|slices   render the loop through the preview transport (default)" << endl;
+    cerr << "                   or each slice natively at its own length, with exact slice markers" << endl;
+    cerr << "  --bits 16|24|32f|source   output sample format (default 16); source follows the"
+         << " file's own bit depth" << endl;
+    cerr << "  --dither         add TPDF dither when converting to 16-bit or 24-bit PCM" << endl;
+    cerr << "  --tempos 90,120,140.5   render one preview variant per BPM from a single load of the" << endl;
+    cerr << "                   file; each gets its own outputs, named like loop_140.5bpm.wav" << endl;
+    cerr << "  --rate HZ        resample the output to HZ (windowed sinc); slice markers are scaled" << endl;
+    cerr << "                   to match, so no second conversion is needed" << endl;
+    cerr << "  --quality fast|standard|best   resampler filter length for --rate (default standard)" << endl;
+    cerr << "  --flac-level 0-" << MAX_FLAC_LEVEL << "   FLAC compression level (default " << DEFAULT_FLAC_LEVEL
+         << "); higher is smaller and slower" << endl;
+    cerr << "  --flac-threads N FLAC encoder threads per output (default: the cores divided among the jobs)" << endl;
+    cerr << "  --compensation auto|N   preview marker offset in frames; auto (default) takes it from the" << endl;
+    cerr << "                   slice onsets found in each render, falling back to "
+         << PREVIEW_LATENCY_COMPENSATION << endl;
+    cerr << "  --slices-dir DIR also write each slice to DIR as a file of its own (loop_01.wav, ...)" << endl;
+    cerr << "                   and all of them end to end, with markers, as loop_chain.wav" << endl;
+    cerr << "  --slice-fade MS  fade the end of each exported slice out over MS milliseconds" << endl;
+    cerr << "  --slice-pad MS   add MS milliseconds of silence after each exported slice" << endl;
+    cerr << "  --slice-threads N   slice files written at once (default: the cores divided among the jobs)" << endl;
+    cerr << "  --atomic         write temporary files next to the outputs and rename them into place" << endl;
+    cerr << "                   when done, so readers never see a partial file" << endl;
+    cerr << "  --progress       single file mode: report START, PROGRESS, SEGMENT and DONE events on stdout" << endl;
+    cerr << "                   while decoding, and publish the first bar early as output_first.wav" << endl;
+    cerr << "                   and output_first.txt; those belong to the caller, who removes them" << endl;
+    cerr << "  --stdout         single file mode: send the .rx2meta sidecar and the WAV to stdout as one" << endl;
+    cerr << "                   framed message instead of writing output.wav/output.txt (pass - for both)" << endl;
+    cerr << "  --cache DIR      reuse earlier decodes of the same file and options from DIR" << endl;
+    cerr << "  --cache-size MB  least recently used cache entries go past this size (default "
+         << DEFAULT_DECODE_CACHE_MB << ")" << endl;
+    cerr << "  --log-level quiet|info|debug   diagnostics to print (default info); debug adds the" << endl;
+    cerr << "                   bundle checks and the step-by-step length and slice analysis" << endl;
+    cerr << "  --timings        print per-phase TIMING lines (phase, calls, total ms, max ms) to stderr" << endl;
+    cerr << "  --trace out.json write a Chrome trace of every phase (chrome://tracing, Perfetto)" << endl;
+    cerr << "  --backend " << rex_backend_names() << "   REX implementation (default " << default_rex_backend_name()
+         << "); synth renders deterministic stand-in loops" << endl;
+    cerr << "                   from REXSYNTH spec files and ignores sdk_path (see rex_backend_synth.cpp)" << endl;
+}
+
+// ---------------------------------------------------------------------
+// Main Program: Extract metadata and render full loop using preview API
+// ---------------------------------------------------------------------
+int main(int argc, char** argv) {
+    // Expected usage: input.rx2 output.wav output.txt sdk_path [options]
+    //             or: --batch sdk_path [--jobs N] [--processes] [--manifest jobs.txt | --dir in out] [options]
+    //             or: --index sdk_path index_file library_dir [--jobs N] [--creator]
+    //             or: --query index_file [filters]
+    //             or: --bench-render input.rx2 sdk_path [--repeat N] [--block-sizes 64,128,...]
+    //             or: --bench-convert [--frames N] [--repeat N]
+    //             or: --bench-resample [--frames N] [--rate-in HZ] [--rate-out HZ] [--repeat N]
+    //             or: --bench-flac [--frames N] [--threads N] [--repeat N]
+
+    // The conversion, resampler and FLAC benchmarks need no SDK
+    if (argc >= 2 && strcmp(argv[1], "--bench-convert") == 0) {
+        int frames = 4 * 1024 * 1024;
+        int repeats = 5;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                frames = max(1, atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+                repeats = max(1, atoi(argv[++i]));
+            } else {
+                cerr << "Unknown option: " << argv[i] << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        return run_convert_benchmark(frames, repeats, cout);
+    }
+    if (argc >= 2 && strcmp(argv[1], "--bench-resample") == 0) {
+        int frames = 1024 * 1024;
+        int inputRate = 44100;
+        int outputRate = 48000;
+        int repeats = 3;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                frames = max(1, atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--rate-in") == 0 && i + 1 < argc) {
+                inputRate = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--rate-out") == 0 && i + 1 < argc) {
+                outputRate = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+                repeats = max(1, atoi(argv[++i]));
+            } else {
+                cerr << "Unknown option: " << argv[i] << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        if (inputRate < 8000 || inputRate > 192000 || outputRate < 8000 || outputRate > 192000) {
+            cerr << "Rates must be 8000 to 192000 Hz" << endl;
+            return 1;
+        }
+        return run_resample_benchmark(frames, inputRate, outputRate, repeats, cout);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--bench-flac") == 0) {
+        int frames = 4 * 1024 * 1024;
+        int threads = max(1, (int)thread::hardware_concurrency());
+        int repeats = 3;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+                frames = max(1, atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+                threads = max(1, atoi(argv[++i]));
+            } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+                repeats = max(1, atoi(argv[++i]));
+            } else {
+                cerr << "Unknown option: " << argv[i] << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        return run_flac_benchmark(frames, threads, repeats, cout);
+    }
+
+    // Index queries only read the index file
+    if (argc >= 3 && strcmp(argv[1], "--query") == 0) {
+        IndexQuery query;
+        for (int i = 3; i < argc; i++) {
+            if (!parse_index_query_option(argc, argv, i, query)) {
+                cerr << "Unknown query option: " << argv[i] << endl;
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        return run_index_query(argv[2], query, cout, cerr);
+    }
+
+    bool batchMode = (argc >= 3 && strcmp(argv[1], "--batch") == 0);
+    bool benchMode = (argc >= 4 && strcmp(argv[1], "--bench-render") == 0);
+    bool indexMode = (argc >= 5 && strcmp(argv[1], "--index") == 0);
+    if (argc < 5 && !batchMode && !benchMode) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const char* sdkPath = batchMode || indexMode ? argv[2] : (benchMode ? argv[3] : argv[4]);
+    int firstOption = batchMode ? 3 : (benchMode ? 4 : 5);
+
+    // Decode options apply to every mode; the rest are mode specific
+    DecodeOptions options;
+    vector<string> forwardedArgs;
+    int jobCount = indexMode ? max(1, (int)thread::hardware_concurrency()) : 1;
+    bool useProcesses = false;
+    const char* manifestPath = nullptr;
+    const char* inputDir = nullptr;
+    const char* outputDir = nullptr;
+    bool printTimings = false;
+    const char* tracePath = nullptr;
+    bool streamOutput = false;
+    bool progressEvents = false;
+    bool indexCreator = false;
+    bool dirFlac = false;
+    int benchRepeats = 5;
+    vector<int> benchBlockSizes = parse_int_list("64,128,256,512,1024,2048,4096,8192,16384");
+    for (int i = firstOption; i < argc; i++) {
+        if (parse_decode_option(argc, argv, i, options, forwardedArgs)) {
+            continue;
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            string value = argv[++i];
+            if (!select_rex_backend(value)) {
+                cerr << "Unknown --backend " << value << ", expected " << rex_backend_names() << endl;
+                return 1;
+            }
+            forwardedArgs.push_back("--backend");
+            forwardedArgs.push_back(value);
+        } else if (!batchMode && !benchMode && !indexMode && strcmp(argv[i], "--stdout") == 0) {
+            streamOutput = true;
+        } else if (!batchMode && !benchMode && !indexMode && strcmp(argv[i], "--progress") == 0) {
+            progressEvents = true;
+        } else if (strcmp(argv[i], "--timings") == 0) {
+            printTimings = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if ((batchMode || indexMode) && strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+            jobCount = atoi(argv[++i]);
+            if (jobCount <= 0) {
+                jobCount = max(1, (int)thread::hardware_concurrency());
+            }
+        } else if (indexMode && strcmp(argv[i], "--creator") == 0) {
+            indexCreator = true;
+        } else if (batchMode && strcmp(argv[i], "--processes") == 0) {
+            useProcesses = true;
+        } else if (batchMode && strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifestPath = argv[++i];
+        } else if (batchMode && strcmp(argv[i], "--flac") == 0) {
+            dirFlac = true;
+        } else if (batchMode && strcmp(argv[i], "--dir") == 0 && i + 2 < argc) {
+            inputDir = argv[++i];
+            outputDir = argv[++i];
+        } else if (benchMode && strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            benchRepeats = max(1, atoi(argv[++i]));
+        } else if (benchMode && strcmp(argv[i], "--block-sizes") == 0 && i + 1 < argc) {
+            benchBlockSizes = parse_int_list(argv[++i]);
+        } else {
+            cerr << "Unknown option: " << argv[i] << endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    // Slice renders play every slice at its recorded length, so only the preview has a tempo
+    if (!options.tempos.empty() && options.extractSlices) {
+        cerr << "--tempos renders through the preview and cannot be combined with --extract slices" << endl;
+        return 1;
+    }
+    if (streamOutput && progressEvents) {
+        cerr << "--progress and --stdout both write to stdout; use one of them" << endl;
+        return 1;
+    }
+    if (!batchMode && !benchMode && !indexMode && is_flac_path(argv[2]) && options.format == kFloat32 &&
+        !options.matchSourceDepth) {
+        cerr << "FLAC stores integer samples; use --bits 16, 24 or source" << endl;
+        return 1;
+    }
+    // Parallel jobs share one loaded library only when the backend allows it
+    if (batchMode && jobCount > 1 && !useProcesses && !rex_backend().threadSafe()) {
+        useProcesses = true;
+    }
+    bool pooled = batchMode && (jobCount > 1 || useProcesses || manifestPath || inputDir);
+    // FLAC encoder threads share the cores with the decode jobs; worker
+    // processes are told the split instead of working it out again
+    if (options.flacThreads == 0) {
+        options.flacThreads = max(1, (int)thread::hardware_concurrency() / (pooled ? max(1, jobCount) : 1));
+        forwardedArgs.push_back("--flac-threads");
+        forwardedArgs.push_back(to_string(options.flacThreads));
+    }
+    if (options.sliceThreads == 0) {
+        options.sliceThreads = max(1, (int)thread::hardware_concurrency() / (pooled ? max(1, jobCount) : 1));
+        forwardedArgs.push_back("--slice-threads");
+        forwardedArgs.push_back(to_string(options.sliceThreads));
+    }
+    if (printTimings || tracePath) {
+        trace_enable();
+    }
+
+    // In batch and index mode stdout is reserved for results, with --stdout
+    // for the framed output and with --progress for the events
+    ostream results(cout.rdbuf());
+    if (batchMode || benchMode || indexMode || streamOutput || progressEvents) {
+        cout.rdbuf(cerr.rdbuf());
+    }
+    if (progressEvents) {
+        options.progress = &results;
+    }
+    if (streamOutput) {
+        set_stdout_binary();
+    }
+
+    // The pool needs the whole job list up front to balance it
+    vector<DecodeJob> jobs;
+    if (pooled) {
+        if (inputDir) {
+            collect_directory_jobs(inputDir, outputDir, dirFlac ? ".flac" : ".wav", jobs);
+        } else if (manifestPath) {
+            ifstream manifest(manifestPath);
+            if (!manifest || !read_job_list(manifest, jobs)) {
+                cerr << "Failed to read batch manifest: " << manifestPath << endl;
+                return 1;
+            }
+        } else if (!read_job_list(cin, jobs)) {
+            return 1;
+        }
+        if (options.logLevel >= kLogInfo) {
+            cerr << "Decoding " << jobs.size() << " files with " << jobCount
+                 << (useProcesses ? " worker processes" : " worker threads") << endl;
+        }
+    }
+
+    // Isolated workers load the library themselves
+    if (pooled && useProcesses) {
+        vector<string> childArgs;
+        childArgs.push_back(self_executable_path(argv[0]));
+        childArgs.push_back("--batch");
+        childArgs.push_back(sdkPath);
+        childArgs.insert(childArgs.end(), forwardedArgs.begin(), forwardedArgs.end());
+        int poolExit = runPool(jobs, jobCount, childArgs, options, results);
+        write_trace_output(printTimings, tracePath);
+        return poolExit;
+    }
+
+    // Perform diagnostics on the provided SDK bundle
+    bool sdkBackend = strcmp(rex_backend().name(), "sdk") == 0;
+    if (options.logLevel >= kLogDebug && sdkBackend) {
+        print_bundle_debug(sdkPath);
+    }
+
+    // Initialize the REX DLL/dynamic library (or the stand-in). A single
+    // REX1 file is decoded natively and does not need it.
+    bool needsLibrary = batchMode || benchMode || indexMode || !is_rex1_input(argv[1]);
+    if (needsLibrary) {
+        TraceSpan initSpan("dll_init");
+        RexError initErr = rex_backend().initialize(sdkPath);
+        initSpan.end();
+        if (options.logLevel >= kLogInfo) {
+            cout << (sdkBackend ? "REXInitializeDLL_DirPath" : "Synth backend initialize")
+                 << " returned: " << initErr << endl;
+        }
+        if (initErr != kRexError_NoError) {
+            cerr << "DLL initialization failed." << endl;
+            return 1;
+        }
+    }
+
+    int exitCode;
+    if (pooled) {
+        exitCode = runPool(jobs, jobCount, vector<string>(), options, results);
+    } else if (batchMode) {
+        exitCode = runBatch(cin, options, results);
+    } else if (indexMode) {
+        ostream discard(nullptr);
+        exitCode = update_library_index(argv[3], argv[4], jobCount, indexCreator, results,
+                                        options.logLevel >= kLogInfo ? cerr : discard);
+    } else if (benchMode) {
+        cout.rdbuf(results.rdbuf());
+        exitCode = runRenderBenchmark(argv[2], benchBlockSizes, benchRepeats);
+    } else if (streamOutput) {
+        exitCode = (decodeToStream(argv[1], options, cout, results) == kRexError_NoError) ? 0 : 1;
+    } else {
+        exitCode = (decodeFile(argv[1], argv[2], argv[3], options, cout) == kRexError_NoError) ? 0 : 1;
+    }
+
+    // Cleanup
+    if (needsLibrary) {
+        rex_backend().uninitialize();
+    }
+    write_trace_output(printTimings, tracePath);
+
+    return exitCode;
+}
@@ -0,0 +1,883 @@
+// flac_encoder.cpp
+//
+// FLAC encoding behind flac_encoder.h. Each block is analysed per channel
+// into the cheapest subframe plan, then written; stereo blocks compare
+// the plans of left, right, mid and side to pick the channel assignment.
+
+#include "flac_encoder.h"
+#include "pcm_convert.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+struct LevelSettings {
+    int blockSize;
+    int maxLpcOrder;            // 0 for fixed predictors only
+    int maxPartitionOrder;
+    int stereoSearch;           // 0 independent, 1 estimated, 2 every assignment encoded
+    bool exhaustiveLpc;         // Try every LPC order instead of the estimated best
+};
+
+const LevelSettings LEVELS[MAX_FLAC_LEVEL + 1] = {
+    {1152, 0, 3, 0, false},
+    {1152, 0, 3, 1, false},
+    {1152, 0, 3, 2, false},
+    {4096, 6, 4, 2, false},
+    {4096, 8, 4, 2, false},
+    {4096, 8, 5, 2, false},
+    {4096, 8, 6, 2, false},
+    {4096, 12, 6, 2, false},
+    {4096, 12, 6, 2, true},
+};
+
+const int MAX_LPC_ORDER = 12;
+const int MAX_FIXED_ORDER = 4;
+
+// ---------------------------------------------------------------------
+// Bits and checksums
+// ---------------------------------------------------------------------
+class BitWriter {
+public:
+    explicit BitWriter(vector<unsigned char>& out) : bytes(out) {}
+
+    // Low count bits of value, count <= 32
+    void put(uint32_t value, int count) {
+        if (count == 0) return;
+        accumulator = (accumulator << count) | (value & (uint32_t)((1ULL << count) - 1));
+        pendingBits += count;
+        while (pendingBits >= 8) {
+            pendingBits -= 8;
+            bytes.push_back((unsigned char)(accumulator >> pendingBits));
+        }
+    }
+
+    void putSigned(int32_t value, int count) { put((uint32_t)value, count); }
+
+    // q zero bits and a one
+    void putUnary(uint32_t q) {
+        while (q >= 32) {
+            put(0, 32);
+            q -= 32;
+        }
+        put(1, q + 1);
+    }
+
+    void putRice(int32_t value, int k) {
+        uint32_t u = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+        putUnary(u >> k);
+        put(u, k);
+    }
+
+    void align() {
+        if (pendingBits > 0) put(0, 8 - pendingBits);
+    }
+
+private:
+    vector<unsigned char>& bytes;
+    uint64_t accumulator = 0;
+    int pendingBits = 0;
+};
+
+struct CrcTables {
+    uint8_t crc8[256];
+    uint16_t crc16[256];
+    CrcTables() {
+        for (int i = 0; i < 256; i++) {
+            uint8_t c8 = (uint8_t)i;
+            uint16_t c16 = (uint16_t)(i << 8);
+            for (int b = 0; b < 8; b++) {
+                c8 = (uint8_t)((c8 & 0x80) ? (c8 << 1) ^ 0x07 : c8 << 1);
+                c16 = (uint16_t)((c16 & 0x8000) ? (c16 << 1) ^ 0x8005 : c16 << 1);
+            }
+            crc8[i] = c8;
+            crc16[i] = c16;
+        }
+    }
+};
+
+const CrcTables& crc_tables() {
+    static const CrcTables tables;
+    return tables;
+}
+
+uint8_t crc8(const unsigned char* p, size_t n) {
+    const CrcTables& t = crc_tables();
+    uint8_t crc = 0;
+    for (size_t i = 0; i < n; i++) crc = t.crc8[crc ^ p[i]];
+    return crc;
+}
+
+uint16_t crc16(const unsigned char* p, size_t n) {
+    const CrcTables& t = crc_tables();
+    uint16_t crc = 0;
+    for (size_t i = 0; i < n; i++) crc = (uint16_t)((crc << 8) ^ t.crc16[(crc >> 8) ^ p[i]]);
+    return crc;
+}
+
+// ---------------------------------------------------------------------
+// Subframe analysis
+// ---------------------------------------------------------------------
+enum SubframeType {
+    kSubframeConstant,
+    kSubframeVerbatim,
+    kSubframeFixed,
+    kSubframeLpc
+};
+
+struct RicePlan {
+    int partitionOrder = 0;
+    bool wideParameters = false;        // 5-bit parameters (coding method 1)
+    vector<int> parameters;
+    long long bits = 0;
+};
+
+struct SubframePlan {
+    SubframeType type = kSubframeVerbatim;
+    int wasted = 0;                     // Low zero bits shared by every sample
+    int bps = 0;                        // Sample bits after the wasted ones
+    int order = 0;
+    int precision = 0;                  // LPC coefficient bits
+    int shift = 0;
+    int coefficients[MAX_LPC_ORDER];
+    RicePlan rice;
+    vector<int32_t> signal;             // Samples with the wasted bits removed
+    vector<int32_t> residual;           // From order on
+    long long bits = 0;
+};
+
+// Partitioned Rice cost of residual, which starts order samples into a block of n
+RicePlan plan_rice(const vector<int32_t>& residual, int n, int order, int maxPartitionOrder) {
+    // Sums of the zigzag values per partition at the finest order, merged upwards
+    int finest = maxPartitionOrder;
+    while (finest > 0 && ((n & ((1 << finest) - 1)) != 0 || (n >> finest) < order)) finest--;
+    int partitions = 1 << finest;
+    int partitionSize = n >> finest;
+    vector<uint64_t> sums(partitions, 0);
+    size_t r = 0;
+    for (int p = 0; p < partitions; p++) {
+        int count = partitionSize - (p == 0 ? order : 0);
+        uint64_t sum = 0;
+        for (int i = 0; i < count; i++, r++) {
+            int32_t v = residual[r];
+            sum += ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+        }
+        sums[p] = sum;
+    }
+
+    RicePlan best;
+    best.bits = -1;
+    for (int po = finest; po >= 0; po--) {
+        int count = 1 << po;
+        int size = n >> po;
+        RicePlan plan;
+        plan.partitionOrder = po;
+        plan.parameters.resize(count);
+        long long bits = 0;
+        for (int p = 0; p < count; p++) {
+            uint64_t sum = sums[p];
+            long long samples = size - (p == 0 ? order : 0);
+            int k = 0;
+            while (k < 30 && ((uint64_t)samples << (k + 1)) <= sum) k++;
+            // The estimate can sit one above the best parameter
+            long long cost = samples * (k + 1) + (long long)(sum >> k);
+            if (k > 0) {
+                long long lower = samples * k + (long long)(sum >> (k - 1));
+                if (lower <= cost) {
+                    k--;
+                    cost = lower;
+                }
+            }
+            plan.parameters[p] = k;
+            plan.wideParameters = plan.wideParameters || k > 14;
+            bits += cost;
+        }
+        plan.bits = 2 + 4 + bits + (long long)count * (plan.wideParameters ? 5 : 4);
+        if (best.bits < 0 || plan.bits < best.bits) {
+            best = plan;
+        }
+        if (po > 0) {
+            for (int p = 0; p < count / 2; p++) sums[p] = sums[2 * p] + sums[2 * p + 1];
+        }
+    }
+    return best;
+}
+
+bool fits_residual(int64_t value) {
+    return value >= -(1LL << 30) && value < (1LL << 30);
+}
+
+// Residual of fixed predictor order into residual; false if it overflows
+bool fixed_residual(const int32_t* x, int n, int order, vector<int32_t>& residual) {
+    residual.resize(n - order);
+    for (int i = order; i < n; i++) {
+        int64_t e;
+        switch (order) {
+            case 0: e = x[i]; break;
+            case 1: e = (int64_t)x[i] - x[i-1]; break;
+            case 2: e = (int64_t)x[i] - 2LL * x[i-1] + x[i-2]; break;
+            case 3: e = (int64_t)x[i] - 3LL * x[i-1] + 3LL * x[i-2] - x[i-3]; break;
+            default: e = (int64_t)x[i] - 4LL * x[i-1] + 6LL * x[i-2] - 4LL * x[i-3] + x[i-4]; break;
+        }
+        if (!fits_residual(e)) return false;
+        residual[i - order] = (int32_t)e;
+    }
+    return true;
+}
+
+// Fixed predictor order with the smallest total absolute residual
+int best_fixed_order(const int32_t* x, int n) {
+    int maxOrder = min(MAX_FIXED_ORDER, n - 1);
+    uint64_t totals[MAX_FIXED_ORDER + 1] = {0, 0, 0, 0, 0};
+    for (int i = MAX_FIXED_ORDER; i < n; i++) {
+        int64_t e0 = x[i];
+        int64_t e1 = e0 - x[i-1];
+        int64_t e2 = e1 - ((int64_t)x[i-1] - x[i-2]);
+        int64_t e3 = e2 - (((int64_t)x[i-1] - x[i-2]) - ((int64_t)x[i-2] - x[i-3]));
+        int64_t e4 = e3 - ((((int64_t)x[i-1] - x[i-2]) - ((int64_t)x[i-2] - x[i-3]))
+                         - (((int64_t)x[i-2] - x[i-3]) - ((int64_t)x[i-3] - x[i-4])));
+        totals[0] += (uint64_t)llabs(e0);
+        totals[1] += (uint64_t)llabs(e1);
+        totals[2] += (uint64_t)llabs(e2);
+        totals[3] += (uint64_t)llabs(e3);
+        totals[4] += (uint64_t)llabs(e4);
+    }
+    int best = 0;
+    for (int o = 1; o <= maxOrder; o++) {
+        if (totals[o] < totals[best]) best = o;
+    }
+    return best;
+}
+
+// LPC coefficients of every order up to maxOrder (Levinson-Durbin on a
+// Tukey(0.5) windowed autocorrelation), with each order's prediction error
+int compute_lpc(const int32_t* x, int n, int maxOrder, double lpc[MAX_LPC_ORDER][MAX_LPC_ORDER],
+                double error[MAX_LPC_ORDER]) {
+    vector<double> w(n);
+    int taper = max(1, n / 4);
+    for (int i = 0; i < n; i++) {
+        double g = 1.0;
+        if (i < taper) g = 0.5 - 0.5 * cos(PI * i / taper);
+        else if (i >= n - taper) g = 0.5 - 0.5 * cos(PI * (n - 1 - i) / taper);
+        w[i] = x[i] * g;
+    }
+    double autoc[MAX_LPC_ORDER + 1];
+    for (int lag = 0; lag <= maxOrder; lag++) {
+        double sum = 0;
+        for (int i = lag; i < n; i++) sum += w[i] * w[i - lag];
+        autoc[lag] = sum;
+    }
+    if (autoc[0] == 0) {
+        return 0;
+    }
+    double a[MAX_LPC_ORDER] = {0};
+    double err = autoc[0];
+    int orders = 0;
+    for (int i = 0; i < maxOrder; i++) {
+        double r = -autoc[i + 1];
+        for (int j = 0; j < i; j++) r -= a[j] * autoc[i - j];
+        r /= err;
+        a[i] = r;
+        for (int j = 0; j < i / 2; j++) {
+            double tmp = a[j];
+            a[j] += r * a[i - 1 - j];
+            a[i - 1 - j] += r * tmp;
+        }
+        if (i & 1) a[i / 2] += a[i / 2] * r;
+        err *= 1.0 - r * r;
+        for (int j = 0; j <= i; j++) lpc[i][j] = -a[j];
+        error[i] = err;
+        orders = i + 1;
+        if (err <= 0) break;
+    }
+    return orders;
+}
+
+// Coefficient bits for an LPC order. Up to 16-bit samples the prediction
+// stays within 32 bits, so decoders can take their fast path.
+int lpc_precision(int bps, int order) {
+    if (bps > 16) {
+        return 15;
+    }
+    int orderBits = 0;
+    while ((1 << (orderBits + 1)) <= order) orderBits++;
+    return max(5, min(15, 32 - bps - orderBits));
+}
+
+// Quantize coefficients to precision signed bits; false if they do not fit
+bool quantize_lpc(const double* lpc, int order, int precision, int coefficients[], int& shift) {
+    double cmax = 0;
+    for (int i = 0; i < order; i++) cmax = max(cmax, fabs(lpc[i]));
+    if (cmax <= 0) return false;
+    int log2cmax;
+    frexp(cmax, &log2cmax);
+    int qmax = (1 << (precision - 1)) - 1;
+    int qmin = -(1 << (precision - 1));
+    shift = min(15, precision - 1 - log2cmax);
+    if (shift < 0) return false;
+    double carried = 0;
+    for (int i = 0; i < order; i++) {
+        carried += lpc[i] * (double)(1 << shift);
+        long q = lround(carried);
+        q = max<long>(qmin, min<long>(qmax, q));
+        carried -= q;
+        coefficients[i] = (int)q;
+    }
+    return true;
+}
+
+bool lpc_residual(const int32_t* x, int n, int order, const int coefficients[], int shift,
+                  vector<int32_t>& residual) {
+    residual.resize(n - order);
+    for (int i = order; i < n; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) sum += (int64_t)coefficients[j] * x[i - 1 - j];
+        int64_t e = (int64_t)x[i] - (sum >> shift);
+        if (!fits_residual(e)) return false;
+        residual[i - order] = (int32_t)e;
+    }
+    return true;
+}
+
+// Cheapest subframe for n samples of bps bits
+void plan_subframe(const int32_t* samples, int n, int bps, const LevelSettings& settings, SubframePlan& plan) {
+    plan.signal.assign(samples, samples + n);
+    uint32_t bitsSet = 0;
+    for (int i = 0; i < n; i++) bitsSet |= (uint32_t)samples[i];
+    bool constant = true;
+    for (int i = 1; i < n && constant; i++) constant = samples[i] == samples[0];
+    plan.wasted = 0;
+    if (bitsSet != 0 && !constant) {
+        while (((bitsSet >> plan.wasted) & 1) == 0) plan.wasted++;
+        for (int i = 0; i < n; i++) plan.signal[i] >>= plan.wasted;
+    }
+    plan.bps = bps - plan.wasted;
+    long long headerBits = 8 + plan.wasted;
+
+    if (constant) {
+        plan.type = kSubframeConstant;
+        plan.bits = headerBits + bps;
+        return;
+    }
+    plan.type = kSubframeVerbatim;
+    plan.bits = headerBits + (long long)n * plan.bps;
+
+    const int32_t* x = plan.signal.data();
+    vector<int32_t> residual;
+    int fixedOrder = best_fixed_order(x, n);
+    if (fixed_residual(x, n, fixedOrder, residual)) {
+        RicePlan rice = plan_rice(residual, n, fixedOrder, settings.maxPartitionOrder);
+        long long bits = headerBits + (long long)fixedOrder * plan.bps + rice.bits;
+        if (bits < plan.bits) {
+            plan.type = kSubframeFixed;
+            plan.order = fixedOrder;
+            plan.rice = rice;
+            plan.residual.swap(residual);
+            plan.bits = bits;
+        }
+    }
+
+    int maxOrder = min(settings.maxLpcOrder, n - 1);
+    if (maxOrder <= 0) {
+        return;
+    }
+    double lpc[MAX_LPC_ORDER][MAX_LPC_ORDER];
+    double error[MAX_LPC_ORDER];
+    int orders = compute_lpc(x, n, maxOrder, lpc, error);
+    if (orders == 0) {
+        return;
+    }
+
+    // Without the exhaustive search, the order with the lowest estimated size
+    int first = 1;
+    int last = orders;
+    if (!settings.exhaustiveLpc) {
+        int best = 1;
+        double bestBits = 0;
+        for (int o = 1; o <= orders; o++) {
+            double perSample = error[o - 1] > 0 ? max(0.0, 0.5 * log2(error[o - 1] / n) + 0.5) : 0.0;
+            double estimate = perSample * (n - o) + (double)o * (plan.bps + lpc_precision(plan.bps, o));
+            if (o == 1 || estimate < bestBits) {
+                best = o;
+                bestBits = estimate;
+            }
+        }
+        first = last = best;
+    }
+    for (int order = first; order <= last; order++) {
+        int coefficients[MAX_LPC_ORDER];
+        int shift;
+        int precision = lpc_precision(plan.bps, order);
+        if (!quantize_lpc(lpc[order - 1], order, precision, coefficients, shift) ||
+            !lpc_residual(x, n, order, coefficients, shift, residual)) {
+            continue;
+        }
+        RicePlan rice = plan_rice(residual, n, order, settings.maxPartitionOrder);
+        long long bits = headerBits + (long long)order * plan.bps + 4 + 5 + (long long)order * precision + rice.bits;
+        if (bits < plan.bits) {
+            plan.type = kSubframeLpc;
+            plan.order = order;
+            plan.precision = precision;
+            plan.shift = shift;
+            memcpy(plan.coefficients, coefficients, sizeof(coefficients));
+            plan.rice = rice;
+            plan.residual.swap(residual);
+            plan.bits = bits;
+        }
+    }
+}
+
+void write_subframe(BitWriter& out, const SubframePlan& plan, int n) {
+    int typeCode = 1;
+    switch (plan.type) {
+        case kSubframeConstant: typeCode = 0; break;
+        case kSubframeVerbatim: typeCode = 1; break;
+        case kSubframeFixed: typeCode = 8 | plan.order; break;
+        case kSubframeLpc: typeCode = 32 | (plan.order - 1); break;
+    }
+    out.put(0, 1);
+    out.put(typeCode, 6);
+    out.put(plan.wasted > 0 ? 1 : 0, 1);
+    if (plan.wasted > 0) {
+        out.put(1, plan.wasted);    // wasted - 1 zeros, then a one
+    }
+    const int32_t* x = plan.signal.data();
+    if (plan.type == kSubframeConstant) {
+        out.putSigned(x[0], plan.bps + plan.wasted);
+        return;
+    }
+    if (plan.type == kSubframeVerbatim) {
+        for (int i = 0; i < n; i++) out.putSigned(x[i], plan.bps);
+        return;
+    }
+    for (int i = 0; i < plan.order; i++) out.putSigned(x[i], plan.bps);
+    if (plan.type == kSubframeLpc) {
+        out.put(plan.precision - 1, 4);
+        out.putSigned(plan.shift, 5);
+        for (int i = 0; i < plan.order; i++) out.putSigned(plan.coefficients[i], plan.precision);
+    }
+    const RicePlan& rice = plan.rice;
+    out.put(rice.wideParameters ? 1 : 0, 2);
+    out.put(rice.partitionOrder, 4);
+    int partitions = 1 << rice.partitionOrder;
+    int size = n >> rice.partitionOrder;
+    size_t r = 0;
+    for (int p = 0; p < partitions; p++) {
+        int k = rice.parameters[p];
+        out.put(k, rice.wideParameters ? 5 : 4);
+        int count = size - (p == 0 ? plan.order : 0);
+        for (int i = 0; i < count; i++, r++) out.putRice(plan.residual[r], k);
+    }
+}
+
+// ---------------------------------------------------------------------
+// Frames
+// ---------------------------------------------------------------------
+int block_size_code(int frames) {
+    switch (frames) {
+        case 192: return 1;
+        case 576: return 2;
+        case 1152: return 3;
+        case 2304: return 4;
+        case 4608: return 5;
+    }
+    for (int k = 0; k < 8; k++) {
+        if (frames == (256 << k)) return 8 + k;
+    }
+    return frames <= 256 ? 6 : 7;
+}
+
+int sample_rate_code(int rate) {
+    switch (rate) {
+        case 88200: return 1;
+        case 176400: return 2;
+        case 192000: return 3;
+        case 8000: return 4;
+        case 16000: return 5;
+        case 22050: return 6;
+        case 24000: return 7;
+        case 32000: return 8;
+        case 44100: return 9;
+        case 48000: return 10;
+        case 96000: return 11;
+    }
+    if (rate <= 65535) return 13;
+    if (rate % 10 == 0 && rate / 10 <= 65535) return 14;
+    return 0;
+}
+
+int sample_size_code(int bits) {
+    switch (bits) {
+        case 8: return 1;
+        case 12: return 2;
+        case 16: return 4;
+        case 20: return 5;
+        case 24: return 6;
+    }
+    return 0;
+}
+
+// Frame number in FLAC's extended UTF-8 coding
+void put_utf8(BitWriter& out, uint64_t value) {
+    if (value < 0x80) {
+        out.put((uint32_t)value, 8);
+        return;
+    }
+    int extra = 1;
+    while (extra < 6 && value >= (1ULL << (5 * extra + 6))) extra++;
+    int leadBits = 6 - extra;
+    out.put((1u << (extra + 1)) - 1, extra + 1);
+    out.put(0, 1);
+    out.put((uint32_t)(value >> (6 * extra)), leadBits);
+    for (int i = extra - 1; i >= 0; i--) {
+        out.put(2, 2);
+        out.put((uint32_t)(value >> (6 * i)), 6);
+    }
+}
+
+// One frame of frames interleaved samples
+void encode_frame(const int32_t* interleaved, int channels, int frames, int bits, int rate,
+                  const LevelSettings& settings, long long frameNumber, vector<unsigned char>& out) {
+    // Planes: left/right (or mono), then mid and side for stereo searches
+    vector<int32_t> planes[4];
+    for (int c = 0; c < channels; c++) {
+        planes[c].resize(frames);
+        for (int i = 0; i < frames; i++) planes[c][i] = interleaved[(size_t)i * channels + c];
+    }
+
+    int assignment = channels - 1;
+    SubframePlan plans[4];
+    int chosen[2] = {0, 1};
+    if (channels == 2 && settings.stereoSearch > 0) {
+        planes[2].resize(frames);
+        planes[3].resize(frames);
+        for (int i = 0; i < frames; i++) {
+            int64_t l = planes[0][i];
+            int64_t r = planes[1][i];
+            planes[2][i] = (int32_t)((l + r) >> 1);
+            planes[3][i] = (int32_t)(l - r);
+        }
+        long long cost[4];
+        if (settings.stereoSearch == 1) {
+            // Order 2 residual size as a stand-in for the encoded size
+            for (int c = 0; c < 4; c++) {
+                const int32_t* x = planes[c].data();
+                uint64_t sum = 0;
+                for (int i = 2; i < frames; i++) sum += (uint64_t)llabs((int64_t)x[i] - 2LL * x[i-1] + x[i-2]);
+                cost[c] = (long long)sum;
+            }
+        } else {
+            for (int c = 0; c < 4; c++) {
+                plan_subframe(planes[c].data(), frames, bits + (c == 3 ? 1 : 0), settings, plans[c]);
+                cost[c] = plans[c].bits;
+            }
+        }
+        // Independent, left/side, side/right, mid/side
+        const int pairs[4][2] = {{0, 1}, {0, 3}, {3, 1}, {2, 3}};
+        const int codes[4] = {1, 8, 9, 10};
+        int best = 0;
+        for (int a = 1; a < 4; a++) {
+            if (cost[pairs[a][0]] + cost[pairs[a][1]] < cost[pairs[best][0]] + cost[pairs[best][1]]) best = a;
+        }
+        assignment = codes[best];
+        chosen[0] = pairs[best][0];
+        chosen[1] = pairs[best][1];
+    }
+    for (int c = 0; c < channels; c++) {
+        int plane = chosen[c];
+        if (channels == 2 && settings.stereoSearch == 2) continue;
+        plan_subframe(planes[plane].data(), frames, bits + (plane == 3 ? 1 : 0), settings, plans[plane]);
+    }
+
+    size_t start = out.size();
+    BitWriter writer(out);
+    writer.put(0xFFF8, 16);
+    int sizeCode = block_size_code(frames);
+    int rateCode = sample_rate_code(rate);
+    writer.put(sizeCode, 4);
+    writer.put(rateCode, 4);
+    writer.put(assignment, 4);
+    writer.put(sample_size_code(bits), 3);
+    writer.put(0, 1);
+    put_utf8(writer, (uint64_t)frameNumber);
+    if (sizeCode == 6) writer.put(frames - 1, 8);
+    if (sizeCode == 7) writer.put(frames - 1, 16);
+    if (rateCode == 13) writer.put(rate, 16);
+    if (rateCode == 14) writer.put(rate / 10, 16);
+    writer.put(crc8(out.data() + start, out.size() - start), 8);
+
+    for (int c = 0; c < channels; c++) {
+        write_subframe(writer, plans[chosen[c]], frames);
+    }
+    writer.align();
+    writer.put(crc16(out.data() + start, out.size() - start), 16);
+}
+
+// ---------------------------------------------------------------------
+// MD5 of the samples, for the STREAMINFO block (RFC 1321)
+// ---------------------------------------------------------------------
+class Md5Digest {
+public:
+    Md5Digest() : length(0) {
+        state[0] = 0x67452301;
+        state[1] = 0xefcdab89;
+        state[2] = 0x98badcfe;
+        state[3] = 0x10325476;
+    }
+
+    void update(const unsigned char* data, size_t n) {
+        size_t used = (size_t)(length & 63);
+        length += n;
+        if (used > 0) {
+            size_t take = min(n, 64 - used);
+            memcpy(buffer + used, data, take);
+            data += take;
+            n -= take;
+            if (used + take < 64) return;
+            transform(buffer);
+        }
+        for (; n >= 64; data += 64, n -= 64) transform(data);
+        memcpy(buffer, data, n);
+    }
+
+    void finish(unsigned char digest[16]) {
+        uint64_t bitLength = length * 8;
+        unsigned char pad[72] = {0x80};
+        size_t used = (size_t)(length & 63);
+        size_t padBytes = (used < 56 ? 56 : 120) - used;
+        for (int i = 0; i < 8; i++) pad[padBytes + i] = (unsigned char)(bitLength >> (8 * i));
+        update(pad, padBytes + 8);
+        for (int i = 0; i < 16; i++) digest[i] = (unsigned char)(state[i / 4] >> (8 * (i % 4)));
+    }
+
+private:
+    static uint32_t rotate(uint32_t x, int c) { return (x << c) | (x >> (32 - c)); }
+
+    void transform(const unsigned char* block) {
+        static const uint32_t K[64] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391};
+        static const int S[16] = {7, 12, 17, 22, 5, 9, 14, 20, 4, 11, 16, 23, 6, 10, 15, 21};
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = block[i * 4] | (block[i * 4 + 1] << 8) | (block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        for (int i = 0; i < 64; i++) {
+            uint32_t f;
+            int g;
+            int round = i / 16;
+            if (round == 0) { f = (b & c) | (~b & d); g = i; }
+            else if (round == 1) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+            else if (round == 2) { f = b ^ c ^ d; g = (3 * i + 5) % 16; }
+            else { f = c ^ (b | ~d); g = (7 * i) % 16; }
+            uint32_t next = d;
+            d = c;
+            c = b;
+            b = b + rotate(a + f + K[i] + m[g], S[round * 4 + i % 4]);
+            a = next;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+    }
+
+    uint32_t state[4];
+    uint64_t length;
+    unsigned char buffer[64];
+};
+
+} // namespace
+
+struct FlacEncoder::Md5 : Md5Digest {};
+
+bool is_flac_path(const string& path) {
+    if (path.size() < 5) return false;
+    string ext = path.substr(path.size() - 5);
+    for (size_t i = 0; i < ext.size(); i++) ext[i] = (char)tolower((unsigned char)ext[i]);
+    return ext == ".flac";
+}
+
+FlacEncoder::FlacEncoder(int channelCount, int sampleRate, int bitsPerSample, int compressionLevel, int threadCount)
+    : channels(channelCount), rate(sampleRate), bits(bitsPerSample),
+      level(max(0, min(MAX_FLAC_LEVEL, compressionLevel))), threads(max(1, threadCount)),
+      blockSize(LEVELS[level].blockSize), md5(new Md5()) {
+    memset(digest, 0, sizeof(digest));
+}
+
+FlacEncoder::~FlacEncoder() {
+    delete md5;
+}
+
+string FlacEncoder::header() const {
+    vector<unsigned char> bytes;
+    BitWriter out(bytes);
+    for (int i = 0; i < 4; i++) out.put("fLaC"[i], 8);
+    out.put(1, 1);                  // Last metadata block
+    out.put(0, 7);                  // STREAMINFO
+    out.put(34, 24);
+    out.put(blockSize, 16);
+    out.put(blockSize, 16);
+    out.put(minFrameBytes, 24);
+    out.put(maxFrameBytes, 24);
+    out.put(rate, 20);
+    out.put(channels - 1, 3);
+    out.put(bits - 1, 5);
+    out.put((uint32_t)(totalFrames >> 32), 4);
+    out.put((uint32_t)totalFrames, 32);
+    for (int i = 0; i < 16; i++) out.put(digest[i], 8);
+    return string(bytes.begin(), bytes.end());
+}
+
+void FlacEncoder::encode(const unsigned char* pcm, int frames, vector<unsigned char>& out) {
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    int bytesPerSample = bits / 8;
+    size_t samples = (size_t)frames * channels;
+    size_t offset = pending.size();
+    pending.resize(offset + samples);
+    int32_t* dst = pending.data() + offset;
+    const unsigned char* p = pcm;
+    if (bytesPerSample == 2) {
+        for (size_t i = 0; i < samples; i++, p += 2) dst[i] = (int16_t)(p[0] | (p[1] << 8));
+    } else {
+        for (size_t i = 0; i < samples; i++, p += 3) {
+            dst[i] = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+        }
+    }
+    md5->update(pcm, samples * bytesPerSample);
+    pendingFrames += frames;
+    totalFrames += frames;
+
+    int blocks = pendingFrames / blockSize;
+    if (blocks > 0) {
+        encodeBlocks(pending.data(), blocks, blockSize, out);
+        size_t used = (size_t)blocks * blockSize * channels;
+        pending.erase(pending.begin(), pending.begin() + used);
+        pendingFrames -= blocks * blockSize;
+    }
+    encodeTime += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+void FlacEncoder::finish(vector<unsigned char>& out) {
+    if (finished) return;
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    if (pendingFrames > 0) {
+        encodeBlocks(pending.data(), 1, pendingFrames, out);
+        pending.clear();
+        pendingFrames = 0;
+    }
+    md5->finish(digest);
+    finished = true;
+    encodeTime += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+}
+
+// Encode blockCount blocks, all of blockSize frames but the last one of
+// lastFrames, on up to threads threads, and append them in order
+void FlacEncoder::encodeBlocks(const int32_t* samples, int blockCount, int lastFrames, vector<unsigned char>& out) {
+    vector<vector<unsigned char> > encoded(blockCount);
+    atomic<int> nextIndex(0);
+    const LevelSettings& settings = LEVELS[level];
+    long long firstBlock = nextBlock;
+    auto work = [&]() {
+        for (int b = nextIndex++; b < blockCount; b = nextIndex++) {
+            int frames = b == blockCount - 1 ? lastFrames : blockSize;
+            encode_frame(samples + (size_t)b * blockSize * channels, channels, frames, bits, rate, settings,
+                         firstBlock + b, encoded[b]);
+        }
+    };
+    int helpers = min(threads, blockCount) - 1;
+    vector<thread> pool;
+    for (int t = 0; t < helpers; t++) pool.push_back(thread(work));
+    work();
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+
+    for (int b = 0; b < blockCount; b++) {
+        unsigned int size = (unsigned int)encoded[b].size();
+        minFrameBytes = minFrameBytes == 0 ? size : min(minFrameBytes, size);
+        maxFrameBytes = max(maxFrameBytes, size);
+        out.insert(out.end(), encoded[b].begin(), encoded[b].end());
+        totalBytes += size;
+    }
+    nextBlock += blockCount;
+}
+
+int run_flac_benchmark(int frames, int threads, int repeats, ostream& out) {
+    // A sweep with some noise on top, quantized like a decode
+    vector<float> left(frames), right(frames);
+    uint32_t seed = 12345;
+    for (int i = 0; i < frames; i++) {
+        double t = (double)i / 44100.0;
+        seed = seed * 1664525u + 1013904223u;
+        float noise = ((seed >> 9) / 8388608.0f - 0.5f) * 0.02f;
+        left[i] = (float)(0.6 * sin(2.0 * PI * (50.0 + 2000.0 * t) * t)) + noise;
+        right[i] = (float)(0.5 * sin(2.0 * PI * (50.0 + 2000.0 * t) * t + 0.3)) - noise;
+    }
+    vector<unsigned char> pcm((size_t)frames * 4);
+    const float* planes[2] = {left.data(), right.data()};
+    convert_planar_to_pcm(planes, 2, frames, kPcm16, nullptr, pcm.data());
+    const int chunkFrames = 16384;
+    bool allExact = true;
+
+    out << "FLAC benchmark: " << frames << " stereo 16-bit frames, " << repeats << " run(s) each" << endl;
+    out << setw(6) << "level" << setw(8) << "block" << setw(9) << "threads" << setw(12) << "ms"
+        << setw(12) << "MB/s" << setw(12) << "bytes" << setw(8) << "ratio" << "  exact" << endl;
+    for (int level = 0; level <= MAX_FLAC_LEVEL; level++) {
+        vector<unsigned char> reference;
+        int threadCounts[2] = {1, threads};
+        for (int t = 0; t < (threads > 1 ? 2 : 1); t++) {
+            vector<unsigned char> stream;
+            int block = 0;
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++) {
+                FlacEncoder encoder(2, 44100, 16, level, threadCounts[t]);
+                string header = encoder.header();
+                stream.assign(header.begin(), header.end());
+                for (int i = 0; i < frames; i += chunkFrames) {
+                    encoder.encode(pcm.data() + (size_t)i * 4, min(chunkFrames, frames - i), stream);
+                }
+                encoder.finish(stream);
+                header = encoder.header();
+                memcpy(stream.data(), header.data(), header.size());
+                block = encoder.blockFrames();
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / repeats;
+            string exact = "-";
+            if (t == 0) {
+                reference.swap(stream);
+            } else {
+                bool same = stream == reference;
+                allExact = allExact && same;
+                exact = same ? "yes" : "NO";
+            }
+            size_t bytes = t == 0 ? reference.size() : stream.size();
+            out << setw(6) << level
+                << setw(8) << block
+                << setw(9) << threadCounts[t]
+                << setw(12) << fixed << setprecision(3) << ms
+                << setw(12) << setprecision(1) << (pcm.size() / 1048576.0) / (ms / 1000.0)
+                << setw(12) << bytes
+                << setw(8) << setprecision(3) << (double)bytes / pcm.size()
+                << "  " << exact << endl;
+        }
+    }
+    return allExact ? 0 : 1;
+}
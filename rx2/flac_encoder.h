@@ -0,0 +1,103 @@
+// flac_encoder.h
+//
+// Lossless FLAC output, for decodes written to a .flac path. Batch runs
+// to network storage are bound by disk I/O; FLAC roughly halves the bytes
+// of a typical loop and Renoise loads it natively.
+//
+// The encoder takes the same interleaved little-endian 16 or 24-bit PCM
+// the WAV writer produces, so a FLAC decode holds exactly the samples the
+// WAV would. Audio is cut into fixed-size blocks and each block is
+// encoded on its own, on up to threads worker threads; the bytes do not
+// depend on the thread count. Per channel a block becomes a constant,
+// verbatim, fixed (order 0-4) or, from level 3 on, quantized LPC
+// subframe, whichever is smallest, with a partitioned Rice residual.
+// Stereo blocks pick the cheapest of left/right, left/side, side/right
+// and mid/side: level 1 estimates it, level 2 on encodes all four
+// channels and compares.
+//
+// Levels follow the reference encoder's roughly:
+//
+//   level  block  LPC order  Rice partition order
+//   0-2    1152   -          3  (0: no stereo decorrelation)
+//   3      4096   6          4
+//   4      4096   8          4
+//   5      4096   8          5  (default)
+//   6      4096   8          6
+//   7      4096   12         6
+//   8      4096   12         6  (every LPC order tried)
+//
+// The stream starts with a STREAMINFO block that finish() completes with
+// the total length, frame sizes and the MD5 of the samples.
+
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+const int DEFAULT_FLAC_LEVEL = 5;
+const int MAX_FLAC_LEVEL = 8;
+
+// Bytes of the stream header: "fLaC" and the STREAMINFO block
+const int FLAC_HEADER_BYTES = 42;
+
+// True when path names a FLAC output (.flac)
+bool is_flac_path(const std::string& path);
+
+class FlacEncoder {
+public:
+    FlacEncoder(int channelCount, int sampleRate, int bitsPerSample, int level, int threads);
+    ~FlacEncoder();
+
+    // Samples per block at this level; encode() buffers anything short of a block
+    int blockFrames() const { return blockSize; }
+
+    // The stream header for what has been encoded so far. Written first,
+    // then again in place once finish() has run.
+    std::string header() const;
+
+    // Append the blocks that frames more frames of interleaved PCM complete to out
+    void encode(const unsigned char* pcm, int frames, std::vector<unsigned char>& out);
+
+    // Encode the last, short block and complete the STREAMINFO
+    void finish(std::vector<unsigned char>& out);
+
+    long long frames() const { return totalFrames; }
+    long long bytes() const { return totalBytes; }
+    double encodeSeconds() const { return encodeTime; }
+    int threadCount() const { return threads; }
+    int compressionLevel() const { return level; }
+
+private:
+    FlacEncoder(const FlacEncoder&);
+    FlacEncoder& operator=(const FlacEncoder&);
+
+    void encodeBlocks(const int32_t* samples, int blockCount, int lastFrames, std::vector<unsigned char>& out);
+
+    int channels;
+    int rate;
+    int bits;
+    int level;
+    int threads;
+    int blockSize;
+    std::vector<int32_t> pending;       // Interleaved samples of the unfinished block
+    int pendingFrames = 0;
+    long long nextBlock = 0;            // Frame number of the next block
+    long long totalFrames = 0;
+    long long totalBytes = FLAC_HEADER_BYTES;
+    unsigned int minFrameBytes = 0;
+    unsigned int maxFrameBytes = 0;
+    double encodeTime = 0;
+    struct Md5;
+    Md5* md5;
+    unsigned char digest[16];
+    bool finished = false;
+};
+
+// Encode a synthetic stereo loop at every level with 1 and threads
+// threads; report size, ratio and speed and check the bytes match
+int run_flac_benchmark(int frames, int threads, int repeats, std::ostream& out);
+
+#endif
@@ -0,0 +1,470 @@
+// library_index.cpp
+//
+// The RX2 library index behind library_index.h.
+
+#include "library_index.h"
+#include "decode_cache.h"
+#include "platform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+// REX positions are in 15360ths of a quarter note
+const int PPQ_PER_QUARTER = 15360;
+
+// ---------------------------------------------------------------------
+// Serialization
+// ---------------------------------------------------------------------
+void append_u32(string& out, unsigned int v) {
+    out += (char)(v & 0xFF);
+    out += (char)((v >> 8) & 0xFF);
+    out += (char)((v >> 16) & 0xFF);
+    out += (char)((v >> 24) & 0xFF);
+}
+
+void append_i64(string& out, long long v) {
+    append_u32(out, (unsigned int)((unsigned long long)v & 0xFFFFFFFFULL));
+    append_u32(out, (unsigned int)((unsigned long long)v >> 32));
+}
+
+void append_string(string& out, const string& s) {
+    append_u32(out, (unsigned int)s.size());
+    out += s;
+}
+
+// Bounds-checked reads from a loaded index; any overrun fails the read
+class Reader {
+public:
+    explicit Reader(const string& bytes) : data(bytes), pos(0), ok(true) {}
+
+    unsigned int u32() {
+        if (!need(4)) return 0;
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + pos;
+        pos += 4;
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+    }
+    int i32() { return (int)u32(); }
+    long long i64() {
+        unsigned long long low = u32();
+        unsigned long long high = u32();
+        return (long long)(low | (high << 32));
+    }
+    unsigned char u8() {
+        if (!need(1)) return 0;
+        return (unsigned char)data[pos++];
+    }
+    string bytes(size_t count) {
+        if (!need(count)) return string();
+        string out = data.substr(pos, count);
+        pos += count;
+        return out;
+    }
+    string str() { return bytes(u32()); }
+
+    bool good() const { return ok; }
+
+private:
+    bool need(size_t count) {
+        if (!ok || data.size() - pos < count) {
+            ok = false;
+            return false;
+        }
+        return true;
+    }
+
+    const string& data;
+    size_t pos;
+    bool ok;
+};
+
+string to_lower(string text) {
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] >= 'A' && text[i] <= 'Z') text[i] = (char)(text[i] - 'A' + 'a');
+    }
+    return text;
+}
+
+// Index paths use '/' whatever the platform lists them with
+string index_path(string relative) {
+    replace(relative.begin(), relative.end(), '\\', '/');
+    return relative;
+}
+
+string full_path(const string& root, const string& relative) {
+    string path = root + PATH_SEPARATOR + relative;
+    replace(path.begin(), path.end(), '/', PATH_SEPARATOR);
+    return path;
+}
+
+// Read one file's header (and creator) into entry, whose path, size and
+// modified fields are already set. A previous entry with the same content
+// is reused as it is.
+void index_file(const string& root, IndexEntry& entry, const IndexEntry* previous, bool withCreator) {
+    InputFile input;
+    if (!input.open(full_path(root, entry.path)) || input.size() > INT32_MAX) {
+        entry.status = kRexError_FileCorrupt;
+        return;
+    }
+    entry.hash = decode_cache_key(input.data(), input.size(), string()).hex;
+    if (previous != nullptr && previous->hash == entry.hash && (previous->creatorRead || !withCreator)) {
+        long long size = entry.size;
+        long long modified = entry.modified;
+        entry = *previous;
+        entry.size = size;
+        entry.modified = modified;
+        return;
+    }
+
+    RexInfo info;
+    entry.status = rex_backend().getInfoFromBuffer(input.data(), (int)input.size(), &info);
+    if (entry.status != kRexError_NoError) {
+        return;
+    }
+    entry.channels = info.fChannels;
+    entry.sampleRate = info.fSampleRate;
+    entry.sliceCount = info.fSliceCount;
+    entry.tempo = info.fTempo;
+    entry.originalTempo = info.fOriginalTempo;
+    entry.ppqLength = info.fPPQLength;
+    entry.timeSignNom = info.fTimeSignNom;
+    entry.timeSignDenom = info.fTimeSignDenom;
+    entry.bitDepth = info.fBitDepth;
+
+    // Creator info only comes from a handle; the file is parsed, not rendered
+    if (withCreator) {
+        entry.creatorRead = true;
+        RexHandle handle = nullptr;
+        if (rex_backend().create(&handle, input.data(), (int)input.size()) == kRexError_NoError && handle) {
+            RexCreatorInfo creator;
+            if (rex_backend().getCreatorInfo(handle, &creator) == kRexError_NoError) {
+                entry.hasCreator = true;
+                entry.creator.name = creator.fName;
+                entry.creator.copyright = creator.fCopyright;
+                entry.creator.url = creator.fURL;
+                entry.creator.email = creator.fEmail;
+                entry.creator.freeText = creator.fFreeText;
+            }
+        }
+        if (handle) {
+            rex_backend().destroy(&handle);
+        }
+    }
+}
+
+bool parse_range(const string& text, double& low, double& high) {
+    size_t dash = text.find('-', 1);
+    char* end = nullptr;
+    low = strtod(text.c_str(), &end);
+    if (dash == string::npos) {
+        high = low;
+        return *end == '\0' && low > 0;
+    }
+    if (end != text.c_str() + dash) {
+        return false;
+    }
+    high = strtod(text.c_str() + dash + 1, &end);
+    return *end == '\0' && low > 0 && high >= low;
+}
+
+bool in_range(double value, double low, double high) {
+    // Small tolerance so 2 bars matches a loop that is 2 bars to the tick
+    const double epsilon = 1e-6;
+    return (low <= 0 || value >= low - epsilon) && (high <= 0 || value <= high + epsilon);
+}
+
+bool matches(const IndexEntry& entry, const IndexQuery& query) {
+    if (entry.status != kRexError_NoError) {
+        return false;
+    }
+    if (!in_range(entry.tempo / 1000.0, query.minTempo, query.maxTempo) ||
+        !in_range(index_entry_bars(entry), query.minBars, query.maxBars) ||
+        !in_range(entry.sliceCount, query.minSlices, query.maxSlices)) {
+        return false;
+    }
+    if (query.timeSignNom > 0 &&
+        (entry.timeSignNom != query.timeSignNom || entry.timeSignDenom != query.timeSignDenom)) {
+        return false;
+    }
+    if (query.channels > 0 && entry.channels != query.channels) {
+        return false;
+    }
+    if (!query.text.empty()) {
+        const SidecarCreator& c = entry.creator;
+        string haystack = to_lower(entry.path + '\n' + c.name + '\n' + c.copyright + '\n' + c.url + '\n' +
+                                   c.email + '\n' + c.freeText);
+        if (haystack.find(query.text) == string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+bool read_library_index(const string& path, LibraryIndex& index) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) {
+        return false;
+    }
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    Reader reader(bytes);
+    if (reader.bytes(4) != "PKIX" || reader.u32() != LIBRARY_INDEX_VERSION) {
+        return false;
+    }
+    unsigned int count = reader.u32();
+    index.root = reader.str();
+    index.entries.clear();
+    // Every entry takes at least 80 bytes; a bad count cannot force a huge allocation
+    index.entries.reserve(min<size_t>(count, bytes.size() / 80));
+    for (unsigned int i = 0; i < count && reader.good(); i++) {
+        IndexEntry entry;
+        entry.path = reader.str();
+        entry.size = reader.i64();
+        entry.modified = reader.i64();
+        entry.hash = reader.bytes(32);
+        entry.status = (RexError)reader.i32();
+        entry.channels = reader.i32();
+        entry.sampleRate = reader.i32();
+        entry.sliceCount = reader.i32();
+        entry.tempo = reader.i32();
+        entry.originalTempo = reader.i32();
+        entry.ppqLength = reader.i32();
+        entry.timeSignNom = reader.i32();
+        entry.timeSignDenom = reader.i32();
+        entry.bitDepth = reader.i32();
+        unsigned char flags = reader.u8();
+        entry.hasCreator = (flags & 1) != 0;
+        entry.creatorRead = (flags & 2) != 0;
+        entry.creator.name = reader.str();
+        entry.creator.copyright = reader.str();
+        entry.creator.url = reader.str();
+        entry.creator.email = reader.str();
+        entry.creator.freeText = reader.str();
+        index.entries.push_back(entry);
+    }
+    return reader.good();
+}
+
+bool write_library_index(const string& path, const LibraryIndex& index) {
+    string out = "PKIX";
+    append_u32(out, LIBRARY_INDEX_VERSION);
+    append_u32(out, (unsigned int)index.entries.size());
+    append_string(out, index.root);
+    for (size_t i = 0; i < index.entries.size(); i++) {
+        const IndexEntry& e = index.entries[i];
+        append_string(out, e.path);
+        append_i64(out, e.size);
+        append_i64(out, e.modified);
+        string hash = e.hash;
+        hash.resize(32, '0');
+        out += hash;
+        append_u32(out, (unsigned int)e.status);
+        append_u32(out, (unsigned int)e.channels);
+        append_u32(out, (unsigned int)e.sampleRate);
+        append_u32(out, (unsigned int)e.sliceCount);
+        append_u32(out, (unsigned int)e.tempo);
+        append_u32(out, (unsigned int)e.originalTempo);
+        append_u32(out, (unsigned int)e.ppqLength);
+        append_u32(out, (unsigned int)e.timeSignNom);
+        append_u32(out, (unsigned int)e.timeSignDenom);
+        append_u32(out, (unsigned int)e.bitDepth);
+        out += (char)((e.hasCreator ? 1 : 0) | (e.creatorRead ? 2 : 0));
+        append_string(out, e.creator.name);
+        append_string(out, e.creator.copyright);
+        append_string(out, e.creator.url);
+        append_string(out, e.creator.email);
+        append_string(out, e.creator.freeText);
+    }
+
+    string temp = unique_temp_path(path);
+    ofstream file(temp.c_str(), ios::binary);
+    if (!file) {
+        return false;
+    }
+    file.write(out.data(), out.size());
+    file.close();
+    if (file.fail() || !replace_file(temp, path)) {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+int update_library_index(const string& indexPath, const string& libraryDir, int workerCount, bool withCreator,
+                         ostream& results, ostream& log) {
+    if (!path_is_directory(libraryDir)) {
+        cerr << "Not a folder: " << libraryDir << endl;
+        return 1;
+    }
+    LibraryIndex previous;
+    bool havePrevious = path_exists(indexPath) && read_library_index(indexPath, previous);
+    if (path_exists(indexPath) && !havePrevious) {
+        log << "Unreadable index " << indexPath << ", rebuilding it\n";
+    }
+    if (havePrevious && previous.root != libraryDir) {
+        log << "Index was built for " << previous.root << ", rebuilding it for " << libraryDir << '\n';
+        previous.entries.clear();
+    }
+    map<string, const IndexEntry*> known;
+    for (size_t i = 0; i < previous.entries.size(); i++) {
+        known[previous.entries[i].path] = &previous.entries[i];
+    }
+
+    // Files whose size and modification time still match keep their entry
+    vector<string> files;
+    list_rx2_files(libraryDir, "", files);
+    LibraryIndex index;
+    index.root = libraryDir;
+    index.entries.resize(files.size());
+    vector<size_t> changed;
+    size_t kept = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        IndexEntry& entry = index.entries[i];
+        entry.path = index_path(files[i]);
+        string path = full_path(libraryDir, entry.path);
+        entry.size = file_size(path);
+        entry.modified = file_modified(path);
+        map<string, const IndexEntry*>::const_iterator old = known.find(entry.path);
+        if (old != known.end() && old->second->size == entry.size && old->second->modified == entry.modified &&
+            (old->second->creatorRead || !withCreator || old->second->status != kRexError_NoError)) {
+            entry = *old->second;
+            kept++;
+        } else {
+            changed.push_back(i);
+        }
+    }
+    set<string> present;
+    for (size_t i = 0; i < index.entries.size(); i++) {
+        present.insert(index.entries[i].path);
+    }
+    size_t removed = 0;
+    for (size_t i = 0; i < previous.entries.size(); i++) {
+        if (present.count(previous.entries[i].path) == 0) removed++;
+    }
+    // Every worker calls into the backend, so one that is not thread-safe gets a single worker
+    if (workerCount > 1 && !rex_backend().threadSafe()) {
+        log << "The " << rex_backend().name() << " backend is not thread-safe; indexing on one thread\n";
+        workerCount = 1;
+    }
+    log << "Indexing " << changed.size() << " of " << files.size() << " files with "
+        << workerCount << " worker threads\n";
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    atomic<size_t> next(0);
+    atomic<int> failed(0);
+    mutex logLock;
+    vector<thread> workers;
+    workerCount = (int)min<size_t>(max(1, workerCount), max<size_t>(1, changed.size()));
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&]() {
+            size_t n;
+            while ((n = next++) < changed.size()) {
+                IndexEntry& entry = index.entries[changed[n]];
+                map<string, const IndexEntry*>::const_iterator old = known.find(entry.path);
+                index_file(libraryDir, entry, old != known.end() ? old->second : nullptr, withCreator);
+                if (entry.status != kRexError_NoError) {
+                    failed++;
+                    lock_guard<mutex> guard(logLock);
+                    cerr << "Failed to index " << entry.path << ": " << entry.status << endl;
+                }
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    log << "Read " << changed.size() << " files in " << fixed << setprecision(1) << elapsedMs << " ms\n";
+
+    if (!write_library_index(indexPath, index)) {
+        cerr << "Failed to write index: " << indexPath << endl;
+        return 1;
+    }
+    results << "INDEXED\t" << index.entries.size() << "\t" << changed.size() << "\t" << kept << "\t"
+            << removed << "\t" << failed << endl;
+    return 0;
+}
+
+double index_entry_bars(const IndexEntry& entry) {
+    if (entry.timeSignNom <= 0 || entry.timeSignDenom <= 0) {
+        return 0;
+    }
+    double quartersPerBar = 4.0 * entry.timeSignNom / entry.timeSignDenom;
+    return entry.ppqLength / (PPQ_PER_QUARTER * quartersPerBar);
+}
+
+bool parse_index_query_option(int argc, char** argv, int& i, IndexQuery& query) {
+    if (i + 1 >= argc) {
+        return false;
+    }
+    string option = argv[i];
+    string value = argv[i + 1];
+    bool ok;
+    if (option == "--tempo") {
+        ok = parse_range(value, query.minTempo, query.maxTempo);
+    } else if (option == "--bars") {
+        ok = parse_range(value, query.minBars, query.maxBars);
+    } else if (option == "--slices") {
+        double low, high;
+        ok = parse_range(value, low, high);
+        query.minSlices = (int)low;
+        query.maxSlices = (int)high;
+    } else if (option == "--sig") {
+        ok = sscanf(value.c_str(), "%d/%d", &query.timeSignNom, &query.timeSignDenom) == 2 &&
+             query.timeSignNom > 0 && query.timeSignDenom > 0;
+    } else if (option == "--channels") {
+        query.channels = atoi(value.c_str());
+        ok = query.channels == 1 || query.channels == 2;
+    } else if (option == "--text") {
+        query.text = to_lower(value);
+        ok = true;
+    } else {
+        return false;
+    }
+    if (!ok) {
+        cerr << "Invalid " << option << " value " << value << endl;
+        return false;
+    }
+    i++;
+    return true;
+}
+
+int run_index_query(const string& indexPath, const IndexQuery& query, ostream& results, ostream& log) {
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    LibraryIndex index;
+    if (!read_library_index(indexPath, index)) {
+        cerr << "Failed to read index: " << indexPath << endl;
+        return 1;
+    }
+    size_t found = 0;
+    ostringstream lines;
+    for (size_t i = 0; i < index.entries.size(); i++) {
+        const IndexEntry& e = index.entries[i];
+        if (!matches(e, query)) continue;
+        lines << full_path(index.root, e.path) << '\t' << e.tempo / 1000.0 << '\t' << index_entry_bars(e) << '\t'
+              << e.timeSignNom << '/' << e.timeSignDenom << '\t' << e.sliceCount << '\t' << e.channels << '\t'
+              << e.hash << '\t' << e.creator.name << '\n';
+        found++;
+    }
+    results << lines.str() << flush;
+    double elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    log << found << " of " << index.entries.size() << " loops match (" << fixed << setprecision(1)
+        << elapsedMs << " ms)\n";
+    return 0;
+}
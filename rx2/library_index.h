@@ -0,0 +1,107 @@
+// library_index.h
+//
+// Header index of an RX2 library, for finding loops by tempo, length, time
+// signature or slice count without importing them one by one.
+//
+// --index reads every .rx2 below a folder on N worker threads with
+// REXGetInfoFromBuffer. Nothing is ever rendered. The creator fields need
+// a REXCreate, which decodes the audio and is far slower than the header,
+// so they are only filled in with --creator. A rescan only reads
+// files whose size or modification time changed since the last one, and
+// drops entries for files that are gone. --query loads the index and
+// filters it; no SDK is needed.
+//
+// Index file, all integers little-endian:
+//
+//   "PKIX"  u32 version  u32 count  u32 length + root folder
+//   then count entries:
+//     u32 length + path below the root, '/' separated
+//     i64 size, i64 modified (seconds since the epoch)
+//     32 hex digits of the file's content hash (the decode cache's hash)
+//     i32 status (a RexError, 1 = indexed), channels, sampleRate,
+//         sliceCount, tempo, originalTempo, ppqLength, timeSignNom,
+//         timeSignDenom, bitDepth
+//     u8 flags (1 = has creator info, 2 = creator info was looked up),
+//        then 5 strings (u32 length + bytes): name, copyright, url,
+//        email, free text
+//
+// Files that fail to parse keep an entry with their error status, so a
+// rescan does not retry them until they change. The index is written to a
+// temporary name and renamed into place.
+
+#ifndef LIBRARY_INDEX_H
+#define LIBRARY_INDEX_H
+
+#include "rex_backend.h"
+#include "sidecar.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+const unsigned int LIBRARY_INDEX_VERSION = 1;
+
+struct IndexEntry {
+    std::string path;           // Below the index root, '/' separated
+    long long size = 0;
+    long long modified = 0;
+    std::string hash;
+    RexError status = kRexError_NoError;
+    int channels = 0;
+    int sampleRate = 0;
+    int sliceCount = 0;
+    int tempo = 0;              // BPM * 1000
+    int originalTempo = 0;
+    int ppqLength = 0;
+    int timeSignNom = 0;
+    int timeSignDenom = 0;
+    int bitDepth = 0;
+    bool creatorRead = false;   // Looked up with --creator
+    bool hasCreator = false;
+    SidecarCreator creator;
+};
+
+struct LibraryIndex {
+    std::string root;
+    std::vector<IndexEntry> entries;    // Sorted by path
+};
+
+bool read_library_index(const std::string& path, LibraryIndex& index);
+bool write_library_index(const std::string& path, const LibraryIndex& index);
+
+// Bring the index at indexPath up to date with libraryDir, creating it if
+// needed, using the initialized backend, on workerCount threads when the
+// backend is thread-safe and on one otherwise. Prints one summary line to
+// results: INDEXED <TAB> entries <TAB> read <TAB> unchanged <TAB> removed
+// <TAB> failed. Returns the process exit code.
+int update_library_index(const std::string& indexPath, const std::string& libraryDir, int workerCount,
+                         bool withCreator, std::ostream& results, std::ostream& log);
+
+// Length of a loop in bars, from its PPQ length and time signature
+double index_entry_bars(const IndexEntry& entry);
+
+// Filters for --query; every one that is set must match
+struct IndexQuery {
+    double minTempo = 0;        // BPM, 0 for no limit
+    double maxTempo = 0;
+    double minBars = 0;
+    double maxBars = 0;
+    int timeSignNom = 0;        // 0 for any time signature
+    int timeSignDenom = 0;
+    int minSlices = 0;
+    int maxSlices = 0;
+    int channels = 0;
+    std::string text;           // Case-insensitive, in the path or creator fields
+};
+
+// Parse the query option at argv[i], advancing i past its value. Returns
+// false for an unknown or malformed option.
+bool parse_index_query_option(int argc, char** argv, int& i, IndexQuery& query);
+
+// Print every indexed loop matching query to results, one per line:
+// path <TAB> BPM <TAB> bars <TAB> nom/denom <TAB> slices <TAB> channels
+// <TAB> hash <TAB> creator name. Returns the process exit code.
+int run_index_query(const std::string& indexPath, const IndexQuery& query, std::ostream& results,
+                    std::ostream& log);
+
+#endif
@@ -0,0 +1,425 @@
+// pcm_convert.cpp
+//
+// Scalar, SSE2 and AVX2 kernels converting planar float audio into
+// interleaved 16-bit, 24-bit or 32-bit float PCM. See pcm_convert.h.
+
+#include "pcm_convert.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+  #define PCM_CONVERT_X86 1
+  #include <immintrin.h>
+#else
+  #define PCM_CONVERT_X86 0
+#endif
+
+// The AVX2 kernel is compiled with a per-function target attribute so the
+// rest of the program still runs on CPUs without AVX2
+#if PCM_CONVERT_X86 && (defined(__GNUC__) || defined(__clang__))
+  #define PCM_CONVERT_AVX2 1
+  #define PCM_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define PCM_CONVERT_AVX2 0
+#endif
+
+using namespace std;
+
+DitherState::DitherState(uint32_t seed) {
+    for (int i = 0; i < 8; i++) {
+        seed = seed * 1664525u + 1013904223u;
+        lanes[i] = seed | 1u; // xorshift must never start at zero
+    }
+}
+
+int pcm_bytes_per_sample(PcmFormat format) {
+    switch (format) {
+        case kPcm16: return 2;
+        case kPcm24: return 3;
+        default: return 4;
+    }
+}
+
+// ---------------------------------------------------------------------
+// Scalar kernel, also used for the tail of every SIMD kernel
+// ---------------------------------------------------------------------
+static inline uint32_t xorshift32(uint32_t& x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Uniform float in [0, 1) from the top 23 bits
+static inline float unit_float(uint32_t r) {
+    uint32_t bits = (r >> 9) | 0x3F800000u;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f - 1.0f;
+}
+
+// Triangular noise in (-1, 1) LSB
+static inline float tpdf_noise(uint32_t& state) {
+    float a = unit_float(xorshift32(state));
+    float b = unit_float(xorshift32(state));
+    return a - b;
+}
+
+// Scale, dither, clip and round one sample. The clip is written so that a
+// NaN ends up at the lower bound, exactly like _mm_max_ps(v, lo).
+static inline int32_t quantize(float x, float scale, float lo, float hi, uint32_t* state) {
+    float v = x * scale;
+    if (state != nullptr) v += tpdf_noise(*state);
+    v = v > lo ? v : lo;
+    v = v < hi ? v : hi;
+    return (int32_t)lrintf(v);
+}
+
+static inline void store16(unsigned char* p, int32_t v) {
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+}
+
+static inline void store24(unsigned char* p, int32_t v) {
+    p[0] = (unsigned char)(v & 0xFF);
+    p[1] = (unsigned char)((v >> 8) & 0xFF);
+    p[2] = (unsigned char)((v >> 16) & 0xFF);
+}
+
+static void convert_scalar(const float* const channels[2], int channelCount, int frames,
+                           PcmFormat format, DitherState* dither, unsigned char* out) {
+    uint32_t* state = (dither != nullptr && format != kFloat32) ? &dither->lanes[0] : nullptr;
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < channelCount; c++) {
+            float x = channels[c][i];
+            if (format == kPcm16) {
+                store16(out, quantize(x, 32767.0f, -32768.0f, 32767.0f, state));
+                out += 2;
+            } else if (format == kPcm24) {
+                store24(out, quantize(x, 8388607.0f, -8388608.0f, 8388607.0f, state));
+                out += 3;
+            } else {
+                memcpy(out, &x, 4); // IEEE float, little-endian host
+                out += 4;
+            }
+        }
+    }
+}
+
+#if PCM_CONVERT_X86
+// ---------------------------------------------------------------------
+// SSE2 kernel: 4 samples per vector
+// ---------------------------------------------------------------------
+static inline __m128i sse2_xorshift(__m128i& x) {
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    return x;
+}
+
+static inline __m128 sse2_unit(__m128i r) {
+    __m128i bits = _mm_or_si128(_mm_srli_epi32(r, 9), _mm_set1_epi32(0x3F800000));
+    return _mm_sub_ps(_mm_castsi128_ps(bits), _mm_set1_ps(1.0f));
+}
+
+static inline __m128i sse2_quantize(const float* p, __m128 scale, __m128 lo, __m128 hi, __m128i* state) {
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(p), scale);
+    if (state != nullptr) {
+        __m128 a = sse2_unit(sse2_xorshift(*state));
+        __m128 b = sse2_unit(sse2_xorshift(*state));
+        v = _mm_add_ps(v, _mm_sub_ps(a, b));
+    }
+    v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+    return _mm_cvtps_epi32(v);
+}
+
+static void convert_sse2(const float* const channels[2], int channelCount, int frames,
+                         PcmFormat format, DitherState* dither, unsigned char* out) {
+    const float* left = channels[0];
+    const float* right = channelCount == 2 ? channels[1] : channels[0];
+    bool stereo = (channelCount == 2);
+    bool useDither = (dither != nullptr && format != kFloat32);
+    __m128i stateVector = useDither ? _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->lanes)) : _mm_setzero_si128();
+    __m128i* state = useDither ? &stateVector : nullptr;
+    int i = 0;
+
+    if (format == kPcm16) {
+        __m128 scale = _mm_set1_ps(32767.0f), lo = _mm_set1_ps(-32768.0f), hi = _mm_set1_ps(32767.0f);
+        if (stereo) {
+            for (; i + 8 <= frames; i += 8) {
+                __m128i l = _mm_packs_epi32(sse2_quantize(left + i, scale, lo, hi, state), sse2_quantize(left + i + 4, scale, lo, hi, state));
+                __m128i r = _mm_packs_epi32(sse2_quantize(right + i, scale, lo, hi, state), sse2_quantize(right + i + 4, scale, lo, hi, state));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), _mm_unpacklo_epi16(l, r));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4 + 16), _mm_unpackhi_epi16(l, r));
+            }
+        } else {
+            for (; i + 8 <= frames; i += 8) {
+                __m128i m = _mm_packs_epi32(sse2_quantize(left + i, scale, lo, hi, state), sse2_quantize(left + i + 4, scale, lo, hi, state));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), m);
+            }
+        }
+    } else if (format == kPcm24) {
+        __m128 scale = _mm_set1_ps(8388607.0f), lo = _mm_set1_ps(-8388608.0f), hi = _mm_set1_ps(8388607.0f);
+        int32_t tmp[8];
+        for (; i + 4 <= frames; i += 4) {
+            __m128i l = sse2_quantize(left + i, scale, lo, hi, state);
+            int count = 4;
+            if (stereo) {
+                __m128i r = sse2_quantize(right + i, scale, lo, hi, state);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(tmp), _mm_unpacklo_epi32(l, r));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(tmp + 4), _mm_unpackhi_epi32(l, r));
+                count = 8;
+            } else {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(tmp), l);
+            }
+            unsigned char* o = out + (size_t)i * channelCount * 3;
+            for (int k = 0; k < count; k++) store24(o + k * 3, tmp[k]);
+        }
+    } else {
+        if (stereo) {
+            for (; i + 4 <= frames; i += 4) {
+                __m128 l = _mm_loadu_ps(left + i);
+                __m128 r = _mm_loadu_ps(right + i);
+                _mm_storeu_ps(reinterpret_cast<float*>(out + i * 8), _mm_unpacklo_ps(l, r));
+                _mm_storeu_ps(reinterpret_cast<float*>(out + i * 8 + 16), _mm_unpackhi_ps(l, r));
+            }
+        } else {
+            memcpy(out, left, (size_t)frames * 4);
+            i = frames;
+        }
+    }
+
+    if (useDither) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->lanes), stateVector);
+    }
+    if (i < frames) {
+        const float* tail[2] = {left + i, right + i};
+        convert_scalar(tail, channelCount, frames - i, format, dither,
+                       out + (size_t)i * channelCount * pcm_bytes_per_sample(format));
+    }
+}
+#endif
+
+#if PCM_CONVERT_AVX2
+// ---------------------------------------------------------------------
+// AVX2 kernel: 8 samples per vector
+// ---------------------------------------------------------------------
+PCM_TARGET_AVX2 static inline __m256i avx2_xorshift(__m256i& x) {
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    return x;
+}
+
+PCM_TARGET_AVX2 static inline __m256 avx2_unit(__m256i r) {
+    __m256i bits = _mm256_or_si256(_mm256_srli_epi32(r, 9), _mm256_set1_epi32(0x3F800000));
+    return _mm256_sub_ps(_mm256_castsi256_ps(bits), _mm256_set1_ps(1.0f));
+}
+
+PCM_TARGET_AVX2 static inline __m256i avx2_quantize(const float* p, __m256 scale, __m256 lo, __m256 hi, __m256i* state) {
+    __m256 v = _mm256_mul_ps(_mm256_loadu_ps(p), scale);
+    if (state != nullptr) {
+        __m256 a = avx2_unit(avx2_xorshift(*state));
+        __m256 b = avx2_unit(avx2_xorshift(*state));
+        v = _mm256_add_ps(v, _mm256_sub_ps(a, b));
+    }
+    v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+    return _mm256_cvtps_epi32(v);
+}
+
+PCM_TARGET_AVX2 static void convert_avx2(const float* const channels[2], int channelCount, int frames,
+                                         PcmFormat format, DitherState* dither, unsigned char* out) {
+    const float* left = channels[0];
+    const float* right = channelCount == 2 ? channels[1] : channels[0];
+    bool stereo = (channelCount == 2);
+    bool useDither = (dither != nullptr && format != kFloat32);
+    __m256i stateVector = useDither ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dither->lanes)) : _mm256_setzero_si256();
+    __m256i* state = useDither ? &stateVector : nullptr;
+    int i = 0;
+
+    if (format == kPcm16) {
+        __m256 scale = _mm256_set1_ps(32767.0f), lo = _mm256_set1_ps(-32768.0f), hi = _mm256_set1_ps(32767.0f);
+        if (stereo) {
+            // packs leaves l0-3 r0-3 | l4-7 r4-7 per lane; interleave within each lane
+            const __m256i interleave = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+                                                        0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+            for (; i + 8 <= frames; i += 8) {
+                __m256i packed = _mm256_packs_epi32(avx2_quantize(left + i, scale, lo, hi, state),
+                                                    avx2_quantize(right + i, scale, lo, hi, state));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), _mm256_shuffle_epi8(packed, interleave));
+            }
+        } else {
+            for (; i + 16 <= frames; i += 16) {
+                __m256i packed = _mm256_packs_epi32(avx2_quantize(left + i, scale, lo, hi, state),
+                                                    avx2_quantize(left + i + 8, scale, lo, hi, state));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 2), _mm256_permute4x64_epi64(packed, 0xD8));
+            }
+        }
+    } else if (format == kPcm24) {
+        __m256 scale = _mm256_set1_ps(8388607.0f), lo = _mm256_set1_ps(-8388608.0f), hi = _mm256_set1_ps(8388607.0f);
+        int32_t tmp[16];
+        for (; i + 8 <= frames; i += 8) {
+            __m256i l = avx2_quantize(left + i, scale, lo, hi, state);
+            int count = 8;
+            if (stereo) {
+                __m256i r = avx2_quantize(right + i, scale, lo, hi, state);
+                __m256i a = _mm256_unpacklo_epi32(l, r);
+                __m256i b = _mm256_unpackhi_epi32(l, r);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(tmp), _mm256_permute2x128_si256(a, b, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(tmp + 8), _mm256_permute2x128_si256(a, b, 0x31));
+                count = 16;
+            } else {
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(tmp), l);
+            }
+            unsigned char* o = out + (size_t)i * channelCount * 3;
+            for (int k = 0; k < count; k++) store24(o + k * 3, tmp[k]);
+        }
+    } else {
+        if (stereo) {
+            for (; i + 8 <= frames; i += 8) {
+                __m256 l = _mm256_loadu_ps(left + i);
+                __m256 r = _mm256_loadu_ps(right + i);
+                __m256 a = _mm256_unpacklo_ps(l, r);
+                __m256 b = _mm256_unpackhi_ps(l, r);
+                _mm256_storeu_ps(reinterpret_cast<float*>(out + i * 8), _mm256_permute2f128_ps(a, b, 0x20));
+                _mm256_storeu_ps(reinterpret_cast<float*>(out + i * 8 + 32), _mm256_permute2f128_ps(a, b, 0x31));
+            }
+        } else {
+            memcpy(out, left, (size_t)frames * 4);
+            i = frames;
+        }
+    }
+
+    if (useDither) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dither->lanes), stateVector);
+    }
+    if (i < frames) {
+        const float* tail[2] = {left + i, right + i};
+        convert_scalar(tail, channelCount, frames - i, format, dither,
+                       out + (size_t)i * channelCount * pcm_bytes_per_sample(format));
+    }
+}
+#endif
+
+// ---------------------------------------------------------------------
+// Kernel selection
+// ---------------------------------------------------------------------
+bool convert_kernel_supported(ConvertKernel kernel) {
+    switch (kernel) {
+        case kKernelScalar:
+            return true;
+#if PCM_CONVERT_X86
+        case kKernelSSE2:
+  #if defined(__x86_64__) || defined(_M_X64)
+            return true;
+  #else
+            return __builtin_cpu_supports("sse2");
+  #endif
+#endif
+#if PCM_CONVERT_AVX2
+        case kKernelAVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* convert_kernel_name(ConvertKernel kernel) {
+    switch (kernel) {
+        case kKernelSSE2: return "sse2";
+        case kKernelAVX2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+ConvertKernel active_convert_kernel() {
+    static const ConvertKernel kernel = convert_kernel_supported(kKernelAVX2) ? kKernelAVX2
+                                      : convert_kernel_supported(kKernelSSE2) ? kKernelSSE2
+                                      : kKernelScalar;
+    return kernel;
+}
+
+void convert_planar_to_pcm_with(ConvertKernel kernel, const float* const channels[2], int channelCount, int frames,
+                                PcmFormat format, DitherState* dither, unsigned char* out) {
+    switch (kernel) {
+#if PCM_CONVERT_AVX2
+        case kKernelAVX2:
+            convert_avx2(channels, channelCount, frames, format, dither, out);
+            return;
+#endif
+#if PCM_CONVERT_X86
+        case kKernelSSE2:
+            convert_sse2(channels, channelCount, frames, format, dither, out);
+            return;
+#endif
+        default:
+            convert_scalar(channels, channelCount, frames, format, dither, out);
+            return;
+    }
+}
+
+void convert_planar_to_pcm(const float* const channels[2], int channelCount, int frames,
+                           PcmFormat format, DitherState* dither, unsigned char* out) {
+    convert_planar_to_pcm_with(active_convert_kernel(), channels, channelCount, frames, format, dither, out);
+}
+
+// ---------------------------------------------------------------------
+// Microbenchmark
+// ---------------------------------------------------------------------
+int run_convert_benchmark(int frames, int repeats, ostream& out) {
+    // Deterministic test signal that also exercises clipping
+    vector<float> left(frames), right(frames);
+    uint32_t seed = 12345;
+    for (int i = 0; i < frames; i++) {
+        left[i] = (unit_float(xorshift32(seed)) - 0.5f) * 2.4f;
+        right[i] = (unit_float(xorshift32(seed)) - 0.5f) * 2.4f;
+    }
+    const float* channels[2] = {left.data(), right.data()};
+
+    const PcmFormat formats[3] = {kPcm16, kPcm24, kFloat32};
+    const ConvertKernel kernels[3] = {kKernelScalar, kKernelSSE2, kKernelAVX2};
+    vector<unsigned char> reference((size_t)frames * 2 * 4), output((size_t)frames * 2 * 4);
+    bool allExact = true;
+
+    out << "Conversion benchmark: " << frames << " stereo frames, " << repeats << " run(s) each" << endl;
+    out << "Active kernel: " << convert_kernel_name(active_convert_kernel()) << endl;
+    out << setw(8) << "format" << setw(8) << "dither" << setw(8) << "kernel" << setw(12) << "ms"
+        << setw(12) << "Mframes/s" << setw(10) << "speedup" << "  exact" << endl;
+    for (int f = 0; f < 3; f++) {
+        for (int d = 0; d < (formats[f] == kFloat32 ? 1 : 2); d++) {
+            double scalarMs = 0.0;
+            size_t bytes = (size_t)frames * 2 * pcm_bytes_per_sample(formats[f]);
+            for (int k = 0; k < 3; k++) {
+                if (!convert_kernel_supported(kernels[k])) continue;
+                DitherState dither;
+                unsigned char* target = (k == 0) ? reference.data() : output.data();
+                chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+                for (int r = 0; r < repeats; r++) {
+                    convert_planar_to_pcm_with(kernels[k], channels, 2, frames, formats[f], d ? &dither : nullptr, target);
+                }
+                double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / repeats;
+                if (k == 0) scalarMs = ms;
+                string exact = "-";
+                if (k > 0 && !d) {
+                    bool same = memcmp(reference.data(), output.data(), bytes) == 0;
+                    allExact = allExact && same;
+                    exact = same ? "yes" : "NO";
+                }
+                out << setw(8) << (formats[f] == kFloat32 ? "32f" : (formats[f] == kPcm24 ? "24" : "16"))
+                    << setw(8) << (d ? "tpdf" : "off")
+                    << setw(8) << convert_kernel_name(kernels[k])
+                    << setw(12) << fixed << setprecision(3) << ms
+                    << setw(12) << setprecision(1) << (frames / 1000.0) / ms
+                    << setw(9) << setprecision(2) << scalarMs / ms << "x"
+                    << "  " << exact << endl;
+            }
+        }
+    }
+    return allExact ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+// pcm_convert.h
+//
+// Planar float to interleaved little-endian PCM conversion for the WAV
+// output path. One call converts and interleaves a block of 1 or 2
+// channels into 16-bit, 24-bit or 32-bit float samples, optionally with
+// TPDF dither for the integer formats.
+//
+// The kernel (scalar, SSE2 or AVX2) is picked once at runtime from what
+// the CPU supports. All kernels produce identical output when dither is
+// off; with dither on each kernel draws its own noise sequence.
+
+#ifndef PCM_CONVERT_H
+#define PCM_CONVERT_H
+
+#include <cstdint>
+#include <iosfwd>
+
+enum PcmFormat {
+    kPcm16 = 16,
+    kPcm24 = 24,
+    kFloat32 = 32
+};
+
+enum ConvertKernel {
+    kKernelScalar,
+    kKernelSSE2,
+    kKernelAVX2
+};
+
+// Noise generator state for TPDF dither, one xorshift lane per SIMD lane
+struct DitherState {
+    uint32_t lanes[8];
+    explicit DitherState(uint32_t seed = 0x9E3779B9u);
+};
+
+int pcm_bytes_per_sample(PcmFormat format);
+
+// Best kernel this CPU can run
+ConvertKernel active_convert_kernel();
+bool convert_kernel_supported(ConvertKernel kernel);
+const char* convert_kernel_name(ConvertKernel kernel);
+
+// Convert frames of planar audio (channels[0], channels[1] for stereo) to
+// interleaved PCM at out, which must hold frames * channelCount *
+// pcm_bytes_per_sample(format) bytes. Integer formats are clipped to full
+// scale and rounded to nearest; dither is ignored for kFloat32.
+void convert_planar_to_pcm(const float* const channels[2], int channelCount, int frames,
+                           PcmFormat format, DitherState* dither, unsigned char* out);
+
+// Same, forcing a specific kernel (used by the benchmark)
+void convert_planar_to_pcm_with(ConvertKernel kernel, const float* const channels[2], int channelCount, int frames,
+                                PcmFormat format, DitherState* dither, unsigned char* out);
+
+// Time every supported kernel against the scalar one on a long stereo
+// buffer and check that undithered output is identical
+int run_convert_benchmark(int frames, int repeats, std::ostream& out);
+
+#endif
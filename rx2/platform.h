@@ -0,0 +1,136 @@
+// platform.h
+//
+// Operating system layer of the decoder. rex2decoder_posix.cpp implements it
+// for POSIX systems (macOS and Linux) and rex2decoder_win.cpp for Windows;
+// the shared decoder core in decoder_core.cpp reaches the OS only through
+// the functions declared here.
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+const char PATH_SEPARATOR = '\\';
+#else
+const char PATH_SEPARATOR = '/';
+#endif
+
+#if defined(_WIN32)
+// UTF-8 to UTF-16 for the wide Windows APIs
+std::wstring ConvertToWide(const char* str);
+#endif
+
+bool path_exists(const std::string& path);
+bool path_is_directory(const std::string& path);
+
+// Check the SDK bundle/folder and print what was found
+void print_bundle_debug(const std::string& bundle_path);
+
+// ---------------------------------------------------------------------
+// RX2 input: regular files are memory-mapped and the mapped pages are
+// handed straight to the backend. Pipes, stdin ("-") and anything else
+// that cannot be mapped are streamed into memory instead.
+// ---------------------------------------------------------------------
+class InputFile {
+public:
+    InputFile() {}
+    ~InputFile() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return mapped != nullptr ? mapped : streamed.data(); }
+    size_t size() const { return mapped != nullptr ? mappedSize : streamed.size(); }
+    bool isMapped() const { return mapped != nullptr; }
+
+private:
+    InputFile(const InputFile&);
+    InputFile& operator=(const InputFile&);
+
+    void* mapping = nullptr;    // Mapping object, where the OS has one
+    const char* mapped = nullptr;
+    size_t mappedSize = 0;
+    std::vector<char> streamed;
+};
+
+// Peak resident set size of this process in kilobytes
+long long peak_rss_kb();
+
+long long file_size(const std::string& path);
+
+// Modification time in seconds since the epoch, 0 if the file is missing
+long long file_modified(const std::string& path);
+
+// Recursively list .rx2 files below dir as paths relative to it
+void list_rx2_files(const std::string& dir, const std::string& relative, std::vector<std::string>& files);
+
+std::string self_executable_path(const char* argv0);
+
+// ---------------------------------------------------------------------
+// Cache directory helpers
+// ---------------------------------------------------------------------
+struct DirectoryEntry {
+    std::string name;
+    long long size = 0;
+    long long modified = 0;     // Seconds since the epoch
+};
+
+// Create dir if it does not exist yet (one level)
+bool make_directory(const std::string& path);
+
+// Regular files directly inside dir
+void list_directory(const std::string& dir, std::vector<DirectoryEntry>& entries);
+
+// Rename from over to in one step, replacing an existing file
+bool replace_file(const std::string& from, const std::string& to);
+
+// Set a file's modification time to now
+bool touch_file(const std::string& path);
+
+int current_process_id();
+
+// Switch stdout to binary so framed output is not newline-translated
+void set_stdout_binary();
+
+// A child decoder running --batch, driven through its stdin/stdout
+struct ChildProcess {
+    FILE* in = nullptr;
+    FILE* out = nullptr;
+    intptr_t process = 0;       // pid, or the process HANDLE on Windows
+};
+
+bool spawn_child(const std::vector<std::string>& args, ChildProcess& child);
+void finish_child(ChildProcess& child);
+
+// Shared helpers used on both sides of the layer
+inline void trim_line_end(std::string& line) {
+    while (!line.empty() && (line[line.size() - 1] == '\r' || line[line.size() - 1] == '\n')) {
+        line.erase(line.size() - 1);
+    }
+}
+
+// A sibling of finalPath no other writer will pick, for write-then-rename
+inline std::string unique_temp_path(const std::string& finalPath) {
+    static std::atomic<unsigned int> counter(0);
+    char suffix[48];
+    snprintf(suffix, sizeof(suffix), ".tmp.%d.%u", current_process_id(), counter++);
+    return finalPath + suffix;
+}
+
+inline bool has_rx2_extension(const std::string& name) {
+    if (name.size() < 4)
+        return false;
+    std::string ext = name.substr(name.size() - 4);
+    for (size_t i = 0; i < ext.size(); i++) {
+        char c = ext[i];
+        if (c >= 'A' && c <= 'Z') ext[i] = (char)(c - 'A' + 'a');
+    }
+    return ext == ".rx2";
+}
+
+#endif
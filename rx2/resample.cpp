@@ -0,0 +1,320 @@
+// resample.cpp
+//
+// Polyphase windowed-sinc resampler behind resample.h.
+
+#include "resample.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+  #define RESAMPLE_X86 1
+  #include <immintrin.h>
+#else
+  #define RESAMPLE_X86 0
+#endif
+
+#if RESAMPLE_X86 && (defined(__GNUC__) || defined(__clang__))
+  #define RESAMPLE_AVX2 1
+  #define RESAMPLE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+  #define RESAMPLE_AVX2 0
+#endif
+
+using namespace std;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+struct QualityPreset {
+    int halfTaps;               // Taps each side of the centre when upsampling
+    int phases;
+    double beta;                // Kaiser window shape
+    double rolloff;             // Cutoff as a fraction of the lower Nyquist rate
+};
+
+QualityPreset preset_for(ResampleQuality quality) {
+    switch (quality) {
+        case kResampleFast: { QualityPreset p = {8, 128, 6.0, 0.90}; return p; }
+        case kResampleBest: { QualityPreset p = {32, 1024, 10.0, 0.97}; return p; }
+        default: { QualityPreset p = {16, 512, 8.5, 0.94}; return p; }
+    }
+}
+
+long long gcd(long long a, long long b) {
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Zeroth-order modified Bessel function of the first kind
+double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-17) break;
+    }
+    return sum;
+}
+
+// ---------------------------------------------------------------------
+// Inner product of taps input samples with one interpolated filter phase,
+// coefficient c[k] + frac * d[k]. Eight running sums, reduced the same way
+// in every kernel, keep the output identical across kernels; taps is
+// always a multiple of 8.
+// ---------------------------------------------------------------------
+typedef float (*DotKernel)(const float* x, const float* c, const float* d, float frac, int taps);
+
+float dot_scalar(const float* x, const float* c, const float* d, float frac, int taps) {
+    float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    for (int k = 0; k < taps; k += 8) {
+        for (int j = 0; j < 8; j++) {
+            float coefficient = c[k + j] + frac * d[k + j];
+            acc[j] += x[k + j] * coefficient;
+        }
+    }
+    float b0 = acc[0] + acc[4], b1 = acc[1] + acc[5], b2 = acc[2] + acc[6], b3 = acc[3] + acc[7];
+    return (b0 + b2) + (b1 + b3);
+}
+
+#if RESAMPLE_X86
+inline float reduce_sse2(__m128 b) {
+    __m128 t = _mm_add_ps(b, _mm_movehl_ps(b, b));
+    return _mm_cvtss_f32(_mm_add_ss(t, _mm_shuffle_ps(t, t, 1)));
+}
+
+float dot_sse2(const float* x, const float* c, const float* d, float frac, int taps) {
+    __m128 f = _mm_set1_ps(frac);
+    __m128 lo = _mm_setzero_ps();
+    __m128 hi = _mm_setzero_ps();
+    for (int k = 0; k < taps; k += 8) {
+        __m128 c0 = _mm_add_ps(_mm_loadu_ps(c + k), _mm_mul_ps(f, _mm_loadu_ps(d + k)));
+        __m128 c1 = _mm_add_ps(_mm_loadu_ps(c + k + 4), _mm_mul_ps(f, _mm_loadu_ps(d + k + 4)));
+        lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(x + k), c0));
+        hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(x + k + 4), c1));
+    }
+    return reduce_sse2(_mm_add_ps(lo, hi));
+}
+#endif
+
+#if RESAMPLE_AVX2
+RESAMPLE_TARGET_AVX2 float dot_avx2(const float* x, const float* c, const float* d, float frac, int taps) {
+    __m256 f = _mm256_set1_ps(frac);
+    __m256 acc = _mm256_setzero_ps();
+    for (int k = 0; k < taps; k += 8) {
+        __m256 coefficient = _mm256_add_ps(_mm256_loadu_ps(c + k), _mm256_mul_ps(f, _mm256_loadu_ps(d + k)));
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(x + k), coefficient));
+    }
+    return reduce_sse2(_mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1)));
+}
+#endif
+
+DotKernel dot_kernel(ConvertKernel kernel) {
+    switch (kernel) {
+#if RESAMPLE_AVX2
+        case kKernelAVX2: return dot_avx2;
+#endif
+#if RESAMPLE_X86
+        case kKernelSSE2: return dot_sse2;
+#endif
+        default: return dot_scalar;
+    }
+}
+
+} // namespace
+
+bool parse_resample_quality(const string& text, ResampleQuality& quality) {
+    if (text == "fast") {
+        quality = kResampleFast;
+    } else if (text == "standard") {
+        quality = kResampleStandard;
+    } else if (text == "best") {
+        quality = kResampleBest;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* resample_quality_name(ResampleQuality quality) {
+    switch (quality) {
+        case kResampleFast: return "fast";
+        case kResampleBest: return "best";
+        default: return "standard";
+    }
+}
+
+long long resampled_frame(long long frame, int inputRate, int outputRate) {
+    return (frame * outputRate * 2 + inputRate) / (2LL * inputRate);
+}
+
+Resampler::Resampler(int channelCount, int inRate, int outRate, ResampleQuality quality, ConvertKernel dotKernel)
+    : channels(channelCount), inputRate(inRate), outputRate(outRate), kernel(dotKernel),
+      historyStart(0), inputFrames(0), outputFrames(0) {
+    long long divisor = gcd(inputRate, outputRate);
+    step = inputRate / divisor;
+    denominator = outputRate / divisor;
+
+    // Downsampling stretches the filter over more input samples
+    QualityPreset preset = preset_for(quality);
+    double stretch = max(1.0, (double)inputRate / outputRate);
+    halfTaps = ((int)ceil(preset.halfTaps * stretch) + 3) / 4 * 4;
+    tapCount = halfTaps * 2;
+    phases = preset.phases;
+    double cutoff = 0.5 * min(1.0, (double)outputRate / inputRate) * preset.rolloff;
+
+    // One extra row so the last phase has a neighbour to interpolate to
+    vector<double> row(tapCount);
+    vector<float> table((size_t)(phases + 1) * tapCount);
+    for (int p = 0; p <= phases; p++) {
+        double mu = (double)p / phases;
+        double sum = 0.0;
+        for (int k = 0; k < tapCount; k++) {
+            double t = k - halfTaps + 1 - mu;
+            double sinc = t == 0.0 ? 2.0 * cutoff : sin(2.0 * PI * cutoff * t) / (PI * t);
+            double u = t / halfTaps;
+            double window = fabs(u) >= 1.0 ? 0.0 : bessel_i0(preset.beta * sqrt(1.0 - u * u)) / bessel_i0(preset.beta);
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+        // Unity gain at DC for every phase
+        for (int k = 0; k < tapCount; k++) {
+            table[(size_t)p * tapCount + k] = (float)(row[k] / sum);
+        }
+    }
+    coefficients.assign(table.begin(), table.begin() + (size_t)phases * tapCount);
+    deltas.resize(coefficients.size());
+    for (size_t i = 0; i < deltas.size(); i++) {
+        deltas[i] = table[i + tapCount] - table[i];
+    }
+
+    // Silence before the first frame
+    historyStart = -(halfTaps - 1);
+    for (int c = 0; c < channels; c++) {
+        history[c].assign(halfTaps - 1, 0.0f);
+    }
+}
+
+void Resampler::produce(long long limit, vector<float> out[2]) {
+    DotKernel dot = dot_kernel(kernel);
+    long long historyEnd = historyStart + (long long)history[0].size();
+    while (outputFrames < limit) {
+        long long position = outputFrames * step;
+        long long first = position / denominator - halfTaps + 1;
+        if (first + tapCount > historyEnd) {
+            break;
+        }
+        double phase = (double)(position % denominator) * phases / denominator;
+        int p = (int)phase;
+        float frac = (float)(phase - p);
+        const float* c = coefficients.data() + (size_t)p * tapCount;
+        const float* d = deltas.data() + (size_t)p * tapCount;
+        for (int ch = 0; ch < channels; ch++) {
+            out[ch].push_back(dot(history[ch].data() + (first - historyStart), c, d, frac, tapCount));
+        }
+        outputFrames++;
+    }
+
+    // Drop the input no later output frame reaches back to
+    long long keep = (outputFrames * step) / denominator - halfTaps + 1;
+    if (keep > historyStart) {
+        size_t drop = (size_t)min<long long>(keep - historyStart, (long long)history[0].size());
+        for (int ch = 0; ch < channels; ch++) {
+            history[ch].erase(history[ch].begin(), history[ch].begin() + drop);
+        }
+        historyStart += (long long)drop;
+    }
+}
+
+void Resampler::process(const float* const input[2], int frames, vector<float> out[2]) {
+    for (int ch = 0; ch < channels; ch++) {
+        history[ch].insert(history[ch].end(), input[ch], input[ch] + frames);
+    }
+    inputFrames += frames;
+    produce(LLONG_MAX, out);
+}
+
+void Resampler::finish(vector<float> out[2]) {
+    // Silence after the last frame, enough for the final filter window
+    for (int ch = 0; ch < channels; ch++) {
+        history[ch].insert(history[ch].end(), halfTaps + 1, 0.0f);
+    }
+    produce(resampled_frame(inputFrames, inputRate, outputRate), out);
+}
+
+// ---------------------------------------------------------------------
+// Microbenchmark
+// ---------------------------------------------------------------------
+int run_resample_benchmark(int frames, int inputRate, int outputRate, int repeats, ostream& out) {
+    // A sweep with some noise on top, so every phase gets used
+    vector<float> left(frames), right(frames);
+    uint32_t seed = 12345;
+    for (int i = 0; i < frames; i++) {
+        double t = (double)i / inputRate;
+        seed = seed * 1664525u + 1013904223u;
+        float noise = ((seed >> 9) / 8388608.0f - 0.5f) * 0.05f;
+        left[i] = (float)(0.8 * sin(2.0 * PI * (50.0 + 2000.0 * t) * t)) + noise;
+        right[i] = (float)(0.8 * cos(2.0 * PI * (80.0 + 1500.0 * t) * t)) - noise;
+    }
+    const int blockFrames = 4096;
+    const ResampleQuality qualities[3] = {kResampleFast, kResampleStandard, kResampleBest};
+    const ConvertKernel kernels[3] = {kKernelScalar, kKernelSSE2, kKernelAVX2};
+    bool allExact = true;
+
+    out << "Resample benchmark: " << frames << " stereo frames, " << inputRate << " -> " << outputRate << " Hz, "
+        << repeats << " run(s) each" << endl;
+    out << "Active kernel: " << convert_kernel_name(active_convert_kernel()) << endl;
+    out << setw(10) << "quality" << setw(6) << "taps" << setw(8) << "kernel" << setw(12) << "ms"
+        << setw(12) << "Mframes/s" << setw(10) << "speedup" << "  exact" << endl;
+    for (int q = 0; q < 3; q++) {
+        vector<float> reference[2];
+        double scalarMs = 0.0;
+        for (int k = 0; k < 3; k++) {
+            if (!convert_kernel_supported(kernels[k])) continue;
+            vector<float> output[2];
+            int taps = 0;
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            for (int r = 0; r < repeats; r++) {
+                output[0].clear();
+                output[1].clear();
+                Resampler resampler(2, inputRate, outputRate, qualities[q], kernels[k]);
+                for (int i = 0; i < frames; i += blockFrames) {
+                    const float* block[2] = {left.data() + i, right.data() + i};
+                    resampler.process(block, min(blockFrames, frames - i), output);
+                }
+                resampler.finish(output);
+                taps = resampler.taps();
+            }
+            double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() / repeats;
+            string exact = "-";
+            if (k == 0) {
+                scalarMs = ms;
+                reference[0].swap(output[0]);
+                reference[1].swap(output[1]);
+            } else {
+                bool same = output[0] == reference[0] && output[1] == reference[1];
+                allExact = allExact && same;
+                exact = same ? "yes" : "NO";
+            }
+            out << setw(10) << resample_quality_name(qualities[q])
+                << setw(6) << taps
+                << setw(8) << convert_kernel_name(kernels[k])
+                << setw(12) << fixed << setprecision(3) << ms
+                << setw(12) << setprecision(1) << (frames / 1000.0) / ms
+                << setw(9) << setprecision(2) << scalarMs / ms << "x"
+                << "  " << exact << endl;
+        }
+    }
+    return allExact ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+// resample.h
+//
+// Sample rate conversion for decodes that target a fixed hardware rate
+// (Octatrack 44.1 kHz, Digitakt 48 kHz, ...), so the WAV comes out of the
+// decoder at that rate instead of being converted again in Lua or Renoise.
+//
+// The filter is a Kaiser-windowed sinc, tabulated as a polyphase bank and
+// interpolated linearly between neighbouring phases. Output frame n sits
+// at input position n * inputRate / outputRate, tracked as an exact
+// fraction, so timing never drifts however long the loop is. Downsampling
+// lowers the cutoff and widens the filter to match.
+//
+// The inner product runs on the same kernels as pcm_convert.h (scalar,
+// SSE2 or AVX2, picked at runtime). All of them accumulate in the same
+// order, so every kernel produces identical output.
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include "pcm_convert.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+enum ResampleQuality {
+    kResampleFast,              // 16 taps, 128 phases
+    kResampleStandard,          // 32 taps, 512 phases
+    kResampleBest               // 64 taps, 1024 phases
+};
+
+bool parse_resample_quality(const std::string& text, ResampleQuality& quality);
+const char* resample_quality_name(ResampleQuality quality);
+
+// Where input frame frame lands at the output rate, rounded to nearest.
+// Also the output length for frame input frames, so slice positions and
+// the audio are scaled by the same rule.
+long long resampled_frame(long long frame, int inputRate, int outputRate);
+
+class Resampler {
+public:
+    Resampler(int channels, int inputRate, int outputRate, ResampleQuality quality,
+              ConvertKernel kernel = active_convert_kernel());
+
+    // Feed frames of planar input and append the output they complete to
+    // out[0] (and out[1] for stereo)
+    void process(const float* const input[2], int frames, std::vector<float> out[2]);
+
+    // The input is complete: append the rest of the output, for a total
+    // of resampled_frame(input frames) frames
+    void finish(std::vector<float> out[2]);
+
+    int taps() const { return tapCount; }
+
+private:
+    Resampler(const Resampler&);
+    Resampler& operator=(const Resampler&);
+
+    void produce(long long limit, std::vector<float> out[2]);
+
+    int channels;
+    int inputRate;
+    int outputRate;
+    long long step;             // Input advance per output frame is step / denominator
+    long long denominator;
+    int halfTaps;
+    int tapCount;
+    int phases;
+    std::vector<float> coefficients;    // phases rows of tapCount
+    std::vector<float> deltas;          // Each row's difference to the next phase
+    ConvertKernel kernel;
+    std::vector<float> history[2];      // Input from historyStart on
+    long long historyStart;
+    long long inputFrames;
+    long long outputFrames;
+};
+
+// Time every supported kernel against the scalar one at each quality and
+// check that their output is identical
+int run_resample_benchmark(int frames, int inputRate, int outputRate, int repeats, std::ostream& out);
+
+#endif
@@ -0,0 +1,189 @@
+// rex1_file.cpp
+//
+// REX1 and ReCycle parsing behind rex1_file.h.
+
+#include "rex1_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <set>
+
+using namespace std;
+
+namespace {
+
+const size_t SLICE_TABLE_OFFSET = 1024;
+const size_t SLICE_RECORD_BYTES = 12;
+const int MAX_SLICES = 256;
+
+uint16_t read_be16(const unsigned char* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+uint32_t read_be32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// 80-bit IEEE extended, as AIFF stores the sample rate
+double read_extended(const unsigned char* p) {
+    int exponent = ((p[0] & 0x7F) << 8) | p[1];
+    uint64_t mantissa = 0;
+    for (int i = 0; i < 8; i++) {
+        mantissa = (mantissa << 8) | p[2 + i];
+    }
+    if (exponent == 0 && mantissa == 0) {
+        return 0;
+    }
+    double value = ldexp((double)mantissa, exponent - 16383 - 63);
+    return (p[0] & 0x80) ? -value : value;
+}
+
+struct Chunk {
+    const unsigned char* id;
+    const unsigned char* data;
+    size_t size;
+};
+
+bool is_aiff(const unsigned char* p, size_t size) {
+    return size >= 12 && memcmp(p, "FORM", 4) == 0 && (memcmp(p + 8, "AIFF", 4) == 0 || memcmp(p + 8, "AIFC", 4) == 0);
+}
+
+// Chunks after the FORM header, a chunk running past the end cut short
+vector<Chunk> read_chunks(const unsigned char* p, size_t size) {
+    vector<Chunk> chunks;
+    size_t pos = 12;
+    while (pos + 8 <= size) {
+        Chunk chunk;
+        chunk.id = p + pos;
+        chunk.data = p + pos + 8;
+        chunk.size = min<size_t>(read_be32(p + pos + 4), size - pos - 8);
+        chunks.push_back(chunk);
+        pos += 8 + chunk.size + (chunk.size & 1);
+    }
+    return chunks;
+}
+
+const Chunk* find_chunk(const vector<Chunk>& chunks, const char* id) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (memcmp(chunks[i].id, id, 4) == 0) return &chunks[i];
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool is_rex1_file(const char* data, size_t size) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    return is_aiff(p, size) && find_chunk(read_chunks(p, size), "REX ") != nullptr;
+}
+
+bool parse_rex1(const char* data, size_t size, Rex1File& file, string& error) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    file = Rex1File();
+    if (!is_aiff(p, size)) {
+        error = "Not an AIFF file";
+        return false;
+    }
+    vector<Chunk> chunks = read_chunks(p, size);
+    const Chunk* comm = find_chunk(chunks, "COMM");
+    const Chunk* ssnd = find_chunk(chunks, "SSND");
+    const Chunk* rex = find_chunk(chunks, "REX ");
+    if (comm == nullptr || comm->size < 18 || ssnd == nullptr || ssnd->size < 8) {
+        error = "Missing COMM or SSND chunk";
+        return false;
+    }
+    if (rex == nullptr) {
+        error = "REX chunk not found";
+        return false;
+    }
+    if (memcmp(p + 8, "AIFC", 4) == 0 && comm->size >= 22 && memcmp(comm->data + 18, "NONE", 4) != 0) {
+        error = "Compressed AIFC is not supported";
+        return false;
+    }
+
+    file.channels = read_be16(comm->data);
+    file.bits = read_be16(comm->data + 6);
+    file.sampleRate = (int)lround(read_extended(comm->data + 8));
+    if (file.channels < 1 || file.channels > 2) {
+        error = "Unsupported channel count: " + to_string(file.channels);
+        return false;
+    }
+    if (file.bits != 8 && file.bits != 16 && file.bits != 24) {
+        error = "Unsupported bit depth: " + to_string(file.bits);
+        return false;
+    }
+    if (file.sampleRate < 8000 || file.sampleRate > 192000) {
+        error = "Unsupported sample rate: " + to_string(file.sampleRate);
+        return false;
+    }
+
+    size_t soundOffset = min<size_t>(read_be32(ssnd->data), ssnd->size - 8);
+    file.sound = ssnd->data + 8 + soundOffset;
+    size_t frameBytes = (size_t)file.channels * (file.bits / 8);
+    file.soundFrames = min<long long>(read_be32(comm->data + 2), (ssnd->size - 8 - soundOffset) / frameBytes);
+
+    // Slice positions, read until a zero or repeated one like the Lua loader does
+    vector<long long> offsets;
+    set<long long> seen;
+    const unsigned char* end = p + size;
+    const unsigned char* record = rex->id + 8 + SLICE_TABLE_OFFSET;
+    for (int i = 0; i < MAX_SLICES && record + 4 <= end; i++, record += SLICE_RECORD_BYTES) {
+        long long offset = read_be32(record);
+        if (offset == 0 || !seen.insert(offset).second) break;
+        offsets.push_back(offset);
+    }
+    if (offsets.empty()) {
+        error = "REX contained no slice offsets";
+        return false;
+    }
+    sort(offsets.begin(), offsets.end());
+    file.sliceCount = (int)offsets.size();
+
+    // Audio before the first slice header, then each slice up to the next header
+    Rex1Span lead;
+    lead.frames = min(offsets[0] - REX1_SLICE_HEADER_FRAMES, file.soundFrames);
+    if (lead.frames > 0) {
+        file.spans.push_back(lead);
+    }
+    for (size_t i = 0; i < offsets.size(); i++) {
+        long long next = i + 1 < offsets.size() ? offsets[i + 1] - REX1_SLICE_HEADER_FRAMES : file.soundFrames;
+        Rex1Span span;
+        span.slice = (int)i;
+        span.sourceFrame = offsets[i];
+        span.frames = min(next, file.soundFrames) - offsets[i];
+        if (span.frames > 0) {
+            file.spans.push_back(span);
+        }
+    }
+    for (size_t i = 0; i < file.spans.size(); i++) {
+        file.outputFrames += file.spans[i].frames;
+    }
+    if (file.outputFrames <= 0 || file.outputFrames > INT32_MAX) {
+        error = "No audio in REX slices";
+        return false;
+    }
+    return true;
+}
+
+void rex1_read_frames(const Rex1File& file, long long sourceFrame, int frames, float* out[2]) {
+    const int bytes = file.bits / 8;
+    const unsigned char* p = file.sound + (size_t)sourceFrame * file.channels * bytes;
+    // The WAV writer quantizes with a scale of 32767 (see pcm_convert.h)
+    const float scale16 = 1.0f / 32767.0f;
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < file.channels; c++, p += bytes) {
+            float value;
+            if (bytes == 1) {
+                value = (float)((int8_t)p[0] * 256) * scale16;
+            } else if (bytes == 2) {
+                value = (float)(int16_t)read_be16(p) * scale16;
+            } else {
+                int32_t v = (int32_t)(((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8)) >> 8;
+                value = (float)v / 8388607.0f;
+            }
+            out[c][i] = value;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+// rex1_file.h
+//
+// REX1 (.rex) and ReCycle (.rcy) loops, read without the REX library.
+//
+// Both are AIFF files whose sound data holds every slice behind a
+// 256-frame slice header, with a "REX " chunk listing where the slices
+// are. The slice table starts 1024 bytes into the chunk's data: up to 256
+// records of 12 bytes, each starting with the big-endian frame position
+// at which that slice's audio begins, ending at a zero or repeated
+// position. This is the layout importers/PakettiREXLoader.lua reads.
+//
+// The decoder cuts the headers out and writes the audio straight from
+// the mapped file, with the slices laid end to end like --extract slices.
+
+#ifndef REX1_FILE_H
+#define REX1_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Frames of a slice header in the sound data
+const int REX1_SLICE_HEADER_FRAMES = 256;
+
+// A run of sound data frames that ends up in the output
+struct Rex1Span {
+    int slice = -1;             // Index into the file's slice table; -1 for audio before the first slice
+    long long sourceFrame = 0;  // First frame in the sound data
+    long long frames = 0;
+};
+
+struct Rex1File {
+    int channels = 0;
+    int sampleRate = 0;
+    int bits = 0;
+    const unsigned char* sound = nullptr;   // Big-endian PCM inside the file's buffer
+    long long soundFrames = 0;              // Slice headers included
+    int sliceCount = 0;                     // Records in the slice table
+    std::vector<Rex1Span> spans;            // In output order, headers left out
+    long long outputFrames = 0;
+};
+
+// An AIFF or AIFC file with a "REX " chunk
+bool is_rex1_file(const char* data, size_t size);
+
+// Read the format, sound data and slice table. The spans point into data,
+// which must outlive file.
+bool parse_rex1(const char* data, size_t size, Rex1File& file, std::string& error);
+
+// frames frames of sound data from sourceFrame on, to planar float in
+// out[0] (and out[1] for stereo). 8 and 16-bit samples are scaled so the
+// 16-bit WAV writer gives back the 16-bit values unchanged.
+void rex1_read_frames(const Rex1File& file, long long sourceFrame, int frames, float* out[2]);
+
+#endif
@@ -0,0 +1,284 @@
+// rex2decoder_posix.cpp
+//
+// POSIX platform layer of the decoder (macOS and Linux): file checks,
+// memory-mapped input, directory scans and worker processes. The decoder
+// itself lives in decoder_core.cpp; see platform.h.
+
+// If building for macOS, enable Darwin extensions.
+#if defined(DREX_MAC) && (DREX_MAC == 1)
+  #define _DARWIN_C_SOURCE 1
+  #include <CoreFoundation/CoreFoundation.h>
+#endif
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#if defined(DREX_MAC) && (DREX_MAC == 1)
+  #include <sys/xattr.h>
+  #include <unistd.h>
+  #include <dlfcn.h>
+#elif defined(DREX_WINDOWS) && (DREX_WINDOWS == 1)
+  #include <windows.h>
+#endif
+
+#include "platform.h"
+
+using namespace std;
+
+// ---------------------------------------------------------------------
+// Utility functions for diagnostics and file/path checking
+// ---------------------------------------------------------------------
+#if defined(DREX_WINDOWS) && (DREX_WINDOWS == 1)
+bool path_exists(const std::string& path) {
+    DWORD attrib = GetFileAttributesA(path.c_str());
+    return (attrib != INVALID_FILE_ATTRIBUTES);
+}
+bool path_is_directory(const std::string& path) {
+    DWORD attrib = GetFileAttributesA(path.c_str());
+    return (attrib != INVALID_FILE_ATTRIBUTES &&
+            (attrib & FILE_ATTRIBUTE_DIRECTORY));
+}
+#else
+bool path_exists(const std::string& path) {
+    struct stat buffer;
+    return stat(path.c_str(), &buffer) == 0;
+}
+bool path_is_directory(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0)
+        return false;
+    return S_ISDIR(buffer.st_mode);
+}
+#endif
+
+void print_bundle_debug(const std::string& bundle_path) {
+    cout << "--- Bundle Diagnostics ---" << endl;
+    if (!path_exists(bundle_path)) {
+        cerr << "❌ Bundle path does not exist: " << bundle_path << endl;
+        return;
+    }
+    if (!path_is_directory(bundle_path)) {
+        cerr << "❌ Bundle path is not a directory: " << bundle_path << endl;
+        return;
+    }
+#if defined(DREX_MAC) && (DREX_MAC == 1)
+    std::string dylib_path = bundle_path + "/Contents/MacOS/REX Shared Library";
+    if (!path_exists(dylib_path)) {
+        cerr << "❌ Binary not found at: " << dylib_path << endl;
+    } else {
+        cout << "✅ Found binary: " << dylib_path << endl;
+        std::string cmd = "file \"" + dylib_path + "\"";
+        cout << "→ Running: " << cmd << endl;
+        system(cmd.c_str());
+        char quarantine[1024];
+        ssize_t len = getxattr(bundle_path.c_str(), "com.apple.quarantine",
+                                 quarantine, sizeof(quarantine), 0, 0);
+        if (len > 0) {
+            cout << "⚠️  Quarantine attribute found: ";
+            cout.write(quarantine, len);
+            cout << endl;
+        } else {
+            cout << "✅ No quarantine attribute found." << endl;
+        }
+        std::string codesign_cmd = "codesign --verify --deep --verbose=4 \"" + bundle_path + "\"";
+        cout << "→ Running codesign check..." << endl;
+        system(codesign_cmd.c_str());
+    }
+#endif
+    cout << "---------------------------" << endl;
+}
+
+// ---------------------------------------------------------------------
+// RX2 input
+// ---------------------------------------------------------------------
+bool InputFile::open(const std::string& path) {
+    close();
+    int fd = (path == "-") ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            madvise(view, (size_t)st.st_size, MADV_SEQUENTIAL);
+            mapped = static_cast<const char*>(view);
+            mappedSize = (size_t)st.st_size;
+            if (fd != STDIN_FILENO) ::close(fd);
+            return true;
+        }
+    }
+    // Not mappable: stream it in
+    char chunk[65536];
+    ssize_t got;
+    while ((got = read(fd, chunk, sizeof(chunk))) > 0) {
+        streamed.insert(streamed.end(), chunk, chunk + got);
+    }
+    if (fd != STDIN_FILENO) ::close(fd);
+    return got == 0;
+}
+
+void InputFile::close() {
+    if (mapped != nullptr) {
+        munmap(const_cast<char*>(mapped), mappedSize);
+    }
+    mapped = nullptr;
+    mappedSize = 0;
+    std::vector<char>().swap(streamed);
+}
+
+// Peak resident set size of this process in kilobytes
+long long peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (long long)usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return (long long)usage.ru_maxrss;        // kilobytes on Linux
+#endif
+}
+
+// ---------------------------------------------------------------------
+// Batch helpers: file sizes, directory scans and worker processes
+// ---------------------------------------------------------------------
+long long file_size(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0)
+        return 0;
+    return static_cast<long long>(buffer.st_size);
+}
+
+long long file_modified(const std::string& path) {
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) != 0)
+        return 0;
+    return static_cast<long long>(buffer.st_mtime);
+}
+
+// Recursively list .rx2 files below dir as paths relative to it
+void list_rx2_files(const std::string& dir, const std::string& relative, std::vector<std::string>& files) {
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr)
+        return;
+    while (struct dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string full = dir + "/" + name;
+        std::string rel = relative.empty() ? name : relative + "/" + name;
+        if (path_is_directory(full)) {
+            list_rx2_files(full, rel, files);
+        } else if (has_rx2_extension(name)) {
+            files.push_back(rel);
+        }
+    }
+    closedir(handle);
+    sort(files.begin(), files.end());
+}
+
+std::string self_executable_path(const char* argv0) {
+    return argv0;
+}
+
+// ---------------------------------------------------------------------
+// Cache directory helpers
+// ---------------------------------------------------------------------
+bool make_directory(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0 || path_is_directory(path);
+}
+
+void list_directory(const std::string& dir, std::vector<DirectoryEntry>& entries) {
+    DIR* handle = opendir(dir.c_str());
+    if (handle == nullptr)
+        return;
+    while (struct dirent* entry = readdir(handle)) {
+        struct stat st;
+        std::string full = dir + "/" + entry->d_name;
+        if (stat(full.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            continue;
+        DirectoryEntry item;
+        item.name = entry->d_name;
+        item.size = (long long)st.st_size;
+        item.modified = (long long)st.st_mtime;
+        entries.push_back(item);
+    }
+    closedir(handle);
+}
+
+bool replace_file(const std::string& from, const std::string& to) {
+    return rename(from.c_str(), to.c_str()) == 0;
+}
+
+bool touch_file(const std::string& path) {
+    return utimes(path.c_str(), nullptr) == 0;
+}
+
+int current_process_id() {
+    return (int)getpid();
+}
+
+void set_stdout_binary() {
+}
+
+bool spawn_child(const std::vector<std::string>& args, ChildProcess& child) {
+    int toChild[2];
+    int fromChild[2];
+    if (pipe(toChild) != 0)
+        return false;
+    if (pipe(fromChild) != 0) {
+        close(toChild[0]);
+        close(toChild[1]);
+        return false;
+    }
+    // Keep our ends out of later children so that closing them signals EOF
+    fcntl(toChild[1], F_SETFD, FD_CLOEXEC);
+    fcntl(fromChild[0], F_SETFD, FD_CLOEXEC);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        close(toChild[0]);
+        close(fromChild[1]);
+        std::vector<char*> argv;
+        for (size_t i = 0; i < args.size(); i++) argv.push_back(const_cast<char*>(args[i].c_str()));
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    close(toChild[0]);
+    close(fromChild[1]);
+    if (pid < 0) {
+        close(toChild[1]);
+        close(fromChild[0]);
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    child.in = fdopen(toChild[1], "w");
+    child.out = fdopen(fromChild[0], "r");
+    child.process = pid;
+    return true;
+}
+
+void finish_child(ChildProcess& child) {
+    if (child.in) fclose(child.in);
+    if (child.out) fclose(child.out);
+    if (child.process > 0) {
+        int status = 0;
+        waitpid((pid_t)child.process, &status, 0);
+    }
+    child = ChildProcess();
+}
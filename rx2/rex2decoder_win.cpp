@@ -1,36 +1,29 @@
 // rex2decoder_win.cpp
 //
-// This version of the decoder is reformatted to compile only for Windows
-// using the REX SDK files (rex.h and rex.c) provided by Reason Studios.
-// All macOS-specific code paths have been removed.
+// Windows platform layer of the decoder: file checks, memory-mapped input,
+// directory scans and worker processes. The decoder itself lives in
+// decoder_core.cpp; see platform.h.
 // 
-// Compilation command (example):
-//   x86_64-w64-mingw32-g++ rex2decoder_win.cpp Wav.c REX.c -o rex2decoder_win.exe \
-//       -I/Users/esaruoho/Downloads/rx2 -DREX_MAC=0 -DREX_WINDOWS=1 -DREX_DLL_LOADER=1
+// Built with build_win.sh, which has the full list of sources and flags.
 
-#include "Wav.h"
 #include <windows.h>
 #include <shlobj.h>
+#include <psapi.h>
 #include <wchar.h>
+#include <cstdint>
 #include <cstdlib>
 #include <cstdio>
-#include <fstream>
 #include <iostream>
 #include <vector>
-#include <sstream>
-#include <iomanip>
-#include <cmath>
-#include <cstring>
+#include <algorithm>
 #include <sys/stat.h>
+#include <io.h>
+#include <fcntl.h>
 
-#include "REX.h"
+#include "platform.h"
 
 using namespace std;
 
-// Latency compensation for preview rendering (adjust this value based on testing)
-// Positive values shift markers later, negative values shift them earlier
-const int PREVIEW_LATENCY_COMPENSATION = -64; // Start with -64 frames (about 1.45ms at 44.1kHz)
-
 // -------------------------------
 // Utility: Convert UTF-8 char* string to std::wstring
 // -------------------------------
@@ -77,343 +70,244 @@ void print_bundle_debug(const string& bundle_path) {
     cout << "---------------------------" << endl;
 }
 
-// ---------------------------------------------------------------------
-// Preview render function like REX Test App (Windows version)
-// ---------------------------------------------------------------------
-REX::REXError previewRenderFullLoop(REX::REXHandle handle, const string& wavPath, const string& txtPath) {
-    REX::REXError result;
-    REX::REXInfo info;
-    float* renderSamples = nullptr;
-    float* renderBuffers[2] = {nullptr, nullptr};
-    int lengthFrames = 0;
-    int framesRendered = 0;
-
-    result = REX::REXGetInfo(handle, sizeof(REX::REXInfo), &info);
-    if (result != REX::kREXError_NoError) {
-        return result;
-    }
-
-    // Calculate length in frames of preview rendered loop (same formula as REX Test App)
-    // Use double precision to minimize rounding errors
-    double exactLength = (double)info.fSampleRate * 1000.0 * (double)info.fPPQLength / ((double)info.fTempo * 256.0);
-    lengthFrames = (int)round(exactLength);
-
-    cout << "=== LENGTH CALCULATION DEBUG ===" << endl;
-    cout << "REX Test App formula: (sampleRate * 1000.0 * PPQLength) / (tempo * 256)" << endl;
-    cout << "Step by step:" << endl;
-    cout << "  Sample Rate: " << info.fSampleRate << endl;
-    cout << "  PPQ Length: " << info.fPPQLength << endl;
-    cout << "  Tempo: " << info.fTempo << " (internal units)" << endl;
-    cout << "  Real BPM: " << (info.fTempo / 1000.0) << endl;
-    cout << "  Calculation: (" << info.fSampleRate << " * 1000.0 * " << info.fPPQLength << ") / (" << info.fTempo << " * 256)" << endl;
-    cout << "  = " << (info.fSampleRate * 1000.0 * info.fPPQLength) << " / " << (info.fTempo * 256) << endl;
-    cout << "  = " << exactLength << " (exact)" << endl;
-    cout << "  = " << lengthFrames << " frames (after rounding)" << endl;
-    cout << "  Precision difference: " << (exactLength - lengthFrames) << " frames" << endl;
-    cout << "=================================" << endl;
-
-    cout << "Calculated preview length: " << lengthFrames << " frames" << endl;
-
-    // Allocate memory for all channels
-    renderSamples = (float*)malloc(info.fChannels * lengthFrames * sizeof(float));
-    if (renderSamples == nullptr) {
-        cerr << "Malloc failed for preview render" << endl;
-        return REX::kREXError_OutOfMemory;
-    } 
-
-    // Set up channel pointers
-    renderBuffers[0] = &renderSamples[0];
-    if (info.fChannels == 2) {
-        renderBuffers[1] = &renderSamples[lengthFrames];
+// -------------------------------
+// RX2 input
+// -------------------------------
+bool InputFile::open(const string& path) {
+    close();
+    HANDLE file;
+    bool ownsFile = true;
+    if (path == "-") {
+        file = GetStdHandle(STD_INPUT_HANDLE);
+        ownsFile = false;
     } else {
-        renderBuffers[1] = nullptr;
+        wstring widePath = ConvertToWide(path.c_str());
+        file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
     }
-
-    // Set preview tempo to original tempo
-    result = REX::REXSetPreviewTempo(handle, info.fTempo);
-    if(result != REX::kREXError_NoError) {
-        cerr << "REXSetPreviewTempo failed: " << result << endl;
-        free(renderSamples);
-        return result;
+    if (file == INVALID_HANDLE_VALUE || file == NULL)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            mapped = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (mapped != nullptr) {
+                mappedSize = static_cast<size_t>(fileSize.QuadPart);
+                if (ownsFile) CloseHandle(file);
+                return true;
+            }
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
     }
-
-    // Start preview
-    result = REX::REXStartPreview(handle);
-    if(result != REX::kREXError_NoError) {
-        cerr << "REXStartPreview failed: " << result << endl;
-        free(renderSamples);
-        return result;
+    // Not mappable: stream it in.
+    char chunk[65536];
+    DWORD got = 0;
+    BOOL readOk;
+    while ((readOk = ReadFile(file, chunk, sizeof(chunk), &got, NULL)) && got > 0) {
+        streamed.insert(streamed.end(), chunk, chunk + got);
     }
+    bool complete = readOk || GetLastError() == ERROR_BROKEN_PIPE;
+    if (ownsFile) CloseHandle(file);
+    return complete;
+}
 
-    // Render in small batches like REX Test App
-    while (framesRendered != lengthFrames) {
-        int remaining = lengthFrames - framesRendered;
-        int todo = remaining;
-        float* tmpRenderBuffers[2] = {nullptr, nullptr};
-
-        if(todo > 64) {
-            todo = 64;
-        }
-
-        tmpRenderBuffers[0] = renderBuffers[0] + framesRendered;
-        if(renderBuffers[1] != nullptr) {
-            tmpRenderBuffers[1] = renderBuffers[1] + framesRendered;
-        }
+void InputFile::close() {
+    if (mapped != nullptr) UnmapViewOfFile(mapped);
+    if (mapping != NULL) CloseHandle(mapping);
+    mapped = nullptr;
+    mapping = NULL;
+    mappedSize = 0;
+    vector<char>().swap(streamed);
+}
 
-        result = REX::REXRenderPreviewBatch(handle, todo, tmpRenderBuffers);
-        if(result != REX::kREXError_NoError) {
-            cerr << "REXRenderPreviewBatch failed: " << result << endl;
-            free(renderSamples);
-            return result;
-        }
+// Peak working set of this process in kilobytes
+long long peak_rss_kb() {
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return static_cast<long long>(counters.PeakWorkingSetSize / 1024);
+}
 
-        framesRendered += todo;
-    }
-    
-    // Stop preview
-    result = REX::REXStopPreview(handle);
-    if(result != REX::kREXError_NoError) {
-        cerr << "REXStopPreview failed: " << result << endl;
-        free(renderSamples);
-        return result;
-    }
+// -------------------------------
+// Batch helpers: file sizes, directory scans and worker processes
+// -------------------------------
+long long file_size(const string& path) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+        return 0;
+    return (static_cast<long long>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+}
 
-    // Write the WAV file using the same WriteWave function as REX Test App
-    FILE* outputFile = fopen(wavPath.c_str(), "wb");
-    if (outputFile != nullptr) {
-        WriteWave(outputFile, lengthFrames, info.fChannels, 16, info.fSampleRate, renderBuffers);
-        fclose(outputFile);
-        cout << "Full loop written to: " << wavPath << endl;
-    } else {
-        cerr << "Failed to open output WAV file: " << wavPath << endl;
-        free(renderSamples);
-        return REX::kREXError_Undefined;
-    }
+long long file_modified(const string& path) {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+        return 0;
+    // FILETIME counts 100 ns steps since 1601
+    ULARGE_INTEGER written;
+    written.LowPart = data.ftLastWriteTime.dwLowDateTime;
+    written.HighPart = data.ftLastWriteTime.dwHighDateTime;
+    return static_cast<long long>(written.QuadPart / 10000000ULL) - 11644473600LL;
+}
 
-    // Calculate slice markers for Renoise and write txt file
-    // Use the actual rendered length, not a separate calculation
-    cout << "=== COMPREHENSIVE SLICE DEBUG ANALYSIS ===" << endl;
-    cout << "Original file info:" << endl;
-    cout << "  Sample Rate: " << info.fSampleRate << " Hz" << endl;
-    cout << "  Tempo: " << info.fTempo << " (Real BPM: " << (info.fTempo / 1000.0) << ")" << endl;
-    cout << "  PPQ Length: " << info.fPPQLength << " PPQ units" << endl;
-    cout << "  Total Slices: " << info.fSliceCount << endl;
-    cout << endl;
-    
-    cout << "Rendered preview info:" << endl;
-    cout << "  Total rendered frames: " << lengthFrames << endl;
-    cout << "  Rendered duration: " << (double)lengthFrames / info.fSampleRate << " seconds" << endl;
-    cout << "  Frames per PPQ unit: " << (double)lengthFrames / info.fPPQLength << endl;
-    cout << endl;
-    
-    cout << "=== DETAILED SLICE ANALYSIS ===" << endl;
-    ostringstream txt;
-    
-    for (int i = 0; i < info.fSliceCount; i++) {
-        REX::REXSliceInfo slice;
-        REX::REXError sliceErr = REX::REXGetSliceInfo(handle, i, sizeof(slice), &slice);
-        if (sliceErr == REX::kREXError_NoError) {
-            // Calculate frame position in the actual rendered WAV using the same method as REX Test App
-            double ratio = (double)slice.fPPQPos / (double)info.fPPQLength;
-            int rawFramePosition = (int)round(ratio * lengthFrames);
-            int framePosition = rawFramePosition + PREVIEW_LATENCY_COMPENSATION;
-            if (framePosition < 1) framePosition = 1;
-            
-            // Calculate slice end position (next slice start or end of loop)
-            int nextSliceStart = lengthFrames; // Default to end of loop
-            if (i < info.fSliceCount - 1) {
-                REX::REXSliceInfo nextSlice;
-                REX::REXError nextSliceErr = REX::REXGetSliceInfo(handle, i + 1, sizeof(nextSlice), &nextSlice);
-                if (nextSliceErr == REX::kREXError_NoError) {
-                    double nextRatio = (double)nextSlice.fPPQPos / (double)info.fPPQLength;
-                    int rawNextStart = (int)round(nextRatio * lengthFrames);
-                    nextSliceStart = rawNextStart + PREVIEW_LATENCY_COMPENSATION;
-                }
-            }
-            int sliceLength = nextSliceStart - framePosition;
-            
-            // Time calculations
-            double sliceStartTime = (double)framePosition / info.fSampleRate;
-            double sliceEndTime = (double)nextSliceStart / info.fSampleRate;
-            double sliceDuration = sliceEndTime - sliceStartTime;
-            
-            cout << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ') << ":" << endl;
-            cout << "  PPQ Position: " << slice.fPPQPos << " / " << info.fPPQLength;
-            cout << " (ratio: " << fixed << setprecision(6) << ratio << ")" << endl;
-            cout << "  Original Sample Length: " << slice.fSampleLength << " samples" << endl;
-            cout << "  Raw Frame Position: " << rawFramePosition << endl;
-            cout << "  Latency Compensation: " << PREVIEW_LATENCY_COMPENSATION << " frames" << endl;
-            cout << "  Final Frame Start: " << framePosition << endl;
-            cout << "  Rendered Frame End: " << nextSliceStart << endl;
-            cout << "  Rendered Slice Length: " << sliceLength << " frames" << endl;
-            cout << "  Time Start: " << fixed << setprecision(6) << sliceStartTime << "s" << endl;
-            cout << "  Time End: " << fixed << setprecision(6) << sliceEndTime << "s" << endl;
-            cout << "  Time Duration: " << fixed << setprecision(6) << sliceDuration << "s" << endl;
-            
-            // Show the math step by step
-            cout << "  Math: " << slice.fPPQPos << " / " << info.fPPQLength << " * " << lengthFrames;
-            cout << " = " << ratio << " * " << lengthFrames << " = " << (ratio * lengthFrames);
-            cout << " → " << rawFramePosition << " + (" << PREVIEW_LATENCY_COMPENSATION << ") = " << framePosition << endl;
-            
-            cout << "  Renoise command: renoise.song().selected_sample:insert_slice_marker(" << framePosition << ")" << endl;
-            cout << endl;
-            
-            txt << "renoise.song().selected_sample:insert_slice_marker(" << framePosition << ")\n";
-        } else {
-            cout << "ERROR: Failed to get slice " << (i+1) << " info: " << sliceErr << endl;
+// Recursively list .rx2 files below dir as paths relative to it
+void list_rx2_files(const string& dir, const string& relative, vector<string>& files) {
+    WIN32_FIND_DATAA entry;
+    HANDLE handle = FindFirstFileA((dir + "\\*").c_str(), &entry);
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        string name = entry.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        string full = dir + "\\" + name;
+        string rel = relative.empty() ? name : relative + "\\" + name;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            list_rx2_files(full, rel, files);
+        } else if (has_rx2_extension(name)) {
+            files.push_back(rel);
         }
-    }
-    
-    cout << "=== SUMMARY ===" << endl;
-    cout << "Applied latency compensation: " << PREVIEW_LATENCY_COMPENSATION << " frames" << endl;
-    cout << "Total analysis complete. Check frame positions against actual audio transients." << endl;
-    cout << "If positions are still off:" << endl;
-    cout << "  - Adjust PREVIEW_LATENCY_COMPENSATION constant (currently " << PREVIEW_LATENCY_COMPENSATION << ")" << endl;
-    cout << "  - Positive values shift markers later in time" << endl;
-    cout << "  - Negative values shift markers earlier in time" << endl;
-    cout << "  - Each frame = " << fixed << setprecision(3) << (1000.0 / info.fSampleRate) << "ms at " << info.fSampleRate << "Hz" << endl;
-    cout << "=============================================" << endl;
-
-    // Write text file with Renoise commands
-    ofstream txtFile(txtPath);
-    if (txtFile) {
-        txtFile << txt.str();
-        txtFile.close();
-        cout << "Renoise slice commands written to: " << txtPath << endl;
-    } else {
-        cerr << "Failed to open output text file: " << txtPath << endl;
-    }
+    } while (FindNextFileA(handle, &entry));
+    FindClose(handle);
+    sort(files.begin(), files.end());
+}
 
-    free(renderSamples);
-    return REX::kREXError_NoError;
+string self_executable_path(const char* argv0) {
+    char path[MAX_PATH];
+    DWORD len = GetModuleFileNameA(NULL, path, MAX_PATH);
+    if (len == 0 || len == MAX_PATH)
+        return argv0;
+    return string(path, len);
 }
 
 // -------------------------------
-// Main Program (Windows-only)
+// Cache directory helpers
 // -------------------------------
-int main(int argc, char** argv) {
-    // Expected usage: input.rx2 output.wav output.txt sdk_path
-    if (argc != 5) {
-        cerr << "Usage: " << argv[0] << " input.rx2 output.wav output.txt sdk_path" << endl;
-        return 1;
-    }
-    const char* rx2Path = argv[1];
-    const char* wavPath = argv[2];
-    const char* txtPath = argv[3];
-    const char* sdkPath = argv[4];
-
-    // Print diagnostics for the provided SDK folder.
-    print_bundle_debug(sdkPath);
+bool make_directory(const string& path) {
+    return CreateDirectoryA(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
 
-    // Read the RX2 file into memory.
-    ifstream file(rx2Path, ios::binary);
-    if (!file) {
-        cerr << "Failed to open RX2 file: " << rx2Path << endl;
-        return 1;
-    }
-    file.seekg(0, ios::end);
-    size_t fileSize = static_cast<size_t>(file.tellg());
-    file.seekg(0);
-    vector<char> fileBuffer(fileSize);
-    file.read(fileBuffer.data(), fileSize);
-    file.close();
-    cout << "Loaded RX2 file: " << rx2Path << ", size: " << fileSize << " bytes" << endl;
+void list_directory(const string& dir, vector<DirectoryEntry>& entries) {
+    WIN32_FIND_DATAA entry;
+    HANDLE handle = FindFirstFileA((dir + "\\*").c_str(), &entry);
+    if (handle == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        // FILETIME counts 100 ns steps since 1601
+        ULARGE_INTEGER written;
+        written.LowPart = entry.ftLastWriteTime.dwLowDateTime;
+        written.HighPart = entry.ftLastWriteTime.dwHighDateTime;
+        DirectoryEntry item;
+        item.name = entry.cFileName;
+        item.size = (static_cast<long long>(entry.nFileSizeHigh) << 32) | entry.nFileSizeLow;
+        item.modified = static_cast<long long>(written.QuadPart / 10000000ULL) - 11644473600LL;
+        entries.push_back(item);
+    } while (FindNextFileA(handle, &entry));
+    FindClose(handle);
+}
 
-    // Initialize the REX DLL/dynamic library.
-    // Note: REXInitializeDLL_DirPath for Windows expects a wide-character string.
-    wstring sdkPathW = ConvertToWide(sdkPath);
-    REX::REXError initErr = REX::REXInitializeDLL_DirPath(sdkPathW.c_str());
-    cout << "REXInitializeDLL_DirPath returned: " << initErr << endl;
-    if (initErr != REX::kREXError_NoError) {
-        cerr << "DLL initialization failed." << endl;
-        return 1;
-    }
+bool replace_file(const string& from, const string& to) {
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
 
-    // Create a REX object.
-    REX::REXHandle handle = nullptr;
-    REX::REXError createErr = REX::REXCreate(&handle, fileBuffer.data(), static_cast<int>(fileSize), nullptr, nullptr);
-    cout << "REXCreate returned: " << createErr << ", handle: " << handle << endl;
-    if (createErr != REX::kREXError_NoError || !handle) {
-        cerr << "REXCreate failed or returned null handle." << endl;
-        return 1;
-    }
+bool touch_file(const string& path) {
+    HANDLE file = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    BOOL ok = SetFileTime(file, NULL, NULL, &now);
+    CloseHandle(file);
+    return ok != 0;
+}
 
-    // Extract header information
-    REX::REXInfo info;
-    REX::REXError infoErr = REX::REXGetInfo(handle, sizeof(info), &info);
-    if (infoErr != REX::kREXError_NoError) {
-        cerr << "REXGetInfo failed with error: " << infoErr << endl;
-        return 1;
-    }
-    
-    // Set output sample rate to native rate
-    REX::REXError sampleRateErr = REX::REXSetOutputSampleRate(handle, info.fSampleRate);
-    if (sampleRateErr != REX::kREXError_NoError) {
-        cerr << "REXSetOutputSampleRate failed with error: " << sampleRateErr << endl;
-        return 1;
-    }
-    
-    // Re-fetch info after setting sample rate
-    infoErr = REX::REXGetInfo(handle, sizeof(info), &info);
-    if (infoErr != REX::kREXError_NoError) {
-        cerr << "REXGetInfo #2 failed with error: " << infoErr << endl;
-        return 1;
-    }
-    
-    cout << "=== Header Information ===" << endl;
-    cout << "Channels:       " << info.fChannels << endl;
-    cout << "Sample Rate:    " << info.fSampleRate << endl;
-    cout << "Slice Count:    " << info.fSliceCount << endl;
-    double realTempo = info.fTempo / 1000.0;
-    double realOriginalTempo = info.fOriginalTempo / 1000.0;
-    cout << "Tempo:          " << info.fTempo << " (Real BPM: " << realTempo << " BPM)" << endl;
-    cout << "Original Tempo: " << info.fOriginalTempo << " (Real BPM: " << realOriginalTempo << " BPM)" << endl;
-    cout << "Loop Length (PPQ):    " << info.fPPQLength << endl;
-    cout << "Time Signature:       " << info.fTimeSignNom << "/" << info.fTimeSignDenom << endl;
-    cout << "Bit Depth:      " << info.fBitDepth << endl;
-    cout << "==========================" << endl;
+int current_process_id() {
+    return static_cast<int>(GetCurrentProcessId());
+}
 
-    // Extract creator info
-    REX::REXCreatorInfo creator;
-    REX::REXError creatorErr = REX::REXGetCreatorInfo(handle, sizeof(creator), &creator);
-    bool hasCreatorInfo = (creatorErr == REX::kREXError_NoError);
-    if (hasCreatorInfo) {
-        cout << "=== Creator Information ===" << endl;
-        cout << "Name:       " << creator.fName << endl;
-        cout << "Copyright:  " << creator.fCopyright << endl;
-        cout << "URL:        " << creator.fURL << endl;
-        cout << "Email:      " << creator.fEmail << endl;
-        cout << "FreeText:   " << creator.fFreeText << endl;
-        cout << "===========================" << endl;
-    } else {
-        cout << "No creator information available." << endl;
-    }
+void set_stdout_binary() {
+    fflush(stdout);
+    _setmode(_fileno(stdout), _O_BINARY);
+}
 
-    // Extract slice info
-    cout << "=== Slice Information ===" << endl;
-    for (int i = 0; i < info.fSliceCount; i++) {
-        REX::REXSliceInfo slice;
-        REX::REXError sliceErr = REX::REXGetSliceInfo(handle, i, sizeof(slice), &slice);
-        if (sliceErr == REX::kREXError_NoError) {
-            cout << "Slice " << setfill('0') << setw(3) << (i+1) << setfill(' ')
-                 << ": PPQ Position = " << slice.fPPQPos
-                 << ", Sample Length = " << slice.fSampleLength << endl;
+// Quote one argument following the CommandLineToArgvW rules.
+string quote_argument(const string& arg) {
+    string quoted = "\"";
+    size_t backslashes = 0;
+    for (size_t i = 0; i < arg.size(); i++) {
+        if (arg[i] == '\\') {
+            backslashes++;
+        } else if (arg[i] == '"') {
+            quoted.append(backslashes + 1, '\\');
+            backslashes = 0;
         } else {
-            cerr << "REXGetSliceInfo failed for slice index " << i 
-                 << " with error: " << sliceErr << endl;
+            backslashes = 0;
         }
+        quoted += arg[i];
     }
-    cout << "=========================" << endl;
+    quoted.append(backslashes, '\\');
+    quoted += "\"";
+    return quoted;
+}
 
-    // Render full loop using preview API (like REX Test App)
-    REX::REXError renderErr = previewRenderFullLoop(handle, wavPath, txtPath);
-    if (renderErr != REX::kREXError_NoError) {
-        cerr << "Preview render failed with error: " << renderErr << endl;
+bool spawn_child(const vector<string>& args, ChildProcess& child) {
+    SECURITY_ATTRIBUTES sa;
+    sa.nLength = sizeof(sa);
+    sa.lpSecurityDescriptor = NULL;
+    sa.bInheritHandle = TRUE;
+    HANDLE inRead, inWrite, outRead, outWrite;
+    if (!CreatePipe(&inRead, &inWrite, &sa, 0))
+        return false;
+    if (!CreatePipe(&outRead, &outWrite, &sa, 0)) {
+        CloseHandle(inRead);
+        CloseHandle(inWrite);
+        return false;
+    }
+    // Keep our ends out of the child so that closing them signals EOF.
+    SetHandleInformation(inWrite, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(outRead, HANDLE_FLAG_INHERIT, 0);
+
+    string cmdLine;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (i > 0) cmdLine += " ";
+        cmdLine += quote_argument(args[i]);
     }
-        
-    // Cleanup
-    REX::REXDelete(&handle);
-    REX::REXUninitializeDLL();
 
-    return 0;
+    STARTUPINFOA si;
+    ZeroMemory(&si, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = inRead;
+    si.hStdOutput = outWrite;
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION pi;
+    ZeroMemory(&pi, sizeof(pi));
+    BOOL started = CreateProcessA(NULL, &cmdLine[0], NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+    CloseHandle(inRead);
+    CloseHandle(outWrite);
+    if (!started) {
+        CloseHandle(inWrite);
+        CloseHandle(outRead);
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    child.in = _fdopen(_open_osfhandle(reinterpret_cast<intptr_t>(inWrite), 0), "w");
+    child.out = _fdopen(_open_osfhandle(reinterpret_cast<intptr_t>(outRead), _O_RDONLY), "r");
+    child.process = reinterpret_cast<intptr_t>(pi.hProcess);
+    return true;
+}
+
+void finish_child(ChildProcess& child) {
+    if (child.in) fclose(child.in);
+    if (child.out) fclose(child.out);
+    if (child.process) {
+        HANDLE process = reinterpret_cast<HANDLE>(child.process);
+        WaitForSingleObject(process, INFINITE);
+        CloseHandle(process);
+    }
+    child = ChildProcess();
 }
@@ -0,0 +1,53 @@
+// rex_backend.cpp
+//
+// Backend selection behind rex_backend.h.
+
+#include "rex_backend.h"
+
+#include <memory>
+
+using namespace std;
+
+#if defined(REX_BACKEND_SDK) && (REX_BACKEND_SDK == 1)
+RexBackend* make_sdk_rex_backend();
+#endif
+RexBackend* make_synth_rex_backend();
+
+static unique_ptr<RexBackend> gBackend;
+
+const char* rex_backend_names() {
+#if defined(REX_BACKEND_SDK) && (REX_BACKEND_SDK == 1)
+    return "sdk|synth";
+#else
+    return "synth";
+#endif
+}
+
+const char* default_rex_backend_name() {
+#if defined(REX_BACKEND_SDK) && (REX_BACKEND_SDK == 1)
+    return "sdk";
+#else
+    return "synth";
+#endif
+}
+
+bool select_rex_backend(const string& name) {
+#if defined(REX_BACKEND_SDK) && (REX_BACKEND_SDK == 1)
+    if (name == "sdk") {
+        gBackend.reset(make_sdk_rex_backend());
+        return true;
+    }
+#endif
+    if (name == "synth") {
+        gBackend.reset(make_synth_rex_backend());
+        return true;
+    }
+    return false;
+}
+
+RexBackend& rex_backend() {
+    if (!gBackend) {
+        select_rex_backend(default_rex_backend_name());
+    }
+    return *gBackend;
+}
@@ -0,0 +1,129 @@
+// rex_backend.h
+//
+// The REX-style interface the decoder core renders through.
+//
+// It mirrors the part of the REX SDK C API (REX.h) that the decoder uses,
+// with the decoder's own types so the core compiles without the SDK
+// headers. Two backends implement it:
+//
+//   sdk     the REX Shared Library, loaded through REX.c. Only built when
+//           REX_BACKEND_SDK is defined (build_mac.sh, build_win.sh).
+//   synth   a deterministic stand-in that synthesizes loops, for
+//           benchmarking the decoder anywhere, Linux included
+//           (rex_backend_synth.cpp)
+//
+// Error values match the SDK's REXError codes so numbers printed in logs
+// and batch results mean the same thing with either backend.
+
+#ifndef REX_BACKEND_H
+#define REX_BACKEND_H
+
+#include <string>
+
+enum RexError {
+    kRexError_NoError = 1,
+    kRexError_OperationAbortedByUser = 2,
+    kRexError_NoCreatorInfoAvailable = 3,
+
+    kRexError_NotEnoughMemoryForDLL = 100,
+    kRexError_UnableToLoadDLL = 101,
+    kRexError_DLLTooOld = 102,
+    kRexError_DLLNotFound = 103,
+    kRexError_APITooOld = 104,
+    kRexError_OutOfMemory = 105,
+    kRexError_FileCorrupt = 106,
+    kRexError_REX2FileTooNew = 107,
+    kRexError_FileHasZeroLoopLength = 108,
+    kRexError_OSVersionNotSupported = 109,
+
+    kRexImplError_DLLNotInitialized = 200,
+    kRexImplError_DLLAlreadyInitialized = 201,
+    kRexImplError_InvalidHandle = 202,
+    kRexImplError_InvalidSize = 203,
+    kRexImplError_InvalidArgument = 204,
+    kRexImplError_InvalidSlice = 205,
+    kRexImplError_InvalidSampleRate = 206,
+    kRexImplError_BufferTooSmall = 207,
+    kRexImplError_IsBeingPreviewed = 208,
+    kRexImplError_NotBeingPreviewed = 209,
+    kRexImplError_InvalidTempo = 210,
+
+    kRexError_Undefined = 666
+};
+
+typedef struct RexHandleData* RexHandle;
+
+// Same fields as REXInfo
+struct RexInfo {
+    int fChannels;
+    int fSampleRate;
+    int fSliceCount;
+    int fTempo;             // BPM * 1000
+    int fOriginalTempo;     // BPM * 1000
+    int fPPQLength;
+    int fTimeSignNom;
+    int fTimeSignDenom;
+    int fBitDepth;
+};
+
+// Same fields as REXSliceInfo
+struct RexSliceInfo {
+    int fPPQPos;
+    int fSampleLength;
+};
+
+// Same fields as REXCreatorInfo
+struct RexCreatorInfo {
+    char fName[256];
+    char fCopyright[256];
+    char fURL[256];
+    char fEmail[256];
+    char fFreeText[256];
+};
+
+class RexBackend {
+public:
+    virtual ~RexBackend() {}
+
+    virtual const char* name() const = 0;
+
+    // True when several threads may use the backend at once, each with its
+    // own handles. Batch and index runs isolate the others in processes.
+    virtual bool threadSafe() const = 0;
+
+    // REXInitializeDLL_DirPath / REXUninitializeDLL
+    virtual RexError initialize(const char* sdkPath) = 0;
+    virtual void uninitialize() = 0;
+
+    // REXCreate / REXDelete. The buffer must outlive the handle.
+    virtual RexError create(RexHandle* handle, const char* buffer, int size) = 0;
+    virtual void destroy(RexHandle* handle) = 0;
+
+    virtual RexError getInfo(RexHandle handle, RexInfo* info) = 0;
+    virtual RexError getInfoFromBuffer(const char* buffer, int size, RexInfo* info) = 0;
+    virtual RexError getCreatorInfo(RexHandle handle, RexCreatorInfo* creator) = 0;
+    virtual RexError getSliceInfo(RexHandle handle, int sliceIndex, RexSliceInfo* slice) = 0;
+
+    virtual RexError setOutputSampleRate(RexHandle handle, int sampleRate) = 0;
+    virtual RexError renderSlice(RexHandle handle, int sliceIndex, int bufferFrameLength, float* outputBuffers[2]) = 0;
+
+    virtual RexError startPreview(RexHandle handle) = 0;
+    virtual RexError stopPreview(RexHandle handle) = 0;
+    virtual RexError setPreviewTempo(RexHandle handle, int tempo) = 0;
+    virtual RexError renderPreviewBatch(RexHandle handle, int framesToRender, float* outputBuffers[2]) = 0;
+};
+
+// Backend names accepted by select_rex_backend, separated by "|"
+const char* rex_backend_names();
+
+// "sdk" when it was built in, "synth" otherwise
+const char* default_rex_backend_name();
+
+// Choose the backend before anything is decoded. Returns false for an
+// unknown name or one that was not built in.
+bool select_rex_backend(const std::string& name);
+
+// The selected backend, or the default one when none was selected
+RexBackend& rex_backend();
+
+#endif
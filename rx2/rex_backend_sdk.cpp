@@ -0,0 +1,172 @@
+// rex_backend_sdk.cpp
+//
+// RexBackend on top of the REX Shared Library, loaded through the SDK's
+// REX.c. Built with -DREX_BACKEND_SDK=1 by build_mac.sh and build_win.sh.
+
+#if defined(REX_BACKEND_SDK) && (REX_BACKEND_SDK == 1)
+
+#if defined(_WIN32)
+  #include <windows.h>
+#endif
+
+#include "REX.h"
+#include "platform.h"
+#include "rex_backend.h"
+
+#include <cstring>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+// The SDK and RexError share their values, but map by name so a
+// renumbered SDK cannot silently change what the decoder reports
+RexError from_sdk(REX::REXError err) {
+    switch (err) {
+#define REX_SDK_ERROR(sdkName, ownName) case REX::sdkName: return ownName;
+    REX_SDK_ERROR(kREXError_NoError, kRexError_NoError)
+    REX_SDK_ERROR(kREXError_OperationAbortedByUser, kRexError_OperationAbortedByUser)
+    REX_SDK_ERROR(kREXError_NoCreatorInfoAvailable, kRexError_NoCreatorInfoAvailable)
+    REX_SDK_ERROR(kREXError_NotEnoughMemoryForDLL, kRexError_NotEnoughMemoryForDLL)
+    REX_SDK_ERROR(kREXError_UnableToLoadDLL, kRexError_UnableToLoadDLL)
+    REX_SDK_ERROR(kREXError_DLLTooOld, kRexError_DLLTooOld)
+    REX_SDK_ERROR(kREXError_DLLNotFound, kRexError_DLLNotFound)
+    REX_SDK_ERROR(kREXError_APITooOld, kRexError_APITooOld)
+    REX_SDK_ERROR(kREXError_OutOfMemory, kRexError_OutOfMemory)
+    REX_SDK_ERROR(kREXError_FileCorrupt, kRexError_FileCorrupt)
+    REX_SDK_ERROR(kREXError_REX2FileTooNew, kRexError_REX2FileTooNew)
+    REX_SDK_ERROR(kREXError_FileHasZeroLoopLength, kRexError_FileHasZeroLoopLength)
+    REX_SDK_ERROR(kREXError_OSVersionNotSupported, kRexError_OSVersionNotSupported)
+    REX_SDK_ERROR(kREXImplError_DLLNotInitialized, kRexImplError_DLLNotInitialized)
+    REX_SDK_ERROR(kREXImplError_DLLAlreadyInitialized, kRexImplError_DLLAlreadyInitialized)
+    REX_SDK_ERROR(kREXImplError_InvalidHandle, kRexImplError_InvalidHandle)
+    REX_SDK_ERROR(kREXImplError_InvalidSize, kRexImplError_InvalidSize)
+    REX_SDK_ERROR(kREXImplError_InvalidArgument, kRexImplError_InvalidArgument)
+    REX_SDK_ERROR(kREXImplError_InvalidSlice, kRexImplError_InvalidSlice)
+    REX_SDK_ERROR(kREXImplError_InvalidSampleRate, kRexImplError_InvalidSampleRate)
+    REX_SDK_ERROR(kREXImplError_BufferTooSmall, kRexImplError_BufferTooSmall)
+    REX_SDK_ERROR(kREXImplError_IsBeingPreviewed, kRexImplError_IsBeingPreviewed)
+    REX_SDK_ERROR(kREXImplError_NotBeingPreviewed, kRexImplError_NotBeingPreviewed)
+    REX_SDK_ERROR(kREXImplError_InvalidTempo, kRexImplError_InvalidTempo)
+#undef REX_SDK_ERROR
+    default:
+        return kRexError_Undefined;
+    }
+}
+
+REX::REXHandle sdk_handle(RexHandle handle) {
+    return reinterpret_cast<REX::REXHandle>(handle);
+}
+
+void copy_info(const REX::REXInfo& from, RexInfo* to) {
+    to->fChannels = from.fChannels;
+    to->fSampleRate = from.fSampleRate;
+    to->fSliceCount = from.fSliceCount;
+    to->fTempo = from.fTempo;
+    to->fOriginalTempo = from.fOriginalTempo;
+    to->fPPQLength = from.fPPQLength;
+    to->fTimeSignNom = from.fTimeSignNom;
+    to->fTimeSignDenom = from.fTimeSignDenom;
+    to->fBitDepth = from.fBitDepth;
+}
+
+class SdkRexBackend : public RexBackend {
+public:
+    const char* name() const { return "sdk"; }
+    // The REX library makes no promise about concurrent calls
+    bool threadSafe() const { return false; }
+
+    RexError initialize(const char* sdkPath) {
+#if defined(_WIN32)
+        // REXInitializeDLL_DirPath for Windows expects a wide-character string
+        wstring sdkPathW = ConvertToWide(sdkPath);
+        return from_sdk(REX::REXInitializeDLL_DirPath(sdkPathW.c_str()));
+#else
+        return from_sdk(REX::REXInitializeDLL_DirPath(sdkPath));
+#endif
+    }
+
+    void uninitialize() {
+        REX::REXUninitializeDLL();
+    }
+
+    RexError create(RexHandle* handle, const char* buffer, int size) {
+        REX::REXHandle sdkHandle = nullptr;
+        RexError err = from_sdk(REX::REXCreate(&sdkHandle, buffer, size, nullptr, nullptr));
+        *handle = reinterpret_cast<RexHandle>(sdkHandle);
+        return err;
+    }
+
+    void destroy(RexHandle* handle) {
+        REX::REXHandle sdkHandle = sdk_handle(*handle);
+        REX::REXDelete(&sdkHandle);
+        *handle = nullptr;
+    }
+
+    RexError getInfo(RexHandle handle, RexInfo* info) {
+        REX::REXInfo sdkInfo;
+        RexError err = from_sdk(REX::REXGetInfo(sdk_handle(handle), sizeof(sdkInfo), &sdkInfo));
+        if (err == kRexError_NoError) copy_info(sdkInfo, info);
+        return err;
+    }
+
+    RexError getInfoFromBuffer(const char* buffer, int size, RexInfo* info) {
+        REX::REXInfo sdkInfo;
+        RexError err = from_sdk(REX::REXGetInfoFromBuffer(size, buffer, sizeof(sdkInfo), &sdkInfo));
+        if (err == kRexError_NoError) copy_info(sdkInfo, info);
+        return err;
+    }
+
+    RexError getCreatorInfo(RexHandle handle, RexCreatorInfo* creator) {
+        REX::REXCreatorInfo sdkCreator;
+        RexError err = from_sdk(REX::REXGetCreatorInfo(sdk_handle(handle), sizeof(sdkCreator), &sdkCreator));
+        if (err == kRexError_NoError) {
+            static_assert(sizeof(RexCreatorInfo) == sizeof(REX::REXCreatorInfo), "creator info layout");
+            memcpy(creator, &sdkCreator, sizeof(sdkCreator));
+        }
+        return err;
+    }
+
+    RexError getSliceInfo(RexHandle handle, int sliceIndex, RexSliceInfo* slice) {
+        REX::REXSliceInfo sdkSlice;
+        RexError err = from_sdk(REX::REXGetSliceInfo(sdk_handle(handle), sliceIndex, sizeof(sdkSlice), &sdkSlice));
+        if (err == kRexError_NoError) {
+            slice->fPPQPos = sdkSlice.fPPQPos;
+            slice->fSampleLength = sdkSlice.fSampleLength;
+        }
+        return err;
+    }
+
+    RexError setOutputSampleRate(RexHandle handle, int sampleRate) {
+        return from_sdk(REX::REXSetOutputSampleRate(sdk_handle(handle), sampleRate));
+    }
+
+    RexError renderSlice(RexHandle handle, int sliceIndex, int bufferFrameLength, float* outputBuffers[2]) {
+        return from_sdk(REX::REXRenderSlice(sdk_handle(handle), sliceIndex, bufferFrameLength, outputBuffers));
+    }
+
+    RexError startPreview(RexHandle handle) {
+        return from_sdk(REX::REXStartPreview(sdk_handle(handle)));
+    }
+
+    RexError stopPreview(RexHandle handle) {
+        return from_sdk(REX::REXStopPreview(sdk_handle(handle)));
+    }
+
+    RexError setPreviewTempo(RexHandle handle, int tempo) {
+        return from_sdk(REX::REXSetPreviewTempo(sdk_handle(handle), tempo));
+    }
+
+    RexError renderPreviewBatch(RexHandle handle, int framesToRender, float* outputBuffers[2]) {
+        return from_sdk(REX::REXRenderPreviewBatch(sdk_handle(handle), framesToRender, outputBuffers));
+    }
+};
+
+} // namespace
+
+RexBackend* make_sdk_rex_backend() {
+    return new SdkRexBackend();
+}
+
+#endif
@@ -0,0 +1,417 @@
+// rex_backend_synth.cpp
+//
+// Stand-in REX backend that synthesizes loops instead of decoding them, so
+// the render, conversion and write pipeline can be run and timed on any
+// machine, without the REX Shared Library. Output depends only on the input
+// bytes, so runs are repeatable.
+//
+// An input that starts with "REXSYNTH" describes the loop as key=value
+// pairs separated by whitespace; every key is optional:
+//
+//   REXSYNTH slices=16 bars=2 tempo=120 rate=44100 channels=2 bits=16
+//            sign=4/4 gate=1.0 seed=1 name=Breakbeat
+//
+//   slices    number of slices, evenly spaced over the loop (1..4096)
+//   bars      loop length in bars (1..64)
+//   tempo     original tempo in BPM, decimals allowed (20..450)
+//   rate      sample rate (8000..192000)
+//   channels  1 or 2
+//   bits      bit depth reported in the header (16, 24 or 32)
+//   sign      time signature
+//   gate      slice length as a fraction of the slice spacing (0.05..1)
+//   seed      varies the synthesized sounds
+//   name      creator name; without it there is no creator info
+//
+// Any other input (a real .rx2, for instance) gets its parameters from a
+// hash of its bytes, so a folder of real files can be pushed through the
+// pipeline too.
+//
+// The preview transport runs 64 frames ahead of the loop position, the
+// offset the decoder's PREVIEW_LATENCY_COMPENSATION corrects for, so the
+// written markers land exactly on the synthesized slices.
+
+#include "rex_backend.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const int PPQ_PER_QUARTER = 15360;
+const int PREVIEW_LEAD_FRAMES = 64;
+const double TWO_PI = 6.283185307179586;
+
+struct SynthParams {
+    int slices = 16;
+    int bars = 2;
+    int tempo = 120000;         // BPM * 1000
+    int sampleRate = 44100;
+    int channels = 2;
+    int bitDepth = 16;
+    int timeSignNom = 4;
+    int timeSignDenom = 4;
+    double gate = 1.0;
+    unsigned int seed = 1;
+    string name;
+};
+
+unsigned int fnv1a(const char* data, int size) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool parse_spec(const char* buffer, int size, SynthParams& params) {
+    string text(buffer, size);
+    istringstream in(text);
+    string word;
+    in >> word;
+    while (in >> word) {
+        size_t eq = word.find('=');
+        if (eq == string::npos) {
+            return false;
+        }
+        string key = word.substr(0, eq);
+        string value = word.substr(eq + 1);
+        if (key == "slices") {
+            params.slices = atoi(value.c_str());
+        } else if (key == "bars") {
+            params.bars = atoi(value.c_str());
+        } else if (key == "tempo") {
+            params.tempo = (int)lround(atof(value.c_str()) * 1000.0);
+        } else if (key == "rate") {
+            params.sampleRate = atoi(value.c_str());
+        } else if (key == "channels") {
+            params.channels = atoi(value.c_str());
+        } else if (key == "bits") {
+            params.bitDepth = atoi(value.c_str());
+        } else if (key == "sign") {
+            if (sscanf(value.c_str(), "%d/%d", &params.timeSignNom, &params.timeSignDenom) != 2) {
+                return false;
+            }
+        } else if (key == "gate") {
+            params.gate = atof(value.c_str());
+        } else if (key == "seed") {
+            params.seed = (unsigned int)strtoul(value.c_str(), nullptr, 10);
+        } else if (key == "name") {
+            params.name = value;
+        } else {
+            return false;
+        }
+    }
+    return params.slices >= 1 && params.slices <= 4096 &&
+           params.bars >= 1 && params.bars <= 64 &&
+           params.tempo >= 20000 && params.tempo <= 450000 &&
+           params.sampleRate >= 8000 && params.sampleRate <= 192000 &&
+           (params.channels == 1 || params.channels == 2) &&
+           (params.bitDepth == 16 || params.bitDepth == 24 || params.bitDepth == 32) &&
+           params.timeSignNom >= 1 && params.timeSignNom <= 32 &&
+           (params.timeSignDenom == 2 || params.timeSignDenom == 4 ||
+            params.timeSignDenom == 8 || params.timeSignDenom == 16) &&
+           params.gate >= 0.05 && params.gate <= 1.0;
+}
+
+RexError read_params(const char* buffer, int size, SynthParams& params) {
+    if (buffer == nullptr || size <= 0) {
+        return kRexError_FileCorrupt;
+    }
+    if (size >= 8 && memcmp(buffer, "REXSYNTH", 8) == 0) {
+        return parse_spec(buffer, size, params) ? kRexError_NoError : kRexError_FileCorrupt;
+    }
+    unsigned int hash = fnv1a(buffer, size);
+    params.slices = 4 + (int)(hash % 61);
+    params.bars = 1 + (int)((hash >> 6) % 4);
+    params.tempo = 80000 + (int)((hash >> 8) % 90000);
+    params.channels = 1 + (int)((hash >> 20) & 1);
+    params.seed = hash;
+    return kRexError_NoError;
+}
+
+int loop_ppq_length(const SynthParams& params) {
+    return params.bars * params.timeSignNom * PPQ_PER_QUARTER * 4 / params.timeSignDenom;
+}
+
+// Frames covered by ppq ticks at a tempo (BPM * 1000)
+double ppq_to_frames(double ppq, int sampleRate, int tempo) {
+    return ppq / PPQ_PER_QUARTER * 60000.0 / tempo * sampleRate;
+}
+
+unsigned int next_noise(unsigned int& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+struct Loop {
+    SynthParams params;
+    int outputRate = 0;
+    int ppqLength = 0;
+    vector<int> ppqPos;
+    vector<int> sliceLength;                // Frames at the output rate
+    vector<vector<float> > sliceAudio;      // Planar, channels * sliceLength
+
+    bool previewing = false;
+    int previewTempo = 0;
+    int previewLoopFrames = 0;
+    vector<int> previewStart;
+    int longestSlice = 0;
+    long long previewFrame = 0;
+
+    void layout() {
+        ppqLength = loop_ppq_length(params);
+        ppqPos.resize(params.slices);
+        for (int j = 0; j < params.slices; j++) {
+            ppqPos[j] = (int)((long long)ppqLength * j / params.slices);
+        }
+    }
+
+    // A decaying tone over a short noise burst, different for every slice
+    void synthesize(int sampleRate) {
+        outputRate = sampleRate;
+        sliceLength.assign(params.slices, 0);
+        sliceAudio.assign(params.slices, vector<float>());
+        longestSlice = 0;
+        for (int j = 0; j < params.slices; j++) {
+            int nextPpq = (j + 1 < params.slices) ? ppqPos[j + 1] : ppqLength;
+            double spacing = ppq_to_frames(nextPpq - ppqPos[j], sampleRate, params.tempo);
+            int length = max(1, (int)lround(spacing * params.gate));
+            sliceLength[j] = length;
+            longestSlice = max(longestSlice, length);
+
+            unsigned int noise = (params.seed * 2654435761u + (unsigned int)j * 40503u) | 1u;
+            double frequency = 55.0 * pow(2.0, ((params.seed + j * 7u) % 36) / 12.0);
+            double decay = 0.05 + 0.02 * (((params.seed >> 3) + j * 5u) % 13);
+            double pan = params.channels == 2 ? (((params.seed + j * 3u) % 9) / 8.0) : 0.5;
+            vector<float>& audio = sliceAudio[j];
+            audio.resize((size_t)length * params.channels);
+            for (int k = 0; k < length; k++) {
+                double t = (double)k / sampleRate;
+                double n = (next_noise(noise) / 4294967296.0) * 2.0 - 1.0;
+                double v = 0.6 * exp(-t / decay) * sin(TWO_PI * frequency * t) + 0.3 * n * exp(-t / 0.004);
+                if (params.channels == 2) {
+                    audio[k] = (float)(v * (1.0 - 0.5 * pan));
+                    audio[length + k] = (float)(v * (0.5 + 0.5 * pan));
+                } else {
+                    audio[k] = (float)v;
+                }
+            }
+        }
+    }
+
+    void layoutPreview(int tempo) {
+        previewTempo = tempo;
+        previewLoopFrames = max(1, (int)lround(ppq_to_frames(ppqLength, outputRate, tempo)));
+        previewStart.resize(params.slices);
+        for (int j = 0; j < params.slices; j++) {
+            previewStart[j] = (int)lround((double)ppqPos[j] / ppqLength * previewLoopFrames);
+        }
+    }
+
+    // Mix the slices sounding in [from, to) of one loop pass into out
+    void mixPass(int from, int to, float* outputBuffers[2], int offset) {
+        int first = (int)(lower_bound(previewStart.begin(), previewStart.end(), from - longestSlice) - previewStart.begin());
+        for (int j = first; j < params.slices && previewStart[j] < to; j++) {
+            int start = previewStart[j];
+            int length = min(sliceLength[j], previewLoopFrames - start);
+            int a = max(from, start);
+            int b = min(to, start + length);
+            for (int c = 0; c < params.channels; c++) {
+                float* out = outputBuffers[c] + offset + (a - from);
+                const float* in = sliceAudio[j].data() + (size_t)c * sliceLength[j] + (a - start);
+                for (int f = 0; f < b - a; f++) {
+                    out[f] += in[f];
+                }
+            }
+        }
+    }
+
+    void renderPreview(int frames, float* outputBuffers[2]) {
+        for (int c = 0; c < params.channels; c++) {
+            memset(outputBuffers[c], 0, sizeof(float) * frames);
+        }
+        int done = 0;
+        while (done < frames) {
+            long long looped = previewFrame + done + PREVIEW_LEAD_FRAMES;
+            int from = (int)(looped % previewLoopFrames);
+            int to = min(previewLoopFrames, from + (frames - done));
+            mixPass(from, to, outputBuffers, done);
+            done += to - from;
+        }
+        previewFrame += frames;
+    }
+};
+
+Loop* as_loop(RexHandle handle) {
+    return reinterpret_cast<Loop*>(handle);
+}
+
+void fill_info(const Loop& loop, RexInfo* info) {
+    info->fChannels = loop.params.channels;
+    info->fSampleRate = loop.outputRate;
+    info->fSliceCount = loop.params.slices;
+    info->fTempo = loop.params.tempo;
+    info->fOriginalTempo = loop.params.tempo;
+    info->fPPQLength = loop.ppqLength;
+    info->fTimeSignNom = loop.params.timeSignNom;
+    info->fTimeSignDenom = loop.params.timeSignDenom;
+    info->fBitDepth = loop.params.bitDepth;
+}
+
+void copy_field(char (&field)[256], const string& value) {
+    snprintf(field, sizeof(field), "%s", value.c_str());
+}
+
+class SynthRexBackend : public RexBackend {
+public:
+    const char* name() const { return "synth"; }
+    bool threadSafe() const { return true; }
+
+    RexError initialize(const char*) {
+        if (initialized) return kRexImplError_DLLAlreadyInitialized;
+        initialized = true;
+        return kRexError_NoError;
+    }
+
+    void uninitialize() {
+        initialized = false;
+    }
+
+    RexError create(RexHandle* handle, const char* buffer, int size) {
+        *handle = nullptr;
+        if (!initialized) return kRexImplError_DLLNotInitialized;
+        Loop* loop = new Loop();
+        RexError err = read_params(buffer, size, loop->params);
+        if (err != kRexError_NoError) {
+            delete loop;
+            return err;
+        }
+        loop->layout();
+        loop->synthesize(loop->params.sampleRate);
+        *handle = reinterpret_cast<RexHandle>(loop);
+        return kRexError_NoError;
+    }
+
+    void destroy(RexHandle* handle) {
+        delete as_loop(*handle);
+        *handle = nullptr;
+    }
+
+    RexError getInfo(RexHandle handle, RexInfo* info) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        fill_info(*as_loop(handle), info);
+        return kRexError_NoError;
+    }
+
+    RexError getInfoFromBuffer(const char* buffer, int size, RexInfo* info) {
+        if (!initialized) return kRexImplError_DLLNotInitialized;
+        Loop loop;
+        RexError err = read_params(buffer, size, loop.params);
+        if (err != kRexError_NoError) return err;
+        loop.layout();
+        loop.outputRate = loop.params.sampleRate;
+        fill_info(loop, info);
+        return kRexError_NoError;
+    }
+
+    RexError getCreatorInfo(RexHandle handle, RexCreatorInfo* creator) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        const SynthParams& params = as_loop(handle)->params;
+        if (params.name.empty()) return kRexError_NoCreatorInfoAvailable;
+        copy_field(creator->fName, params.name);
+        copy_field(creator->fCopyright, "");
+        copy_field(creator->fURL, "");
+        copy_field(creator->fEmail, "");
+        copy_field(creator->fFreeText, "Synthesized stand-in loop");
+        return kRexError_NoError;
+    }
+
+    RexError getSliceInfo(RexHandle handle, int sliceIndex, RexSliceInfo* slice) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        Loop* loop = as_loop(handle);
+        if (sliceIndex < 0 || sliceIndex >= loop->params.slices) return kRexImplError_InvalidSlice;
+        slice->fPPQPos = loop->ppqPos[sliceIndex];
+        slice->fSampleLength = loop->sliceLength[sliceIndex];
+        return kRexError_NoError;
+    }
+
+    RexError setOutputSampleRate(RexHandle handle, int sampleRate) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        Loop* loop = as_loop(handle);
+        if (loop->previewing) return kRexImplError_IsBeingPreviewed;
+        if (sampleRate < 8000 || sampleRate > 192000) return kRexImplError_InvalidSampleRate;
+        if (sampleRate != loop->outputRate) loop->synthesize(sampleRate);
+        return kRexError_NoError;
+    }
+
+    RexError renderSlice(RexHandle handle, int sliceIndex, int bufferFrameLength, float* outputBuffers[2]) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        Loop* loop = as_loop(handle);
+        if (sliceIndex < 0 || sliceIndex >= loop->params.slices) return kRexImplError_InvalidSlice;
+        int length = loop->sliceLength[sliceIndex];
+        if (bufferFrameLength < length) return kRexImplError_BufferTooSmall;
+        for (int c = 0; c < loop->params.channels; c++) {
+            if (!outputBuffers[c]) return kRexImplError_InvalidArgument;
+            memcpy(outputBuffers[c], loop->sliceAudio[sliceIndex].data() + (size_t)c * length, sizeof(float) * length);
+            memset(outputBuffers[c] + length, 0, sizeof(float) * (bufferFrameLength - length));
+        }
+        return kRexError_NoError;
+    }
+
+    RexError startPreview(RexHandle handle) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        Loop* loop = as_loop(handle);
+        if (loop->previewing) return kRexImplError_IsBeingPreviewed;
+        if (loop->previewTempo == 0) loop->layoutPreview(loop->params.tempo);
+        loop->previewing = true;
+        loop->previewFrame = 0;
+        return kRexError_NoError;
+    }
+
+    RexError stopPreview(RexHandle handle) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        Loop* loop = as_loop(handle);
+        if (!loop->previewing) return kRexImplError_NotBeingPreviewed;
+        loop->previewing = false;
+        return kRexError_NoError;
+    }
+
+    RexError setPreviewTempo(RexHandle handle, int tempo) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        if (tempo < 20000 || tempo > 450000) return kRexImplError_InvalidTempo;
+        as_loop(handle)->layoutPreview(tempo);
+        return kRexError_NoError;
+    }
+
+    RexError renderPreviewBatch(RexHandle handle, int framesToRender, float* outputBuffers[2]) {
+        if (!handle) return kRexImplError_InvalidHandle;
+        Loop* loop = as_loop(handle);
+        if (!loop->previewing) return kRexImplError_NotBeingPreviewed;
+        if (framesToRender <= 0) return kRexImplError_InvalidArgument;
+        for (int c = 0; c < loop->params.channels; c++) {
+            if (!outputBuffers[c]) return kRexImplError_InvalidArgument;
+        }
+        loop->renderPreview(framesToRender, outputBuffers);
+        return kRexError_NoError;
+    }
+
+private:
+    bool initialized = false;
+};
+
+} // namespace
+
+RexBackend* make_synth_rex_backend() {
+    return new SynthRexBackend();
+}
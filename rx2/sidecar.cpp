@@ -0,0 +1,127 @@
+// sidecar.cpp
+//
+// Writers for the slice metadata sidecar. See sidecar.h for the layout.
+
+#include "sidecar.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+using namespace std;
+
+bool is_binary_sidecar_path(const string& path) {
+    const char* ext = ".rx2meta";
+    size_t len = strlen(ext);
+    if (path.size() < len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        char c = path[path.size() - len + i];
+        if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+        if (c != ext[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------
+// Chunk building
+// ---------------------------------------------------------------------
+static void append_u32(string& out, unsigned int v) {
+    out += (char)(v & 0xFF);
+    out += (char)((v >> 8) & 0xFF);
+    out += (char)((v >> 16) & 0xFF);
+    out += (char)((v >> 24) & 0xFF);
+}
+
+static void append_i32(string& out, int v) {
+    append_u32(out, (unsigned int)v);
+}
+
+static void append_string(string& out, const string& s) {
+    append_u32(out, (unsigned int)s.size());
+    out += s;
+}
+
+static void append_chunk(string& out, const char id[4], const string& payload) {
+    out.append(id, 4);
+    append_u32(out, (unsigned int)payload.size());
+    out += payload;
+}
+
+static string build_binary_sidecar(const Sidecar& sidecar) {
+    string out = "PKRX";
+    append_u32(out, SIDECAR_VERSION);
+
+    const SidecarHeader& h = sidecar.header;
+    string info;
+    append_i32(info, h.channels);
+    append_i32(info, h.sampleRate);
+    append_i32(info, h.sliceCount);
+    append_i32(info, h.tempo);
+    append_i32(info, h.originalTempo);
+    append_i32(info, h.ppqLength);
+    append_i32(info, h.timeSignNom);
+    append_i32(info, h.timeSignDenom);
+    append_i32(info, h.bitDepth);
+    append_i32(info, h.renderedFrames);
+    append_i32(info, h.outputBits);
+    append_i32(info, h.renderMode);
+    append_i32(info, h.markerOffset);
+    append_chunk(out, "INFO", info);
+
+    if (sidecar.hasCreator) {
+        string creator;
+        append_string(creator, sidecar.creator.name);
+        append_string(creator, sidecar.creator.copyright);
+        append_string(creator, sidecar.creator.url);
+        append_string(creator, sidecar.creator.email);
+        append_string(creator, sidecar.creator.freeText);
+        append_chunk(out, "CRTR", creator);
+    }
+
+    const unsigned int recordBytes = 8 * 4;
+    string slices;
+    append_u32(slices, (unsigned int)sidecar.slices.size());
+    append_u32(slices, recordBytes);
+    for (size_t i = 0; i < sidecar.slices.size(); i++) {
+        const SidecarSlice& s = sidecar.slices[i];
+        append_i32(slices, s.ppqPos);
+        append_i32(slices, s.sampleLength);
+        append_i32(slices, s.startFrame);
+        append_i32(slices, s.lengthFrames);
+        append_i32(slices, s.marker);
+        append_i32(slices, s.peakLevel);
+        append_i32(slices, s.rmsLevel);
+        append_i32(slices, s.onsetFrame);
+    }
+    append_chunk(out, "SLCE", slices);
+    return out;
+}
+
+static string build_marker_script(const Sidecar& sidecar) {
+    string out;
+    char line[96];
+    for (size_t i = 0; i < sidecar.slices.size(); i++) {
+        snprintf(line, sizeof(line), "renoise.song().selected_sample:insert_slice_marker(%d)\n", sidecar.slices[i].marker);
+        out += line;
+    }
+    return out;
+}
+
+string sidecar_bytes(const Sidecar& sidecar, bool binary) {
+    return binary ? build_binary_sidecar(sidecar) : build_marker_script(sidecar);
+}
+
+bool write_sidecar(const string& path, const Sidecar& sidecar, bool binary) {
+    string bytes = sidecar_bytes(sidecar, binary);
+    ofstream file(path.c_str(), binary ? ios::binary : ios::out);
+    if (!file) {
+        return false;
+    }
+    file.write(bytes.data(), bytes.size());
+    file.close();
+    return !file.fail();
+}
@@ -0,0 +1,93 @@
+// sidecar.h
+//
+// Slice and header metadata written next to the decoded WAV.
+//
+// Two formats are supported, chosen by the output file name:
+//
+//   *.rx2meta   binary sidecar with everything the decoder knows
+//   other       one renoise.song().selected_sample:insert_slice_marker(N)
+//               line per slice (the original .txt output)
+//
+// Binary layout, all integers little-endian:
+//
+//   "PKRX"  u32 version
+//   then chunks: 4-byte id, u32 payload size, payload
+//
+//   "INFO"  i32 channels, sampleRate, sliceCount, tempo, originalTempo,
+//           ppqLength, timeSignNom, timeSignDenom, bitDepth,
+//           renderedFrames, outputBits, renderMode (0 preview, 1 slices),
+//           markerOffset
+//   "CRTR"  5 strings (u32 length + bytes): name, copyright, url, email,
+//           free text. Only present when the file has creator info.
+//   "SLCE"  u32 count, u32 recordBytes, then count records of i32
+//           ppqPos, sampleLength, startFrame, lengthFrames, marker,
+//           peakLevel, rmsLevel, onsetFrame
+//
+// Levels are in hundredths of a dB relative to full scale, -14400 for
+// silence (see slice_analysis.h).
+//
+// Readers skip chunks they do not know and ignore record bytes past the
+// fields they understand, so fields can be appended without a new version.
+
+#ifndef SIDECAR_H
+#define SIDECAR_H
+
+#include <string>
+#include <vector>
+
+const unsigned int SIDECAR_VERSION = 1;
+
+struct SidecarHeader {
+    int channels = 0;
+    int sampleRate = 0;
+    int sliceCount = 0;
+    int tempo = 0;              // BPM * 1000, the tempo the loop was rendered at
+    int originalTempo = 0;      // BPM * 1000
+    int ppqLength = 0;
+    int timeSignNom = 0;
+    int timeSignDenom = 0;
+    int bitDepth = 0;
+    int renderedFrames = 0;     // Length of the output WAV
+    int outputBits = 0;         // 16, 24 or 32 (float)
+    int renderMode = 0;         // 0 preview, 1 slices
+    int markerOffset = 0;       // Frames the preview markers were shifted by, calibrated or fixed
+};
+
+struct SidecarCreator {
+    std::string name;
+    std::string copyright;
+    std::string url;
+    std::string email;
+    std::string freeText;
+};
+
+// Where one slice ended up in the output WAV
+struct SidecarSlice {
+    int ppqPos = 0;             // REXSliceInfo.fPPQPos
+    int sampleLength = 0;       // REXSliceInfo.fSampleLength
+    int startFrame = 0;         // First frame in the WAV, 0-based
+    int lengthFrames = 0;       // Frames up to the next slice or the loop end
+    int marker = 0;             // Renoise slice marker, 1-based
+    int peakLevel = -14400;     // Hundredths of a dBFS over the slice's frames
+    int rmsLevel = -14400;
+    int onsetFrame = -1;        // Transient near the slice start, 0-based; -1 if none was found
+};
+
+struct Sidecar {
+    SidecarHeader header;
+    bool hasCreator = false;
+    SidecarCreator creator;
+    std::vector<SidecarSlice> slices;
+};
+
+// True when path names a binary sidecar (.rx2meta)
+bool is_binary_sidecar_path(const std::string& path);
+
+// The bytes write_sidecar would write, binary sidecar or marker script
+std::string sidecar_bytes(const Sidecar& sidecar, bool binary);
+
+// Write the binary sidecar or the marker script. Callers normally pass
+// is_binary_sidecar_path() of the name the user asked for.
+bool write_sidecar(const std::string& path, const Sidecar& sidecar, bool binary);
+
+#endif
@@ -0,0 +1,288 @@
+// slice_analysis.cpp
+//
+// Streaming slice analysis behind slice_analysis.h. The level kernels
+// have an SSE2 version on x86, where SSE2 is always available, and a
+// scalar one elsewhere.
+
+#include "slice_analysis.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+  #define SLICE_ANALYSIS_SSE2 1
+  #include <emmintrin.h>
+#else
+  #define SLICE_ANALYSIS_SSE2 0
+#endif
+
+using namespace std;
+
+namespace {
+
+// Mean high-frequency energy per frame below which audio counts as silence
+const double ONSET_ENERGY_FLOOR = 1e-6;
+
+// How much more high-frequency energy the frames after an onset need than those before
+const double ONSET_MIN_RISE = 4.0;
+
+// calibrate() needs onsets in at least this many slices, and a quarter of them
+const int CALIBRATION_MIN_ONSETS = 2;
+
+// One frame of frame_levels, with the frame before it given
+inline void frame_level(float l, float r, float lastL, float lastR, bool stereo, float* peak, float* energy, float* flux) {
+    float dl = l - lastL;
+    *peak = fabsf(l);
+    *energy = l * l;
+    *flux = dl * dl;
+    if (stereo) {
+        float dr = r - lastR;
+        *peak = max(*peak, fabsf(r));
+        *energy += r * r;
+        *flux += dr * dr;
+    }
+}
+
+// Per frame: the largest magnitude over the channels, the sum of squares
+// and the sum of squared differences to the frame before; last holds the
+// frame before the first
+void frame_levels(const float* left, const float* right, int frames, const float last[2],
+                  float* peak, float* energy, float* flux) {
+    if (frames <= 0) {
+        return;
+    }
+    bool stereo = right != nullptr;
+    frame_level(left[0], stereo ? right[0] : 0.0f, last[0], last[1], stereo, peak, energy, flux);
+    int i = 1;
+#if SLICE_ANALYSIS_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 dl = _mm_sub_ps(l, _mm_loadu_ps(left + i - 1));
+        __m128 p = _mm_and_ps(l, absMask);
+        __m128 e = _mm_mul_ps(l, l);
+        __m128 f = _mm_mul_ps(dl, dl);
+        if (stereo) {
+            __m128 r = _mm_loadu_ps(right + i);
+            __m128 dr = _mm_sub_ps(r, _mm_loadu_ps(right + i - 1));
+            p = _mm_max_ps(p, _mm_and_ps(r, absMask));
+            e = _mm_add_ps(e, _mm_mul_ps(r, r));
+            f = _mm_add_ps(f, _mm_mul_ps(dr, dr));
+        }
+        _mm_storeu_ps(peak + i, p);
+        _mm_storeu_ps(energy + i, e);
+        _mm_storeu_ps(flux + i, f);
+    }
+#endif
+    for (; i < frames; i++) {
+        frame_level(left[i], stereo ? right[i] : 0.0f, left[i - 1], stereo ? right[i - 1] : 0.0f, stereo,
+                    peak + i, energy + i, flux + i);
+    }
+}
+
+// The same levels folded into a running peak and energy sum
+void accumulate_levels(const float* left, const float* right, int frames, float& peak, double& energy) {
+    int i = 0;
+    float p = peak;
+    double e = 0;
+#if SLICE_ANALYSIS_SSE2
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    __m128 peakSum = _mm_setzero_ps();
+    __m128 energySum = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        peakSum = _mm_max_ps(peakSum, _mm_and_ps(l, absMask));
+        energySum = _mm_add_ps(energySum, _mm_mul_ps(l, l));
+        if (right != nullptr) {
+            __m128 r = _mm_loadu_ps(right + i);
+            peakSum = _mm_max_ps(peakSum, _mm_and_ps(r, absMask));
+            energySum = _mm_add_ps(energySum, _mm_mul_ps(r, r));
+        }
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, peakSum);
+    p = max(max(p, lanes[0]), max(lanes[1], max(lanes[2], lanes[3])));
+    _mm_storeu_ps(lanes, energySum);
+    e = (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+    for (; i < frames; i++) {
+        float l = left[i];
+        p = max(p, fabsf(l));
+        e += l * l;
+        if (right != nullptr) {
+            float r = right[i];
+            p = max(p, fabsf(r));
+            e += r * r;
+        }
+    }
+    peak = p;
+    energy += e;
+}
+
+// Hundredths of a dB relative to full scale
+int level_from_linear(double linear) {
+    if (!(linear > 0)) {
+        return SILENT_LEVEL;
+    }
+    return (int)max((double)SILENT_LEVEL, round(2000.0 * log10(linear)));
+}
+
+} // namespace
+
+SliceAnalyzer::SliceAnalyzer(int channelCount, int lengthFrames, const vector<int>& slicePositions)
+    : channels(channelCount), length(max(0, lengthFrames)), positions(slicePositions) {
+    onsets.assign(positions.size(), -1);
+    order.resize(positions.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int)i;
+    }
+    stable_sort(order.begin(), order.end(), [this](int a, int b) { return positions[a] < positions[b]; });
+
+    // Search windows, merged where they overlap, with the stretches between them
+    int end = 0;
+    for (size_t k = 0; k < order.size(); k++) {
+        int p = positions[order[k]];
+        int from = max(0, p - ONSET_SEARCH_FRAMES);
+        int to = min(length, p + ONSET_SEARCH_FRAMES);
+        if (from >= to) continue;
+        if (!regions.empty() && regions.back().window && from <= regions.back().end) {
+            regions.back().end = max(regions.back().end, to);
+        } else {
+            if (from > end) {
+                Region between = {end, from, false, 0, 0.0f, 0.0};
+                regions.push_back(between);
+            }
+            Region window = {from, to, true, 0, 0.0f, 0.0};
+            regions.push_back(window);
+        }
+        end = regions.back().end;
+    }
+    if (end < length) {
+        Region between = {end, length, false, 0, 0.0f, 0.0};
+        regions.push_back(between);
+    }
+    size_t windowFrames = 0;
+    for (size_t r = 0; r < regions.size(); r++) {
+        if (!regions[r].window) continue;
+        regions[r].base = windowFrames;
+        windowFrames += regions[r].end - regions[r].start;
+    }
+    peaks.assign(windowFrames, 0.0f);
+    energies.assign(windowFrames, 0.0f);
+    flux.assign(windowFrames, 0.0f);
+}
+
+void SliceAnalyzer::process(const float* const planes[2], int frames) {
+    int done = 0;
+    while (done < frames && current < regions.size()) {
+        Region& region = regions[current];
+        int todo = min(frames - done, region.end - cursor);
+        const float* left = planes[0] + done;
+        const float* right = channels == 2 ? planes[1] + done : nullptr;
+        if (region.window) {
+            size_t at = region.base + (cursor - region.start);
+            frame_levels(left, right, todo, previous, &peaks[at], &energies[at], &flux[at]);
+        } else {
+            accumulate_levels(left, right, todo, region.peak, region.energy);
+        }
+        if (todo > 0) {
+            previous[0] = left[todo - 1];
+            previous[1] = right != nullptr ? right[todo - 1] : 0.0f;
+        }
+        cursor += todo;
+        done += todo;
+        if (cursor == region.end) {
+            if (region.window) {
+                findOnsets(region);
+            }
+            current++;
+        }
+    }
+}
+
+// Locate the onset of every slice whose search window is this region,
+// while its frames are still in cache
+void SliceAnalyzer::findOnsets(const Region& region) {
+    const int context = ONSET_CONTEXT_FRAMES;
+    const int history = ONSET_HISTORY_FRAMES;
+    vector<double> sums;
+    for (; nextOnset < order.size(); nextOnset++) {
+        int slice = order[nextOnset];
+        int p = positions[slice];
+        if (p - ONSET_SEARCH_FRAMES >= region.end) break;
+        int from = max(region.start, p - ONSET_SEARCH_FRAMES);
+        int to = min(region.end, p + ONSET_SEARCH_FRAMES);
+        if (to - from < history + context) continue;
+
+        // Running sums over the window, so every candidate costs the same
+        const float* energy = &flux[region.base + (from - region.start)];
+        sums.assign(to - from + 1, 0.0);
+        for (int i = 0; i < to - from; i++) {
+            sums[i + 1] = sums[i] + energy[i];
+        }
+        double bestRise = 0;
+        int best = -1;
+        for (int n = history; n <= to - from - context; n++) {
+            double before = (sums[n] - sums[n - history]) / history;
+            double after = (sums[n + context] - sums[n]) / context;
+            double rise = after / (before + ONSET_ENERGY_FLOOR);
+            if (rise > bestRise) {
+                bestRise = rise;
+                best = n;
+            }
+        }
+        if (best >= 0 && bestRise >= ONSET_MIN_RISE) {
+            onsets[slice] = from + best;
+        }
+    }
+}
+
+int SliceAnalyzer::onsetCount() const {
+    int count = 0;
+    for (size_t i = 0; i < onsets.size(); i++) {
+        if (onsets[i] >= 0) count++;
+    }
+    return count;
+}
+
+bool SliceAnalyzer::calibrate(int& offset) const {
+    vector<int> distances;
+    for (size_t i = 0; i < onsets.size(); i++) {
+        if (onsets[i] >= 0) {
+            distances.push_back(onsets[i] - positions[i]);
+        }
+    }
+    size_t searched = cursor >= length ? positions.size() : nextOnset;
+    int needed = max(CALIBRATION_MIN_ONSETS, (int)(searched + 3) / 4);
+    if ((int)distances.size() < needed) {
+        return false;
+    }
+    nth_element(distances.begin(), distances.begin() + distances.size() / 2, distances.end());
+    offset = distances[distances.size() / 2];
+    return true;
+}
+
+void SliceAnalyzer::measure(int start, int end, int& peakLevel, int& rmsLevel) const {
+    start = max(0, start);
+    end = min(min(end, length), cursor);
+    float peak = 0;
+    double energy = 0;
+    for (size_t r = 0; r < regions.size() && start < end; r++) {
+        const Region& region = regions[r];
+        if (region.end <= start || region.start >= end) continue;
+        if (region.window) {
+            size_t from = region.base + (max(start, region.start) - region.start);
+            size_t to = region.base + (min(end, region.end) - region.start);
+            for (size_t i = from; i < to; i++) {
+                peak = max(peak, peaks[i]);
+                energy += energies[i];
+            }
+        } else if (region.start >= start) {
+            // Boundaries lie in windows, so a stretch is either in or out
+            peak = max(peak, region.peak);
+            energy += region.energy;
+        }
+    }
+    peakLevel = level_from_linear(peak);
+    rmsLevel = end > start ? level_from_linear(sqrt(energy / ((double)(end - start) * channels))) : SILENT_LEVEL;
+}
@@ -0,0 +1,97 @@
+// slice_analysis.h
+//
+// Per-slice peak, RMS and onset measured while the loop renders, so the
+// importer needs no normalization or transient-finding pass of its own.
+//
+// The analyzer is fed every rendered block before it goes to the writer.
+// Around each slice's expected start it keeps the per-frame peak, energy
+// and high-frequency energy (of the first difference) of
+// ONSET_SEARCH_FRAMES frames either side; everything in between is folded
+// into one running peak and energy sum per stretch. Once a search window
+// has been rendered its onset is located straight away: the frame where
+// the mean high-frequency energy of the next ONSET_CONTEXT_FRAMES frames
+// rises furthest above that of the ONSET_HISTORY_FRAMES before it. Plain
+// energy would rise and fall with every cycle of a bass note; its first
+// difference stays low until a transient arrives.
+//
+// Slice boundaries may move anywhere inside their search windows after
+// the render, which is what lets the preview's marker offset be taken
+// from the onsets it found: calibrate() returns the median distance from
+// expected start to onset. Peak and RMS are then measured exactly over
+// the final boundaries.
+//
+// Levels are in hundredths of a dB relative to full scale, the scale the
+// sidecar stores them in.
+
+#ifndef SLICE_ANALYSIS_H
+#define SLICE_ANALYSIS_H
+
+#include <cstddef>
+#include <vector>
+
+// Bumped when the analysis changes what ends up in the sidecar
+const int SLICE_ANALYSIS_VERSION = 1;
+
+// Frames searched for an onset either side of a slice's expected start
+const int ONSET_SEARCH_FRAMES = 512;
+
+// Frames compared after and before a candidate onset
+const int ONSET_CONTEXT_FRAMES = 32;
+const int ONSET_HISTORY_FRAMES = 128;
+
+// Level of silence, -144 dBFS
+const int SILENT_LEVEL = -14400;
+
+class SliceAnalyzer {
+public:
+    // positions holds the frame each slice is expected to start at, in
+    // slice order; lengthFrames is the length of the render. Slices
+    // expected outside the render get no search window and no onset.
+    SliceAnalyzer(int channelCount, int lengthFrames, const std::vector<int>& positions);
+
+    // The next frames of the render, planar
+    void process(const float* const planes[2], int frames);
+
+    // The onset found near positions[slice], or -1 when there was none
+    int onset(int slice) const { return onsets[slice]; }
+    int onsetCount() const;
+
+    // Median distance from expected start to onset. False when too few
+    // slices had an onset to tell. Before the render is complete only the
+    // slices whose search windows have been rendered count.
+    bool calibrate(int& offset) const;
+
+    // Peak and RMS level of frames [start, end). Both ends must lie inside
+    // a search window or at the ends of the render.
+    void measure(int start, int end, int& peakLevel, int& rmsLevel) const;
+
+private:
+    // A stretch of the render: either a search window, kept frame by
+    // frame, or the frames between two windows, kept as a sum
+    struct Region {
+        int start;
+        int end;
+        bool window;
+        size_t base;            // Window: index of its first frame in peaks and energies
+        float peak;             // Between windows: running peak and energy
+        double energy;
+    };
+
+    void findOnsets(const Region& region);
+
+    int channels;
+    int length;
+    std::vector<int> positions;
+    std::vector<int> order;     // Slice indices by expected start
+    std::vector<int> onsets;
+    std::vector<Region> regions;
+    std::vector<float> peaks;   // Per window frame: largest magnitude over the channels
+    std::vector<float> energies;// Per window frame: sum of squares over the channels
+    std::vector<float> flux;    // Per window frame: sum of squared differences to the frame before
+    float previous[2] = {0.0f, 0.0f};  // Last frame processed
+    size_t current = 0;         // Region the next frame falls in
+    int cursor = 0;             // Next frame
+    size_t nextOnset = 0;       // Into order: first slice whose window is still to come
+};
+
+#endif
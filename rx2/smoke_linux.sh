@@ -0,0 +1,13 @@
+#!/bin/bash
+# Decode one synthesized loop with the Linux build (see build_linux.sh).
+#
+# Usage: ./smoke_linux.sh [decoder]   (default: ./rex2decoder_linux)
+#
+# The loop and the decoder's outputs go to a fresh temp folder, which is
+# removed afterwards; the exit status is the decoder's.
+set -e
+DECODER="$(cd "$(dirname "${1:-./rex2decoder_linux}")" && pwd)/$(basename "${1:-./rex2decoder_linux}")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+printf 'REXSYNTH slices=16 bars=2 tempo=120 name=Synth\n' > "$WORK/synth.rx2"
+"$DECODER" "$WORK/synth.rx2" "$WORK/synth.wav" "$WORK/synth.txt" -
@@ -0,0 +1,212 @@
+// trace.cpp
+//
+// Span and counter collection behind trace.h.
+
+#include "trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct Span {
+    const char* name;
+    string detail;
+    long long startUs;
+    long long durationUs;
+    int thread;
+};
+
+struct Counter {
+    const char* name;
+    long long value;
+    long long timeUs;
+    int thread;
+};
+
+atomic<bool> gEnabled(false);
+mutex gLock;
+chrono::steady_clock::time_point gOrigin = chrono::steady_clock::now();
+vector<Span> gSpans;
+vector<Counter> gCounters;
+vector<thread::id> gThreads;
+
+long long since_origin_us(chrono::steady_clock::time_point t) {
+    return chrono::duration_cast<chrono::microseconds>(t - gOrigin).count();
+}
+
+// Small stable thread numbers for the trace viewer. Called with gLock held.
+int thread_number() {
+    thread::id self = this_thread::get_id();
+    for (size_t i = 0; i < gThreads.size(); i++) {
+        if (gThreads[i] == self) return (int)i + 1;
+    }
+    gThreads.push_back(self);
+    return (int)gThreads.size();
+}
+
+void write_json_string(ostream& out, const string& text) {
+    out << '"';
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            out << '\\' << (char)c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << (char)c;
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+bool parse_log_level(const string& text, LogLevel& level) {
+    if (text == "quiet") {
+        level = kLogQuiet;
+    } else if (text == "info") {
+        level = kLogInfo;
+    } else if (text == "debug") {
+        level = kLogDebug;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void trace_enable() {
+    gEnabled = true;
+}
+
+bool trace_enabled() {
+    return gEnabled;
+}
+
+void trace_add_span(const char* name, chrono::steady_clock::time_point start,
+                    chrono::steady_clock::time_point end, const string& detail) {
+    Span span;
+    span.name = name;
+    span.detail = detail;
+    span.startUs = since_origin_us(start);
+    span.durationUs = chrono::duration_cast<chrono::microseconds>(end - start).count();
+    lock_guard<mutex> guard(gLock);
+    span.thread = thread_number();
+    gSpans.push_back(span);
+}
+
+void trace_add_counter(const char* name, long long value) {
+    if (!gEnabled) {
+        return;
+    }
+    Counter counter;
+    counter.name = name;
+    counter.value = value;
+    counter.timeUs = since_origin_us(chrono::steady_clock::now());
+    lock_guard<mutex> guard(gLock);
+    counter.thread = thread_number();
+    gCounters.push_back(counter);
+}
+
+void trace_write_summary(ostream& out) {
+    lock_guard<mutex> guard(gLock);
+    vector<const char*> names;
+    vector<long long> calls, totalUs, maxUs;
+    for (size_t i = 0; i < gSpans.size(); i++) {
+        const Span& span = gSpans[i];
+        size_t k = 0;
+        while (k < names.size() && string(names[k]) != span.name) k++;
+        if (k == names.size()) {
+            names.push_back(span.name);
+            calls.push_back(0);
+            totalUs.push_back(0);
+            maxUs.push_back(0);
+        }
+        calls[k]++;
+        totalUs[k] += span.durationUs;
+        if (span.durationUs > maxUs[k]) maxUs[k] = span.durationUs;
+    }
+    out << fixed << setprecision(3);
+    for (size_t k = 0; k < names.size(); k++) {
+        out << "TIMING\t" << names[k] << '\t' << calls[k] << '\t'
+            << totalUs[k] / 1000.0 << '\t' << maxUs[k] / 1000.0 << '\n';
+    }
+
+    vector<const char*> counterNames;
+    vector<long long> counterMax;
+    for (size_t i = 0; i < gCounters.size(); i++) {
+        size_t k = 0;
+        while (k < counterNames.size() && string(counterNames[k]) != gCounters[i].name) k++;
+        if (k == counterNames.size()) {
+            counterNames.push_back(gCounters[i].name);
+            counterMax.push_back(gCounters[i].value);
+        } else if (gCounters[i].value > counterMax[k]) {
+            counterMax[k] = gCounters[i].value;
+        }
+    }
+    for (size_t k = 0; k < counterNames.size(); k++) {
+        out << "TIMING\t" << counterNames[k] << '\t' << counterMax[k] << '\n';
+    }
+    out.flush();
+}
+
+bool trace_write_chrome(const string& path) {
+    ofstream out(path.c_str());
+    if (!out) {
+        return false;
+    }
+    lock_guard<mutex> guard(gLock);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (size_t i = 0; i < gSpans.size(); i++) {
+        const Span& span = gSpans[i];
+        out << (first ? "" : ",\n") << "{\"name\":";
+        write_json_string(out, span.name);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+            << ",\"ts\":" << span.startUs << ",\"dur\":" << span.durationUs;
+        if (!span.detail.empty()) {
+            out << ",\"args\":{\"detail\":";
+            write_json_string(out, span.detail);
+            out << "}";
+        }
+        out << "}";
+        first = false;
+    }
+    for (size_t i = 0; i < gCounters.size(); i++) {
+        const Counter& counter = gCounters[i];
+        out << (first ? "" : ",\n") << "{\"name\":";
+        write_json_string(out, counter.name);
+        out << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << counter.thread << ",\"ts\":" << counter.timeUs
+            << ",\"args\":{\"value\":" << counter.value << "}}";
+        first = false;
+    }
+    out << "\n]}\n";
+    out.close();
+    return !out.fail();
+}
+
+TraceSpan::TraceSpan(const char* spanName, const string& spanDetail)
+    : name(spanName), active(gEnabled) {
+    if (active) {
+        detail = spanDetail;
+        start = chrono::steady_clock::now();
+    }
+}
+
+void TraceSpan::end() {
+    if (!active) {
+        return;
+    }
+    active = false;
+    trace_add_span(name, start, chrono::steady_clock::now(), detail);
+}
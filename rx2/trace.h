@@ -0,0 +1,61 @@
+// trace.h
+//
+// Log levels and per-phase timing for the decoder.
+//
+// Phases are timed with TraceSpan, a scoped monotonic timer. Nothing is
+// measured unless tracing was enabled before decoding started, so the
+// spans cost a branch when it is off. Collected spans can be printed as a
+// tab-separated summary (one TIMING line per phase) or written as a Chrome
+// trace JSON file for chrome://tracing or Perfetto.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+
+enum LogLevel {
+    kLogQuiet = 0,   // Errors only
+    kLogInfo = 1,    // Header, creator and slice summary
+    kLogDebug = 2    // Bundle diagnostics and the full length/slice analysis
+};
+
+// Parse quiet|info|debug; returns false for anything else
+bool parse_log_level(const std::string& text, LogLevel& level);
+
+// Turn span collection on. Call before any decoding thread starts.
+void trace_enable();
+bool trace_enabled();
+
+// Record a finished span or a counter value (e.g. peak memory)
+void trace_add_span(const char* name, std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end, const std::string& detail);
+void trace_add_counter(const char* name, long long value);
+
+// One "TIMING <TAB> phase <TAB> calls <TAB> total_ms <TAB> max_ms" line per
+// phase in first-seen order, then one "TIMING <TAB> name <TAB> max" line per
+// counter
+void trace_write_summary(std::ostream& out);
+
+// Write everything recorded so far as Chrome trace event JSON
+bool trace_write_chrome(const std::string& path);
+
+// Times one phase from construction until end() or destruction
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* spanName, const std::string& spanDetail = std::string());
+    ~TraceSpan() { end(); }
+    void end();
+
+private:
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+    const char* name;
+    std::string detail;
+    bool active;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
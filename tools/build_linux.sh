@@ -0,0 +1,4 @@
+# Native import tools for Linux. Renoise runs these directly, without wine.
+g++ -O2 itdecompress.cpp it_compression.cpp mapped_file.cpp wav_file.cpp -o itdecompress_linux
+g++ -O2 sf2extract.cpp sf2_file.cpp mapped_file.cpp wav_file.cpp -o sf2extract_linux -lpthread
+g++ -O2 iffconvert.cpp iff_file.cpp sample_convert.cpp mapped_file.cpp wav_file.cpp -o iffconvert_linux -lpthread
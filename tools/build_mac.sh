@@ -0,0 +1,3 @@
+clang++ -O2 -std=c++11 itdecompress.cpp it_compression.cpp mapped_file.cpp wav_file.cpp -o itdecompress_mac
+clang++ -O2 -std=c++11 sf2extract.cpp sf2_file.cpp mapped_file.cpp wav_file.cpp -o sf2extract_mac
+clang++ -O2 -std=c++11 iffconvert.cpp iff_file.cpp sample_convert.cpp mapped_file.cpp wav_file.cpp -o iffconvert_mac
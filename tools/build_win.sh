@@ -0,0 +1,6 @@
+x86_64-w64-mingw32-g++ -O2 -static itdecompress.cpp it_compression.cpp mapped_file.cpp wav_file.cpp -o itdecompress_win.exe \
+  -static-libstdc++ -static-libgcc
+x86_64-w64-mingw32-g++ -O2 -static sf2extract.cpp sf2_file.cpp mapped_file.cpp wav_file.cpp -o sf2extract_win.exe \
+  -static-libstdc++ -static-libgcc
+x86_64-w64-mingw32-g++ -O2 -static iffconvert.cpp iff_file.cpp sample_convert.cpp mapped_file.cpp wav_file.cpp \
+  -o iffconvert_win.exe -static-libstdc++ -static-libgcc
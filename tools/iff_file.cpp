@@ -0,0 +1,300 @@
+// iff_file.cpp
+//
+// IFF, AIFF and WAV sample I/O behind iff_file.h.
+
+#include "iff_file.h"
+#include "sample_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+uint16_t read_be16(const unsigned char* p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+uint32_t read_be32(const unsigned char* p) {
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint16_t read_le16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t read_le32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void put_be16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+void put_be32(unsigned char* p, unsigned int v) {
+    put_be16(p, v >> 16);
+    put_be16(p + 2, v & 0xFFFF);
+}
+
+struct Chunk {
+    char id[4];
+    const unsigned char* data;
+    size_t size;
+};
+
+// Chunks from pos to the end of the buffer, padded to even sizes. Like
+// the Lua readers, a chunk running past the end is cut short.
+void read_chunks(const unsigned char* data, size_t size, size_t pos, bool bigEndian, vector<Chunk>& chunks) {
+    while (pos + 8 <= size) {
+        Chunk chunk;
+        memcpy(chunk.id, data + pos, 4);
+        chunk.size = bigEndian ? read_be32(data + pos + 4) : read_le32(data + pos + 4);
+        chunk.data = data + pos + 8;
+        if (chunk.size > size - pos - 8) {
+            chunk.size = size - pos - 8;
+        }
+        chunks.push_back(chunk);
+        pos += 8 + chunk.size + (chunk.size & 1);
+    }
+}
+
+bool is_id(const Chunk& chunk, const char* id) {
+    return memcmp(chunk.id, id, 4) == 0;
+}
+
+// Sample data in a file's byte order into pcm.samples
+void load_samples(const unsigned char* data, size_t bytes, int bits, bool bigEndian, bool isUnsigned, MonoPcm& pcm) {
+    pcm.bits = bits;
+    if (bits == 8) {
+        pcm.samples.resize(bytes);
+        widen_8bit(data, pcm.samples.data(), bytes, isUnsigned);
+    } else {
+        pcm.samples.resize(bytes / 2);
+        if (bigEndian) {
+            swap16(data, pcm.samples.data(), bytes / 2);
+        } else if (bytes > 0) {
+            // Every platform the tools are built for is little-endian
+            memcpy(pcm.samples.data(), data, bytes & ~(size_t)1);
+        }
+    }
+}
+
+// Fibonacci-delta 8SVX BODY: a pad byte, the initial value, then two
+// 4-bit delta codes per byte, high nibble first
+void fibonacci_decode(const unsigned char* body, size_t size, MonoPcm& pcm) {
+    static const int8_t codeToDelta[16] = { -34, -21, -13, -8, -5, -3, -2, -1, 0, 1, 2, 3, 5, 8, 13, 21 };
+    pcm.bits = 8;
+    pcm.samples.clear();
+    if (size < 2) {
+        return;
+    }
+    pcm.samples.resize((size - 2) * 2);
+    int8_t x = (int8_t)body[1];
+    for (size_t i = 2; i < size; i++) {
+        x = (int8_t)(x + codeToDelta[body[i] >> 4]);
+        pcm.samples[(i - 2) * 2] = x;
+        x = (int8_t)(x + codeToDelta[body[i] & 0x0F]);
+        pcm.samples[(i - 2) * 2 + 1] = x;
+    }
+}
+
+string bit_depth_error(int bits) {
+    return "Unsupported bit depth: " + to_string(bits) + " (only 8 and 16-bit supported)";
+}
+
+} // namespace
+
+bool read_iff(const unsigned char* data, size_t size, MonoPcm& pcm, string& error) {
+    pcm = MonoPcm();
+    if (size < 4 || memcmp(data, "FORM", 4) != 0) {
+        // Raw signed 8-bit PCM at 16574 Hz
+        if (size == 0) {
+            error = "Empty file in raw fallback";
+            return false;
+        }
+        pcm.sampleRate = 16574;
+        load_samples(data, size, 8, true, false, pcm);
+        return true;
+    }
+    string formType = size >= 12 ? string(reinterpret_cast<const char*>(data + 8), 4) : string();
+    if (formType != "8SVX" && formType != "16SV") {
+        error = "Unsupported IFF type: " + (formType.empty() ? string("nil") : formType);
+        return false;
+    }
+
+    vector<Chunk> chunks;
+    read_chunks(data, size, 12, true, chunks);
+    const Chunk* body = nullptr;
+    bool haveRate = false;
+    int compression = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (is_id(chunks[i], "VHDR") && chunks[i].size >= 14) {
+            pcm.sampleRate = read_be16(chunks[i].data + 12);
+            compression = chunks[i].size >= 16 ? chunks[i].data[15] : 0;
+            haveRate = true;
+        } else if (is_id(chunks[i], "BODY")) {
+            body = &chunks[i];
+        }
+    }
+    if (!haveRate || body == nullptr) {
+        error = "Missing VHDR or BODY chunk in IFF";
+        return false;
+    }
+
+    if (formType == "8SVX") {
+        if (compression == 1) {
+            fibonacci_decode(body->data, body->size, pcm);
+        } else if (compression == 0) {
+            load_samples(body->data, body->size, 8, true, false, pcm);
+        } else {
+            error = "Unsupported 8SVX compression: " + to_string(compression);
+            return false;
+        }
+    } else {
+        if (body->size % 2 != 0) {
+            error = "Odd byte count in 16SV body";
+            return false;
+        }
+        load_samples(body->data, body->size, 16, true, false, pcm);
+    }
+    return true;
+}
+
+bool read_wav(const unsigned char* data, size_t size, MonoPcm& pcm, string& error) {
+    pcm = MonoPcm();
+    if (size < 4 || memcmp(data, "RIFF", 4) != 0) {
+        error = "Not a valid WAV file (missing RIFF header)";
+        return false;
+    }
+    if (size < 12 || memcmp(data + 8, "WAVE", 4) != 0) {
+        error = "Not a valid WAV file (missing WAVE header)";
+        return false;
+    }
+    vector<Chunk> chunks;
+    read_chunks(data, size, 12, false, chunks);
+    const Chunk* pcmData = nullptr;
+    int channels = 0;
+    int bits = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (is_id(chunks[i], "fmt ") && chunks[i].size >= 16) {
+            if (read_le16(chunks[i].data) != 1) {
+                error = "Unsupported WAV format (not PCM)";
+                return false;
+            }
+            channels = read_le16(chunks[i].data + 2);
+            pcm.sampleRate = (int)read_le32(chunks[i].data + 4);
+            bits = read_le16(chunks[i].data + 14);
+        } else if (is_id(chunks[i], "data")) {
+            pcmData = &chunks[i];
+        }
+    }
+    if (bits == 0 || pcmData == nullptr) {
+        error = "Missing required WAV chunks";
+        return false;
+    }
+    if (channels != 1) {
+        error = "Only mono WAV files are supported for IFF conversion";
+        return false;
+    }
+    if (bits != 8 && bits != 16) {
+        error = bit_depth_error(bits);
+        return false;
+    }
+    if (bits == 16 && pcmData->size % 2 != 0) {
+        error = "Odd byte count in 16-bit WAV data";
+        return false;
+    }
+    // 8-bit WAV is unsigned
+    load_samples(pcmData->data, pcmData->size, bits, false, true, pcm);
+    return true;
+}
+
+bool read_aiff(const unsigned char* data, size_t size, MonoPcm& pcm, string& error) {
+    pcm = MonoPcm();
+    if (size < 4 || memcmp(data, "FORM", 4) != 0) {
+        error = "Not a valid AIFF file (missing FORM header)";
+        return false;
+    }
+    if (size < 12 || (memcmp(data + 8, "AIFF", 4) != 0 && memcmp(data + 8, "AIFC", 4) != 0)) {
+        error = "Not a valid AIFF file (missing AIFF/AIFC header)";
+        return false;
+    }
+    vector<Chunk> chunks;
+    read_chunks(data, size, 12, true, chunks);
+    const unsigned char* sound = nullptr;
+    size_t soundBytes = 0;
+    int channels = 0;
+    int bits = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const Chunk& chunk = chunks[i];
+        if (is_id(chunk, "COMM") && chunk.size >= 18) {
+            channels = read_be16(chunk.data);
+            bits = read_be16(chunk.data + 6);
+            // 80-bit extended sample rate, from the sign/exponent word and
+            // the top 32 bits of the mantissa as the Lua reader does
+            int exponent = read_be16(chunk.data + 8);
+            uint32_t mantissa = read_be32(chunk.data + 10);
+            pcm.sampleRate = exponent > 0 ? (int)floor(ldexp((double)mantissa, exponent - 16414)) : 44100;
+        } else if (is_id(chunk, "SSND") && chunk.size >= 8) {
+            size_t offset = read_be32(chunk.data);
+            sound = chunk.data + 8 + min(offset, chunk.size - 8);
+            soundBytes = chunk.size - 8 - min(offset, chunk.size - 8);
+        }
+    }
+    if (bits == 0 || sound == nullptr) {
+        error = "Missing required AIFF chunks";
+        return false;
+    }
+    if (channels != 1) {
+        error = "Only mono AIFF files are supported for IFF conversion";
+        return false;
+    }
+    if (bits != 8 && bits != 16) {
+        error = bit_depth_error(bits);
+        return false;
+    }
+    if (bits == 16 && soundBytes % 2 != 0) {
+        error = "Odd byte count in 16-bit AIFF data";
+        return false;
+    }
+    // AIFF samples are signed at both depths
+    load_samples(sound, soundBytes, bits, true, false, pcm);
+    return true;
+}
+
+bool write_iff_file(const string& path, const int16_t* samples, size_t count, int sampleRate, int bits) {
+    const size_t bodyBytes = bits == 16 ? count * 2 : count;
+    vector<unsigned char> file(48 + bodyBytes + (bodyBytes & 1), 0);
+    unsigned char* p = file.data();
+    memcpy(p, "FORM", 4);
+    put_be32(p + 4, (unsigned int)(file.size() - 8));
+    memcpy(p + 8, bits == 16 ? "16SV" : "8SVX", 4);
+    memcpy(p + 12, "VHDR", 4);
+    put_be32(p + 16, 20);
+    put_be32(p + 20, (unsigned int)count);     // oneShotHiSamples
+    // repeatHiSamples and samplesPerHiCycle stay 0
+    put_be16(p + 32, sampleRate);
+    p[34] = 1;                                  // ctOctave
+    p[35] = 0;                                  // sCompression
+    put_be32(p + 36, 65536);                    // Volume, fixed point 1.0
+    memcpy(p + 40, "BODY", 4);
+    put_be32(p + 44, (unsigned int)bodyBytes);
+    if (bits == 16) {
+        swap16(samples, p + 48, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            p[48 + i] = (unsigned char)samples[i];
+        }
+    }
+
+    FILE* out = fopen(path.c_str(), "wb");
+    if (out == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(file.data(), 1, file.size(), out) == file.size();
+    return fclose(out) == 0 && ok;
+}
@@ -0,0 +1,39 @@
+// iff_file.h
+//
+// Reading and writing the sample formats importers/PakettiIFFLoader.lua
+// converts between: Amiga IFF (8SVX, optionally Fibonacci-delta packed,
+// and 16SV), AIFF and PCM WAV. The readers work on a buffer, normally a
+// memory-mapped file, and accept exactly what the Lua readers accept,
+// failing with the same messages.
+
+#ifndef IFF_FILE_H
+#define IFF_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Mono samples at their stored width: -128..127 for 8-bit, full range
+// for 16-bit
+struct MonoPcm {
+    int sampleRate = 0;
+    int bits = 8;
+    std::vector<int16_t> samples;
+};
+
+// 8SVX or 16SV. Data without a FORM header is taken as raw signed 8-bit
+// samples at 16574 Hz, like the Lua reader does.
+bool read_iff(const unsigned char* data, size_t size, MonoPcm& pcm, std::string& error);
+
+// 8 or 16-bit mono PCM WAV
+bool read_wav(const unsigned char* data, size_t size, MonoPcm& pcm, std::string& error);
+
+// 8 or 16-bit mono AIFF or uncompressed AIFC
+bool read_aiff(const unsigned char* data, size_t size, MonoPcm& pcm, std::string& error);
+
+// Write samples (8 or 16-bit values, see MonoPcm) as an 8SVX or 16SV file
+// with the VHDR the Lua writer produces. Returns false on any I/O error.
+bool write_iff_file(const std::string& path, const int16_t* samples, size_t count, int sampleRate, int bits);
+
+#endif
@@ -0,0 +1,211 @@
+// iffconvert.cpp
+//
+// Batch conversion between Amiga IFF samples and WAV/AIFF for the batch
+// commands in importers/PakettiIFFLoader.lua, which are far too slow in
+// Lua for sample archives of thousands of files.
+//
+//   iffconvert wav|8svx|16sv|iff list_file [--jobs N]
+//
+// list_file holds one input path per line. Each input is converted next to
+// itself, its extension replaced by the target format's:
+//   wav    8SVX (plain or Fibonacci-delta) and 16SV to 16-bit WAV at the
+//          file's own rate; files without a FORM header are raw 8-bit
+//   8svx   WAV and AIFF (by extension) to 8-bit 8SVX at 28604 Hz
+//   16sv   the same, to 16-bit 16SV
+//   iff    as 8svx, with the .iff extension
+// IFF targets are resampled linearly and cut to 65534 frames when longer
+// than 65535, as the Lua converter does, and produce the same samples.
+//
+// Files are memory-mapped and converted by N worker threads (default: one
+// per core). The manifest goes to stdout as files finish, one line each:
+// "OK\t<line>\t<output>\t<frames>" or "ERR\t<line>\t<reason>", where line
+// is the input's 1-based line in list_file, then "DONE\t<ok>\t<failed>".
+
+#include "iff_file.h"
+#include "mapped_file.h"
+#include "sample_convert.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// The rate the Lua converter gives every IFF it writes (A-3, finetune +4)
+const int IFF_TARGET_RATE = 28604;
+const size_t IFF_MAX_FRAMES = 65535;
+const size_t IFF_TRUNCATED_FRAMES = 65534;
+
+static string lower(const string& text) {
+    string out = text;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] >= 'A' && out[i] <= 'Z') out[i] = (char)(out[i] - 'A' + 'a');
+    }
+    return out;
+}
+
+// Same as the Lua change_extension: everything after the last dot
+static string change_extension(const string& path, const string& extension) {
+    size_t dot = path.rfind('.');
+    return (dot == string::npos ? path : path.substr(0, dot)) + "." + extension;
+}
+
+static bool ends_with(const string& text, const string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Linear resampling exactly as the Lua resample_buffer does it, stopping
+// after maxFrames
+static void resample(const vector<double>& in, int fromRate, int toRate, size_t maxFrames, vector<double>& out) {
+    const size_t n = in.size();
+    const double ratio = (double)fromRate / toRate;
+    size_t length = (size_t)floor(n / ratio);
+    out.resize(min(length, maxFrames));
+    for (size_t i = 0; i < out.size(); i++) {
+        double pos = i * ratio + 1;
+        double index = floor(pos);
+        double frac = pos - index;
+        if (index >= n) {
+            out[i] = in[n - 1];
+        } else if (index < 1) {
+            out[i] = in[0];
+        } else {
+            size_t k = (size_t)index;
+            double a = in[k - 1];
+            double b = in[min(k + 1, n) - 1];
+            out[i] = a + frac * (b - a);
+        }
+    }
+}
+
+static bool to_wav(const MonoPcm& pcm, const string& outputPath, size_t& frames, string& error) {
+    vector<int16_t> out(pcm.samples.size());
+    rescale_to_16bit(pcm.samples.data(), out.data(), out.size(), pcm.bits);
+    WavFormat format;
+    format.sampleRate = pcm.sampleRate;
+    format.bits = 16;
+    if (!write_wav_file(outputPath, format, out.data(), out.size() * 2)) {
+        error = "cannot write " + outputPath;
+        return false;
+    }
+    frames = out.size();
+    return true;
+}
+
+static bool to_iff(const MonoPcm& pcm, int bits, const string& outputPath, size_t& frames, string& error) {
+    if (pcm.sampleRate <= 0) {
+        error = "Invalid sample rate: " + to_string(pcm.sampleRate);
+        return false;
+    }
+    vector<double> normalised(pcm.samples.size());
+    to_double(pcm.samples.data(), normalised.data(), normalised.size(), pcm.bits);
+    vector<double> resampled;
+    const vector<double>* source = &normalised;
+    if (pcm.sampleRate != IFF_TARGET_RATE) {
+        resample(normalised, pcm.sampleRate, IFF_TARGET_RATE, IFF_MAX_FRAMES + 1, resampled);
+        source = &resampled;
+    }
+    size_t count = source->size() > IFF_MAX_FRAMES ? IFF_TRUNCATED_FRAMES : source->size();
+    vector<int16_t> out(count);
+    quantize(source->data(), out.data(), count, bits);
+    if (!write_iff_file(outputPath, out.data(), count, IFF_TARGET_RATE, bits)) {
+        error = "cannot write " + outputPath;
+        return false;
+    }
+    frames = count;
+    return true;
+}
+
+static bool convert(const string& inputPath, const string& target, string& outputPath, size_t& frames,
+                    string& error) {
+    MappedFile input;
+    if (!input.open(inputPath)) {
+        error = "Could not open file: " + inputPath;
+        return false;
+    }
+    outputPath = change_extension(inputPath, target);
+    MonoPcm pcm;
+    if (target == "wav") {
+        return read_iff(input.data(), input.size(), pcm, error) && to_wav(pcm, outputPath, frames, error);
+    }
+    bool ok = ends_with(lower(inputPath), ".wav") ? read_wav(input.data(), input.size(), pcm, error)
+                                                  : read_aiff(input.data(), input.size(), pcm, error);
+    return ok && to_iff(pcm, target == "16sv" ? 16 : 8, outputPath, frames, error);
+}
+
+static void print_usage(const char* program) {
+    cerr << "Usage: " << program << " wav|8svx|16sv|iff list_file [--jobs N]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && !(argc == 5 && strcmp(argv[3], "--jobs") == 0)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const string target = argv[1];
+    if (target != "wav" && target != "8svx" && target != "16sv" && target != "iff") {
+        print_usage(argv[0]);
+        return 1;
+    }
+    int jobs = argc == 5 ? atoi(argv[4]) : (int)thread::hardware_concurrency();
+    jobs = max(1, jobs);
+
+    ifstream list(argv[2], ios::binary);
+    if (!list) {
+        cerr << "Cannot read " << argv[2] << endl;
+        return 1;
+    }
+    vector<string> inputs;
+    string line;
+    while (getline(list, line)) {
+        if (!line.empty() && line[line.size() - 1] == '\r') line.erase(line.size() - 1);
+        inputs.push_back(line);
+    }
+
+    atomic<size_t> next(0);
+    atomic<int> succeeded(0);
+    mutex outputLock;
+    vector<thread> workers;
+    int workerCount = (int)min<size_t>(jobs, max<size_t>(1, inputs.size()));
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&]() {
+            size_t i;
+            while ((i = next++) < inputs.size()) {
+                if (inputs[i].empty()) {
+                    continue;
+                }
+                string outputPath;
+                string error;
+                size_t frames = 0;
+                bool ok = convert(inputs[i], target, outputPath, frames, error);
+                if (ok) succeeded++;
+                // One whole line at a time, flushed so the caller sees progress
+                lock_guard<mutex> lock(outputLock);
+                if (ok) {
+                    cout << "OK\t" << i + 1 << "\t" << outputPath << "\t" << frames << endl;
+                } else {
+                    cout << "ERR\t" << i + 1 << "\t" << error << endl;
+                }
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    int total = 0;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (!inputs[i].empty()) total++;
+    }
+    cout << "DONE\t" << succeeded << "\t" << total - succeeded << endl;
+    return succeeded == total ? 0 : 1;
+}
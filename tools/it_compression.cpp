@@ -0,0 +1,265 @@
+// it_compression.cpp
+//
+// IT214/IT215 decompression and sample header parsing. See
+// it_compression.h for the format.
+
+#include "it_compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const size_t ITI_SAMPLE_HEADERS_OFFSET = 554;
+const size_t IT_SAMPLE_HEADER_SIZE = 80;
+
+uint16_t read_u16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t read_u32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool parse_sample_header(const unsigned char* data, size_t size, size_t offset, ItSample& sample) {
+    if (offset > size || size - offset < IT_SAMPLE_HEADER_SIZE || memcmp(data + offset, "IMPS", 4) != 0) {
+        return false;
+    }
+    const unsigned char* h = data + offset;
+    sample.headerOffset = offset;
+    sample.flags = h[0x12];
+    const char* name = reinterpret_cast<const char*>(h + 0x14);
+    sample.name.assign(name, strnlen(name, 26));
+    sample.convert = h[0x2E];
+    sample.length = read_u32(h + 0x30);
+    sample.c5Speed = read_u32(h + 0x3C);
+    sample.dataOffset = read_u32(h + 0x48);
+    return true;
+}
+
+// LSB-first bit reader over one compressed block
+class BitReader {
+public:
+    BitReader(const unsigned char* data, size_t size) : pos(data), end(data + size) {}
+
+    // Returns false when the block runs out
+    bool read(int width, uint32_t& value) {
+        if (count < width) {
+            while (count <= 56 && pos != end) {
+                bits |= (uint64_t)*pos++ << count;
+                count += 8;
+            }
+            if (count < width) {
+                return false;
+            }
+        }
+        value = (uint32_t)(bits & ((1ULL << width) - 1));
+        bits >>= width;
+        count -= width;
+        return true;
+    }
+
+private:
+    const unsigned char* pos;
+    const unsigned char* end;
+    uint64_t bits = 0;
+    int count = 0;
+};
+
+// Shared by both sample sizes: T is int8_t or int16_t, BLOCK_FRAMES the
+// samples per block, SAMPLE_BITS the bits of T and WIDTH_BITS the size of
+// the new width field after a narrow-width escape (3 for 8-bit samples, 4
+// for 16-bit). Blocks start at width SAMPLE_BITS + 1; width changes are
+// signalled three ways depending on the current width:
+//   1-6 bits           the value 1 << (width - 1), then WIDTH_BITS bits of
+//                      new width
+//   7..SAMPLE_BITS     a value in (border, border + SAMPLE_BITS], where
+//                      border sits just below the largest positive value
+//   SAMPLE_BITS + 1    the top bit set, low byte + 1 is the new width
+// A new width never equals the current one, so the encoded values skip it.
+template <typename T, size_t BLOCK_FRAMES, int SAMPLE_BITS, int WIDTH_BITS>
+bool decompress(const unsigned char* src, size_t size, T* dest, size_t frames, int stride,
+                bool it215, size_t& consumed) {
+    const int fullWidth = SAMPLE_BITS + 1;
+    const uint32_t sampleMask = (1u << SAMPLE_BITS) - 1;
+    size_t pos = 0;
+    consumed = 0;
+    while (frames > 0) {
+        if (size - pos < 2) {
+            return false;
+        }
+        size_t blockBytes = read_u16(src + pos);
+        pos += 2;
+        if (size - pos < blockBytes) {
+            return false;
+        }
+        BitReader reader(src + pos, blockBytes);
+        pos += blockBytes;
+        consumed = pos;
+
+        size_t blockFrames = min(frames, BLOCK_FRAMES);
+        int width = fullWidth;
+        T d1 = 0;
+        T d2 = 0;
+        for (size_t done = 0; done < blockFrames;) {
+            uint32_t value;
+            if (!reader.read(width, value)) {
+                return false;
+            }
+            if (width < 7) {
+                if (value == (1u << (width - 1))) {
+                    if (!reader.read(WIDTH_BITS, value)) {
+                        return false;
+                    }
+                    int newWidth = (int)value + 1;
+                    width = newWidth < width ? newWidth : newWidth + 1;
+                    continue;
+                }
+            } else if (width < fullWidth) {
+                uint32_t border = (sampleMask >> (fullWidth - width)) - SAMPLE_BITS / 2;
+                if (value > border && value <= border + SAMPLE_BITS) {
+                    int newWidth = (int)(value - border);
+                    width = newWidth < width ? newWidth : newWidth + 1;
+                    continue;
+                }
+            } else if (value & (1u << SAMPLE_BITS)) {
+                width = (int)((value + 1) & 0xFF);
+                if (width < 1 || width > fullWidth) {
+                    return false;
+                }
+                continue;
+            }
+
+            T delta;
+            if (width < SAMPLE_BITS) {
+                int shift = 32 - width;
+                delta = (T)((int32_t)(value << shift) >> shift);
+            } else {
+                delta = (T)(value & sampleMask);
+            }
+            d1 = (T)(d1 + delta);
+            d2 = (T)(d2 + d1);
+            *dest = it215 ? d2 : d1;
+            dest += stride;
+            done++;
+        }
+        frames -= blockFrames;
+    }
+    return true;
+}
+
+} // namespace
+
+bool find_it_samples(const unsigned char* data, size_t size, vector<ItSample>& samples) {
+    samples.clear();
+    if (size < 4) {
+        return false;
+    }
+    vector<size_t> offsets;
+    if (memcmp(data, "IMPI", 4) == 0) {
+        if (size < ITI_SAMPLE_HEADERS_OFFSET) {
+            return false;
+        }
+        int count = data[0x1E];
+        for (int i = 0; i < count; i++) {
+            offsets.push_back(ITI_SAMPLE_HEADERS_OFFSET + i * IT_SAMPLE_HEADER_SIZE);
+        }
+    } else if (memcmp(data, "IMPM", 4) == 0) {
+        if (size < 0xC0) {
+            return false;
+        }
+        size_t orders = read_u16(data + 0x20);
+        size_t instruments = read_u16(data + 0x22);
+        size_t count = read_u16(data + 0x24);
+        size_t table = 0xC0 + orders + instruments * 4;
+        for (size_t i = 0; i < count && table + i * 4 + 4 <= size; i++) {
+            offsets.push_back(read_u32(data + table + i * 4));
+        }
+    } else {
+        return false;
+    }
+    for (size_t i = 0; i < offsets.size(); i++) {
+        ItSample sample;
+        if (parse_sample_header(data, size, offsets[i], sample)) {
+            samples.push_back(sample);
+        }
+    }
+    return true;
+}
+
+bool it_decompress8(const unsigned char* src, size_t size, int8_t* dest, size_t frames, int stride,
+                    bool it215, size_t& consumed) {
+    return decompress<int8_t, 0x8000, 8, 3>(src, size, dest, frames, stride, it215, consumed);
+}
+
+bool it_decompress16(const unsigned char* src, size_t size, int16_t* dest, size_t frames, int stride,
+                     bool it215, size_t& consumed) {
+    return decompress<int16_t, 0x4000, 16, 4>(src, size, dest, frames, stride, it215, consumed);
+}
+
+bool it_decode_sample(const unsigned char* data, size_t size, const ItSample& sample, vector<char>& pcm,
+                      size_t* sourceBytes) {
+    const size_t frames = sample.length;
+    const int channels = sample.channels();
+    const size_t bytesPerSample = sample.bits() / 8;
+    if (!sample.hasData() || sample.dataOffset >= size) {
+        return false;
+    }
+    const unsigned char* src = data + sample.dataOffset;
+    size_t remaining = size - sample.dataOffset;
+
+    // Check the length from the header against the data before allocating
+    // for it: compressed samples take at least a bit each, uncompressed
+    // ones exactly their size
+    const size_t channelBytes = frames * bytesPerSample;
+    if (sample.compressed() ? frames > remaining * 8 / channels : remaining / channels < channelBytes) {
+        return false;
+    }
+    pcm.assign(frames * channels * bytesPerSample, 0);
+
+    if (sample.compressed()) {
+        // Each channel is compressed on its own, left first
+        for (int c = 0; c < channels; c++) {
+            size_t consumed = 0;
+            bool ok;
+            if (bytesPerSample == 1) {
+                ok = it_decompress8(src, remaining, reinterpret_cast<int8_t*>(&pcm[0]) + c, frames, channels,
+                                    sample.it215(), consumed);
+            } else {
+                // int16_t stores are little-endian on every platform we build for
+                ok = it_decompress16(src, remaining, reinterpret_cast<int16_t*>(&pcm[0]) + c, frames, channels,
+                                     sample.it215(), consumed);
+            }
+            if (!ok) {
+                return false;
+            }
+            src += consumed;
+            remaining -= consumed;
+        }
+        if (sourceBytes != nullptr) {
+            *sourceBytes = size - sample.dataOffset - remaining;
+        }
+        return true;
+    }
+
+    // Uncompressed stereo is also stored one channel after the other
+    const unsigned char flip = (sample.convert & IT_CONVERT_SIGNED) ? 0 : 0x80;
+    for (int c = 0; c < channels; c++) {
+        const unsigned char* in = src + c * channelBytes;
+        for (size_t i = 0; i < frames; i++) {
+            char* out = &pcm[(i * channels + c) * bytesPerSample];
+            if (bytesPerSample == 1) {
+                out[0] = (char)(in[i] ^ flip);
+            } else {
+                out[0] = (char)in[i * 2];
+                out[1] = (char)(in[i * 2 + 1] ^ flip);
+            }
+        }
+    }
+    if (sourceBytes != nullptr) {
+        *sourceBytes = channels * channelBytes;
+    }
+    return true;
+}
@@ -0,0 +1,66 @@
+// it_compression.h
+//
+// Impulse Tracker sample decompression (IT214 and IT215) and the sample
+// header walk for .iti instruments and .it modules.
+//
+// Compressed sample data is a series of blocks, each a u16 byte count
+// followed by that many bytes of LSB-first bit-packed deltas. A block
+// holds up to 0x8000 samples (8-bit) or 0x4000 samples (16-bit) and
+// restarts the bit width and the integrators. Stereo samples store the
+// whole left channel, then the whole right channel. IT215 (header convert
+// flag 4) integrates twice instead of once.
+
+#ifndef IT_COMPRESSION_H
+#define IT_COMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Sample header flags
+const int IT_SAMPLE_ASSOCIATED = 1;
+const int IT_SAMPLE_16BIT = 2;
+const int IT_SAMPLE_STEREO = 4;
+const int IT_SAMPLE_COMPRESSED = 8;
+
+// Sample header convert flags
+const int IT_CONVERT_SIGNED = 1;
+const int IT_CONVERT_DELTA = 4;     // IT215 when the sample is compressed
+
+struct ItSample {
+    size_t headerOffset = 0;        // Byte offset of "IMPS" in the file
+    std::string name;
+    int flags = 0;
+    int convert = 0;
+    uint32_t length = 0;            // Frames
+    uint32_t c5Speed = 0;
+    uint32_t dataOffset = 0;
+
+    int channels() const { return (flags & IT_SAMPLE_STEREO) ? 2 : 1; }
+    int bits() const { return (flags & IT_SAMPLE_16BIT) ? 16 : 8; }
+    bool compressed() const { return (flags & IT_SAMPLE_COMPRESSED) != 0; }
+    bool it215() const { return (convert & IT_CONVERT_DELTA) != 0; }
+    bool hasData() const { return (flags & IT_SAMPLE_ASSOCIATED) && length > 0 && dataOffset > 0; }
+};
+
+// Sample headers of an .iti ("IMPI") or .it ("IMPM") file. Returns false
+// if data is neither; headers that do not fit the file are skipped.
+bool find_it_samples(const unsigned char* data, size_t size, std::vector<ItSample>& samples);
+
+// Decompress frames samples of one channel from src into dest, writing
+// every stride-th element. consumed receives the compressed bytes used,
+// so the next channel starts at src + consumed. Returns false on
+// truncated or corrupt data; dest then holds what was decoded so far.
+bool it_decompress8(const unsigned char* src, size_t size, int8_t* dest, size_t frames, int stride,
+                    bool it215, size_t& consumed);
+bool it_decompress16(const unsigned char* src, size_t size, int16_t* dest, size_t frames, int stride,
+                     bool it215, size_t& consumed);
+
+// Decode a whole sample, compressed or not, to interleaved signed PCM:
+// int8_t per sample for 8-bit samples, little-endian int16_t for 16-bit.
+// sourceBytes, when given, receives the bytes of sample data read.
+bool it_decode_sample(const unsigned char* data, size_t size, const ItSample& sample, std::vector<char>& pcm,
+                      size_t* sourceBytes = nullptr);
+
+#endif
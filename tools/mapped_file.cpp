@@ -0,0 +1,99 @@
+// mapped_file.cpp
+//
+// MappedFile for POSIX systems and Windows.
+
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+using namespace std;
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const string& path) {
+    close();
+    int wideLength = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, NULL, 0);
+    wstring widePath(wideLength > 0 ? wideLength : 1, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &widePath[0], wideLength);
+    HANDLE file = CreateFileW(widePath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL) {
+            mapped = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            if (mapped != nullptr) {
+                mappedSize = static_cast<size_t>(fileSize.QuadPart);
+                CloseHandle(file);
+                return true;
+            }
+            CloseHandle(mapping);
+            mapping = NULL;
+        }
+    }
+    // Not mappable: read it in.
+    unsigned char chunk[65536];
+    DWORD got = 0;
+    BOOL readOk;
+    while ((readOk = ReadFile(file, chunk, sizeof(chunk), &got, NULL)) && got > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + got);
+    }
+    CloseHandle(file);
+    return readOk != FALSE;
+}
+
+void MappedFile::close() {
+    if (mapped != nullptr) UnmapViewOfFile(mapped);
+    if (mapping != NULL) CloseHandle(mapping);
+    mapped = nullptr;
+    mapping = NULL;
+    mappedSize = 0;
+    vector<unsigned char>().swap(buffer);
+}
+
+#else
+
+bool MappedFile::open(const string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            mapped = static_cast<const unsigned char*>(view);
+            mappedSize = (size_t)st.st_size;
+            ::close(fd);
+            return true;
+        }
+    }
+    // Not mappable: read it in
+    unsigned char chunk[65536];
+    ssize_t got;
+    while ((got = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer.insert(buffer.end(), chunk, chunk + got);
+    }
+    ::close(fd);
+    return got == 0;
+}
+
+void MappedFile::close() {
+    if (mapped != nullptr) {
+        munmap(const_cast<unsigned char*>(mapped), mappedSize);
+    }
+    mapped = nullptr;
+    mappedSize = 0;
+    vector<unsigned char>().swap(buffer);
+}
+
+#endif
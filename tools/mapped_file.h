@@ -0,0 +1,36 @@
+// mapped_file.h
+//
+// Read-only view of a whole input file for the native import tools.
+// Regular files are memory-mapped, so large SoundFonts and sample archives
+// are paged in on demand instead of being read up front; anything that
+// cannot be mapped is read into memory instead.
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+
+    const unsigned char* data() const { return mapped != nullptr ? mapped : buffer.data(); }
+    size_t size() const { return mapped != nullptr ? mappedSize : buffer.size(); }
+
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    void* mapping = nullptr;    // Mapping object, where the OS has one
+    const unsigned char* mapped = nullptr;
+    size_t mappedSize = 0;
+    std::vector<unsigned char> buffer;
+};
+
+#endif
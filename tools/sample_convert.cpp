@@ -0,0 +1,127 @@
+// sample_convert.cpp
+//
+// Conversions behind sample_convert.h. Each SSE2 loop handles whole
+// vectors and leaves the tail to the scalar loop after it.
+
+#include "sample_convert.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+  #include <emmintrin.h>
+  #define SAMPLE_CONVERT_SSE2 1
+#endif
+
+using namespace std;
+
+void swap16(const void* src, void* dest, size_t count) {
+    const unsigned char* in = static_cast<const unsigned char*>(src);
+    unsigned char* out = static_cast<unsigned char*>(dest);
+    size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 2), v);
+    }
+#endif
+    for (; i < count; i++) {
+        unsigned char high = in[i * 2];
+        out[i * 2] = in[i * 2 + 1];
+        out[i * 2 + 1] = high;
+    }
+}
+
+void widen_8bit(const unsigned char* src, int16_t* dest, size_t count, bool isUnsigned) {
+    size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+    const __m128i bias = _mm_set1_epi8(isUnsigned ? (char)0x80 : 0);
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)), bias);
+        // Each byte into the high half of a word, then shift down with sign
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i + 8), _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8));
+    }
+#endif
+    for (; i < count; i++) {
+        dest[i] = isUnsigned ? (int16_t)(src[i] - 128) : (int16_t)(int8_t)src[i];
+    }
+}
+
+void rescale_to_16bit(const int16_t* src, int16_t* dest, size_t count, int fromBits) {
+    const int shift = fromBits - 1;
+    const int half = 1 << (fromBits - 2);
+    size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+    const __m128i scale = _mm_set1_epi16(32767);
+    const __m128i round = _mm_set1_epi32(half);
+    const __m128i count32 = _mm_cvtsi32_si128(shift);
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Full 32-bit products from the low and high halves
+        __m128i low = _mm_mullo_epi16(v, scale);
+        __m128i high = _mm_mulhi_epi16(v, scale);
+        __m128i a = _mm_sra_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low, high), round), count32);
+        __m128i b = _mm_sra_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low, high), round), count32);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        dest[i] = (int16_t)((src[i] * 32767 + half) >> shift);
+    }
+}
+
+void to_double(const int16_t* src, double* dest, size_t count, int fromBits) {
+    // A power of two, so multiplying gives exactly what dividing would
+    const double scale = 1.0 / (1 << (fromBits - 1));
+    size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+    const __m128d scale2 = _mm_set1_pd(scale);
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        _mm_storeu_pd(dest + i, _mm_mul_pd(_mm_cvtepi32_pd(wide), scale2));
+        _mm_storeu_pd(dest + i + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(wide, 8)), scale2));
+    }
+#endif
+    for (; i < count; i++) {
+        dest[i] = src[i] * scale;
+    }
+}
+
+#if defined(SAMPLE_CONVERT_SSE2)
+// Two doubles to ints with the scalar loop's clamp and floor; SSE2 has no
+// floor, so truncate and step down where that rounded up
+static __m128i quantize2(__m128d x, __m128d scale, __m128d low, __m128d high) {
+    const __m128d one = _mm_set1_pd(1.0);
+    x = _mm_min_pd(_mm_max_pd(x, _mm_set1_pd(-1.0)), one);
+    __m128d y = _mm_add_pd(_mm_mul_pd(x, scale), _mm_set1_pd(0.5));
+    __m128d t = _mm_cvtepi32_pd(_mm_cvttpd_epi32(y));
+    t = _mm_sub_pd(t, _mm_and_pd(_mm_cmpgt_pd(t, y), one));
+    return _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(t, low), high));
+}
+#endif
+
+void quantize(const double* src, int16_t* dest, size_t count, int toBits) {
+    const double scale = toBits == 8 ? 128.0 : 32767.0;
+    const double low = toBits == 8 ? -128.0 : -32768.0;
+    const double high = toBits == 8 ? 127.0 : 32767.0;
+    size_t i = 0;
+#if defined(SAMPLE_CONVERT_SSE2)
+    const __m128d scale2 = _mm_set1_pd(scale);
+    const __m128d low2 = _mm_set1_pd(low);
+    const __m128d high2 = _mm_set1_pd(high);
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = quantize2(_mm_loadu_pd(src + i), scale2, low2, high2);
+        __m128i b = quantize2(_mm_loadu_pd(src + i + 2), scale2, low2, high2);
+        __m128i both = _mm_unpacklo_epi64(a, b);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + i), _mm_packs_epi32(both, both));
+    }
+#endif
+    for (; i < count; i++) {
+        double x = src[i] < -1.0 ? -1.0 : (src[i] > 1.0 ? 1.0 : src[i]);
+        double value = floor(x * scale + 0.5);
+        dest[i] = (int16_t)(value < low ? low : (value > high ? high : value));
+    }
+}
@@ -0,0 +1,36 @@
+// sample_convert.h
+//
+// Bulk sample conversions for the native IFF converter, with SSE2 paths
+// where the compiler targets it (always on x86-64) and plain loops
+// everywhere else. Both give identical results.
+//
+// The scalings match importers/PakettiIFFLoader.lua, which reads n-bit
+// samples as v / 2^(n-1) and writes 16-bit samples as
+// floor(x * 32767 + 0.5) and 8-bit samples as floor(x * 128 + 0.5),
+// clamped, so a batch converted natively comes out the same as one
+// converted in Lua.
+
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Swap the bytes of count 16-bit words: big-endian to host order and back
+void swap16(const void* src, void* dest, size_t count);
+
+// Sign-extend count 8-bit samples; unsigned input (WAV) is re-centred first
+void widen_8bit(const unsigned char* src, int16_t* dest, size_t count, bool isUnsigned);
+
+// Samples of fromBits (8 or 16) to 16-bit the way the Lua converter
+// writes them: floor(v / 2^(fromBits-1) * 32767 + 0.5)
+void rescale_to_16bit(const int16_t* src, int16_t* dest, size_t count, int fromBits);
+
+// Samples of fromBits to normalised doubles, v / 2^(fromBits-1)
+void to_double(const int16_t* src, double* dest, size_t count, int fromBits);
+
+// Normalised doubles to toBits (8 or 16) with the Lua writer's clamping
+// and rounding. 8-bit results are left in the low byte range of dest.
+void quantize(const double* src, int16_t* dest, size_t count, int toBits);
+
+#endif
@@ -0,0 +1,269 @@
+// sf2_file.cpp
+//
+// SoundFont 2 parsing and preset resolution. See sf2_file.h.
+
+#include "sf2_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+uint16_t read_u16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t read_u32(const unsigned char* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 20-byte name field, trimmed of NULs and surrounding spaces like the
+// Lua importer's trim_string
+string read_name(const unsigned char* p) {
+    string name(reinterpret_cast<const char*>(p), strnlen(reinterpret_cast<const char*>(p), 20));
+    size_t first = name.find_first_not_of(" \t\r\n");
+    if (first == string::npos) {
+        return string();
+    }
+    size_t last = name.find_last_not_of(" \t\r\n");
+    return name.substr(first, last - first + 1);
+}
+
+struct Chunk {
+    char id[4];
+    const unsigned char* data;
+    size_t size;
+};
+
+// Split [data, data + size) into RIFF chunks; chunks are padded to even
+// sizes. A chunk running past the end is cut short and ends the walk.
+void read_chunks(const unsigned char* data, size_t size, vector<Chunk>& chunks) {
+    size_t pos = 0;
+    while (pos + 8 <= size) {
+        Chunk chunk;
+        memcpy(chunk.id, data + pos, 4);
+        chunk.size = read_u32(data + pos + 4);
+        chunk.data = data + pos + 8;
+        if (chunk.size > size - pos - 8) {
+            chunk.size = size - pos - 8;
+            chunks.push_back(chunk);
+            return;
+        }
+        chunks.push_back(chunk);
+        pos += 8 + chunk.size + (chunk.size & 1);
+    }
+}
+
+bool is_id(const Chunk& chunk, const char* id) {
+    return memcmp(chunk.id, id, 4) == 0;
+}
+
+// A LIST chunk of the given type, split into its subchunks
+bool read_list(const vector<Chunk>& chunks, const char* type, vector<Chunk>& subchunks) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (is_id(chunks[i], "LIST") && chunks[i].size >= 4 && memcmp(chunks[i].data, type, 4) == 0) {
+            read_chunks(chunks[i].data + 4, chunks[i].size - 4, subchunks);
+            return true;
+        }
+    }
+    return false;
+}
+
+const Chunk* find_chunk(const vector<Chunk>& chunks, const char* id) {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        if (is_id(chunks[i], id)) {
+            return &chunks[i];
+        }
+    }
+    return nullptr;
+}
+
+void read_bags(const Chunk* chunk, vector<Sf2Bag>& bags) {
+    for (size_t pos = 0; chunk != nullptr && pos + 4 <= chunk->size; pos += 4) {
+        Sf2Bag bag;
+        bag.genIndex = read_u16(chunk->data + pos);
+        bag.modIndex = read_u16(chunk->data + pos + 2);
+        bags.push_back(bag);
+    }
+}
+
+void read_gens(const Chunk* chunk, vector<Sf2Generator>& gens) {
+    for (size_t pos = 0; chunk != nullptr && pos + 4 <= chunk->size; pos += 4) {
+        Sf2Generator gen;
+        gen.op = read_u16(chunk->data + pos);
+        gen.amount = read_u16(chunk->data + pos + 2);
+        gens.push_back(gen);
+    }
+}
+
+// Generators of bag index bag: up to the next bag's first generator, or
+// to the end of the list for the last bag
+void bag_gens(const vector<Sf2Bag>& bags, const vector<Sf2Generator>& gens, size_t bag, vector<Sf2Generator>& out) {
+    out.clear();
+    if (bag >= bags.size()) {
+        return;
+    }
+    size_t begin = bags[bag].genIndex;
+    size_t end = bag + 1 < bags.size() ? bags[bag + 1].genIndex : gens.size();
+    for (size_t g = begin; g < end && g < gens.size(); g++) {
+        out.push_back(gens[g]);
+    }
+}
+
+bool find_gen(const vector<Sf2Generator>& gens, uint16_t op, uint16_t& amount) {
+    bool found = false;
+    for (size_t i = 0; i < gens.size(); i++) {
+        if (gens[i].op == op) {
+            amount = gens[i].amount;
+            found = true;
+        }
+    }
+    return found;
+}
+
+string lower(const string& text) {
+    string out = text;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] >= 'A' && out[i] <= 'Z') out[i] = (char)(out[i] - 'A' + 'a');
+    }
+    return out;
+}
+
+} // namespace
+
+bool parse_sf2(const unsigned char* data, size_t size, Sf2File& file, string& error) {
+    file = Sf2File();
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "sfbk", 4) != 0) {
+        error = "not a SoundFont 2 file";
+        return false;
+    }
+    size_t riffSize = min<size_t>(read_u32(data + 4), size - 8);
+    vector<Chunk> chunks;
+    read_chunks(data + 12, riffSize >= 4 ? riffSize - 4 : 0, chunks);
+
+    vector<Chunk> sdta;
+    vector<Chunk> pdta;
+    if (!read_list(chunks, "sdta", sdta) || !read_list(chunks, "pdta", pdta)) {
+        error = "missing sdta or pdta chunk";
+        return false;
+    }
+    const Chunk* smpl = find_chunk(sdta, "smpl");
+    if (smpl == nullptr) {
+        error = "missing smpl chunk";
+        return false;
+    }
+    file.smpl = smpl->data;
+    file.smplBytes = smpl->size;
+    const Chunk* sm24 = find_chunk(sdta, "sm24");
+    if (sm24 != nullptr) {
+        file.sm24 = sm24->data;
+        file.sm24Bytes = sm24->size;
+    }
+
+    const Chunk* phdr = find_chunk(pdta, "phdr");
+    for (size_t pos = 0; phdr != nullptr && pos + 38 <= phdr->size; pos += 38) {
+        Sf2Preset preset;
+        preset.name = read_name(phdr->data + pos);
+        preset.preset = read_u16(phdr->data + pos + 20);
+        preset.bank = read_u16(phdr->data + pos + 22);
+        preset.bagIndex = read_u16(phdr->data + pos + 24);
+        file.presets.push_back(preset);
+    }
+    read_bags(find_chunk(pdta, "pbag"), file.presetBags);
+    read_gens(find_chunk(pdta, "pgen"), file.presetGens);
+
+    const Chunk* inst = find_chunk(pdta, "inst");
+    for (size_t pos = 0; inst != nullptr && pos + 22 <= inst->size; pos += 22) {
+        Sf2Instrument instrument;
+        instrument.name = read_name(inst->data + pos);
+        instrument.bagIndex = read_u16(inst->data + pos + 20);
+        file.instruments.push_back(instrument);
+    }
+    read_bags(find_chunk(pdta, "ibag"), file.instrumentBags);
+    read_gens(find_chunk(pdta, "igen"), file.instrumentGens);
+
+    const Chunk* shdr = find_chunk(pdta, "shdr");
+    for (size_t pos = 0; shdr != nullptr && pos + 46 <= shdr->size; pos += 46) {
+        const unsigned char* p = shdr->data + pos;
+        Sf2SampleHeader sample;
+        sample.name = read_name(p);
+        sample.start = read_u32(p + 20);
+        sample.end = read_u32(p + 24);
+        sample.loopStart = read_u32(p + 28);
+        sample.loopEnd = read_u32(p + 32);
+        sample.sampleRate = read_u32(p + 36);
+        sample.originalPitch = p[40];
+        sample.pitchCorrection = (int8_t)p[41];
+        sample.link = read_u16(p + 42);
+        sample.type = read_u16(p + 44);
+        file.samples.push_back(sample);
+    }
+    if (file.sampleCount() == 0 || file.presetCount() == 0) {
+        error = "no presets or sample headers";
+        return false;
+    }
+    return true;
+}
+
+void build_zone_map(const Sf2File& file, vector<Sf2PresetMap>& presets) {
+    presets.clear();
+    vector<Sf2Generator> gens;
+    vector<Sf2Generator> instrumentGens;
+    for (size_t p = 0; p < file.presetCount(); p++) {
+        Sf2PresetMap map;
+        map.preset = p;
+        const string presetName = lower(file.presets[p].name);
+        for (size_t bag = file.presets[p].bagIndex; bag < file.presets[p + 1].bagIndex; bag++) {
+            bag_gens(file.presetBags, file.presetGens, bag, gens);
+            size_t firstZone = map.zones.size();
+
+            uint16_t instrument;
+            if (find_gen(gens, SF2_GEN_INSTRUMENT, instrument) && (size_t)instrument + 1 < file.instruments.size()) {
+                for (size_t ibag = file.instruments[instrument].bagIndex;
+                     ibag < file.instruments[instrument + 1].bagIndex; ibag++) {
+                    bag_gens(file.instrumentBags, file.instrumentGens, ibag, instrumentGens);
+                    uint16_t sampleId;
+                    if (find_gen(instrumentGens, SF2_GEN_SAMPLE_ID, sampleId) && sampleId < file.sampleCount()) {
+                        Sf2Zone zone;
+                        zone.sample = sampleId;
+                        zone.presetGens = gens;
+                        zone.instrumentGens = instrumentGens;
+                        map.zones.push_back(zone);
+                    }
+                }
+            }
+
+            uint16_t keyRange;
+            if (map.zones.size() == firstZone && find_gen(gens, SF2_GEN_KEY_RANGE, keyRange)) {
+                int low = min(119, keyRange & 0xFF);
+                int high = min(119, keyRange >> 8);
+                for (size_t s = 0; s < file.sampleCount(); s++) {
+                    int pitch = file.samples[s].originalPitch;
+                    if (pitch >= low && pitch <= high) {
+                        Sf2Zone zone;
+                        zone.sample = (int)s;
+                        zone.presetGens = gens;
+                        map.zones.push_back(zone);
+                    }
+                }
+            }
+
+            if (map.zones.size() == firstZone) {
+                for (size_t s = 0; s < file.sampleCount(); s++) {
+                    if (lower(file.samples[s].name).find(presetName) != string::npos) {
+                        Sf2Zone zone;
+                        zone.sample = (int)s;
+                        zone.presetGens = gens;
+                        map.zones.push_back(zone);
+                    }
+                }
+            }
+            map.lastZoneGens = gens;
+        }
+        if (!map.zones.empty()) {
+            presets.push_back(map);
+        }
+    }
+}
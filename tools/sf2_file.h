@@ -0,0 +1,109 @@
+// sf2_file.h
+//
+// SoundFont 2 parsing for the native extractor. parse_sf2 walks the RIFF
+// chunks once and copies the pdta "hydra" (presets, instruments, their
+// bags and generators, sample headers) into flat arrays. The sample data
+// in sdta is not copied: smpl and sm24 point into the caller's buffer,
+// which is normally a memory-mapped file.
+//
+// build_zone_map resolves presets to the samples they play, the way
+// importers/PakettiSF2Loader.lua always has:
+//   - a preset zone naming an instrument contributes every instrument
+//     zone that names a sample
+//   - a preset zone that got no samples that way but has a key range
+//     takes every sample whose original pitch is inside the range
+//   - failing both, every sample whose name contains the preset name
+//     (case-insensitive)
+// Generators are kept in file order; as in the Lua importer, a later
+// generator with the same operator wins.
+
+#ifndef SF2_FILE_H
+#define SF2_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Generator operators the zone map cares about
+const uint16_t SF2_GEN_KEY_RANGE = 43;
+const uint16_t SF2_GEN_INSTRUMENT = 41;
+const uint16_t SF2_GEN_SAMPLE_ID = 53;
+
+struct Sf2Generator {
+    uint16_t op;
+    uint16_t amount;
+};
+
+struct Sf2Bag {
+    uint16_t genIndex;
+    uint16_t modIndex;
+};
+
+struct Sf2Preset {
+    std::string name;
+    uint16_t preset;
+    uint16_t bank;
+    uint16_t bagIndex;
+};
+
+struct Sf2Instrument {
+    std::string name;
+    uint16_t bagIndex;
+};
+
+struct Sf2SampleHeader {
+    std::string name;
+    uint32_t start;             // Sample points into smpl
+    uint32_t end;
+    uint32_t loopStart;
+    uint32_t loopEnd;
+    uint32_t sampleRate;
+    uint8_t originalPitch;
+    int8_t pitchCorrection;     // Cents
+    uint16_t link;
+    uint16_t type;
+};
+
+struct Sf2File {
+    // Sample data inside the parsed buffer; sm24 is null without 24-bit data
+    const unsigned char* smpl = nullptr;
+    size_t smplBytes = 0;
+    const unsigned char* sm24 = nullptr;
+    size_t sm24Bytes = 0;
+
+    // The hydra, each list including its terminal record
+    std::vector<Sf2Preset> presets;
+    std::vector<Sf2Bag> presetBags;
+    std::vector<Sf2Generator> presetGens;
+    std::vector<Sf2Instrument> instruments;
+    std::vector<Sf2Bag> instrumentBags;
+    std::vector<Sf2Generator> instrumentGens;
+    std::vector<Sf2SampleHeader> samples;
+
+    size_t presetCount() const { return presets.empty() ? 0 : presets.size() - 1; }
+    size_t sampleCount() const { return samples.empty() ? 0 : samples.size() - 1; }
+    bool is24Bit(const Sf2SampleHeader& sample) const {
+        return sm24 != nullptr && sample.end <= sm24Bytes;
+    }
+};
+
+// Returns false with a message in error when data is not a usable SF2
+bool parse_sf2(const unsigned char* data, size_t size, Sf2File& file, std::string& error);
+
+struct Sf2Zone {
+    int sample = -1;
+    std::vector<Sf2Generator> presetGens;
+    std::vector<Sf2Generator> instrumentGens;   // Empty for the key range and name fallbacks
+};
+
+struct Sf2PresetMap {
+    size_t preset = 0;              // Index into Sf2File::presets
+    std::vector<Sf2Generator> lastZoneGens;
+    std::vector<Sf2Zone> zones;
+};
+
+// Presets that end up with at least one sample, in file order
+void build_zone_map(const Sf2File& file, std::vector<Sf2PresetMap>& presets);
+
+#endif
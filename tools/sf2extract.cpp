@@ -0,0 +1,206 @@
+// sf2extract.cpp
+//
+// Extract the samples a SoundFont 2 file's presets use to WAV files, and
+// write a zone map that importers/PakettiSF2Loader.lua applies directly,
+// without reading or parsing the SoundFont itself.
+//
+//   sf2extract input.sf2 output_prefix [--jobs N]
+//
+// The file is memory-mapped. Each referenced sample header becomes
+// output_prefix_<sample index>.wav: 16-bit sample data is written
+// straight from the mapped smpl chunk, and with an sm24 chunk the
+// samples are widened to 24 bits. Samples are written by N worker
+// threads (default: one per core).
+//
+// The zone map, output_prefix.sf2map, is tab-separated text, one record
+// per line:
+//
+//   SF2MAP   version
+//   SAMPLE   index, frames, sample rate, original pitch, pitch correction,
+//            loop start, loop end (frames from the sample start), sample
+//            type, link, bits, name, WAV path
+//   PRESET   bank, preset, name, generators of the preset's last zone
+//   ZONE     sample index, preset zone generators, instrument zone
+//            generators
+//
+// Generator lists are "op:amount" pairs separated by spaces, "-" when
+// empty. ZONE records belong to the PRESET before them. They include the
+// key range and sample name fallbacks of build_zone_map (sf2_file.h),
+// whose instrument zone generators are "-". Only samples
+// with a WAV get a SAMPLE record; zones naming any other sample should
+// be skipped. stdout gets "OK\t<samples>\t<presets>\t<map path>", or
+// "ERR\t<sample index>\t<reason>" for each sample that failed.
+
+#include "mapped_file.h"
+#include "sf2_file.h"
+#include "wav_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+const unsigned int SF2MAP_VERSION = 1;
+
+// Keep names from breaking the line format
+static string clean_field(const string& text) {
+    string out = text;
+    for (size_t i = 0; i < out.size(); i++) {
+        if (out[i] == '\t' || out[i] == '\r' || out[i] == '\n') out[i] = ' ';
+    }
+    return out;
+}
+
+static string gen_list(const vector<Sf2Generator>& gens) {
+    if (gens.empty()) {
+        return "-";
+    }
+    string out;
+    for (size_t i = 0; i < gens.size(); i++) {
+        if (i > 0) out += ' ';
+        out += to_string(gens[i].op) + ":" + to_string(gens[i].amount);
+    }
+    return out;
+}
+
+static string wav_path_for(const string& prefix, size_t sample) {
+    return prefix + "_" + to_string(sample) + ".wav";
+}
+
+static bool write_sample(const Sf2File& file, const Sf2SampleHeader& sample, const string& path, string& error) {
+    if ((size_t)sample.end * 2 > file.smplBytes) {
+        error = "sample data past the end of smpl";
+        return false;
+    }
+    size_t frames = sample.end - sample.start;
+    WavFormat format;
+    format.channels = 1;
+    format.sampleRate = sample.sampleRate > 0 ? (int)sample.sampleRate : 44100;
+    const unsigned char* pcm16 = file.smpl + (size_t)sample.start * 2;
+    bool ok;
+    if (file.is24Bit(sample)) {
+        // sm24 holds the low byte of each 24-bit sample
+        format.bits = 24;
+        const unsigned char* low = file.sm24 + sample.start;
+        vector<unsigned char> pcm24(frames * 3);
+        for (size_t i = 0; i < frames; i++) {
+            pcm24[i * 3] = low[i];
+            pcm24[i * 3 + 1] = pcm16[i * 2];
+            pcm24[i * 3 + 2] = pcm16[i * 2 + 1];
+        }
+        ok = write_wav_file(path, format, pcm24.data(), pcm24.size());
+    } else {
+        format.bits = 16;
+        ok = write_wav_file(path, format, pcm16, frames * 2);
+    }
+    if (!ok) {
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+static void print_usage(const char* program) {
+    cerr << "Usage: " << program << " input.sf2 output_prefix [--jobs N]" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && !(argc == 5 && strcmp(argv[3], "--jobs") == 0)) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const string inputPath = argv[1];
+    const string prefix = argv[2];
+    int jobs = argc == 5 ? atoi(argv[4]) : (int)thread::hardware_concurrency();
+    jobs = max(1, jobs);
+
+    MappedFile input;
+    if (!input.open(inputPath)) {
+        cerr << "Cannot read " << inputPath << endl;
+        return 1;
+    }
+    Sf2File file;
+    string error;
+    if (!parse_sf2(input.data(), input.size(), file, error)) {
+        cerr << inputPath << ": " << error << endl;
+        return 1;
+    }
+    vector<Sf2PresetMap> presets;
+    build_zone_map(file, presets);
+
+    // Each referenced sample is written once, however many zones use it.
+    // Empty headers get no WAV, so the importer skips their zones.
+    vector<char> referenced(file.sampleCount(), 0);
+    for (size_t p = 0; p < presets.size(); p++) {
+        for (size_t z = 0; z < presets[p].zones.size(); z++) {
+            referenced[presets[p].zones[z].sample] = 1;
+        }
+    }
+    vector<size_t> work;
+    for (size_t s = 0; s < referenced.size(); s++) {
+        if (referenced[s] && file.samples[s].end > file.samples[s].start) work.push_back(s);
+    }
+
+    vector<char> written(file.sampleCount(), 0);
+    vector<string> errors(file.sampleCount());
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    int workerCount = (int)min<size_t>(jobs, max<size_t>(1, work.size()));
+    for (int w = 0; w < workerCount; w++) {
+        workers.push_back(thread([&]() {
+            size_t i;
+            while ((i = next++) < work.size()) {
+                size_t s = work[i];
+                written[s] = write_sample(file, file.samples[s], wav_path_for(prefix, s), errors[s]) ? 1 : 0;
+            }
+        }));
+    }
+    for (size_t w = 0; w < workers.size(); w++) {
+        workers[w].join();
+    }
+
+    const string mapPath = prefix + ".sf2map";
+    FILE* map = fopen(mapPath.c_str(), "wb");
+    if (map == nullptr) {
+        cerr << "Cannot write " << mapPath << endl;
+        return 1;
+    }
+    fprintf(map, "SF2MAP\t%u\n", SF2MAP_VERSION);
+    int samplesWritten = 0;
+    for (size_t i = 0; i < work.size(); i++) {
+        size_t s = work[i];
+        if (!written[s]) {
+            cout << "ERR\t" << s << "\t" << errors[s] << endl;
+            continue;
+        }
+        const Sf2SampleHeader& sample = file.samples[s];
+        fprintf(map, "SAMPLE\t%u\t%u\t%u\t%d\t%d\t%lld\t%lld\t%u\t%u\t%d\t%s\t%s\n", (unsigned)s, sample.end - sample.start,
+                sample.sampleRate, sample.originalPitch, sample.pitchCorrection,
+                (long long)sample.loopStart - sample.start, (long long)sample.loopEnd - sample.start, sample.type,
+                sample.link, file.is24Bit(sample) ? 24 : 16, clean_field(sample.name).c_str(),
+                wav_path_for(prefix, s).c_str());
+        samplesWritten++;
+    }
+    for (size_t p = 0; p < presets.size(); p++) {
+        const Sf2Preset& preset = file.presets[presets[p].preset];
+        fprintf(map, "PRESET\t%u\t%u\t%s\t%s\n", preset.bank, preset.preset, clean_field(preset.name).c_str(),
+                gen_list(presets[p].lastZoneGens).c_str());
+        for (size_t z = 0; z < presets[p].zones.size(); z++) {
+            const Sf2Zone& zone = presets[p].zones[z];
+            fprintf(map, "ZONE\t%d\t%s\t%s\n", zone.sample, gen_list(zone.presetGens).c_str(),
+                    gen_list(zone.instrumentGens).c_str());
+        }
+    }
+    if (fclose(map) != 0) {
+        cerr << "Cannot write " << mapPath << endl;
+        return 1;
+    }
+    cout << "OK\t" << samplesWritten << "\t" << presets.size() << "\t" << mapPath << endl;
+    return samplesWritten == (int)work.size() ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+// wav_file.cpp
+//
+// WAV writer behind wav_file.h.
+
+#include "wav_file.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+void put_le16(unsigned char* p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+void put_le32(unsigned char* p, unsigned int v) {
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+} // namespace
+
+size_t wav_header_bytes(const WavFormat& format) {
+    // Float files carry an 18-byte fmt chunk and a fact chunk
+    return format.isFloat ? 58 : 44;
+}
+
+void build_wav_header(const WavFormat& format, size_t dataBytes, unsigned char* header) {
+    unsigned int blockAlign = format.channels * (format.bits / 8);
+    unsigned int fmtBytes = format.isFloat ? 18 : 16;
+    unsigned char* p = header;
+    memcpy(p, "RIFF", 4);
+    memcpy(p + 8, "WAVEfmt ", 8);
+    put_le32(p + 16, fmtBytes);
+    put_le16(p + 20, format.isFloat ? 3 : 1); // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+    put_le16(p + 22, format.channels);
+    put_le32(p + 24, format.sampleRate);
+    put_le32(p + 28, format.sampleRate * blockAlign);
+    put_le16(p + 32, blockAlign);
+    put_le16(p + 34, format.bits);
+    p += 20 + fmtBytes;
+    if (format.isFloat) {
+        put_le16(p - 2, 0); // cbSize
+        memcpy(p, "fact", 4);
+        put_le32(p + 4, 4);
+        put_le32(p + 8, blockAlign ? (unsigned int)(dataBytes / blockAlign) : 0);
+        p += 12;
+    }
+    memcpy(p, "data", 4);
+    put_le32(p + 4, (unsigned int)dataBytes);
+    p += 8;
+    put_le32(header + 4, (unsigned int)(p - header - 8 + dataBytes + (dataBytes & 1)));
+}
+
+bool write_wav_file(const string& path, const WavFormat& format, const void* data, size_t dataBytes) {
+    unsigned char header[58];
+    size_t headerBytes = wav_header_bytes(format);
+    build_wav_header(format, dataBytes, header);
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(header, 1, headerBytes, file) == headerBytes &&
+              (dataBytes == 0 || fwrite(data, 1, dataBytes, file) == dataBytes);
+    // Odd-sized data chunks are padded to a word boundary
+    if (ok && (dataBytes & 1)) {
+        ok = fputc(0, file) != EOF;
+    }
+    return fclose(file) == 0 && ok;
+}
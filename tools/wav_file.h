@@ -0,0 +1,30 @@
+// wav_file.h
+//
+// Minimal WAV writer shared by the native import tools. The caller hands
+// over sample data already in WAV encoding (unsigned 8-bit, signed
+// little-endian 16/24/32-bit, or 32-bit float), interleaved.
+
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <cstddef>
+#include <string>
+
+struct WavFormat {
+    int channels = 1;
+    int sampleRate = 44100;
+    int bits = 16;
+    bool isFloat = false;
+};
+
+// Bytes of the RIFF header write_wav_file puts in front of the data
+size_t wav_header_bytes(const WavFormat& format);
+
+// Build the header for dataBytes of sample data into header, which must
+// hold wav_header_bytes(format) bytes
+void build_wav_header(const WavFormat& format, size_t dataBytes, unsigned char* header);
+
+// Write header and data in one go. Returns false on any I/O error.
+bool write_wav_file(const std::string& path, const WavFormat& format, const void* data, size_t dataBytes);
+
+#endif